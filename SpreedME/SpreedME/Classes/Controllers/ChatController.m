@@ -537,24 +537,21 @@ NSString * const kChatControllerUserSessionIdKey		= @"kChatControllerUserSession
 
 - (void)chatViewController:(STChatViewController *)chatViewController wantsToShareMediaWithInfo:(NSDictionary *)info
 {
-	[self tempFileForAssetFromMediaInfo:info completionBlock:^(NSString *filePath) {
-        NSString* fileName = [filePath lastPathComponent];
-        [self startSharingFileAtPath:filePath withFileName:fileName];
-		spreed_me_log("Created temp file %s for upload %s", [filePath cDescription], [info cDescription]);
-	} failureBlock:^(NSError *error) {
-		spreed_me_log("Failed to create temp file for upload: %s", [error cDescription]);
-	}];
+	[self shareAssetFromMediaInfo:info];
 }
 
 
 - (void)chatViewController:(STChatViewController *)chatViewController wantsToShareFileAtPath:(NSString *)filePath
 {
-    NSString *tempFile = [self tempFilePathFromFilePath:filePath];
     NSString* fileName = [filePath lastPathComponent];
-    
-    if (tempFile) {
-        [self startSharingFileAtPath:tempFile withFileName:fileName];
+    if ([[FileSharingManagerObjC defaultManager] isEncryptedDownloadedFileAtPath:fileName]) {
+        fileName = [fileName stringByDeletingPathExtension];
     }
+    
+    [[FileSharingManagerObjC defaultManager] startSharingCloneOfFileAtPath:filePath
+                                                                  fileName:fileName
+                                                                  fileType:[self MIMETypeForFileName:fileName]
+                                                                  forUsers:[self usersToShareFilesWith]];
 }
 
 
@@ -564,21 +561,25 @@ NSString * const kChatControllerUserSessionIdKey		= @"kChatControllerUserSession
 }
 
 
-- (void)startSharingFileAtPath:(NSString *)filePath  withFileName:(NSString*)fileName
+- (NSString *)MIMETypeForFileName:(NSString *)fileName
 {
-    CFStringRef fileExtension = (__bridge CFStringRef)[filePath pathExtension];
+    CFStringRef fileExtension = (__bridge CFStringRef)[fileName pathExtension];
     CFStringRef UTI = UTTypeCreatePreferredIdentifierForTag(kUTTagClassFilenameExtension, fileExtension, NULL);
     CFStringRef MIMEType = UTTypeCopyPreferredTagWithClass(UTI, kUTTagClassMIMEType);
     CFRelease(UTI);
-    NSString *MIMETypeString = (__bridge_transfer NSString *)MIMEType;
-    
+    return (__bridge_transfer NSString *)MIMEType;
+}
+
+
+- (NSSet *)usersToShareFilesWith
+{
     NSSet *users = nil;
     
     if (![_userActivityManager.userSessionId isEqualToString:[UsersManager defaultManager].currentUser.room.name]) {
         users = [NSSet setWithObject:_userActivityManager.userSessionId];
     }
     
-    [[FileSharingManagerObjC defaultManager] startSharingFileAtPath:filePath fileName:fileName fileType:MIMETypeString fileIsTemporary:YES forUsers:users];
+    return users;
 }
 
 
@@ -668,6 +669,8 @@ NSString * const kChatControllerUserSessionIdKey		= @"kChatControllerUserSession
 {
 	NSString *fileToken = [notification.userInfo objectForKey:kFileTokenUserInfoKey];
 	uint64_t downloadProgress = [[notification.userInfo objectForKey:kFileDownloadProgressUserInfoKey] unsignedLongLongValue];
+	NSNumber *downloadRate = [notification.userInfo objectForKey:kFileDownloadRateUserInfoKey];
+	NSNumber *timeLeft = [notification.userInfo objectForKey:kFileDownloadTimeLeftUserInfoKey];
 	
 	NSInteger index = [[_fileSharingActivities objectForKey:fileToken] integerValue];
 	if (index > -1) {
@@ -676,6 +679,8 @@ NSString * const kChatControllerUserSessionIdKey		= @"kChatControllerUserSession
 			if ([message isKindOfClass:[ChatFileInfo class]]) {
 				ChatFileInfo *fileInfo = (ChatFileInfo *)message;
 				fileInfo.downloadedBytes = downloadProgress;
+				fileInfo.sharingSpeed = downloadRate ? [downloadRate unsignedLongLongValue] : 0;
+				fileInfo.estimatedTimeLeft = timeLeft ? [timeLeft doubleValue] : -1.0;
 				
 				[self.chatViewController updateChatMessageStateAtIndex:index];
 			}
@@ -686,82 +691,62 @@ NSString * const kChatControllerUserSessionIdKey		= @"kChatControllerUserSession
 
 #pragma mark - FileSharing
 
-- (void)tempFileForAssetFromMediaInfo:(NSDictionary *)info completionBlock:(void (^)(NSString *filePath))complBlock failureBlock:(void (^)(NSError *error))failureBlock
+// Asset is read straight from photo library when peers request chunks, nothing is copied to disk.
+- (void)shareAssetFromMediaInfo:(NSDictionary *)info
 {
 	NSURL *assetUrl = [info objectForKey:UIImagePickerControllerReferenceURL];
+	if (!assetUrl) {
+		return;
+	}
 	
 	NSString *surl = [assetUrl absoluteString];
     NSString *ext = [surl substringFromIndex:[surl rangeOfString:@"ext="].location + 4];
     NSTimeInterval ti = [[NSDate date]timeIntervalSinceReferenceDate];
-    NSString *filename = [NSString stringWithFormat: @"%f.%@",ti,ext];
-    NSString *tmpfile = [NSTemporaryDirectory() stringByAppendingPathComponent:filename];
+    NSString *fileName = [NSString stringWithFormat: @"%f.%@",ti,ext];
+	
+	// Library has to outlive asset representation, so read block keeps it
+	ALAssetsLibrary *assetslibrary = [[ALAssetsLibrary alloc] init];
 	
     ALAssetsLibraryAssetForURLResultBlock resultblock = ^(ALAsset *myasset)
     {
-        ALAssetRepresentation * rep = [myasset defaultRepresentation];
-		
-        NSUInteger size = [rep size];
-        const int bufferSize = 8192;
-		
-        spreed_me_log("Writing to %s", [tmpfile cDescription]);
-		NSOutputStream *fileStream = [NSOutputStream outputStreamToFileAtPath:tmpfile append:YES];
-		[fileStream open];
+        ALAssetRepresentation *rep = [myasset defaultRepresentation];
+		if (!rep) {
+			spreed_me_log("Asset %s has no representation", [surl cDescription]);
+			return;
+		}
 		
-        uint8_t *buffer = (uint8_t *)malloc(bufferSize);
-        int read = 0, offset = 0, written = 0;
-        NSError* err;
-        if (size != 0) {
-            do {
-                read = [rep getBytes:buffer
-                          fromOffset:offset
-                              length:bufferSize
-                               error:&err];
-				written = [fileStream write:buffer maxLength:read];
-                offset += read;
-            } while (read != 0);
-        }
-		[fileStream close];
-		free(buffer);
+		SMFileChunkReadBlock readBlock = ^BOOL(uint8_t *buffer, uint64_t offset, NSUInteger length) {
+			__unused ALAssetsLibrary *library = assetslibrary; // captured to keep library alive
+			NSUInteger totalRead = 0;
+			while (totalRead < length) {
+				NSError *err = nil;
+				NSUInteger read = [rep getBytes:buffer + totalRead fromOffset:(long long)(offset + totalRead) length:length - totalRead error:&err];
+				if (read == 0) {
+					spreed_me_log("Couldn't read asset %s: %s", [surl cDescription], [err cDescription]);
+					return NO;
+				}
+				totalRead += read;
+			}
+			return YES;
+		};
 		
-		if (complBlock){
-			complBlock(tmpfile);
-		}
+		[[FileSharingManagerObjC defaultManager] startSharingDataOfSize:(uint64_t)[rep size]
+															  readBlock:readBlock
+															   fileName:fileName
+															   fileType:[self MIMETypeForFileName:fileName]
+															   forUsers:[self usersToShareFilesWith]];
+		spreed_me_log("Sharing asset %s as %s", [surl cDescription], [fileName cDescription]);
     };
 	
 	
     ALAssetsLibraryAccessFailureBlock failureblock  = ^(NSError *error)
     {
         spreed_me_log("Can not get asset - %s",[[error localizedDescription] cDescription]);
-		if (failureBlock) {
-			failureBlock(error);
-		}
     };
 	
-    if(assetUrl)
-    {
-        ALAssetsLibrary* assetslibrary = [[ALAssetsLibrary alloc] init];
-        [assetslibrary assetForURL:assetUrl
-                       resultBlock:resultblock
-                      failureBlock:failureblock];
-    }
-}
-
-
-- (NSString *)tempFilePathFromFilePath:(NSString *)filePath
-{
-    NSError *error;
-    NSString* fileName = [filePath lastPathComponent];
-    NSTimeInterval ti = [[NSDate date]timeIntervalSinceReferenceDate];
-    NSString *tempFileName = [NSString stringWithFormat: @"%f.%@",ti,fileName];
-    NSString *tmpFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:tempFileName];
-    
-    if ([[NSFileManager defaultManager] copyItemAtPath:filePath toPath:tmpFilePath error:&error]) {
-        spreed_me_log("Copy %s to temp folder correctly", [fileName cDescription]);
-    } else {
-        spreed_me_log("Failed copying %s to temp. %s", [fileName cDescription], [error.localizedDescription cDescription]);
-        return nil;
-    }
-    return tmpFilePath;
+	[assetslibrary assetForURL:assetUrl
+				   resultBlock:resultblock
+				  failureBlock:failureblock];
 }
 
 
@@ -27,9 +27,12 @@
 #import "SMVideoDevice.h"
 
 
+extern NSString * const CallHasStartedNotification;
 extern NSString * const CallIsFinishedNotification;
 
 extern NSString * const UserHasLeftCallNotification;
+// userInfo contains kUserSessionIdKey of dominant remote speaker or is nil if there is none.
+extern NSString * const DominantSpeakerChangedNotification;
 extern NSString * const kUserSessionIdKey; 
 
 
@@ -130,6 +133,10 @@ typedef enum : NSInteger {
 - (void)muteAudio:(BOOL)mute;
 - (void)muteVideo:(BOOL)mute;
 
+// Call this when remote video view goes off screen (visible == NO) or is shown at given size.
+// Video of invisible users is not decoded and they are asked to send smaller video.
+- (void)setRemoteVideoVisible:(BOOL)visible size:(CGSize)size forUserSessionId:(NSString *)userSessionId;
+
 - (int)calculateMaxNumberOfVideoConnections;
 
 - (void)setVideoPreferencesWithCamera:(NSString *)camera
@@ -60,14 +60,24 @@
 using namespace spreedme;
 
 
+NSString * const CallHasStartedNotification		= @"CallHasStartedNotification";
 NSString * const CallIsFinishedNotification		= @"CallIsFinishedNotification";
 NSString * const UserHasLeftCallNotification	= @"UserHasLeftCallNotification";
+NSString * const DominantSpeakerChangedNotification	= @"DominantSpeakerChangedNotification";
 NSString * const kUserSessionIdKey = @"UserSessionIdKey";
 
 
 NSString *const kCallTimerIncomingKey		= @"Incoming";
 NSString *const kCallTimerUserSessionIdKey	= @"UserSessionId";
 
+// Hidden debug setting. When set every call records its telemetry to Caches/CallTelemetry.
+NSString *const kSMCallTelemetryRecordingEnabledKey	= @"SMCallTelemetryRecordingEnabled";
+const size_t kCallTelemetryMaxFileSize		= 1024 * 1024;
+const int kCallTelemetryMaxRotatedFiles		= 4;
+
+// Active speaker detection and telemetry work on periodic statistics snapshots.
+const int kCallStatisticsIntervalMs			= 1000;
+
 typedef std::pair<std::string, rtc::scoped_refptr<PeerConnectionWrapper> > PeerConnectionWrapperForID;
 typedef std::pair<std::string, std::string> PeerConnectionWrapperIDForUserSessionId;
 
@@ -401,6 +411,7 @@ struct ScreenSharingHandlerAndDelegatesPackage
 
 - (void)appIsInCall:(BOOL)yesNo
 {
+	BOOL callHasStarted = yesNo && !self.inCall;
 	self.inCall = yesNo;
 	[self preventDeviceSleep:yesNo];
 	[self setProximitySensorEnabled:yesNo];
@@ -410,11 +421,30 @@ struct ScreenSharingHandlerAndDelegatesPackage
 	} else {
 		[[NSNotificationCenter defaultCenter] removeObserver:self name:AVAudioSessionInterruptionNotification object:nil];
 	}
+	
+	if (callHasStarted) {
+		[[NSNotificationCenter defaultCenter] postNotificationName:CallHasStartedNotification object:self];
+	}
 }
 
 
 #pragma mark - Call handling
 
+- (void)startTelemetryRecordingForCall:(Call *)call
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	NSString *telemetryDir = [[paths firstObject] stringByAppendingPathComponent:@"CallTelemetry"];
+	NSError *error = nil;
+	if (![[NSFileManager defaultManager] createDirectoryAtPath:telemetryDir withIntermediateDirectories:YES attributes:nil error:&error]) {
+		spreed_me_log("Couldn't create call telemetry directory %s", [[error description] cStringUsingEncoding:NSUTF8StringEncoding]);
+		return;
+	}
+	
+	NSString *telemetryPath = [telemetryDir stringByAppendingPathComponent:@"telemetry.smtl"];
+	call->StartTelemetryRecording(stdStringFromNSString(telemetryPath), kCallTelemetryMaxFileSize, kCallTelemetryMaxRotatedFiles);
+}
+
+
 - (void)createCall
 {
 	if (!_call) {
@@ -432,6 +462,13 @@ struct ScreenSharingHandlerAndDelegatesPackage
 		[SMConnectionController sharedInstance].signallingHandler->SetWrapperProvider(_call);
         
         [self setConstrainsFromVideoPreferences];
+		
+		_call->SetActiveSpeakerDetection(true, true);
+		_call->SetStatisticsInterval(kCallStatisticsIntervalMs);
+		
+		if ([[NSUserDefaults standardUserDefaults] boolForKey:kSMCallTelemetryRecordingEnabledKey]) {
+			[self startTelemetryRecordingForCall:_call];
+		}
 	}
 }
 
@@ -463,6 +500,17 @@ struct ScreenSharingHandlerAndDelegatesPackage
 }
 
 
+- (void)setRemoteVideoVisible:(BOOL)visible size:(CGSize)size forUserSessionId:(NSString *)userSessionId
+{
+	if (_call && userSessionId) {
+		// Ask for video in pixels, not points
+		CGFloat scale = [UIScreen mainScreen].scale;
+		_call->SetRemoteVideoSubscription(stdStringFromNSString(userSessionId), visible ? true : false,
+										  (int)(size.width * scale), (int)(size.height * scale));
+	}
+}
+
+
 - (void)callToBuddy:(User *)buddy withVideo:(BOOL)withVideo
 {
 	[[UsersManager defaultManager] holdUser:buddy forSessionId:buddy.sessionId];
@@ -539,6 +587,9 @@ struct ScreenSharingHandlerAndDelegatesPackage
 	[SMConnectionController sharedInstance].signallingHandler->UnRegisterMessageReceiver(_call);
 	
 	
+	// Periodic snapshots must not arrive for hung up call, only the final one requested in 'callIsFinished:'.
+	_call->SetStatisticsInterval(0);
+	
 	// Now we can send HangUp message
 	_call->HangUp(reason);
 	
@@ -1455,7 +1506,7 @@ struct ScreenSharingHandlerAndDelegatesPackage
 	if (_call == call) {
 		// Remote user hung up
 		
-		_call->RequestStatistics();
+		_call->RequestFinalStatistics();
 		
 		// TODO: WARNING: refactor this since call to delete call will probably
 		// erase messages to remove renderers from signalling_thread message queue.
@@ -1479,7 +1530,8 @@ struct ScreenSharingHandlerAndDelegatesPackage
 			
 			// Warning: we do not check here for duplicate insertions of the CallAndDelegatesPackage with the same call
 			if (it->call == call && !it->hasRequestedStatistics) {
-				call->RequestStatistics();
+				call->RequestFinalStatistics();
+				it->hasRequestedStatistics = true;
 				break;
 			}
 			++it;
@@ -1488,6 +1540,15 @@ struct ScreenSharingHandlerAndDelegatesPackage
 }
 
 
+- (void)dominantSpeakerChanged:(NSString *)userSessionId inCall:(Call *)call
+{
+	if (_call == call) {
+		NSDictionary *userInfo = userSessionId.length > 0 ? @{kUserSessionIdKey : userSessionId} : nil;
+		[[NSNotificationCenter defaultCenter] postNotificationName:DominantSpeakerChangedNotification object:self userInfo:userInfo];
+	}
+}
+
+
 - (void)incomingCallWasAutoRejected:(Call *)call withUserSessionId:(NSString *)userSessionId
 {
 	if (_call == call) {
@@ -1742,8 +1803,14 @@ struct ScreenSharingHandlerAndDelegatesPackage
 
 
 - (void)callHasReceivedStatistics:(spreedme::Call *)call
-							stats:(webrtc::StatsReports)reports;
+					   statistics:(spreedme::CallStatistics)statistics;
 {
+	// Periodic snapshots can still arrive after hang up. Only the final one carries call totals
+	// and is the last callback for the call, so call can be deleted after it.
+	if (!statistics.isFinal) {
+		return;
+	}
+	
 	for (std::vector<spreedme::CallAndDelegatesPackage>::iterator it = _pendingHungUpCalls.begin();
 		 it != _pendingHungUpCalls.end();) {
 		
@@ -1753,27 +1820,8 @@ struct ScreenSharingHandlerAndDelegatesPackage
 			it->DeleteAll();
 			_pendingHungUpCalls.erase(it);
 			
-			for (webrtc::StatsReports::iterator it_rep = reports.begin(); it_rep != reports.end(); ++it_rep) {
-				if ((*it_rep)->type() == webrtc::StatsReport::kStatsReportTypeSsrc) {
-                    
-                    const webrtc::StatsReport::Value *valueRec = (*it_rep)->FindValue(webrtc::StatsReport::kStatsValueNameBytesReceived);
-                    if (valueRec) {
-                        uint64_t result = 0;
-                        std::stringstream convert(valueRec->value);
-                        if ( !(convert >> result) ) { result = 0; }
-                        
-                        [[SMConnectionController sharedInstance].ndController addReceivedBytes:result forServiceName:SMWebRTCServiceNameForStatistics];
-                    }
-                    const webrtc::StatsReport::Value *valueSent = (*it_rep)->FindValue(webrtc::StatsReport::kStatsValueNameBytesSent);
-                    if (valueSent) {
-                        uint64_t result = 0;
-                        std::stringstream convert(valueSent->value);
-                        if ( !(convert >> result) ) { result = 0; }
-                        
-                        [[SMConnectionController sharedInstance].ndController addSentBytes:result forServiceName:SMWebRTCServiceNameForStatistics];
-                    }
-				}
-			}
+			[[SMConnectionController sharedInstance].ndController addReceivedBytes:statistics.totalBytesReceived forServiceName:SMWebRTCServiceNameForStatistics];
+			[[SMConnectionController sharedInstance].ndController addSentBytes:statistics.totalBytesSent forServiceName:SMWebRTCServiceNameForStatistics];
 			
 			break;
 		} else {
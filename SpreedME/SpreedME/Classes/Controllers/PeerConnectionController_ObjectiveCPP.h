@@ -27,6 +27,7 @@
 #include <talk/app/webrtc/statstypes.h>
 #include <webrtc/base/scoped_ref_ptr.h>
 
+#include "CallStatistics.h"
 #include "WebrtcCommonDefinitions.h"
 
 #import "VideoRendereriOSInfo.h"
@@ -59,6 +60,7 @@ namespace spreedme {
 - (void)callHasStarted:(spreedme::Call *)call;
 
 - (void)remoteUserHangUp:(NSString *)userSessionId inCall:(spreedme::Call *)call;
+- (void)dominantSpeakerChanged:(NSString *)userSessionId inCall:(spreedme::Call *)call;
 - (void)callIsFinished:(spreedme::Call *)call callFinishReason:(SMCallFinishReason)finishReason;
 
 - (void)incomingCallWasAutoRejected:(spreedme::Call *)call withUserSessionId:(NSString *)userSessionId;
@@ -90,7 +92,7 @@ namespace spreedme {
 
 
 - (void)callHasReceivedStatistics:(spreedme::Call *)call
-							stats:(webrtc::StatsReports)reports;
+					   statistics:(spreedme::CallStatistics)statistics;
 
 // ScreenSharingUIDelegate methods
 - (void)screenSharingHasStarted:(spreedme::ScreenSharingHandler *)handler
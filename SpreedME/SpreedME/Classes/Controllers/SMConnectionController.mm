@@ -27,6 +27,7 @@
 #import "ChannelingManager_ObjectiveCPP.h"
 #import "ChatManager.h"
 #import "CommonNetDefinitions.h"
+#import "JsonConversion.h"
 #import "LoginManager.h"
 #import "OCLoginManager.h"
 #import "PeerConnectionController.h"
@@ -38,6 +39,7 @@
 #import "SMHmacHelper.h"
 #import "SMLocalizedStrings.h"
 #import "SMLoginManager.h"
+#import "SMNetworkDataServiceProvider.h"
 #import "SMNetworkDataStatisticsController.h"
 #import "SpreedMeStrictSSLSecurityPolicy.h"
 #import "SpreedSSLSecurityPolicy.h"
@@ -72,6 +74,8 @@ const NSTimeInterval kDefaultTTL = 60.0;
 
 const NSTimeInterval kSMDefaultAppVersionCheckInterval = 60.0 * 60.0 * 6; // 6 hours;
 
+const NSTimeInterval kSMNetworkDataStatisticsSaveInterval = 60.0 * 5; // 5 minutes
+
 #pragma mark - Signalling Handler Bridge
 
 namespace spreedme {
@@ -94,7 +98,25 @@ public:
 	{
 		ChannelingManager *messageReceiver = messageReceiver_;
 		NSString *message = [NSString stringWithCString:msg.c_str() encoding:NSUTF8StringEncoding];
-		NSString *wrapperId_objC = NSStr(msg.c_str());
+		NSString *wrapperId_objC = NSStr(wrapperId.c_str());
+		dispatch_async(dispatch_get_main_queue(), ^{
+			[messageReceiver messageReceived:message transportType:transportType wrapperId:wrapperId_objC];
+		});
+	}
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+	{
+		if (transportType == kWebsocketChannelingServer) {
+			// Channeling manager has already parsed and processed this message before handing it to signalling handler.
+			return;
+		}
+		
+		ChannelingManager *messageReceiver = messageReceiver_;
+		if (messageReceiver.signallingRecorder->isRecording()) {
+			messageReceiver.signallingRecorder->RecordReceivedMessage(msg, transportType);
+		}
+		
+		id message = convertJsonValueToObjC(root);
+		NSString *wrapperId_objC = NSStr(wrapperId.c_str());
 		dispatch_async(dispatch_get_main_queue(), ^{
 			[messageReceiver messageReceived:message transportType:transportType wrapperId:wrapperId_objC];
 		});
@@ -135,6 +157,8 @@ typedef enum : NSInteger {
 	
 	NSTimer *_iceServerUpdateTimer;
 	
+	NSTimer *_networkDataStatisticsSaveTimer;
+	
 	spreedme::SignallingHandlerBridge *_signallingHandlerBridge;
 	ChannelingManager *_channelingManager;
 	
@@ -212,6 +236,18 @@ typedef enum : NSInteger {
 		_ndController = [[SMNetworkDataStatisticsController alloc]
 						 initWithSavedEncryptedStatisticsInDir:[SMNetworkDataStatisticsController savedStatisticsDir]];
 		[_ndController registerDataProvider:chanManager forServiceName:@"WebSocket"];
+		[_ndController registerDataProvider:[[SMNetworkDataServiceProvider alloc] initWithNetworkDataService:kNetworkDataServiceDataChannel]
+							 forServiceName:@"DataChannel"];
+		[_ndController registerDataProvider:[[SMNetworkDataServiceProvider alloc] initWithNetworkDataService:kNetworkDataServiceFileTransfer]
+							 forServiceName:@"FileTransfer"];
+		[_ndController registerDataProvider:[[SMNetworkDataServiceProvider alloc] initWithNetworkDataService:kNetworkDataServiceResourceDownload]
+							 forServiceName:@"ResourceDownloadService"];
+		// Counters are sampled only when statistics are saved, save them periodically in case app is killed.
+		_networkDataStatisticsSaveTimer = [NSTimer scheduledTimerWithTimeInterval:kSMNetworkDataStatisticsSaveInterval
+																		   target:self
+																		 selector:@selector(saveNetworkDataStatistics:)
+																		 userInfo:nil
+																		  repeats:YES];
         
         // Version checker setup
         NSArray *endpoints = [self composeEndpointsURLsWithUserServerString:kDefaultServer];
@@ -310,15 +346,6 @@ typedef enum : NSInteger {
 													 name:UIApplicationDidBecomeActiveNotification
 												   object:nil];
 		
-		[[NSNotificationCenter defaultCenter] addObserver:self
-												 selector:@selector(networkDataBytesHaveBeenSent:)
-													 name:STNetworkDataBytesHaveBeenSentNotification
-												   object:nil];
-
-		[[NSNotificationCenter defaultCenter] addObserver:self
-												 selector:@selector(networkDataBytesHaveBeenReceived:)
-													 name:STNetworkDataBytesHaveBeenReceivedNotification
-												   object:nil];
         
         [[NSNotificationCenter defaultCenter] addObserver:self
                                                  selector:@selector(userDidAcceptCertificate:)
@@ -739,6 +766,7 @@ typedef enum : NSInteger {
 {
     _ownCloudMode = NO;
 	
+	[[UsersActivityController sharedInstance] purgeAllHistory];
     [UsersManager defaultManager].currentUser = [[SMLocalUser alloc] init];
 	[UsersManager defaultManager].currentUser.settings.serverString = newServer;
     [UsersManager defaultManager].currentUser.room = nil;
@@ -1366,12 +1394,14 @@ typedef enum : NSInteger {
 
 - (void)logout
 {
+	// Chat history belongs to the user who is logging out
+	[[UsersActivityController sharedInstance] purgeAllHistory];
+	
 	if (_spreedMeMode) {
 		[self disconnect];
 		[SettingsController sharedInstance].lastConnectedUserId = nil;
 		[UsersManager defaultManager].currentUser = [[SMLocalUser alloc] init];
 		[UsersManager defaultManager].currentUser.room = nil;
-        [[UsersActivityController sharedInstance] purgeAllHistory];
 		self.appLoginState = kSMAppLoginStatePromptUserToLogin;
 		
 		// go to rooms view controller
@@ -1557,6 +1587,7 @@ typedef enum : NSInteger {
 	[SettingsController sharedInstance].spreedMeMode = _spreedMeMode;
 	
 	// reset user
+	[[UsersActivityController sharedInstance] purgeAllHistory];
 	[UsersManager defaultManager].currentUser = [[SMLocalUser alloc] init];
 	[UsersManager defaultManager].currentUser.room = nil;
     
@@ -1664,19 +1695,9 @@ typedef enum : NSInteger {
 }
 
 
-- (void)networkDataBytesHaveBeenSent:(NSNotification *)notification
-{
-	uint64_t bytesSent = [[notification.userInfo objectForKey:kSTNetworkDataNotificationUserInfoBytesKey] unsignedLongLongValue];
-	NSString *serviceName = [notification.userInfo objectForKey:kSTNetworkDataNotificationUserInfoServiceNameKey];
-	[self.ndController addSentBytes:bytesSent forServiceName:serviceName];
-}
-
-
-- (void)networkDataBytesHaveBeenReceived:(NSNotification *)notification
+- (void)saveNetworkDataStatistics:(NSTimer *)timer
 {
-	uint64_t bytesReceived = [[notification.userInfo objectForKey:kSTNetworkDataNotificationUserInfoBytesKey] unsignedLongLongValue];
-	NSString *serviceName = [notification.userInfo objectForKey:kSTNetworkDataNotificationUserInfoServiceNameKey];
-	[self.ndController addReceivedBytes:bytesReceived forServiceName:serviceName];
+	[self.ndController saveStatisticsToDir:[SMNetworkDataStatisticsController savedStatisticsDir]];
 }
 
 
@@ -0,0 +1,39 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "NetworkDataAccounting.h"
+#import "STNetworkDataStatisticsController.h"
+
+/*
+ Data provider which gives STNetworkDataStatisticsController snapshots of
+ counters kept by C++ NetworkDataAccounting for one service.
+ Counters are never reset in C++, provider keeps baseline instead.
+ */
+@interface SMNetworkDataServiceProvider : NSObject <STNetworkDataStatisticsControllerDataProvider>
+
+- (instancetype)initWithNetworkDataService:(NetworkDataService)service;
+
+@property (nonatomic, readonly) NetworkDataService service;
+
+@end
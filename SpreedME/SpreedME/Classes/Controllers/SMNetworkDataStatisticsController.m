@@ -26,6 +26,7 @@
 #import "JSONKit.h"
 #import "NSData+Conversion.h"
 #import "SMAppIdentityController.h"
+#import "SMWriteBehindPersister.h"
 #import "utils_objc.h"
 
 @implementation SMNetworkDataStatisticsController
@@ -60,11 +61,12 @@
 	if (jsonString.length > 0) {
 		
 		NSData *stringData = [jsonString dataUsingEncoding:NSUTF8StringEncoding];
+		NSString *password = [[[SMAppIdentityController sharedInstance] appBigIdentifier] hexadecimalString];
 		
-		AES256Encryptor *encr = [[AES256Encryptor alloc] init];
-		[encr saveDataEncrypted:stringData
-				   withPassword:[[[SMAppIdentityController sharedInstance] appBigIdentifier] hexadecimalString]
-						  toDir:dir];
+		[[SMWriteBehindPersister sharedInstance] scheduleWriteForKey:dir withBlock:^BOOL{
+			AES256Encryptor *encr = [[AES256Encryptor alloc] init];
+			return [encr saveDataEncrypted:stringData withPassword:password toDir:dir];
+		}];
 		
 	} else {
 		spreed_me_log("Couldn't create json string from stat data");
@@ -74,6 +76,8 @@
 
 - (NSDictionary *)loadJsonRepresentedStatisticsFromDir:(NSString *)dir
 {
+	[[SMWriteBehindPersister sharedInstance] flushWriteForKey:dir];
+	
 	AES256Encryptor *encr = [[AES256Encryptor alloc] init];
 	NSData *decrData = [encr loadDataFromEncryptedFileInDir:dir
 											   withPassword:[[[SMAppIdentityController sharedInstance] appBigIdentifier] hexadecimalString]];
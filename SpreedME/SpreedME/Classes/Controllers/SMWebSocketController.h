@@ -54,8 +54,12 @@
 
 @property (nonatomic, readonly, copy) NSString *currentServer;
 
+// Bytes on the wire, including websocket framing and whatever compression websocket has negotiated.
 @property (nonatomic, readonly) STByteCount bytesSent;
 @property (nonatomic, readonly) STByteCount bytesReceived;
+// Bytes of messages as they were given to 'send:' or delivered to delegate.
+@property (nonatomic, readonly) STByteCount logicalBytesSent;
+@property (nonatomic, readonly) STByteCount logicalBytesReceived;
 
 
 - (void)send:(id)message;
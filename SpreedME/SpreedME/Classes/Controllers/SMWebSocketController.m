@@ -33,6 +33,9 @@
 	
 	STByteCount _bytesReceivedCurrentWS;
 	STByteCount _bytesSentCurrentWS;
+	
+	STByteCount _logicalBytesReceived;
+	STByteCount _logicalBytesSent;
 }
 
 @property (nonatomic, strong) PSWebSocket *webSocket;
@@ -64,6 +67,7 @@
 - (void)send:(id)message
 {
 	if (_webSocket) {
+		STAddBytesToByteCount([self logicalSizeOfMessage:message], &_logicalBytesSent);
 		[_webSocket send:message];
 	}
 }
@@ -73,6 +77,9 @@
 {
 	[self updateDataUsageAndSumUpWS:YES];
 	
+	spreed_me_log("Websocket bytes sent wire/logical %llu/%llu, received wire/logical %llu/%llu",
+				  _bytesSent.bytes, _logicalBytesSent.bytes, _bytesReceived.bytes, _logicalBytesReceived.bytes);
+	
 	[_webSocket close];
 	_webSocket.delegate = nil;
 	_webSocket = nil;
@@ -224,12 +231,38 @@
 }
 
 
+- (STByteCount)logicalBytesSent
+{
+	return _logicalBytesSent;
+}
+
+
+- (STByteCount)logicalBytesReceived
+{
+	return _logicalBytesReceived;
+}
+
+
+- (uint64_t)logicalSizeOfMessage:(id)message
+{
+	uint64_t size = 0;
+	if ([message isKindOfClass:[NSString class]]) {
+		size = [message lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+	} else if ([message isKindOfClass:[NSData class]]) {
+		size = [message length];
+	}
+	return size;
+}
+
+
 - (void)resetByteCount
 {
 	_bytesReceived = STByteCountMakeZero();
 	_bytesReceivedCurrentWS = STByteCountMakeZero();
 	_bytesSent = STByteCountMakeZero();
 	_bytesSentCurrentWS = STByteCountMakeZero();
+	_logicalBytesReceived = STByteCountMakeZero();
+	_logicalBytesSent = STByteCountMakeZero();
 	
 	[_webSocket resetByteCounts];
 }
@@ -255,6 +288,8 @@
 
 - (void)webSocket:(PSWebSocket *)webSocket didReceiveMessage:(id)message
 {
+	STAddBytesToByteCount([self logicalSizeOfMessage:message], &_logicalBytesReceived);
+	
 	if ([self.delegate respondsToSelector:@selector(webSocketController:didReceiveMessage:)]) {
 		[self.delegate webSocketController:self didReceiveMessage:message];
 	}
@@ -25,12 +25,6 @@
 #import "STByteCount.h"
 
 
-extern NSString * const STNetworkDataBytesHaveBeenSentNotification;
-extern NSString * const STNetworkDataBytesHaveBeenReceivedNotification;
-
-extern NSString * const kSTNetworkDataNotificationUserInfoBytesKey; // Value is NSNumber with uint64_t
-extern NSString * const kSTNetworkDataNotificationUserInfoServiceNameKey; // Value is NSString
-
 extern NSString * const kSTNetworkDataSaveDirInAppSupportDir;
 
 
@@ -135,4 +129,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request);
 
 @property (nonatomic, readonly) STByteCount total; // dynamic, calculated as sent+received;
 
+// Pointers to ivars so counts can be updated in place. Valid as long as the object is alive.
+@property (nonatomic, readonly) STByteCount *sentRef;
+@property (nonatomic, readonly) STByteCount *receivedRef;
+
 @end
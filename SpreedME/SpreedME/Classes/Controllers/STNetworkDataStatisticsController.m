@@ -22,13 +22,6 @@
 
 #import "STNetworkDataStatisticsController.h"
 
-NSString * const STNetworkDataBytesHaveBeenSentNotification					= @"STNetworkDataBytesHaveBeenSentNotification";
-NSString * const STNetworkDataBytesHaveBeenReceivedNotification				= @"STNetworkDataBytesHaveBeenReceivedNotification";
-
-NSString * const kSTNetworkDataNotificationUserInfoBytesKey					= @"bytes";
-NSString * const kSTNetworkDataNotificationUserInfoServiceNameKey			= @"serviceName";
-
-
 NSString * const kSTNetworkDataSaveDirInAppSupportDir				= @"net_data_usage";
 
 // Keys for json representation dict
@@ -128,20 +121,24 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 
 #pragma mark - Accounting bytes
 
-- (void)addSentBytes:(uint64_t)sentBytes forServiceName:(NSString *)serviceName
+- (STNetworkDataValue *)dataValueForServiceName:(NSString *)serviceName
 {
-	if (!serviceName) {	return;	}
-	
+	// STNetworkDataValue is mutable so we put it into dictionary only once
 	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
 	if (!data) {
 		data = [[STNetworkDataValue alloc] init];
+		[_dataStatistics setObject:data forKey:serviceName];
 	}
+	return data;
+}
+
+
+- (void)addSentBytes:(uint64_t)sentBytes forServiceName:(NSString *)serviceName
+{
+	if (!serviceName) {	return;	}
 	
-	STByteCount sent = data.sent;
-	STAddBytesToByteCount(sentBytes, &sent);
-	data.sent = sent;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	STNetworkDataValue *data = [self dataValueForServiceName:serviceName];
+	STAddBytesToByteCount(sentBytes, data.sentRef);
 }
 
 
@@ -149,17 +146,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
-	STByteCount received = data.received;
-	STAddBytesToByteCount(receivedBytes, &received);
-	data.received = received;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
-
+	STNetworkDataValue *data = [self dataValueForServiceName:serviceName];
+	STAddBytesToByteCount(receivedBytes, data.receivedRef);
 }
 
 
@@ -167,16 +155,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
 	STByteCount sent = {sentBytes, 0};
-	
-	data.sent = sent;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	[self dataValueForServiceName:serviceName].sent = sent;
 }
 
 
@@ -184,16 +164,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
 	STByteCount received = {receivedBytes, 0};
-	
-	data.received = received;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	[self dataValueForServiceName:serviceName].received = received;
 }
 
 
@@ -201,16 +173,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
-	STByteCount sent = data.sent;
-	STAddByteCountToByteCount(sentByteCount, &sent);
-	data.sent = sent;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	STNetworkDataValue *data = [self dataValueForServiceName:serviceName];
+	STAddByteCountToByteCount(sentByteCount, data.sentRef);
 }
 
 
@@ -218,16 +182,8 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
-	STByteCount received = data.received;
-	STAddByteCountToByteCount(receiveddByteCount, &received);
-	data.received = received;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	STNetworkDataValue *data = [self dataValueForServiceName:serviceName];
+	STAddByteCountToByteCount(receiveddByteCount, data.receivedRef);
 }
 
 
@@ -235,14 +191,7 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
-	data.sent = sentByteCount;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	[self dataValueForServiceName:serviceName].sent = sentByteCount;
 }
 
 
@@ -250,14 +199,7 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 {
 	if (!serviceName) {	return;	}
 	
-	STNetworkDataValue *data = [_dataStatistics objectForKey:serviceName];
-	if (!data) {
-		data = [[STNetworkDataValue alloc] init];
-	}
-	
-	data.received = receivedByteCount;
-	
-	[_dataStatistics setObject:data forKey:serviceName];
+	[self dataValueForServiceName:serviceName].received = receivedByteCount;
 }
 
 
@@ -600,4 +542,16 @@ uint64_t STCalculateNSURLRequestSize(NSURLRequest *request)
 }
 
 
+- (STByteCount *)sentRef
+{
+	return &_sent;
+}
+
+
+- (STByteCount *)receivedRef
+{
+	return &_received;
+}
+
+
 @end
@@ -26,10 +26,15 @@
 #import "DateFormatterManager.h"
 #import "NonRetainSubscriptionManager.h"
 #import "SettingsController.h"
+#import "SMChatHistoryStore.h"
 #import "UserActivityManager.h"
 #import "UserInterfaceManager.h"
 #import "UsersManager.h"
 
+// Chat history of conversations which were not active for this time is removed on start.
+const NSTimeInterval kUsersActivityHistoryMaxAge = 30.0 * 24.0 * 60.0 * 60.0;
+
+
 @implementation UsersActivityController
 {
 	NSMutableDictionary *_userActivityHistoryJournal; // contains (as value) UserActivityManager for userSessionId key
@@ -69,6 +74,10 @@
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(userHasChangedApplicationMode:) name:UserHasChangedApplicationModeNotification object:nil];
         
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(appplicationDidEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+		
+		[SMChatHistoryStore removeConversationsNotModifiedSince:[NSDate dateWithTimeIntervalSinceNow:-kUsersActivityHistoryMaxAge]];
+		[SMChatHistoryStore removeTransientConversations];
+		[SMChatHistoryStore prepareKey];
 	}
 	
 	return self;
@@ -163,6 +172,11 @@
 
 - (void)purgeAllHistory
 {
+	[SMChatHistoryStore removeAllConversations];
+	// Managers can still be used by chat controllers so purge them too
+	for (UserActivityManager *userActivityManager in [_userActivityHistoryJournal allValues]) {
+		[userActivityManager purgeAllHistory];
+	}
 	[_userActivityHistoryJournal removeAllObjects];
     [_userActivityArray removeAllObjects];
     
@@ -102,8 +102,16 @@
  We now can receive messages through datachannels so we need some message dispatcher.
  At the moment we are going to use ChannelingManager so we need some method to get messages to it.
  TODO: create real message dispatcher!
+ @message can be either json NSString or already parsed NSDictionary.
  */
 - (void)messageReceived:(id)message transportType:(ChannelingMessageTransportType)transportType wrapperId:(NSString *)wrapperId;
 
+/*
+ Per message type counters and main thread processing time histograms of received messages.
+ Statistics are also logged when connection is closed.
+ */
+- (NSString *)messageProcessingStatisticsDescription;
+- (void)resetMessageProcessingStatistics;
+
 
 @end
@@ -23,8 +23,13 @@
 #import "ChannelingManager.h"
 #import "ChannelingManager_ObjectiveCPP.h"
 
+#import <QuartzCore/QuartzCore.h>
+
+#import "JsonConversion.h"
+
 #import "JSONKit.h"
 #import "ReachabilityManager.h"
+#import "SMUserSessionEvent.h"
 #import "SMWebSocketController.h"
 #import "SpreedMeTrustedSSLStore.h"
 #import "STRandomStringGenerator.h"
@@ -37,13 +42,72 @@
 
 const NSTimeInterval kKeepAliveWaitTime = 300.0;
 const NSTimeInterval kKeepAliveTimeOut = 7.0;
+const NSTimeInterval kUserSessionEventsCoalescingInterval = 1.0 / 60.0; // about once per frame
+
+// Hidden debug setting. When set every connection records anonymized channeling traffic to Caches/SignallingRecordings.
+NSString *const kSMSignallingRecordingEnabledKey = @"SMSignallingRecordingEnabled";
+
+// Set as queue specific data on _messageProcessingQueue so we can check that its state is touched only there.
+static char kSMMessageProcessingQueueKey;
+#define SMAssertOnMessageProcessingQueue() NSAssert(dispatch_get_specific(&kSMMessageProcessingQueueKey) != NULL, @"Must be called on _messageProcessingQueue")
+
+
+#pragma mark - Message statistics
+
+typedef void (^ChannelingMessageHandler)(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType);
+
+// Upper bounds of processing time histogram buckets in seconds. Last bucket takes the rest.
+static const int kSMChannelingMessageHistogramBucketsCount = 7;
+static const CFTimeInterval kSMChannelingMessageHistogramBucketBounds[kSMChannelingMessageHistogramBucketsCount - 1] = {0.0001, 0.0005, 0.001, 0.005, 0.016, 0.05};
+
+
+@interface SMChannelingMessageTypeStatistics : NSObject
+{
+	NSUInteger _histogram[kSMChannelingMessageHistogramBucketsCount];
+}
+
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) CFTimeInterval totalTime;
+@property (nonatomic, readonly) CFTimeInterval maxTime;
+
+- (void)addProcessingTime:(CFTimeInterval)time;
+
+@end
+
+
+@implementation SMChannelingMessageTypeStatistics
+
+- (void)addProcessingTime:(CFTimeInterval)time
+{
+	_count++;
+	_totalTime += time;
+	_maxTime = MAX(_maxTime, time);
+	
+	int bucket = 0;
+	while (bucket < kSMChannelingMessageHistogramBucketsCount - 1 && time >= kSMChannelingMessageHistogramBucketBounds[bucket]) {
+		bucket++;
+	}
+	_histogram[bucket]++;
+}
+
+
+- (NSString *)description
+{
+	NSMutableString *description = [NSMutableString stringWithFormat:@"%lu, %.2f, %.2f,", (unsigned long)_count, _totalTime * 1000.0, _maxTime * 1000.0];
+	for (int i = 0; i < kSMChannelingMessageHistogramBucketsCount; ++i) {
+		[description appendFormat:@" %lu", (unsigned long)_histogram[i]];
+	}
+	return description;
+}
+
+@end
 
 
 #pragma mark - Channeling Manager
 
 @interface ChannelingManager () <SMWebSocketControllerDelegate>
 {
-	BuddyParser *_buddyParser;
+	BuddyParser *_buddyParser; // created in init, used only on _messageProcessingQueue. BuddyParser is not thread safe.
 	
 	NSTimer *_keepAliveTimeoutTimer;
 	NSTimer *_keepAliveTimer;
@@ -58,6 +122,23 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 	STByteCount _bytesReceivedCurrentWSC;
 	
 	SMChannelingRequest *_lastHelloRequest;
+	
+	NSMutableDictionary *_messageTypeStatistics; // message type -> SMChannelingMessageTypeStatistics
+	
+	// Received messages are parsed on _messageProcessingQueue and only handled on the main thread.
+	// This includes passing them to signalling handler since its receivers are (un)registered and destroyed on main thread.
+	// Presence events are coalesced there and delivered to the main thread in batches.
+	dispatch_queue_t _messageProcessingQueue;
+	NSUInteger _connectionGeneration; // main thread only. Incremented on close, messages from older connections are dropped.
+	NSMutableArray *_pendingUserSessionEvents; // _messageProcessingQueue only
+	NSUInteger _pendingUserSessionEventsGeneration; // _messageProcessingQueue only
+	BOOL _userSessionEventsFlushScheduled; // _messageProcessingQueue only
+	
+	// Owned by channeling manager. Created in init and deleted only in dealloc, never replaced, so pointer handed out
+	// via signallingRecorder stays valid as long as channeling manager (which is a singleton) lives.
+	// Blocks queued on _messageProcessingQueue retain self so it can't be deleted while they use it.
+	// Recorder itself is thread safe, it is used from main thread, _messageProcessingQueue and signalling thread (P2P).
+	spreedme::SignallingTrafficRecorder *_signallingRecorder;
 }
 
 @property (nonatomic, strong) NSString *lastUsedServer;
@@ -87,6 +168,9 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 	if (self) {
 		
 		_buddyParser = [[BuddyParser alloc] init];
+		_messageProcessingQueue = dispatch_queue_create("SMChannelingMessageProcessing", DISPATCH_QUEUE_SERIAL);
+		dispatch_queue_set_specific(_messageProcessingQueue, &kSMMessageProcessingQueueKey, &kSMMessageProcessingQueueKey, NULL);
+		_signallingRecorder = new spreedme::SignallingTrafficRecorder();
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationWillResignActive:) name:UIApplicationWillResignActiveNotification object:nil];
 	}
 	return self;
@@ -98,6 +182,8 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 	[_keepAliveTimer invalidate];
 	
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	
+	delete _signallingRecorder;
 }
 
 
@@ -107,10 +193,17 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 {
 	[self updateDataUsageAndSumUpWS:YES];
 	
+	if (_messageTypeStatistics.count > 0) {
+		spreed_me_log("%s", [[self messageProcessingStatisticsDescription] cDescription]);
+	}
+	
 	[_webSocketController closeWebSocket];
 	_webSocketController.delegate = nil;
 	_webSocketController = nil;
 	self.isConnected = NO;
+	_connectionGeneration++;
+	
+	_signallingRecorder->Stop();
 	
 	[self stopKeepAliveTimeoutTimer];
 	[self stopKeepAliveTimer];
@@ -128,6 +221,10 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 	
 	[self updateDataUsageAndSumUpWS:YES];
 	
+	if ([[NSUserDefaults standardUserDefaults] boolForKey:kSMSignallingRecordingEnabledKey]) {
+		[self startSignallingRecording];
+	}
+	
 	_webSocketController = [[SMWebSocketController alloc] init];
 	_webSocketController.spreedMeMode = self.spreedMeMode;
 	_webSocketController.delegate = self;
@@ -135,6 +232,34 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 }
 
 
+#pragma mark - Signalling recording
+
+- (spreedme::SignallingTrafficRecorder *)signallingRecorder
+{
+	return _signallingRecorder;
+}
+
+
+- (void)startSignallingRecording
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	NSString *recordingsDir = [[paths firstObject] stringByAppendingPathComponent:@"SignallingRecordings"];
+	NSError *error = nil;
+	if (![[NSFileManager defaultManager] createDirectoryAtPath:recordingsDir withIntermediateDirectories:YES attributes:nil error:&error]) {
+		spreed_me_log("Couldn't create signalling recordings directory %s", [[error description] cStringUsingEncoding:NSUTF8StringEncoding]);
+		return;
+	}
+	
+	NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
+	dateFormatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+	dateFormatter.dateFormat = @"yyyyMMdd-HHmmss";
+	NSString *fileName = [NSString stringWithFormat:@"signalling-%@.smsr", [dateFormatter stringFromDate:[NSDate date]]];
+	
+	NSString *recordingPath = [recordingsDir stringByAppendingPathComponent:fileName];
+	_signallingRecorder->Start(std::string([recordingPath cStringUsingEncoding:NSUTF8StringEncoding]));
+}
+
+
 #pragma mark - Network data usage statistics
 
 - (STByteCount)bytesSent
@@ -641,6 +766,10 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
  Now we send some messages from peer connection so just leave it unwrapped in specific method call. This might change in future.*/
 - (void)sendMessage:(NSString *)message
 {
+	if (_signallingRecorder->isRecording()) {
+		_signallingRecorder->RecordSentMessage(std::string([message cStringUsingEncoding:NSUTF8StringEncoding]));
+	}
+	
 	[_webSocketController send:message];
 }
 
@@ -684,68 +813,129 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 }
 
 
++ (NSDictionary *)messageHandlers
+{
+	static dispatch_once_t once;
+	static NSDictionary *messageHandlers;
+	dispatch_once(&once, ^{
+		// Handlers get full message (with outer structure), its Data part and transport type.
+		messageHandlers = @{
+			NSStr(kSelfKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedSelfMessage:message];
+			},
+			NSStr(kChatKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedChatMessage:message transportType:transportType];
+			},
+			NSStr(kUsersKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager gotBuddyList:data];
+			},
+			NSStr(kLeftKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager leftBuddy:data];
+			},
+			NSStr(kJoinedKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager joinedBuddy:data];
+			},
+			NSStr(kByeKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedByeMessage:message];
+			},
+			NSStr(kStatusKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager updateBuddy:data];
+			},
+			NSStr(kAliveKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedAliveMessage:data];
+			},
+			NSStr(kScreenShareKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedScreenshareMessage:data from:[message objectForKey:NSStr(kFromKey)]];
+			},
+			NSStr(kSessionsKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedSessionsMessage:message];
+			},
+			NSStr(kErrorKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedErrorMessage:message];
+			},
+			NSStr(kWelcomeKey) : ^(ChannelingManager *manager, NSDictionary *message, NSDictionary *data, ChannelingMessageTransportType transportType) {
+				[manager receivedWelcomeMessage:message];
+			},
+		};
+	});
+	return messageHandlers;
+}
+
+
 - (void)processMessageDict:(NSDictionary *)message transportType:(ChannelingMessageTransportType)transportType wrapperId:(NSString *)wrapperId
 {
-	NSString *type = [[message objectForKey:NSStr(kDataKey)] objectForKey:NSStr(kTypeKey)];
+	static NSString *dataKey = NSStr(kDataKey);
+	static NSString *typeKey = NSStr(kTypeKey);
+	
+	NSDictionary *data = [message objectForKey:dataKey];
+	NSString *type = [data objectForKey:typeKey];
 	spreed_me_log("Received message of type: %s", [type cDescription]);
-	if ([type isEqualToString:NSStr(kSelfKey)])
-	{
-		[self receivedSelfMessage:message]; // note: we pass the message with outer structure
-	}
-	else if ([type isEqualToString:NSStr(kChatKey)])
-	{
-		[self receivedChatMessage:message transportType:transportType]; // note: we pass the message with outer structure
-	}
-	else if ([type isEqualToString:NSStr(kUsersKey)])
-	{
-		[self gotBuddyList:[message objectForKey:NSStr(kDataKey)]];
-	}
-	else if ([type isEqualToString:NSStr(kLeftKey)])
-	{
-		[self leftBuddy:[message objectForKey:NSStr(kDataKey)]];
-	}
-	else if ([type isEqualToString:NSStr(kJoinedKey)])
-	{
-		[self joinedBuddy:[message objectForKey:NSStr(kDataKey)]];
-	}
-	else if ([type isEqualToString:NSStr(kByeKey)])
-	{
-		[self receivedByeMessage:message]; // note: we pass the message with outer structure
-	}
-	else if ([type isEqualToString:NSStr(kStatusKey)])
-	{
-		[self updateBuddy:[message objectForKey:NSStr(kDataKey)]];
-	}
-	else if ([type isEqualToString:NSStr(kAliveKey)])
-	{
-		[self receivedAliveMessage:[message objectForKey:NSStr(kDataKey)]];
-	}
-	else if ([type isEqualToString:NSStr(kScreenShareKey)])
-	{
-		[self receivedScreenshareMessage:[message objectForKey:NSStr(kDataKey)] from:[message objectForKey:NSStr(kFromKey)]];
+	
+	ChannelingMessageHandler handler = type ? [[ChannelingManager messageHandlers] objectForKey:type] : nil;
+	if (handler) {
+		CFTimeInterval start = CACurrentMediaTime();
+		handler(self, message, data, transportType);
+		[self recordProcessingTime:CACurrentMediaTime() - start forMessageType:type];
+	} else {
+//		spreed_me_log("Unknown message type in ChannelingManager: %s", [type cDescription]);
+		[self recordProcessingTime:0.0 forMessageType:@"<unhandled>"];
 	}
-	else if ([type isEqualToString:NSStr(kSessionsKey)])
-	{
-		[self receivedSessionsMessage:message]; // note: we pass the message with outer structure
+}
+
+
+#pragma mark - Message processing statistics
+
+- (void)recordProcessingTime:(CFTimeInterval)time forMessageType:(NSString *)type
+{
+	if (!_messageTypeStatistics) {
+		_messageTypeStatistics = [[NSMutableDictionary alloc] init];
 	}
-	else if ([type isEqualToString:NSStr(kErrorKey)])
-	{
-		[self receivedErrorMessage:message];
+	
+	SMChannelingMessageTypeStatistics *statistics = [_messageTypeStatistics objectForKey:type];
+	if (!statistics) {
+		statistics = [[SMChannelingMessageTypeStatistics alloc] init];
+		[_messageTypeStatistics setObject:statistics forKey:type];
 	}
-	else if ([type isEqualToString:NSStr(kWelcomeKey)])
-	{
-		[self receivedWelcomeMessage:message];
+	[statistics addProcessingTime:time];
+}
+
+
+- (NSString *)messageProcessingStatisticsDescription
+{
+	NSMutableString *description = [NSMutableString stringWithString:@"Channeling message processing statistics (type: count, total ms, max ms, histogram"];
+	for (int i = 0; i < kSMChannelingMessageHistogramBucketsCount - 1; ++i) {
+		[description appendFormat:@" <%.1fms", kSMChannelingMessageHistogramBucketBounds[i] * 1000.0];
 	}
-	else
-	{
-//		spreed_me_log("Unknown message type in ChannelingManager: %s", [type cDescription]);
+	[description appendString:@" rest):"];
+	
+	NSArray *sortedTypes = [_messageTypeStatistics keysSortedByValueUsingComparator:^NSComparisonResult(SMChannelingMessageTypeStatistics *obj1, SMChannelingMessageTypeStatistics *obj2) {
+		if (obj1.totalTime > obj2.totalTime) {
+			return NSOrderedAscending;
+		} else if (obj1.totalTime < obj2.totalTime) {
+			return NSOrderedDescending;
+		}
+		return NSOrderedSame;
+	}];
+	
+	for (NSString *type in sortedTypes) {
+		[description appendFormat:@"\n%@: %@", type, [[_messageTypeStatistics objectForKey:type] description]];
 	}
+	
+	return description;
+}
+
+
+- (void)resetMessageProcessingStatistics
+{
+	[_messageTypeStatistics removeAllObjects];
 }
 
 
 - (void)messageReceived:(id)message transportType:(ChannelingMessageTransportType)transportType wrapperId:(NSString *)wrapperId
 {
-	if ([message isKindOfClass:[NSString class]])
+	if ([message isKindOfClass:[NSDictionary class]]) {
+		[self processMessageDict:message transportType:transportType wrapperId:wrapperId];
+	} else if ([message isKindOfClass:[NSString class]])
 	{
 		id serverResponse = [((NSString *)message) objectFromJSONString];
 		
@@ -765,35 +955,89 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 	//TODO: we should probably check if this is a message from server and not p2p
 	[self startKeepAliveTimer]; // we have received some message so server connection is alive. This call will restart timer.
 	
+	NSUInteger connectionGeneration = _connectionGeneration;
+	dispatch_async(_messageProcessingQueue, ^{
+		[self processReceivedMessage:message transportType:transportType wrapperId:wrapperId connectionGeneration:connectionGeneration];
+	});
+}
+
+
+#pragma mark - Message processing queue
+
+// Called on _messageProcessingQueue
+- (void)processReceivedMessage:(id)message
+				 transportType:(ChannelingMessageTransportType)transportType
+					 wrapperId:(NSString *)wrapperId
+		  connectionGeneration:(NSUInteger)connectionGeneration
+{
+	SMAssertOnMessageProcessingQueue();
+	
 	if ([message isKindOfClass:[NSString class]])
     {
-		BOOL shouldPassToSignallinHandler = YES;
+		std::string msg = std::string([message cStringUsingEncoding:NSUTF8StringEncoding]);
 		
-		NSDictionary *dict = [message objectFromJSONString];
-		if (dict && [dict isKindOfClass:[NSDictionary class]]) {
-			if ([dict objectForKey:NSStr(kAttestationTokenKey)]) {
-				
-				spreed_me_log("Attestation available message %s", [[[dict objectForKey:NSStr(kDataKey)] objectForKey:NSStr(kTypeKey)] cDescription]);
-				
-				if ([self shouldCheckUpUserFromAttestationTokenMessage:dict]) {
+		if (_signallingRecorder->isRecording()) {
+			_signallingRecorder->RecordReceivedMessage(msg, transportType);
+		}
+		
+		// This is the only place where websocket messages are parsed. Signalling handler and its receivers get this tree
+		// and Objective-C handlers get Foundation objects converted from it.
+		Json::Reader jsonReader;
+		Json::Value root;
+		if (!jsonReader.parse(msg, root) || !root.isObject()) {
+			spreed_me_log("Channeling message is not a json object!");
+			return;
+		}
+		
+		std::string type;
+		const Json::Value &data = root[kDataKey];
+		if (data.isObject()) {
+			type = data.get(kTypeKey, Json::Value()).asString();
+		}
+		
+		const Json::Value &attestationToken = root[kAttestationTokenKey];
+		if (!attestationToken.isNull()) {
+			
+			spreed_me_log("Attestation available message %s", type.c_str());
+			
+			if ([self shouldCheckUpUserFromAttestationTokenMessageOfType:type]) {
+			
+				NSString *from = NSStr(root.get(kFromKey, Json::Value()).asString().c_str());
+				NSString *attToken = NSStr(attestationToken.asString().c_str());
 				
-					NSString *from = [dict objectForKey:NSStr(kFromKey)];
-					NSString *attToken = [dict objectForKey:NSStr(kAttestationTokenKey)];
-
-					[self.usersManagementHandler channelingManager:self
-							hasReceivedMessageWithAttestationToken:@{ NSStr(kIdKey) : from, NSStr(kAttestationTokenKey) :attToken }];
-				}
+				[self flushUserSessionEvents];
+				dispatch_async(dispatch_get_main_queue(), ^{
+					if (connectionGeneration == _connectionGeneration) {
+						[self.usersManagementHandler channelingManager:self
+								hasReceivedMessageWithAttestationToken:@{ NSStr(kIdKey) : from, NSStr(kAttestationTokenKey) :attToken }];
+					}
+				});
 			}
-			
-			shouldPassToSignallinHandler = [self shouldPassMessageToSignallingHandler:dict];
 		}
 		
-		if (shouldPassToSignallinHandler) {
-			// In this case message still can return to channeling manager!
-			std::string msg = std::string([message cStringUsingEncoding:NSUTF8StringEncoding]);
-			_signallingHandler->ReceiveMessage(msg, kWebsocketChannelingServer, std::string());
+		if ([self shouldPassMessageOfTypeToSignallingHandler:type]) {
+			// Signalling handler receivers are (un)registered and destroyed on main thread so call it only there.
+			// Pending presence events have been received before this message so they should be applied first.
+			[self flushUserSessionEvents];
+			dispatch_async(dispatch_get_main_queue(), ^{
+				if (connectionGeneration == _connectionGeneration) {
+					_signallingHandler->ReceiveMessage(root, msg, kWebsocketChannelingServer, std::string());
+				}
+			});
+			
+			// Signalling handler bridge ignores websocket messages so we process them here ourselves.
+			// Most of these messages (offers, candidates, etc.) have no handler here, don't convert them for nothing.
+			if ([self hasMessageHandlerForType:type]) {
+				[self deliverMessageDict:convertJsonValueToObjC(root) transportType:transportType wrapperId:wrapperId connectionGeneration:connectionGeneration];
+			}
 		} else {
-			[self processMessageDict:dict transportType:transportType wrapperId:wrapperId];
+			NSDictionary *dict = convertJsonValueToObjC(root);
+			SMUserSessionEvent *event = [self userSessionEventFromMessageDict:dict];
+			if (event) {
+				[self enqueueUserSessionEvent:event connectionGeneration:connectionGeneration];
+			} else {
+				[self deliverMessageDict:dict transportType:transportType wrapperId:wrapperId connectionGeneration:connectionGeneration];
+			}
 		}
 		
 	} else {
@@ -802,44 +1046,132 @@ const NSTimeInterval kKeepAliveTimeOut = 7.0;
 }
 
 
-- (BOOL)shouldPassMessageToSignallingHandler:(NSDictionary *)message
+// Called on _messageProcessingQueue
+- (void)deliverMessageDict:(NSDictionary *)message
+			 transportType:(ChannelingMessageTransportType)transportType
+				 wrapperId:(NSString *)wrapperId
+	  connectionGeneration:(NSUInteger)connectionGeneration
 {
-	BOOL answer = YES;
+	SMAssertOnMessageProcessingQueue();
 	
-	NSString *type = [[message objectForKey:NSStr(kDataKey)] objectForKey:NSStr(kTypeKey)];
+	// Pending presence events have been received before this message so they should be applied first.
+	[self flushUserSessionEvents];
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		if (connectionGeneration == _connectionGeneration) {
+			[self processMessageDict:message transportType:transportType wrapperId:wrapperId];
+		}
+	});
+}
 
-	if ([type isEqualToString:NSStr(kSelfKey)]		||
-		[type isEqualToString:NSStr(kChatKey)]		||
-		[type isEqualToString:NSStr(kUsersKey)]		||
-		[type isEqualToString:NSStr(kLeftKey)]		||
-		[type isEqualToString:NSStr(kJoinedKey)]	||
-		[type isEqualToString:NSStr(kByeKey)]		||
-		[type isEqualToString:NSStr(kStatusKey)]	||
-		[type isEqualToString:NSStr(kAliveKey)]		||
-		[type isEqualToString:NSStr(kScreenShareKey)]||
-		[type isEqualToString:NSStr(kSessionsKey)])
-	{
-		answer = NO;
+
+// Called on _messageProcessingQueue. Does all parsing of presence messages so main thread only has to merge results.
+- (SMUserSessionEvent *)userSessionEventFromMessageDict:(NSDictionary *)message
+{
+	SMAssertOnMessageProcessingQueue();
+	
+	static NSString *dataKey = NSStr(kDataKey);
+	static NSString *typeKey = NSStr(kTypeKey);
+	
+	NSDictionary *data = [message objectForKey:dataKey];
+	if (![data isKindOfClass:[NSDictionary class]]) {
+		return nil;
+	}
+	
+	NSString *type = [data objectForKey:typeKey];
+	
+	SMUserSessionEvent *event = nil;
+	
+	if ([type isEqualToString:NSStr(kUsersKey)]) {
+		NSArray *users = [data objectForKey:NSStr(kUsersKey)];
+		if ([users isKindOfClass:[NSArray class]]) {
+			event = [SMUserSessionEvent usersListEventWithUsers:[_buddyParser createBuddyListFromUsersArray:users]];
+		}
+	} else if ([type isEqualToString:NSStr(kJoinedKey)]) {
+		event = [SMUserSessionEvent joinedEventWithUser:[_buddyParser createBuddyFromDictionary:data withType:kBuddyDictionaryTypeJoined]];
+	} else if ([type isEqualToString:NSStr(kLeftKey)]) {
+		id sessionId = [data objectForKey:NSStr(kIdKey)];
+		NSString *userSessionId = [sessionId isKindOfClass:[NSString class]] ? sessionId : [sessionId stringValue];
+		event = [SMUserSessionEvent leftEventWithSessionId:userSessionId leftType:[data objectForKey:NSStr(kStatusKey)]];
+	} else if ([type isEqualToString:NSStr(kStatusKey)]) {
+		event = [SMUserSessionEvent statusEventWithSnapshot:[_buddyParser createStatusSnapshotFromDictionary:data]];
 	}
 	
-	return answer;
+	return event;
 }
 
 
-- (BOOL)shouldCheckUpUserFromAttestationTokenMessage:(NSDictionary *)message
+// Called on _messageProcessingQueue
+- (void)enqueueUserSessionEvent:(SMUserSessionEvent *)event connectionGeneration:(NSUInteger)connectionGeneration
 {
-	BOOL answer = NO;
+	SMAssertOnMessageProcessingQueue();
+	
+	if (_pendingUserSessionEventsGeneration != connectionGeneration) {
+		[self flushUserSessionEvents];
+		_pendingUserSessionEventsGeneration = connectionGeneration;
+	}
+	
+	if (!_pendingUserSessionEvents) {
+		_pendingUserSessionEvents = [[NSMutableArray alloc] init];
+	}
+	[_pendingUserSessionEvents addObject:event];
+	
+	if (!_userSessionEventsFlushScheduled) {
+		_userSessionEventsFlushScheduled = YES;
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kUserSessionEventsCoalescingInterval * NSEC_PER_SEC)), _messageProcessingQueue, ^{
+			_userSessionEventsFlushScheduled = NO;
+			[self flushUserSessionEvents];
+		});
+	}
+}
+
 
-	NSString *messageType = [[message objectForKey:NSStr(kDataKey)] objectForKey:NSStr(kTypeKey)];
+// Called on _messageProcessingQueue
+- (void)flushUserSessionEvents
+{
+	SMAssertOnMessageProcessingQueue();
 	
-	if ([messageType isEqualToString:NSStr(kChatKey)] ||
-		[messageType isEqualToString:NSStr(kOfferKey)] ||
-		[messageType isEqualToString:NSStr(kAnswerKey)])
-	{
-		answer = YES;
+	if (_pendingUserSessionEvents.count == 0) {
+		return;
 	}
 	
-	return answer;
+	NSArray *events = _pendingUserSessionEvents;
+	NSUInteger connectionGeneration = _pendingUserSessionEventsGeneration;
+	_pendingUserSessionEvents = nil;
+	
+	dispatch_async(dispatch_get_main_queue(), ^{
+		if (connectionGeneration == _connectionGeneration) {
+			CFTimeInterval start = CACurrentMediaTime();
+			[self.usersManagementHandler channelingManager:self hasReceivedUserSessionEvents:events];
+			[self recordProcessingTime:CACurrentMediaTime() - start forMessageType:@"<presence batch>"];
+		}
+	});
+}
+
+
+- (BOOL)hasMessageHandlerForType:(const std::string &)type
+{
+	return !type.empty() && [[ChannelingManager messageHandlers] objectForKey:NSStr(type.c_str())] != nil;
+}
+
+
+- (BOOL)shouldPassMessageOfTypeToSignallingHandler:(const std::string &)type
+{
+	static dispatch_once_t once;
+	static std::set<std::string> *channelingManagerOnlyTypes;
+	dispatch_once(&once, ^{
+		channelingManagerOnlyTypes = new std::set<std::string>();
+		const char *types[] = {kSelfKey, kChatKey, kUsersKey, kLeftKey, kJoinedKey, kByeKey, kStatusKey, kAliveKey, kScreenShareKey, kSessionsKey};
+		channelingManagerOnlyTypes->insert(types, types + sizeof(types) / sizeof(types[0]));
+	});
+	
+	return !(!type.empty() && channelingManagerOnlyTypes->count(type) > 0);
+}
+
+
+- (BOOL)shouldCheckUpUserFromAttestationTokenMessageOfType:(const std::string &)type
+{
+	return type == kChatKey || type == kOfferKey || type == kAnswerKey;
 }
 
 
@@ -24,11 +24,13 @@
 #define SpreedME_ChannelingManager_ObjectiveCPP_h
 
 #include "SignallingHandler.h"
+#include "SignallingTrafficRecorder.h"
 #include "ChannelingManager.h"
 
 @interface ChannelingManager ()
 
 @property (nonatomic, assign) spreedme::SignallingHandler *signallingHandler;
+@property (nonatomic, readonly) spreedme::SignallingTrafficRecorder *signallingRecorder; // Owned by channeling manager, valid as long as it lives. Thread safe.
 
 @end
 
@@ -32,8 +32,14 @@ extern NSString * const ChatFileInfoMessageReceivedNotification;
 extern NSString * const ChatMessageDeliveryStatusNotification;
 
 extern NSString * const kMessageUserInfoKey;
+/*
+ ChatMessageDeliveryStatusNotification is posted once per peer with all receipts received during short interval.
+ kDeliveryStatusFromKey - session id of the peer, kDeliveryStatusDeliveredMidsKey - array of delivered (but not seen) mIds,
+ kDeliveryStatusSeenIdsKey - array of seen mIds.
+ */
 extern NSString * const kDeliveryStatusSeenIdsKey;
-extern NSString * const kDeliveryStatusDeliveredMidKey;
+extern NSString * const kDeliveryStatusDeliveredMidsKey;
+extern NSString * const kDeliveryStatusFromKey;
 
 @interface ChatManager : NSObject
 
@@ -44,7 +50,7 @@ extern NSString * const kDeliveryStatusDeliveredMidKey;
 - (void)sendChatTypingNotification:(NSString *)message to:(NSString *)recepientId;
 - (void)sendChatFileInfoMessage:(ChatFileInfo *)chatFileInfo to:(NSString *)recepientId;
 - (void)sendChatGeolocationMessage:(ChatGeolocation *)chatGeolocation to:(NSString *)recepientId;
-- (void)sendSeenMids:(NSArray *)mIds to:(NSString *)recepientId;
+- (void)sendSeenMids:(NSArray *)mIds to:(NSString *)recepientId; // Seen and delivery receipts are sent coalesced per recipient
 
 - (void)receivedChatMessage:(NSDictionary *)message transportType:(ChannelingMessageTransportType)transportType;
 
@@ -44,7 +44,13 @@ NSString * const ChatMessageDeliveryStatusNotification				= @"ChatMessageDeliver
 // Notifications' user info keys
 NSString * const kMessageUserInfoKey						= @"ChatMessageMessage";
 NSString * const kDeliveryStatusSeenIdsKey				= @"kDeliveryStatusSeenIdsKey";
-NSString * const kDeliveryStatusDeliveredMidKey			= @"kDeliveryStatusDeliveredMidKey";
+NSString * const kDeliveryStatusDeliveredMidsKey		= @"kDeliveryStatusDeliveredMidsKey";
+NSString * const kDeliveryStatusFromKey					= @"kDeliveryStatusFromKey";
+
+
+// Receipts are coalesced per peer during these intervals.
+const NSTimeInterval kChatOutgoingReceiptsCoalescingInterval = 0.5;
+const NSTimeInterval kChatIncomingReceiptsCoalescingInterval = 0.1;
 
 
 //Api keys
@@ -52,8 +58,41 @@ NSString * const kStartTyping	= @"start";
 NSString * const kStoppedTyping	= @"stop";
 
 
+/*
+ Delivery and seen receipts of one peer collected during coalescing interval.
+ Seen receipt implies delivered one, so delivered mIds which are also seen are not reported.
+ */
+@interface SMChatReceipts : NSObject
+@property (nonatomic, readonly) NSMutableOrderedSet *deliveredMids;
+@property (nonatomic, readonly) NSMutableOrderedSet *seenMids;
+- (NSArray *)deliveredNotSeenMids;
+@end
+
+@implementation SMChatReceipts
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		_deliveredMids = [[NSMutableOrderedSet alloc] init];
+		_seenMids = [[NSMutableOrderedSet alloc] init];
+	}
+	return self;
+}
+- (NSArray *)deliveredNotSeenMids
+{
+	NSMutableOrderedSet *mIds = [_deliveredMids mutableCopy];
+	[mIds minusOrderedSet:_seenMids];
+	return [mIds array];
+}
+@end
+
+
 @implementation ChatManager
 {
+	NSMutableDictionary *_outgoingReceipts; // peer session id -> SMChatReceipts
+	NSMutableDictionary *_incomingReceipts; // peer session id -> SMChatReceipts
+	BOOL _outgoingReceiptsFlushScheduled;
+	BOOL _incomingReceiptsFlushScheduled;
 }
 
 
@@ -72,7 +111,8 @@ NSString * const kStoppedTyping	= @"stop";
 {
 	self = [super init];
 	if (self) {
-
+		_outgoingReceipts = [[NSMutableDictionary alloc] init];
+		_incomingReceipts = [[NSMutableDictionary alloc] init];
 	}
 	
 	return self;
@@ -141,25 +181,110 @@ NSString * const kStoppedTyping	= @"stop";
 
 - (void)sendDeliveryConfirmationForMid:(NSString *)mId to:(NSString *)recepientId
 {
-	NSDictionary *chatMessage = @{NSStr(kToKey) : recepientId,
-								  NSStr(kTypeKey): NSStr(kChatKey),
-								  NSStr(kChatKey): @{NSStr(kStatusKey): @{NSStr(kStateKey): NSStr(kLCDeliveredKey), NSStr(kMidKey) : mId}, NSStr(kNoEchoKey) : @(YES)}
-								  };
-	NSString *jsonChatMessage = [chatMessage JSONString];
-	spreed_me_log("Chat request: %s", [jsonChatMessage cDescription]);
-	[[SMConnectionController sharedInstance].channelingManager sendMessage:jsonChatMessage type:NSStr(kChatKey) to:recepientId];
+	[[self receiptsForPeer:recepientId inDictionary:_outgoingReceipts].deliveredMids addObject:mId];
+	[self scheduleOutgoingReceiptsFlush];
 }
 
 
 - (void)sendSeenMids:(NSArray *)mIds to:(NSString *)recepientId
 {
-	NSDictionary *chatMessage = @{NSStr(kToKey) : recepientId,
-								  NSStr(kTypeKey): NSStr(kChatKey),
-								  NSStr(kChatKey): @{NSStr(kStatusKey): @{NSStr(kSeenMidsKey) : mIds}, NSStr(kNoEchoKey) : @(YES)}
-								  };
-	NSString *jsonChatMessage = [chatMessage JSONString];
-	spreed_me_log("Chat request: %s", [jsonChatMessage cDescription]);
-	[[SMConnectionController sharedInstance].channelingManager sendMessage:jsonChatMessage type:NSStr(kChatKey) to:recepientId];
+	[[self receiptsForPeer:recepientId inDictionary:_outgoingReceipts].seenMids addObjectsFromArray:mIds];
+	[self scheduleOutgoingReceiptsFlush];
+}
+
+
+#pragma mark - Receipts coalescing
+
+- (SMChatReceipts *)receiptsForPeer:(NSString *)peerId inDictionary:(NSMutableDictionary *)receiptsDictionary
+{
+	SMChatReceipts *receipts = [receiptsDictionary objectForKey:peerId];
+	if (!receipts) {
+		receipts = [[SMChatReceipts alloc] init];
+		[receiptsDictionary setObject:receipts forKey:peerId];
+	}
+	return receipts;
+}
+
+
+- (void)scheduleOutgoingReceiptsFlush
+{
+	if (!_outgoingReceiptsFlushScheduled) {
+		_outgoingReceiptsFlushScheduled = YES;
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kChatOutgoingReceiptsCoalescingInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+			_outgoingReceiptsFlushScheduled = NO;
+			[self flushOutgoingReceipts];
+		});
+	}
+}
+
+
+/*
+ Seen mIds of a peer go in one message. Protocol has only single mId delivered state,
+ so delivered receipts which are not covered by seen ones are still sent one per message.
+ */
+- (void)flushOutgoingReceipts
+{
+	NSDictionary *outgoingReceipts = [_outgoingReceipts copy];
+	[_outgoingReceipts removeAllObjects];
+	
+	[outgoingReceipts enumerateKeysAndObjectsUsingBlock:^(NSString *recepientId, SMChatReceipts *receipts, BOOL *stop) {
+		for (NSString *mId in [receipts deliveredNotSeenMids]) {
+			NSDictionary *chatMessage = @{NSStr(kToKey) : recepientId,
+										  NSStr(kTypeKey): NSStr(kChatKey),
+										  NSStr(kChatKey): @{NSStr(kStatusKey): @{NSStr(kStateKey): NSStr(kLCDeliveredKey), NSStr(kMidKey) : mId}, NSStr(kNoEchoKey) : @(YES)}
+										  };
+			NSString *jsonChatMessage = [chatMessage JSONString];
+			spreed_me_log("Chat request: %s", [jsonChatMessage cDescription]);
+			[[SMConnectionController sharedInstance].channelingManager sendMessage:jsonChatMessage type:NSStr(kChatKey) to:recepientId];
+		}
+		
+		if ([receipts.seenMids count] > 0) {
+			NSDictionary *chatMessage = @{NSStr(kToKey) : recepientId,
+										  NSStr(kTypeKey): NSStr(kChatKey),
+										  NSStr(kChatKey): @{NSStr(kStatusKey): @{NSStr(kSeenMidsKey) : [receipts.seenMids array]}, NSStr(kNoEchoKey) : @(YES)}
+										  };
+			NSString *jsonChatMessage = [chatMessage JSONString];
+			spreed_me_log("Chat request: %s", [jsonChatMessage cDescription]);
+			[[SMConnectionController sharedInstance].channelingManager sendMessage:jsonChatMessage type:NSStr(kChatKey) to:recepientId];
+		}
+	}];
+}
+
+
+- (void)receivedDeliveredMid:(NSString *)mId seenMids:(NSArray *)seenMids from:(NSString *)from
+{
+	SMChatReceipts *receipts = [self receiptsForPeer:from inDictionary:_incomingReceipts];
+	if (mId) {
+		[receipts.deliveredMids addObject:mId];
+	}
+	if (seenMids) {
+		[receipts.seenMids addObjectsFromArray:seenMids];
+	}
+	
+	if (!_incomingReceiptsFlushScheduled) {
+		_incomingReceiptsFlushScheduled = YES;
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kChatIncomingReceiptsCoalescingInterval * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+			_incomingReceiptsFlushScheduled = NO;
+			[self flushIncomingReceipts];
+		});
+	}
+}
+
+
+// Posts one ChatMessageDeliveryStatusNotification per peer
+- (void)flushIncomingReceipts
+{
+	NSDictionary *incomingReceipts = [_incomingReceipts copy];
+	[_incomingReceipts removeAllObjects];
+	
+	[incomingReceipts enumerateKeysAndObjectsUsingBlock:^(NSString *from, SMChatReceipts *receipts, BOOL *stop) {
+		NSDictionary *userInfo = @{kDeliveryStatusFromKey : from,
+								   kDeliveryStatusDeliveredMidsKey : [receipts deliveredNotSeenMids],
+								   kDeliveryStatusSeenIdsKey : [receipts.seenMids array]};
+		[[NSNotificationCenter defaultCenter] postNotificationName:ChatMessageDeliveryStatusNotification
+															object:self
+														  userInfo:userInfo];
+	}];
 }
 
 
@@ -314,11 +439,8 @@ NSString * const kStoppedTyping	= @"stop";
 					// Ignore 'sent' for now
 				} else if ([statusObject isEqualToString:NSStr(kLCDeliveredKey)]) {
 					NSString *deliveredMId = [statusDict objectForKey:NSStr(kMidKey)];
-					if ([deliveredMId length] > 0) {
-						userInfo = @{kDeliveryStatusDeliveredMidKey : deliveredMId};
-						[[NSNotificationCenter defaultCenter] postNotificationName:ChatMessageDeliveryStatusNotification
-																			object:self
-																		  userInfo:userInfo];
+					if ([deliveredMId isKindOfClass:[NSString class]] && [deliveredMId length] > 0) {
+						[self receivedDeliveredMid:deliveredMId seenMids:nil from:from];
 					}
 				}
 			}
@@ -327,10 +449,7 @@ NSString * const kStoppedTyping	= @"stop";
 			if ([statusObject isKindOfClass:[NSArray class]]) {
 				NSArray *seenMids = (NSArray *)statusObject;
 				if ([seenMids count] > 0) {
-					userInfo = @{kDeliveryStatusSeenIdsKey : seenMids};
-					[[NSNotificationCenter defaultCenter] postNotificationName:ChatMessageDeliveryStatusNotification
-																		object:self
-																	  userInfo:userInfo];
+					[self receivedDeliveredMid:nil seenMids:seenMids from:from];
 				}
 			}
 			return;
@@ -466,12 +585,14 @@ NSString * const kStoppedTyping	= @"stop";
 		NSString *fileName = [dict objectForKey:NSStr(kLCNameKey)];
 		NSString *fileType = [dict objectForKey:NSStr(kLCTypeKey)];
 		unsigned long long fileSize = [[dict objectForKey:NSStr(kLCSizeKey)] unsignedLongLongValue];
+		NSString *contentHash = [dict objectForKey:NSStr(kLCContentHashKey)];
 		
 		fileInfo.chunks = chunks;
 		fileInfo.token = token;
 		fileInfo.fileName = fileName;
 		fileInfo.fileType = fileType;
 		fileInfo.fileSize = fileSize;
+		fileInfo.contentHash = [contentHash isKindOfClass:[NSString class]] ? contentHash : nil;
 	} else {
 		spreed_me_log("No fileInfo object or no dictionary to fill with or fileInfo object is of incorrect class!");
 	}
@@ -510,13 +631,16 @@ NSString * const kStoppedTyping	= @"stop";
 		{
 			ChatFileInfo *fileInfo = (ChatFileInfo *)message;
 			
-			NSDictionary *fileInfoDict = @{
+			NSMutableDictionary *fileInfoDict = [NSMutableDictionary dictionaryWithDictionary:@{
 										   NSStr(kLCChunksKey) : @(fileInfo.chunks),
 											   NSStr(kLCIdKey) : fileInfo.token,
 											   NSStr(kLCNameKey) : fileInfo.fileName,
 											   NSStr(kLCTypeKey) : fileInfo.fileType,
 											   NSStr(kLCSizeKey) : @(fileInfo.fileSize)
-										   };
+										   }];
+			if (fileInfo.contentHash.length > 0) {
+				[fileInfoDict setObject:fileInfo.contentHash forKey:NSStr(kLCContentHashKey)];
+			}
 			
 			retDict = @{
 						NSStr(kToKey): fileInfo.to, NSStr(kTypeKey): NSStr(kChatKey), NSStr(kChatKey): @{
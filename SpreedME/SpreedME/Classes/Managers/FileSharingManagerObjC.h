@@ -30,6 +30,18 @@ extern NSString * const FileDownloadProgressHasChangedNotification;
 extern NSString * const kFilePathUserInfoKey;
 extern NSString * const kFileTokenUserInfoKey;
 extern NSString * const kFileDownloadProgressUserInfoKey;
+extern NSString * const kFileDownloadRateUserInfoKey; // bytes per second, is absent while unknown
+extern NSString * const kFileDownloadTimeLeftUserInfoKey; // seconds, is absent while unknown
+
+extern NSString * const kEncryptedDownloadedFileSuffix; // appended to names of downloaded files which are stored encrypted
+
+typedef enum : NSInteger {
+	kSMFileTransferPriorityAutomatic = 0, // downloads app starts on its own, they wait while call is active
+	kSMFileTransferPriorityUserInitiated,
+} SMFileTransferPriority;
+
+// Should read exactly 'length' bytes at 'offset' into buffer. Is called on files worker thread.
+typedef BOOL (^SMFileChunkReadBlock)(uint8_t *buffer, uint64_t offset, NSUInteger length);
 
 
 @interface FileSharingManagerObjC : NSObject
@@ -41,13 +53,29 @@ extern NSString * const kFileDownloadProgressUserInfoKey;
  */
 + (instancetype)defaultManager;
 
-- (void)startDownloadingFile:(ChatFileInfo *)fileInfo;
+// When key (32 bytes) is set, downloaded files are stored encrypted at rest, see AES256Encryptor segmented file methods.
+// Pass nil to store files in plain. Manager sets key derived by SMKeyring from app identity on its own.
+- (void)setDownloadedFilesEncryptionKey:(NSData *)keyData;
+- (BOOL)isEncryptedDownloadedFileAtPath:(NSString *)path;
+// Encrypted files are decrypted to temporary location, only the last one is kept. Plain files are returned as they are.
+// Completion is called on the main thread, openableFilePath is nil if file couldn't be decrypted.
+- (void)openableFileForDownloadedFileAtPath:(NSString *)path completion:(void (^)(NSString *openableFilePath))completion;
+// Downloads are queued, only a few run at once and they are slowed down while call is active.
+- (void)startDownloadingFile:(ChatFileInfo *)fileInfo; // kSMFileTransferPriorityUserInitiated
+- (void)startDownloadingFile:(ChatFileInfo *)fileInfo priority:(SMFileTransferPriority)priority;
+// Bytes per second, 0 means unlimited.
+- (void)setDownloadBandwidthLimit:(uint32_t)downloadLimit uploadBandwidthLimit:(uint32_t)uploadLimit;
 - (void)pauseFileDownloadForToken:(NSString *)token;
 - (void)resumeFileDownloadForToken:(NSString *)token;
 - (void)stopFileDownloadForToken:(NSString *)token;
 
 // fileType is MIME type.
 - (void)startSharingFileAtPath:(NSString *)filePath fileName:(NSString *)fileName fileType:(NSString *)fileType fileIsTemporary:(BOOL)isTemporary forUsers:(NSSet *)users;
+// Shares copy-on-write clone of the file, so sharing starts immediately and the file can be changed meanwhile.
+// Falls back to sharing original file if it can't be cloned.
+- (void)startSharingCloneOfFileAtPath:(NSString *)filePath fileName:(NSString *)fileName fileType:(NSString *)fileType forUsers:(NSSet *)users;
+// Shares data which is read on demand with readBlock, nothing is copied to disk.
+- (void)startSharingDataOfSize:(uint64_t)size readBlock:(SMFileChunkReadBlock)readBlock fileName:(NSString *)fileName fileType:(NSString *)fileType forUsers:(NSSet *)users;
 - (void)stopSharingFileForToken:(NSString *)token;
 
 - (NSSet *)currentlyDownloadingFileTokens;
@@ -59,7 +87,8 @@ extern NSString * const kFileDownloadProgressUserInfoKey;
 - (void)fileHasBeenDownloadedForToken:(NSString *)token filePath:(NSString *)filePath;
 - (void)fileSharingHasStartedForToken:(NSString *)token chatFileInfo:(ChatFileInfo *)chatFileInfo;
 
-- (void)fileDownloadProgressHasChanged:(uint64_t)bytesDownloaded forToken:(NSString *)token;
+// Rate and timeLeft are negative while unknown.
+- (void)fileDownloadProgressHasChanged:(uint64_t)bytesDownloaded rate:(double)bytesPerSecond timeLeft:(NSTimeInterval)timeLeft forToken:(NSString *)token;
 
 - (NSString *)fileLocation;
 
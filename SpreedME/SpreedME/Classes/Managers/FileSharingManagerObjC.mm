@@ -34,8 +34,12 @@
 
 #import "UsersManager.h"
 #import "SMConnectionController_ObjectiveCPP.h"
+#import "AES256Encryptor.h"
 #import "ChatManager.h"
 #import "ChatMessage.h"
+#import "NSData+Conversion.h"
+#import "SMAppIdentityController.h"
+#import "SMKeyring.h"
 #import "PeerConnectionController.h"
 #import "PeerConnectionController_ObjectiveCPP.h"
 #import "SMLocalizedStrings.h"
@@ -48,6 +52,34 @@ NSString * const FileDownloadProgressHasChangedNotification	= @"FileDownloadProg
 NSString * const kFilePathUserInfoKey						= @"kFilePathUserInfoKey";
 NSString * const kFileTokenUserInfoKey						= @"kFileTokenUserInfoKey";
 NSString * const kFileDownloadProgressUserInfoKey			= @"kFileDownloadProgressUserInfoKey";
+NSString * const kFileDownloadRateUserInfoKey				= @"kFileDownloadRateUserInfoKey";
+NSString * const kFileDownloadTimeLeftUserInfoKey			= @"kFileDownloadTimeLeftUserInfoKey";
+
+NSString * const kEncryptedDownloadedFileSuffix				= @".smse"; // spreedme::kEncryptedDownloadFileSuffix
+
+// Salt and number of iterations of downloaded files key, the key itself is derived by SMKeyring from app identity.
+NSString * const kDownloadedFilesKeyMetadataFileName		= @"downloaded_files_key.plist";
+NSString * const kDecryptedFilesDirectoryName				= @"decrypted_files";
+
+
+class BlockChunkSourceProvider : public spreedme::FileChunkSourceProviderInterface
+{
+public:
+	BlockChunkSourceProvider(uint64 size, SMFileChunkReadBlock readBlock) : size_(size), readBlock_(readBlock) {};
+	
+	virtual uint64 Size() {return size_;};
+	virtual bool ReadAt(uint64 offset, char *buffer, uint32 size)
+	{
+		@autoreleasepool {
+			return readBlock_ && readBlock_((uint8_t *)buffer, offset, size);
+		}
+	};
+	virtual void Close() {readBlock_ = nil;};
+	
+private:
+	uint64 size_;
+	SMFileChunkReadBlock readBlock_;
+};
 
 
 ChatFileInfo *ChatFileInfoFromFileInfo(spreedme::FileInfo *fileInfo)
@@ -64,12 +96,14 @@ ChatFileInfo *ChatFileInfoFromFileInfo(spreedme::FileInfo *fileInfo)
 	NSString *fileName = NSStr(fileInfo->fileName.c_str());
 	NSString *fileType = NSStr(fileInfo->fileType.c_str());
 	unsigned long long fileSize = fileInfo->fileSize;
+	NSString *contentHash = fileInfo->contentHash.empty() ? nil : NSStr(fileInfo->contentHash.c_str());
 	
 	chatFileInfo.chunks = chunks;
 	chatFileInfo.token = token;
 	chatFileInfo.fileName = fileName;
 	chatFileInfo.fileType = fileType;
 	chatFileInfo.fileSize = fileSize;
+	chatFileInfo.contentHash = contentHash;
 	
 	return chatFileInfo;
 }
@@ -96,13 +130,13 @@ public:
 		return;
 	};
 	
-	virtual void DownloadProgressHasChanged(const std::string &token, uint64 bytesDownloaded, double estimatedFinishTimeInterval)
+	virtual void DownloadProgressHasChanged(const std::string &token, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval)
 	{
 		FileSharingManagerObjC *messageReceiver = messageReceiver_;
 		NSString *token_objC = NSStr(token.c_str());
 		
 		dispatch_async(dispatch_get_main_queue(), ^{
-			[messageReceiver fileDownloadProgressHasChanged:bytesDownloaded forToken:token_objC];
+			[messageReceiver fileDownloadProgressHasChanged:bytesDownloaded rate:bytesPerSecond timeLeft:estimatedFinishTimeInterval forToken:token_objC];
 		});
 		
 		return;
@@ -157,6 +191,9 @@ private:
 	rtc::Thread *_workerThread;
 	
     NSString *_documentsDirectory;
+	
+	NSData *_downloadedFilesEncryptionKey;
+	NSString *_lastDecryptedFileDirectory;
 }
 
 
@@ -202,8 +239,21 @@ private:
 		_fileSharingManagerDelegate = new FileSharingManagerDelegate(self);
 		_manager->SetDelegate(_fileSharingManagerDelegate);
 		
+		NSString *cachesDirectory = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES) firstObject];
+		if (cachesDirectory) {
+			NSString *contentIndexPath = [cachesDirectory stringByAppendingPathComponent:@"file_content_index.json"];
+			_manager->SetContentIndexFilePath(std::string([contentIndexPath fileSystemRepresentation]));
+		}
+		
+		_manager->SetCallIsActive([PeerConnectionController sharedInstance].inCall);
+		
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(callHasStarted:) name:CallHasStartedNotification object:nil];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(callIsFinished:) name:CallIsFinishedNotification object:nil];
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(userHasResetApp:) name:UserHasResetApplicationNotification object:nil];
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(userHasChangedApplicationMode:) name:UserHasChangedApplicationModeNotification object:nil];
+		
+		[[NSFileManager defaultManager] removeItemAtPath:[self decryptedFilesLocation] error:NULL];
+		[self setupDownloadedFilesEncryption];
 	}
 	return self;
 }
@@ -226,7 +276,80 @@ private:
 
 
 #pragma mark - Public methods
+- (void)setDownloadedFilesEncryptionKey:(NSData *)keyData
+{
+	if (keyData && keyData.length != 32) {
+		spreed_me_log("Download encryption key has to be 32 bytes long");
+		return;
+	}
+	
+	std::string key = keyData ? std::string((const char *)keyData.bytes, keyData.length) : std::string();
+	dispatch_async(dispatch_get_main_queue(), ^{
+		_downloadedFilesEncryptionKey = [keyData copy];
+		_manager->SetDownloadEncryptionKey(key);
+	});
+}
+
+
+- (BOOL)isEncryptedDownloadedFileAtPath:(NSString *)path
+{
+	return [path hasSuffix:kEncryptedDownloadedFileSuffix];
+}
+
+
+- (void)openableFileForDownloadedFileAtPath:(NSString *)path completion:(void (^)(NSString *openableFilePath))completion
+{
+	if (![self isEncryptedDownloadedFileAtPath:path]) {
+		completion(path);
+		return;
+	}
+	
+	NSData *keyData = _downloadedFilesEncryptionKey;
+	if (!keyData) {
+		spreed_me_log("Can't decrypt downloaded file, there is no key yet");
+		completion(nil);
+		return;
+	}
+	
+	// Only the last opened file is kept decrypted
+	if (_lastDecryptedFileDirectory) {
+		[[NSFileManager defaultManager] removeItemAtPath:_lastDecryptedFileDirectory error:NULL];
+		_lastDecryptedFileDirectory = nil;
+	}
+	
+	// File keeps its name so viewers show it and recognize its type, hence a directory per file
+	NSString *fileName = [[path lastPathComponent] stringByDeletingPathExtension]; // drops encrypted file suffix
+	NSString *decryptedFileDirectory = [[self decryptedFilesLocation] stringByAppendingPathComponent:[self randomFileName]];
+	NSString *decryptedFilePath = [decryptedFileDirectory stringByAppendingPathComponent:fileName];
+	
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		[[NSFileManager defaultManager] createDirectoryAtPath:decryptedFileDirectory
+								  withIntermediateDirectories:YES
+												   attributes:@{NSFileProtectionKey : NSFileProtectionComplete}
+														error:NULL];
+		BOOL success = [[[AES256Encryptor alloc] init] decryptSegmentedFileAtPath:path toPath:decryptedFilePath withKeyData:keyData];
+		if (!success) {
+			spreed_me_log("Couldn't decrypt downloaded file");
+			[[NSFileManager defaultManager] removeItemAtPath:decryptedFileDirectory error:NULL];
+		}
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			if (success) {
+				_lastDecryptedFileDirectory = decryptedFileDirectory;
+			}
+			completion(success ? decryptedFilePath : nil);
+		});
+	});
+}
+
+
 - (void)startDownloadingFile:(ChatFileInfo *)fileInfo_objc
+{
+	[self startDownloadingFile:fileInfo_objc priority:kSMFileTransferPriorityUserInitiated];
+}
+
+
+- (void)startDownloadingFile:(ChatFileInfo *)fileInfo_objc priority:(SMFileTransferPriority)priority
 {
 	if (fileInfo_objc) {
 		ChatFileInfo *message = fileInfo_objc;
@@ -239,6 +362,9 @@ private:
 			fileInfo.fileName = std::string([message.fileName cStringUsingEncoding:NSUTF8StringEncoding]);;
 			fileInfo.fileType = std::string([message.fileType cStringUsingEncoding:NSUTF8StringEncoding]);
 			fileInfo.fileSize = message.fileSize;
+			if (message.contentHash) {
+				fileInfo.contentHash = std::string([message.contentHash cStringUsingEncoding:NSUTF8StringEncoding]);
+			}
 			
 			std::set<std::string> userIds;
 			NSString *userSessionId_objc = [message.from copy];
@@ -256,12 +382,21 @@ private:
 			std::string tempFileLocation = std::string([tempFileLocation_objc cStringUsingEncoding:NSUTF8StringEncoding]);
 			spreed_me_log("Download File temp location: %s", tempFileLocation.c_str());
 			
-			_manager->DownloadFile(fileInfo, fileLocation, userIds, tempFileLocation);
+			spreedme::TransferPriority priority_cpp = (priority == kSMFileTransferPriorityAutomatic) ? spreedme::kTransferPriorityAutomatic : spreedme::kTransferPriorityUserInitiated;
+			_manager->DownloadFile(fileInfo, fileLocation, userIds, tempFileLocation, priority_cpp);
 		});
 	}
 }
 
 
+- (void)setDownloadBandwidthLimit:(uint32_t)downloadLimit uploadBandwidthLimit:(uint32_t)uploadLimit
+{
+	dispatch_async(dispatch_get_main_queue(), ^{
+		_manager->SetBandwidthLimits(downloadLimit, uploadLimit);
+	});
+}
+
+
 - (void)pauseFileDownloadForToken:(NSString *)token
 {
 	if (token) {
@@ -300,6 +435,76 @@ private:
 										token,
 										true);
 	
+	[self registerFileShareWithToken:token forUsers:users];
+}
+
+
+- (void)startSharingCloneOfFileAtPath:(NSString *)filePath fileName:(NSString *)fileName fileType:(NSString *)fileType forUsers:(NSSet *)users
+{
+	if ([self isEncryptedDownloadedFileAtPath:filePath]) {
+		[self startSharingEncryptedDownloadedFileAtPath:filePath fileName:fileName fileType:fileType forUsers:users];
+		return;
+	}
+	
+	std::string fileName_cpp = std::string([fileName cStringUsingEncoding:NSUTF8StringEncoding]);
+	std::string token = spreedme::FileUploader::CreateFileUploadTokenForFileName(fileName_cpp);
+	
+	NSString *clonePath = [[self tempFileLocation] stringByAppendingFormat:@"%@_%@", [self randomFileName], fileName];
+	
+	spreedme::FileChunkSource *source = new spreedme::ClonedFileChunkSource(std::string([filePath fileSystemRepresentation]),
+																			 clonePath ? std::string([clonePath fileSystemRepresentation]) : std::string());
+	_manager->StartSharingFromChunkSource(source,
+										  std::string([fileType cStringUsingEncoding:NSUTF8StringEncoding]),
+										  fileName_cpp,
+										  token);
+	
+	[self registerFileShareWithToken:token forUsers:users];
+}
+
+
+- (void)startSharingDataOfSize:(uint64_t)size readBlock:(SMFileChunkReadBlock)readBlock fileName:(NSString *)fileName fileType:(NSString *)fileType forUsers:(NSSet *)users
+{
+	std::string fileName_cpp = std::string([fileName cStringUsingEncoding:NSUTF8StringEncoding]);
+	std::string token = spreedme::FileUploader::CreateFileUploadTokenForFileName(fileName_cpp);
+	
+	spreedme::FileChunkSource *source = new spreedme::StreamingChunkSource(new BlockChunkSourceProvider(size, readBlock));
+	_manager->StartSharingFromChunkSource(source,
+										  std::string([fileType cStringUsingEncoding:NSUTF8StringEncoding]),
+										  fileName_cpp,
+										  token);
+	
+	[self registerFileShareWithToken:token forUsers:users];
+}
+
+
+// Peers get plain file, it is decrypted segment by segment as chunks are read.
+- (void)startSharingEncryptedDownloadedFileAtPath:(NSString *)filePath fileName:(NSString *)fileName fileType:(NSString *)fileType forUsers:(NSSet *)users
+{
+	NSData *keyData = _downloadedFilesEncryptionKey;
+	if (!keyData) {
+		spreed_me_log("Can't share encrypted downloaded file, there is no key yet");
+		return;
+	}
+	
+	AES256Encryptor *encryptor = [[AES256Encryptor alloc] init];
+	uint64_t size = [encryptor plaintextSizeOfSegmentedFileAtPath:filePath];
+	if ([self isEncryptedDownloadedFileAtPath:fileName]) {
+		fileName = [fileName stringByDeletingPathExtension];
+	}
+	
+	[self startSharingDataOfSize:size readBlock:^BOOL(uint8_t *buffer, uint64_t offset, NSUInteger length) {
+		NSData *data = [encryptor dataInRange:NSMakeRange((NSUInteger)offset, length) ofSegmentedFileAtPath:filePath withKeyData:keyData];
+		if ([data length] != length) {
+			return NO;
+		}
+		memcpy(buffer, [data bytes], length);
+		return YES;
+	} fileName:fileName fileType:fileType forUsers:users];
+}
+
+
+- (void)registerFileShareWithToken:(const std::string &)token forUsers:(NSSet *)users
+{
 	NSString *token_objC = [NSString stringWithCString:token.c_str() encoding:NSUTF8StringEncoding];
 	if (!users) {
 		users = [NSSet set];
@@ -426,6 +631,57 @@ private:
 }
 
 
+// Plain copies of encrypted downloaded files which are being viewed. Removed on next open and on start.
+- (NSString *)decryptedFilesLocation
+{
+	return [NSTemporaryDirectory() stringByAppendingPathComponent:kDecryptedFilesDirectoryName];
+}
+
+
+/*
+ Downloaded files key has to be the same on every launch, so unlike other encrypted files
+ it is derived with salt and number of iterations which are generated once and saved.
+ Derivation takes about 100ms and is done off the main thread. Files downloaded before key is ready are stored in plain.
+ */
+- (void)setupDownloadedFilesEncryption
+{
+	NSString *applicationSupportDirectory = [NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES) firstObject];
+	if (!applicationSupportDirectory) {
+		spreed_me_log("Couldn't retrieve application support directory, downloaded files won't be encrypted");
+		return;
+	}
+	
+	NSString *metadataPath = [applicationSupportDirectory stringByAppendingPathComponent:kDownloadedFilesKeyMetadataFileName];
+	
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		NSString *password = [[[SMAppIdentityController sharedInstance] appBigIdentifier] hexadecimalString];
+		
+		NSDictionary *metadata = [NSDictionary dictionaryWithContentsOfFile:metadataPath];
+		NSData *salt = [metadata objectForKey:kSMCryptoSaltKey];
+		NSUInteger iterations = [[metadata objectForKey:kSMCryptoIterationNumberKey] unsignedIntegerValue];
+		
+		NSData *keyData = nil;
+		if ([salt isKindOfClass:[NSData class]] && iterations > 0) {
+			keyData = [[SMKeyring sharedInstance] keyForPassword:password salt:salt iterations:iterations];
+		} else {
+			keyData = [[SMKeyring sharedInstance] encryptionKeyForPassword:password salt:&salt iterations:&iterations];
+			if (keyData) {
+				[[NSFileManager defaultManager] createDirectoryAtPath:applicationSupportDirectory withIntermediateDirectories:YES attributes:nil error:NULL];
+				metadata = @{kSMCryptoSaltKey : salt, kSMCryptoIterationNumberKey : @(iterations)};
+				if (![metadata writeToFile:metadataPath atomically:YES]) {
+					spreed_me_log("Couldn't save downloaded files key metadata, downloaded files won't be encrypted");
+					keyData = nil;
+				}
+			}
+		}
+		
+		if (keyData) {
+			[self setDownloadedFilesEncryptionKey:keyData];
+		}
+	});
+}
+
+
 - (NSString *)tempFileLocation
 {
 	NSString *tempDir = NSTemporaryDirectory();
@@ -496,6 +752,22 @@ private:
 
 #pragma mark - Notifications
 
+- (void)callHasStarted:(NSNotification *)notification
+{
+	dispatch_async(dispatch_get_main_queue(), ^{
+		_manager->SetCallIsActive(true);
+	});
+}
+
+
+- (void)callIsFinished:(NSNotification *)notification
+{
+	dispatch_async(dispatch_get_main_queue(), ^{
+		_manager->SetCallIsActive(false);
+	});
+}
+
+
 - (void)userHasResetApp:(NSNotification *)notification
 {
 	[self stopAllTransfers];
@@ -510,11 +782,19 @@ private:
 
 #pragma mark - File download
 
-- (void)fileDownloadProgressHasChanged:(uint64_t)bytesDownloaded forToken:(NSString *)token
+- (void)fileDownloadProgressHasChanged:(uint64_t)bytesDownloaded rate:(double)bytesPerSecond timeLeft:(NSTimeInterval)timeLeft forToken:(NSString *)token
 {
+	NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithDictionary:@{kFileTokenUserInfoKey : token, kFileDownloadProgressUserInfoKey : @(bytesDownloaded)}];
+	if (bytesPerSecond >= 0.0) {
+		[userInfo setObject:@(bytesPerSecond) forKey:kFileDownloadRateUserInfoKey];
+	}
+	if (timeLeft >= 0.0) {
+		[userInfo setObject:@(timeLeft) forKey:kFileDownloadTimeLeftUserInfoKey];
+	}
+	
 	[[NSNotificationCenter defaultCenter] postNotificationName:FileDownloadProgressHasChangedNotification
 														object:self
-													  userInfo:@{kFileTokenUserInfoKey : token, kFileDownloadProgressUserInfoKey : @(bytesDownloaded)}];
+													  userInfo:userInfo];
 }
 
 
@@ -23,13 +23,12 @@
 #import "ResourceDownloaderPerHost.h"
 
 #import "STQueue.h"
+#import "NetworkDataAccounting.h"
 #import "STNetworkDataStatisticsController.h"
 
 
 NSString * const kResourceDownloadTaskInUserInfoKey			= @"kResourceDownloadTaskInUserInfoKey";
 
-NSString * const kResourceDownloadService	= @"ResourceDownloadService";
-
 @interface GeneralResourceResponseSerializer : AFHTTPResponseSerializer
 @end
 
@@ -250,37 +249,21 @@ NSString * const kResourceDownloadService	= @"ResourceDownloadService";
 			
 			
 			if (urlSessionTask.countOfBytesReceived > 0) {
-				[[NSNotificationCenter defaultCenter]
-				 postNotificationName:STNetworkDataBytesHaveBeenReceivedNotification
-				 object:nil
-				 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(urlSessionTask.countOfBytesReceived),
-							kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+				NetworkDataAccountingAddReceivedBytes(kNetworkDataServiceResourceDownload, urlSessionTask.countOfBytesReceived);
 			}
 			
 			if (urlSessionTask.countOfBytesSent > 0) {
-				[[NSNotificationCenter defaultCenter]
-				 postNotificationName:STNetworkDataBytesHaveBeenSentNotification
-				 object:nil
-				 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(urlSessionTask.countOfBytesSent),
-							kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+				NetworkDataAccountingAddSentBytes(kNetworkDataServiceResourceDownload, urlSessionTask.countOfBytesSent);
 			}
 			
 		} failure:^(NSURLSessionDataTask *urlSessionTask, NSError *error) {
 			
 			if (urlSessionTask.countOfBytesReceived > 0) {
-				[[NSNotificationCenter defaultCenter]
-				 postNotificationName:STNetworkDataBytesHaveBeenReceivedNotification
-				 object:nil
-				 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(urlSessionTask.countOfBytesReceived),
-							kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+				NetworkDataAccountingAddReceivedBytes(kNetworkDataServiceResourceDownload, urlSessionTask.countOfBytesReceived);
 			}
 			
 			if (urlSessionTask.countOfBytesSent > 0) {
-				[[NSNotificationCenter defaultCenter]
-				 postNotificationName:STNetworkDataBytesHaveBeenSentNotification
-				 object:nil
-				 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(urlSessionTask.countOfBytesSent),
-							kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+				NetworkDataAccountingAddSentBytes(kNetworkDataServiceResourceDownload, urlSessionTask.countOfBytesSent);
 			}
 			
 			
@@ -292,10 +275,7 @@ NSString * const kResourceDownloadService	= @"ResourceDownloadService";
 		
 		uint64_t requestSize = STCalculateNSURLRequestSize(nsTask.currentRequest);
 		
-		[[NSNotificationCenter defaultCenter] postNotificationName:STNetworkDataBytesHaveBeenSentNotification
-															object:nil
-														  userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(requestSize),
-																	 kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+		NetworkDataAccountingAddSentBytes(kNetworkDataServiceResourceDownload, requestSize);
 	} else {
 //		NSLog(@"Error: no _httpSessionManager!");
 	}
@@ -314,11 +294,7 @@ NSString * const kResourceDownloadService	= @"ResourceDownloadService";
 			if ([responseObject isKindOfClass:[NSData class]]) {
 				NSUInteger dataLength = [responseObject length];
 				if (dataLength > 0) {
-					[[NSNotificationCenter defaultCenter]
-					 postNotificationName:STNetworkDataBytesHaveBeenReceivedNotification
-					 object:nil
-					 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(dataLength),
-								kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+					NetworkDataAccountingAddReceivedBytes(kNetworkDataServiceResourceDownload, dataLength);
 				}
 			}
 			
@@ -328,11 +304,7 @@ NSString * const kResourceDownloadService	= @"ResourceDownloadService";
 			if ([operation.responseData isKindOfClass:[NSData class]]) {
 				NSUInteger dataLength = [operation.responseData length];
 				if (dataLength) {
-					[[NSNotificationCenter defaultCenter]
-					 postNotificationName:STNetworkDataBytesHaveBeenReceivedNotification
-					 object:nil
-					 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(dataLength),
-								kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+					NetworkDataAccountingAddReceivedBytes(kNetworkDataServiceResourceDownload, dataLength);
 				}
 			}
 		}];
@@ -340,21 +312,13 @@ NSString * const kResourceDownloadService	= @"ResourceDownloadService";
 		uint64_t requestSize = STCalculateNSURLRequestSize(operation.request);
 		
 		if (requestSize > 0) {
-			[[NSNotificationCenter defaultCenter]
-			 postNotificationName:STNetworkDataBytesHaveBeenSentNotification
-			 object:nil
-			 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(requestSize),
-						kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+			NetworkDataAccountingAddSentBytes(kNetworkDataServiceResourceDownload, requestSize);
 		}
 		
 		
 		[operation setUploadProgressBlock:^(NSUInteger bytesWritten, long long totalBytesWritten, long long totalBytesExpectedToWrite) {
 			if (bytesWritten > 0) {
-				[[NSNotificationCenter defaultCenter]
-				 postNotificationName:STNetworkDataBytesHaveBeenSentNotification
-				 object:nil
-				 userInfo:@{kSTNetworkDataNotificationUserInfoBytesKey : @(bytesWritten),
-							kSTNetworkDataNotificationUserInfoServiceNameKey : kResourceDownloadService}];
+				NetworkDataAccountingAddSentBytes(kNetworkDataServiceResourceDownload, bytesWritten);
 			}
 		}];
 		
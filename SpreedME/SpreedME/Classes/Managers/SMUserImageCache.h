@@ -0,0 +1,78 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+#import <UIKit/UIKit.h>
+
+
+typedef void (^SMUserImageCacheCompletionBlock)(UIImage *image);
+
+// Point size of user images in users lists. Biggest user image view is 80 points.
+extern const CGFloat kSMUserImageCacheDefaultThumbnailSize;
+
+
+/*
+ Cache of decoded user pictures. Images are keyed by user key (user id or session id for anonymous users),
+ picture revision and thumbnail point size.
+ Memory tier holds rounded thumbnails and evicts least recently used ones when over memory budget.
+ Disk tier holds original picture data, files are named by SHA-256 of content so users with the same picture share one file.
+ Only the latest revision of user picture is kept on disk.
+ All methods can be called from any thread. Completion handlers are called on the main thread.
+ */
+@interface SMUserImageCache : NSObject
+
+@property (nonatomic, assign) NSUInteger memoryBudget; // In bytes of decoded thumbnails. By default 8MB.
+@property (nonatomic, assign) NSUInteger diskBudget; // In bytes of picture data. By default 20MB. Checked when disk entries are written.
+
++ (instancetype)sharedInstance;
+
+// Memory tier only. Returns nil if thumbnail is not in memory.
+- (UIImage *)cachedImageForKey:(NSString *)key revision:(uint64_t)revision pointSize:(CGFloat)pointSize;
+
+// Looks in memory and then on disk. Completion handler gets nil if picture of this revision is not cached.
+- (void)loadImageForKey:(NSString *)key
+			   revision:(uint64_t)revision
+			  pointSize:(CGFloat)pointSize
+	  completionHandler:(SMUserImageCacheCompletionBlock)completionHandler;
+
+/*
+ Decodes @data, creates rounded thumbnail and puts it to memory tier. If @storeToDisk is YES @data is also written to disk tier.
+ Returns nil if @data is not an image. This method decodes synchronously so do not call it on the main thread.
+ */
+- (UIImage *)imageByStoringImageData:(NSData *)data
+							  forKey:(NSString *)key
+							revision:(uint64_t)revision
+						   pointSize:(CGFloat)pointSize
+						 storeToDisk:(BOOL)storeToDisk;
+
+// The same as above but decodes on internal background queue.
+- (void)storeImageData:(NSData *)data
+				forKey:(NSString *)key
+			  revision:(uint64_t)revision
+			 pointSize:(CGFloat)pointSize
+		   storeToDisk:(BOOL)storeToDisk
+	 completionHandler:(SMUserImageCacheCompletionBlock)completionHandler;
+
+- (void)removeAllImagesFromMemory;
+- (void)removeAllImages; // Memory and disk
+
+@end
@@ -0,0 +1,500 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "SMUserImageCache.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+
+const CGFloat kSMUserImageCacheDefaultThumbnailSize = 80.0f;
+
+static NSString * const kSMUserImageCacheDirectoryName	= @"UserImages";
+static NSString * const kSMUserImageCacheIndexFileName	= @"index.plist";
+static NSString * const kSMUserImageCacheIndexRevisionKey	= @"rev";
+static NSString * const kSMUserImageCacheIndexHashKey		= @"hash";
+
+// Index is written with delay so users list with many pictures causes only one write.
+static const NSTimeInterval kSMUserImageCacheIndexWriteDelay = 2.0;
+
+
+@interface SMUserImageCacheEntry : NSObject
+@property (nonatomic, strong) UIImage *image;
+@property (nonatomic, assign) NSUInteger cost;
+@end
+
+@implementation SMUserImageCacheEntry
+@end
+
+
+@interface SMUserImageCache ()
+{
+	dispatch_queue_t _memoryQueue; // Serial. Guards memory tier.
+	dispatch_queue_t _diskQueue; // Serial. Guards disk index and files.
+	dispatch_queue_t _decodingQueue;
+	
+	NSMutableDictionary *_memoryEntries; // memory key -> SMUserImageCacheEntry
+	NSMutableOrderedSet *_memoryKeysLRU; // Least recently used first
+	NSUInteger _memoryCost;
+	
+	NSString *_directoryPath;
+	NSMutableDictionary *_diskIndex; // user key -> @{rev, hash}
+	NSUInteger _diskUsage;
+	BOOL _diskIndexWriteScheduled;
+	
+	CGFloat _screenScale;
+}
+
+@end
+
+
+@implementation SMUserImageCache
+
++ (instancetype)sharedInstance
+{
+	static dispatch_once_t once;
+	static SMUserImageCache *sharedInstance;
+	dispatch_once(&once, ^{
+		sharedInstance = [[self alloc] init];
+	});
+	return sharedInstance;
+}
+
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		_memoryBudget = 8 * 1024 * 1024;
+		_diskBudget = 20 * 1024 * 1024;
+		
+		_memoryQueue = dispatch_queue_create("SMUserImageCacheMemory", DISPATCH_QUEUE_SERIAL);
+		_diskQueue = dispatch_queue_create("SMUserImageCacheDisk", DISPATCH_QUEUE_SERIAL);
+		_decodingQueue = dispatch_queue_create("SMUserImageCacheDecoding", DISPATCH_QUEUE_SERIAL);
+		dispatch_set_target_queue(_diskQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+		dispatch_set_target_queue(_decodingQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+		
+		_memoryEntries = [[NSMutableDictionary alloc] init];
+		_memoryKeysLRU = [[NSMutableOrderedSet alloc] init];
+		
+		NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+		_directoryPath = [[paths firstObject] stringByAppendingPathComponent:kSMUserImageCacheDirectoryName];
+		
+		_screenScale = [UIScreen mainScreen].scale;
+		
+		dispatch_async(_diskQueue, ^{
+			[self loadDiskIndex];
+		});
+		
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(didReceiveMemoryWarning:) name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Public methods
+
+- (void)setMemoryBudget:(NSUInteger)memoryBudget
+{
+	_memoryBudget = memoryBudget;
+	dispatch_async(_memoryQueue, ^{
+		[self trimMemory];
+	});
+}
+
+
+- (UIImage *)cachedImageForKey:(NSString *)key revision:(uint64_t)revision pointSize:(CGFloat)pointSize
+{
+	if ([key length] == 0) {
+		return nil;
+	}
+	
+	NSString *memoryKey = [self memoryKeyForKey:key revision:revision pointSize:pointSize];
+	
+	__block UIImage *image = nil;
+	dispatch_sync(_memoryQueue, ^{
+		SMUserImageCacheEntry *entry = [_memoryEntries objectForKey:memoryKey];
+		if (entry) {
+			image = entry.image;
+			[_memoryKeysLRU removeObject:memoryKey];
+			[_memoryKeysLRU addObject:memoryKey];
+		}
+	});
+	
+	return image;
+}
+
+
+- (void)loadImageForKey:(NSString *)key
+			   revision:(uint64_t)revision
+			  pointSize:(CGFloat)pointSize
+	  completionHandler:(SMUserImageCacheCompletionBlock)completionHandler
+{
+	if (!completionHandler) {
+		return;
+	}
+	
+	UIImage *image = [self cachedImageForKey:key revision:revision pointSize:pointSize];
+	if (image || [key length] == 0) {
+		dispatch_async(dispatch_get_main_queue(), ^{
+			completionHandler(image);
+		});
+		return;
+	}
+	
+	dispatch_async(_diskQueue, ^{
+		NSData *data = [self diskDataForKey:key revision:revision];
+		if (!data) {
+			dispatch_async(dispatch_get_main_queue(), ^{
+				completionHandler(nil);
+			});
+			return;
+		}
+		
+		dispatch_async(_decodingQueue, ^{
+			UIImage *decodedImage = [self imageByStoringImageData:data forKey:key revision:revision pointSize:pointSize storeToDisk:NO];
+			dispatch_async(dispatch_get_main_queue(), ^{
+				completionHandler(decodedImage);
+			});
+		});
+	});
+}
+
+
+- (UIImage *)imageByStoringImageData:(NSData *)data
+							  forKey:(NSString *)key
+							revision:(uint64_t)revision
+						   pointSize:(CGFloat)pointSize
+						 storeToDisk:(BOOL)storeToDisk
+{
+	if ([data length] == 0 || [key length] == 0) {
+		return nil;
+	}
+	
+	UIImage *image = nil;
+	@autoreleasepool {
+		image = [self roundedThumbnailFromImageData:data pointSize:pointSize];
+	}
+	
+	if (!image) {
+		return nil;
+	}
+	
+	NSString *memoryKey = [self memoryKeyForKey:key revision:revision pointSize:pointSize];
+	SMUserImageCacheEntry *entry = [[SMUserImageCacheEntry alloc] init];
+	entry.image = image;
+	entry.cost = (NSUInteger)(image.size.width * image.scale * image.size.height * image.scale * 4);
+	
+	dispatch_sync(_memoryQueue, ^{
+		SMUserImageCacheEntry *oldEntry = [_memoryEntries objectForKey:memoryKey];
+		if (oldEntry) {
+			_memoryCost -= oldEntry.cost;
+			[_memoryKeysLRU removeObject:memoryKey];
+		}
+		[_memoryEntries setObject:entry forKey:memoryKey];
+		[_memoryKeysLRU addObject:memoryKey];
+		_memoryCost += entry.cost;
+		[self trimMemory];
+	});
+	
+	if (storeToDisk) {
+		dispatch_async(_diskQueue, ^{
+			[self storeDiskData:data forKey:key revision:revision];
+		});
+	}
+	
+	return image;
+}
+
+
+- (void)storeImageData:(NSData *)data
+				forKey:(NSString *)key
+			  revision:(uint64_t)revision
+			 pointSize:(CGFloat)pointSize
+		   storeToDisk:(BOOL)storeToDisk
+	 completionHandler:(SMUserImageCacheCompletionBlock)completionHandler
+{
+	dispatch_async(_decodingQueue, ^{
+		UIImage *image = [self imageByStoringImageData:data forKey:key revision:revision pointSize:pointSize storeToDisk:storeToDisk];
+		if (completionHandler) {
+			dispatch_async(dispatch_get_main_queue(), ^{
+				completionHandler(image);
+			});
+		}
+	});
+}
+
+
+- (void)removeAllImagesFromMemory
+{
+	dispatch_async(_memoryQueue, ^{
+		[_memoryEntries removeAllObjects];
+		[_memoryKeysLRU removeAllObjects];
+		_memoryCost = 0;
+	});
+}
+
+
+- (void)removeAllImages
+{
+	[self removeAllImagesFromMemory];
+	
+	dispatch_async(_diskQueue, ^{
+		NSError *error = nil;
+		if (![[NSFileManager defaultManager] removeItemAtPath:_directoryPath error:&error]) {
+			spreed_me_log("Couldn't remove user images cache %s", [error cDescription]);
+		}
+		[_diskIndex removeAllObjects];
+		_diskUsage = 0;
+		[[NSFileManager defaultManager] createDirectoryAtPath:_directoryPath withIntermediateDirectories:YES attributes:nil error:NULL];
+	});
+}
+
+
+#pragma mark - Memory tier
+
+- (NSString *)memoryKeyForKey:(NSString *)key revision:(uint64_t)revision pointSize:(CGFloat)pointSize
+{
+	return [NSString stringWithFormat:@"%@/%llu/%d", key, revision, (int)pointSize];
+}
+
+
+// Should be called on _memoryQueue
+- (void)trimMemory
+{
+	while (_memoryCost > _memoryBudget && [_memoryKeysLRU count] > 0) {
+		NSString *memoryKey = [_memoryKeysLRU firstObject];
+		SMUserImageCacheEntry *entry = [_memoryEntries objectForKey:memoryKey];
+		_memoryCost -= entry.cost;
+		[_memoryEntries removeObjectForKey:memoryKey];
+		[_memoryKeysLRU removeObjectAtIndex:0];
+	}
+}
+
+
+- (void)didReceiveMemoryWarning:(NSNotification *)notification
+{
+	[self removeAllImagesFromMemory];
+}
+
+
+#pragma mark - Disk tier
+// All methods in this section should be called on _diskQueue
+
+- (void)loadDiskIndex
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSError *error = nil;
+	if (![fileManager createDirectoryAtPath:_directoryPath withIntermediateDirectories:YES attributes:nil error:&error]) {
+		spreed_me_log("Couldn't create user images cache directory %s", [error cDescription]);
+	}
+	
+	NSDictionary *index = [NSDictionary dictionaryWithContentsOfFile:[_directoryPath stringByAppendingPathComponent:kSMUserImageCacheIndexFileName]];
+	_diskIndex = index ? [index mutableCopy] : [[NSMutableDictionary alloc] init];
+	
+	_diskUsage = 0;
+	for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:_directoryPath error:NULL]) {
+		if (![fileName isEqualToString:kSMUserImageCacheIndexFileName]) {
+			NSDictionary *attributes = [fileManager attributesOfItemAtPath:[_directoryPath stringByAppendingPathComponent:fileName] error:NULL];
+			_diskUsage += (NSUInteger)[attributes fileSize];
+		}
+	}
+}
+
+
+- (NSData *)diskDataForKey:(NSString *)key revision:(uint64_t)revision
+{
+	NSDictionary *indexEntry = [_diskIndex objectForKey:key];
+	if (!indexEntry || [[indexEntry objectForKey:kSMUserImageCacheIndexRevisionKey] unsignedLongLongValue] != revision) {
+		return nil;
+	}
+	
+	NSString *filePath = [_directoryPath stringByAppendingPathComponent:[indexEntry objectForKey:kSMUserImageCacheIndexHashKey]];
+	NSData *data = [NSData dataWithContentsOfFile:filePath];
+	if (data) {
+		// Modification date is used as last access date when disk tier is trimmed.
+		[[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate : [NSDate date]} ofItemAtPath:filePath error:NULL];
+	} else {
+		[_diskIndex removeObjectForKey:key];
+		[self scheduleDiskIndexWrite];
+	}
+	
+	return data;
+}
+
+
+- (void)storeDiskData:(NSData *)data forKey:(NSString *)key revision:(uint64_t)revision
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSString *contentHash = [[self class] sha256HexStringOfData:data];
+	NSString *filePath = [_directoryPath stringByAppendingPathComponent:contentHash];
+	
+	if ([fileManager fileExistsAtPath:filePath]) {
+		[fileManager setAttributes:@{NSFileModificationDate : [NSDate date]} ofItemAtPath:filePath error:NULL];
+	} else if ([data writeToFile:filePath atomically:YES]) {
+		_diskUsage += [data length];
+	} else {
+		spreed_me_log("Couldn't write user image to cache");
+		return;
+	}
+	
+	NSString *oldContentHash = [[_diskIndex objectForKey:key] objectForKey:kSMUserImageCacheIndexHashKey];
+	[_diskIndex setObject:@{kSMUserImageCacheIndexRevisionKey : @(revision),
+							kSMUserImageCacheIndexHashKey : contentHash}
+				   forKey:key];
+	
+	if (oldContentHash && ![oldContentHash isEqualToString:contentHash]) {
+		[self removeDiskFileIfUnreferenced:oldContentHash];
+	}
+	
+	if (_diskUsage > _diskBudget) {
+		[self trimDisk];
+	}
+	
+	[self scheduleDiskIndexWrite];
+}
+
+
+- (void)removeDiskFileIfUnreferenced:(NSString *)contentHash
+{
+	for (NSDictionary *indexEntry in [_diskIndex allValues]) {
+		if ([[indexEntry objectForKey:kSMUserImageCacheIndexHashKey] isEqualToString:contentHash]) {
+			return;
+		}
+	}
+	
+	[self removeDiskFile:contentHash];
+}
+
+
+- (void)removeDiskFile:(NSString *)fileName
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSString *filePath = [_directoryPath stringByAppendingPathComponent:fileName];
+	NSUInteger fileSize = (NSUInteger)[[fileManager attributesOfItemAtPath:filePath error:NULL] fileSize];
+	if ([fileManager removeItemAtPath:filePath error:NULL]) {
+		_diskUsage -= MIN(_diskUsage, fileSize);
+	}
+}
+
+
+// Removes least recently used files until disk usage is 3/4 of the budget.
+- (void)trimDisk
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSMutableArray *files = [[NSMutableArray alloc] init];
+	for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:_directoryPath error:NULL]) {
+		if (![fileName isEqualToString:kSMUserImageCacheIndexFileName]) {
+			NSDictionary *attributes = [fileManager attributesOfItemAtPath:[_directoryPath stringByAppendingPathComponent:fileName] error:NULL];
+			if (attributes) {
+				[files addObject:@[fileName, [attributes fileModificationDate]]];
+			}
+		}
+	}
+	
+	[files sortUsingComparator:^NSComparisonResult(NSArray *file1, NSArray *file2) {
+		return [[file1 objectAtIndex:1] compare:[file2 objectAtIndex:1]];
+	}];
+	
+	NSMutableSet *removedHashes = [[NSMutableSet alloc] init];
+	NSUInteger targetUsage = _diskBudget / 4 * 3;
+	for (NSArray *file in files) {
+		if (_diskUsage <= targetUsage) {
+			break;
+		}
+		[self removeDiskFile:[file firstObject]];
+		[removedHashes addObject:[file firstObject]];
+	}
+	
+	if ([removedHashes count] > 0) {
+		NSSet *removedKeys = [_diskIndex keysOfEntriesPassingTest:^BOOL(id key, NSDictionary *indexEntry, BOOL *stop) {
+			return [removedHashes containsObject:[indexEntry objectForKey:kSMUserImageCacheIndexHashKey]];
+		}];
+		[_diskIndex removeObjectsForKeys:[removedKeys allObjects]];
+	}
+}
+
+
+- (void)scheduleDiskIndexWrite
+{
+	if (_diskIndexWriteScheduled) {
+		return;
+	}
+	_diskIndexWriteScheduled = YES;
+	
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSMUserImageCacheIndexWriteDelay * NSEC_PER_SEC)), _diskQueue, ^{
+		_diskIndexWriteScheduled = NO;
+		if (![_diskIndex writeToFile:[_directoryPath stringByAppendingPathComponent:kSMUserImageCacheIndexFileName] atomically:YES]) {
+			spreed_me_log("Couldn't write user images cache index");
+		}
+	});
+}
+
+
+#pragma mark - Utils
+
+/*
+ Decodes and downscales image in one drawing pass. Images larger than @pointSize in screen pixels are scaled down,
+ smaller images keep their size so their rounded corners look as before.
+ */
+- (UIImage *)roundedThumbnailFromImageData:(NSData *)data pointSize:(CGFloat)pointSize
+{
+	UIImage *image = [[UIImage alloc] initWithData:data];
+	if (!image || image.size.width < 1.0f || image.size.height < 1.0f) {
+		return nil;
+	}
+	
+	CGFloat maxSide = pointSize * _screenScale;
+	CGFloat ratio = MIN(1.0f, maxSide / MAX(image.size.width, image.size.height));
+	CGSize thumbnailSize = CGSizeMake(roundf(image.size.width * ratio), roundf(image.size.height * ratio));
+	CGRect rect = CGRectMake(0.0f, 0.0f, thumbnailSize.width, thumbnailSize.height);
+	
+	UIGraphicsBeginImageContextWithOptions(thumbnailSize, NO, 1.0f);
+	[[UIBezierPath bezierPathWithRoundedRect:rect cornerRadius:kViewCornerRadius] addClip];
+	[image drawInRect:rect];
+	UIImage *thumbnail = UIGraphicsGetImageFromCurrentImageContext();
+	UIGraphicsEndImageContext();
+	
+	return thumbnail;
+}
+
+
++ (NSString *)sha256HexStringOfData:(NSData *)data
+{
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+	
+	NSMutableString *output = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+	for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+		[output appendFormat:@"%02x", digest[i]];
+	}
+	
+	return output;
+}
+
+
+@end
@@ -0,0 +1,51 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+typedef BOOL (^SMWriteBehindBlock)(void); // Returns NO if write has failed
+
+
+/*
+ Coalesces rapid successive saves of the same file (or group of files) into one write on a background queue.
+ Write block should capture snapshot of data it writes, it is called on a serial background queue
+ after 'coalescingInterval' since the first of coalesced saves. Only the last scheduled block for a key is run.
+ Pending writes are flushed when app goes to background or terminates.
+ Methods can be called from any thread except from within write blocks.
+ */
+@interface SMWriteBehindPersister : NSObject
+
+@property (nonatomic, assign) NSTimeInterval coalescingInterval; // By default 0.5 sec.
+
++ (instancetype)sharedInstance;
+
+- (void)scheduleWriteForKey:(NSString *)key withBlock:(SMWriteBehindBlock)writeBlock;
+
+// Runs pending write for key (if any) and waits until it is done. Call it before reading what is written under the key.
+- (void)flushWriteForKey:(NSString *)key;
+- (void)flushAllWrites;
+
+// Drops pending writes for keys starting with prefix and waits for write in progress to finish.
+// Call it before deleting what is written. Empty prefix drops all pending writes.
+- (void)cancelWritesForKeysWithPrefix:(NSString *)prefix;
+
+@end
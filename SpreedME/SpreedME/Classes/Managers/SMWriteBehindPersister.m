@@ -0,0 +1,176 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "SMWriteBehindPersister.h"
+
+#import <UIKit/UIKit.h>
+
+
+const NSTimeInterval kSMWriteBehindPersisterDefaultCoalescingInterval = 0.5;
+
+
+@interface SMWriteBehindPersister ()
+{
+	dispatch_queue_t _stateQueue; // guards _pendingWrites
+	dispatch_queue_t _writeQueue;
+	
+	NSMutableDictionary *_pendingWrites; // key -> SMWriteBehindBlock
+}
+
+@end
+
+
+@implementation SMWriteBehindPersister
+
++ (instancetype)sharedInstance
+{
+	static dispatch_once_t once;
+	static SMWriteBehindPersister *sharedInstance;
+	dispatch_once(&once, ^{
+		sharedInstance = [[self alloc] init];
+	});
+	return sharedInstance;
+}
+
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		_coalescingInterval = kSMWriteBehindPersisterDefaultCoalescingInterval;
+		_stateQueue = dispatch_queue_create("SMWriteBehindPersisterState", DISPATCH_QUEUE_SERIAL);
+		_writeQueue = dispatch_queue_create("SMWriteBehindPersisterWrite", DISPATCH_QUEUE_SERIAL);
+		dispatch_set_target_queue(_writeQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0));
+		_pendingWrites = [[NSMutableDictionary alloc] init];
+		
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationDidEnterBackground:) name:UIApplicationDidEnterBackgroundNotification object:nil];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(applicationWillTerminate:) name:UIApplicationWillTerminateNotification object:nil];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+
+#pragma mark - Public
+
+- (void)scheduleWriteForKey:(NSString *)key withBlock:(SMWriteBehindBlock)writeBlock
+{
+	if (key.length == 0 || !writeBlock) {
+		return;
+	}
+	
+	__block BOOL needsToSchedule = NO;
+	dispatch_sync(_stateQueue, ^{
+		needsToSchedule = ([_pendingWrites objectForKey:key] == nil);
+		[_pendingWrites setObject:[writeBlock copy] forKey:key];
+	});
+	
+	// If write for the key is already scheduled it will pick up the latest block
+	if (needsToSchedule) {
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_coalescingInterval * NSEC_PER_SEC)), _writeQueue, ^{
+			[self performPendingWriteForKey:key];
+		});
+	}
+}
+
+
+- (void)flushWriteForKey:(NSString *)key
+{
+	if (key.length == 0) {
+		return;
+	}
+	
+	dispatch_sync(_writeQueue, ^{
+		[self performPendingWriteForKey:key];
+	});
+}
+
+
+- (void)flushAllWrites
+{
+	dispatch_sync(_writeQueue, ^{
+		__block NSArray *keys = nil;
+		dispatch_sync(_stateQueue, ^{
+			keys = [_pendingWrites allKeys];
+		});
+		for (NSString *key in keys) {
+			[self performPendingWriteForKey:key];
+		}
+	});
+}
+
+
+- (void)cancelWritesForKeysWithPrefix:(NSString *)prefix
+{
+	dispatch_sync(_stateQueue, ^{
+		for (NSString *key in [_pendingWrites allKeys]) {
+			if (prefix.length == 0 || [key hasPrefix:prefix]) {
+				[_pendingWrites removeObjectForKey:key];
+			}
+		}
+	});
+	// Wait for write which might be in progress
+	dispatch_sync(_writeQueue, ^{});
+}
+
+
+#pragma mark - Private
+
+// Should be called on _writeQueue
+- (void)performPendingWriteForKey:(NSString *)key
+{
+	__block SMWriteBehindBlock writeBlock = nil;
+	dispatch_sync(_stateQueue, ^{
+		writeBlock = [_pendingWrites objectForKey:key];
+		[_pendingWrites removeObjectForKey:key];
+	});
+	
+	if (writeBlock) {
+		@autoreleasepool {
+			if (!writeBlock()) {
+				spreed_me_log("Write behind for key %s has failed", [key cDescription]);
+			}
+		}
+	}
+}
+
+
+#pragma mark - Notifications
+
+- (void)applicationDidEnterBackground:(NSNotification *)notification
+{
+	[self flushAllWrites];
+}
+
+
+- (void)applicationWillTerminate:(NSNotification *)notification
+{
+	[self flushAllWrites];
+}
+
+
+@end
@@ -42,7 +42,7 @@
 
 @property (nonatomic, readonly, strong) NSString *lastDayLimitedDateString;
 @property (nonatomic, readonly, strong) NSDate *lastUserActivityDate;
-@property (nonatomic, readonly, strong) NSArray *userActivity;
+@property (nonatomic, readonly, strong) NSArray *userActivity; // Reads whole history from disk, prefer activityAtIndex:
 
 @property (nonatomic, assign) NSUInteger indexOfLastActivitySeenByUser;
 @property (nonatomic, assign) NSUInteger numberOfActivitiesSeenByUser;
@@ -52,8 +52,12 @@
 
 - (id)initWithUserSessionId:(NSString *)userSessionId andActivityArray:(NSArray *)activityArray;
 
+/*
+ History is stored on disk per buddy userId or room name (see SMChatHistoryStore) and is restored when manager
+ for the same buddy or room is created again. Only activities around the last requested index are kept in memory.
+ */
 - (void)addUserActivityToHistory:(id<UserRecentActivity>)recentActivity;
-- (void)purgeAllHistory;
+- (void)purgeAllHistory; // Removes history from disk too
 - (id<UserRecentActivity>)activityAtIndex:(NSInteger)index;
 - (NSUInteger)activitiesCount;
 - (NSInteger)getNumberOfUnreadMessages;
@@ -27,9 +27,15 @@
 #import "ChannelingManager.h"
 #import "ChatManager.h"
 #import "NonRetainSubscriptionManager.h"
+#import "SMChatHistoryStore.h"
+#import "SMConnectionController.h"
 #import "UsersActivityController.h"
 
 
+// Activities around the requested index which are kept in memory.
+const NSUInteger kUserActivityWindowMargin = 50;
+
+
 @interface IndexedChatMessageActivity : NSObject
 @property (nonatomic, strong) ChatMessage *chatMessage;
 @property (nonatomic, assign) NSInteger index;
@@ -61,7 +67,15 @@
 	NSString *_userSessionId;
 	UsersActivityController *_usersAcitivityController;
 	
-	NSMutableArray *_userActivityArray;
+	SMChatHistoryStore *_historyStore;
+	
+	// Only a window of activities is kept in memory, the rest is read from _historyStore when needed.
+	NSRange _windowRange;
+	NSArray *_windowActivities; // NSNull for activities which couldn't be read
+	
+	// Activities which can still change stay in memory (file transfers and messages waiting for delivery status).
+	NSMutableDictionary *_pinnedActivities; // NSNumber index -> activity
+	id<UserRecentActivity> _lastActivity; // Its grouping changes when next activity is added
 	
 	NonRetainSubscriptionManager *_subscriptionManager;
 	
@@ -80,10 +94,26 @@
 	if (self) {
 		_userSessionId = userSessionId;
 		
-		if (!activityArray) {
-			_userActivityArray = [[NSMutableArray alloc] init];
-		} else {
-			_userActivityArray = [[NSMutableArray alloc] initWithArray:activityArray];
+		_historyStore = [[SMChatHistoryStore alloc] initWithConversationId:[self historyConversationId]];
+		_pinnedActivities = [[NSMutableDictionary alloc] init];
+		
+		for (id<UserRecentActivity> activity in activityArray) {
+			[_historyStore appendActivity:activity];
+		}
+		
+		if (_historyStore.hasRestoredHistory) {
+			// History from previous app runs is treated as seen
+			_numberOfActivitiesSeenByUser = [_historyStore count];
+			_indexOfLastActivitySeenByUser = [_historyStore count] - 1;
+			
+			_lastActivity = [_historyStore activityAtIndex:[_historyStore count] - 1];
+			if ([_lastActivity isKindOfClass:[ChatFileInfo class]]) {
+				((ChatFileInfo *)_lastActivity).isCanceled = YES;
+			}
+			_lastUserActivityDate = [_lastActivity date];
+			if (_lastUserActivityDate) {
+				_lastDayLimitedDateString = [[UsersActivityController sharedInstance] dayLimitedDateStringForDate:_lastUserActivityDate];
+			}
 		}
 		
         [[UsersManager defaultManager] subscribeForUpdates:self];
@@ -108,6 +138,9 @@
 		
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(localUserDidLeaveRoom:) name:LocalUserDidLeaveRoomNotification object:nil];
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(localUserDidJoinRoom:) name:LocalUserDidJoinRoomNotification object:nil];
+		
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(synchronizePinnedActivities) name:UIApplicationDidEnterBackgroundNotification object:nil];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(synchronizePinnedActivities) name:UIApplicationWillTerminateNotification object:nil];
 	}
 	
 	return self;
@@ -118,6 +151,38 @@
 {
 	[[NSNotificationCenter defaultCenter] removeObserver:self];
     [[UsersManager defaultManager] unsubscribeForUpdates:self];
+	[self synchronizePinnedActivities];
+}
+
+
+/*
+ Session ids change on every connection so history is stored for buddy userId or room name,
+ scoped by server and local user so it doesn't leak between servers and accounts.
+ Anonymous buddies can't be recognized later, their history is kept only for this app run (nil).
+ */
+- (NSString *)historyConversationId
+{
+	NSString *server = [SMConnectionController sharedInstance].currentServer;
+	if ([server length] == 0) {
+		return nil;
+	}
+	
+	SMLocalUser *localUser = [UsersManager defaultManager].currentUser;
+	NSString *localUserId = localUser.userId ? localUser.userId : @"";
+	
+	User *buddy = [[UsersManager defaultManager] userForSessionId:_userSessionId];
+	if (buddy) {
+		if ([buddy.userId length] == 0) {
+			return nil;
+		}
+		return [NSString stringWithFormat:@"%@\n%@\nuser\n%@", server, localUserId, buddy.userId];
+	}
+	
+	if ([_userSessionId isEqualToString:localUser.room.name] || [[UsersManager defaultManager] wasRoomVisited:_userSessionId]) {
+		return [NSString stringWithFormat:@"%@\n%@\nroom\n%@", server, localUserId, _userSessionId];
+	}
+	
+	return nil;
 }
 
 
@@ -137,35 +202,45 @@
 
 #pragma mark -
 
+// Receipts come batched per peer, so only manager of the peer conversation processes them.
 - (void)deliveryStatusNotificationReceived:(NSNotification *)notification
 {
-	NSString *deliveredMId = [notification.userInfo objectForKey:kDeliveryStatusDeliveredMidKey];
+	if (![[notification.userInfo objectForKey:kDeliveryStatusFromKey] isEqualToString:_userSessionId]) {
+		return;
+	}
+	
+	NSArray *deliveredMIds = [notification.userInfo objectForKey:kDeliveryStatusDeliveredMidsKey];
 	NSArray *seenMIds = [notification.userInfo objectForKey:kDeliveryStatusSeenIdsKey];
 	
 	NSMutableArray *activities = [NSMutableArray array];
 	NSMutableArray *activitiesIndices = [NSMutableArray array];
 	
-	if ([seenMIds count]) {
-		for (NSString *seenMid in seenMIds) {
-			IndexedChatMessageActivity *indexedChatMessage = [_notSeenSelfMessages objectForKey:seenMid];
-			if (indexedChatMessage) {
-				indexedChatMessage.chatMessage.deliveryStatus = kChatMessageDeliveryStatusRemoteSeen;
-				[activities addObject:indexedChatMessage.chatMessage];
-				[activitiesIndices addObject:@(indexedChatMessage.index)];
-				[_notSeenSelfMessages removeObjectForKey:seenMid];
-			}
+	for (NSString *seenMid in seenMIds) {
+		IndexedChatMessageActivity *indexedChatMessage = [self notSeenSelfMessageWithId:seenMid];
+		if (indexedChatMessage) {
+			indexedChatMessage.chatMessage.deliveryStatus = kChatMessageDeliveryStatusRemoteSeen;
+			[_historyStore replaceActivityAtIndex:indexedChatMessage.index withActivity:indexedChatMessage.chatMessage];
+			[activities addObject:indexedChatMessage.chatMessage];
+			[activitiesIndices addObject:@(indexedChatMessage.index)];
+			[_notSeenSelfMessages removeObjectForKey:seenMid];
+			[self unpinActivityAtIndex:indexedChatMessage.index];
 		}
 	}
 	
-	if ([deliveredMId length] > 0) {
-		IndexedChatMessageActivity *indexedChatMessage = [_notSeenSelfMessages objectForKey:deliveredMId];
-		if (indexedChatMessage) {
+	for (NSString *deliveredMId in deliveredMIds) {
+		IndexedChatMessageActivity *indexedChatMessage = [self notSeenSelfMessageWithId:deliveredMId];
+		if (indexedChatMessage && indexedChatMessage.chatMessage.deliveryStatus != kChatMessageDeliveryStatusRemoteReceived) {
 			indexedChatMessage.chatMessage.deliveryStatus = kChatMessageDeliveryStatusRemoteReceived;
+			[_historyStore replaceActivityAtIndex:indexedChatMessage.index withActivity:indexedChatMessage.chatMessage];
 			[activities addObject:indexedChatMessage.chatMessage];
 			[activitiesIndices addObject:@(indexedChatMessage.index)];
 		}
 	}
 	
+	if ([activities count] == 0) {
+		return;
+	}
+	
 	[_subscriptionManager enumerateObjectsUsingBlock:^(id obj, BOOL *stop) {
 		if ([obj respondsToSelector:@selector(userActivityManager:didUpdateActivities:atIndices:)]) {
 			[obj userActivityManager:self didUpdateActivities:activities atIndices:activitiesIndices];
@@ -174,6 +249,29 @@
 }
 
 
+/*
+ Messages sent in this session are in _notSeenSelfMessages.
+ Messages restored from history are found by mId in _historyStore and pinned until they are seen.
+ */
+- (IndexedChatMessageActivity *)notSeenSelfMessageWithId:(NSString *)mId
+{
+	IndexedChatMessageActivity *indexedChatMessage = [_notSeenSelfMessages objectForKey:mId];
+	
+	if (!indexedChatMessage) {
+		NSUInteger index = [_historyStore indexOfActivityWithMessageId:mId];
+		if (index != NSNotFound) {
+			id<UserRecentActivity> activity = [self activityAtIndex:index];
+			if ([activity isKindOfClass:[ChatMessage class]]) {
+				[self optionalCheckChatMessage:(ChatMessage *)activity atIndex:index];
+				indexedChatMessage = [_notSeenSelfMessages objectForKey:mId];
+			}
+		}
+	}
+	
+	return indexedChatMessage;
+}
+
+
 #pragma mark - UserAvailability management
 
 - (void)setIsUserAvailable:(BOOL)isUserAvailable
@@ -252,9 +350,19 @@
 
 #pragma mark -
 
+// Reads whole history from disk
 - (NSArray *)userActivity
 {
-	return [NSArray arrayWithArray:_userActivityArray];
+	NSUInteger count = [_historyStore count];
+	NSMutableArray *activities = [[NSMutableArray alloc] initWithCapacity:count];
+	for (NSUInteger i = 0; i < count; i++) {
+		id<UserRecentActivity> activity = [self activityAtIndex:i];
+		if (activity) {
+			[activities addObject:activity];
+		}
+	}
+	
+	return activities;
 }
 
 
@@ -263,9 +371,10 @@
 	_lastUserActivityDate = [NSDate date];
 	_lastDayLimitedDateString = [[UsersActivityController sharedInstance] dayLimitedDateStringForDate:_lastUserActivityDate];
 	
-	NSInteger previousActivityIndex = [_userActivityArray count] - 1;
+	NSInteger previousActivityIndex = [_historyStore count] - 1;
 	if (previousActivityIndex >= 0) {
-		id<UserRecentActivity> previousActivity = [_userActivityArray objectAtIndex:previousActivityIndex];
+		id<UserRecentActivity> previousActivity = [self activityAtIndex:previousActivityIndex];
+		BOOL previousWasEndOfGroup = [previousActivity isEndOfGroup];
 		
 		BOOL shouldGroupAutomatticalyRecent = YES;
 		if ([recentActivity respondsToSelector:@selector(shouldNotGroupAutomatically)]) {
@@ -289,15 +398,22 @@
 			[recentActivity setIsEndOfGroup:YES];
 		}
 		
+		if (previousActivity && previousWasEndOfGroup != [previousActivity isEndOfGroup]) {
+			[_historyStore replaceActivityAtIndex:previousActivityIndex withActivity:previousActivity];
+		}
+		
 	} else {
 		[recentActivity setIsStartOfGroup:YES];
 		[recentActivity setIsEndOfGroup:YES];
 	}
 	
-	[_userActivityArray addObject:recentActivity];
-	
+	NSUInteger indexOfAddedActivity = [_historyStore appendActivity:recentActivity];
+	if (indexOfAddedActivity == NSNotFound) {
+		spreed_me_log("Couldn't add activity to history of %s", [_userSessionId cDescription]);
+		return;
+	}
 	
-	NSInteger indexOfAddedActivity = [_userActivityArray count] - 1;
+	_lastActivity = recentActivity;
 	
 	[self optionalActivityCheck:recentActivity atIndex:indexOfAddedActivity];
 	
@@ -311,31 +427,105 @@
 
 - (void)purgeAllHistory
 {
-	[_userActivityArray removeAllObjects];
+	[_historyStore removeAllActivities];
+	
+	[_pinnedActivities removeAllObjects];
+	[_notSeenSelfMessages removeAllObjects];
+	_lastActivity = nil;
+	_windowRange = NSMakeRange(0, 0);
+	_windowActivities = nil;
+	
+	_indexOfLastActivitySeenByUser = 0;
+	_numberOfActivitiesSeenByUser = 0;
 }
 
 
 - (NSInteger)getNumberOfUnreadMessages
 {
-	return [_userActivityArray count] - _numberOfActivitiesSeenByUser;
+	return [_historyStore count] - _numberOfActivitiesSeenByUser;
 }
 
 
 - (id<UserRecentActivity>)activityAtIndex:(NSInteger)index
 {
-	id<UserRecentActivity> activity = nil;
+	NSUInteger count = [_historyStore count];
+	if (index < 0 || (NSUInteger)index >= count) {
+		return nil;
+	}
 	
-	if (index >= 0 && index < [_userActivityArray count]) {
-		activity = [_userActivityArray objectAtIndex:index];
+	if ((NSUInteger)index == count - 1 && _lastActivity) {
+		return _lastActivity;
 	}
-		
-	return activity;
+	
+	id<UserRecentActivity> activity = [_pinnedActivities objectForKey:@(index)];
+	if (activity) {
+		return activity;
+	}
+	
+	if (!NSLocationInRange(index, _windowRange)) {
+		[self loadWindowAroundIndex:index];
+	}
+	
+	id windowActivity = [_windowActivities objectAtIndex:index - _windowRange.location];
+	
+	return windowActivity != [NSNull null] ? windowActivity : nil;
 }
 
 
 - (NSUInteger)activitiesCount
 {
-	return [_userActivityArray count];
+	return [_historyStore count];
+}
+
+
+#pragma mark - History window
+
+- (void)loadWindowAroundIndex:(NSUInteger)index
+{
+	NSUInteger location = index > kUserActivityWindowMargin ? index - kUserActivityWindowMargin : 0;
+	NSRange range = NSMakeRange(location, MIN(2 * kUserActivityWindowMargin + 1, [_historyStore count] - location));
+	
+	NSMutableArray *activities = [[_historyStore activitiesInRange:range] mutableCopy];
+	
+	for (NSUInteger i = 0; i < [activities count]; i++) {
+		// Keep the same objects for activities which are in memory anyway
+		id<UserRecentActivity> pinnedActivity = [_pinnedActivities objectForKey:@(range.location + i)];
+		if (pinnedActivity) {
+			[activities replaceObjectAtIndex:i withObject:pinnedActivity];
+		} else if ([[activities objectAtIndex:i] isKindOfClass:[ChatFileInfo class]]) {
+			// File transfers of this session are pinned, so this one is from previous app run and can't be resumed.
+			((ChatFileInfo *)[activities objectAtIndex:i]).isCanceled = YES;
+		}
+	}
+	
+	_windowRange = range;
+	_windowActivities = activities;
+}
+
+
+- (void)pinActivity:(id<UserRecentActivity>)activity atIndex:(NSUInteger)index
+{
+	[_pinnedActivities setObject:activity forKey:@(index)];
+}
+
+
+- (void)unpinActivityAtIndex:(NSUInteger)index
+{
+	id<UserRecentActivity> activity = [_pinnedActivities objectForKey:@(index)];
+	if (activity && ![activity isKindOfClass:[ChatFileInfo class]]) {
+		[_pinnedActivities removeObjectForKey:@(index)];
+	}
+}
+
+
+// Writes state of activities which are changed in place (file transfer progress) to history.
+- (void)synchronizePinnedActivities
+{
+	[_pinnedActivities enumerateKeysAndObjectsUsingBlock:^(NSNumber *index, id<UserRecentActivity> activity, BOOL *stop) {
+		if ([activity isKindOfClass:[ChatFileInfo class]]) {
+			[_historyStore replaceActivityAtIndex:[index unsignedIntegerValue] withActivity:activity];
+		}
+	}];
 }
 
 
@@ -343,6 +533,10 @@
 
 - (void)optionalActivityCheck:(id<UserRecentActivity>)activity atIndex:(NSInteger)index
 {
+	if ([activity isKindOfClass:[ChatFileInfo class]]) {
+		[self pinActivity:activity atIndex:index];
+	}
+	
 	if ([activity isKindOfClass:[ChatMessage class]]) {
 		ChatMessage *chatMessageActivity = (ChatMessage *)activity;
 		
@@ -351,13 +545,16 @@
 }
 
 
+// Group chat messages don't get delivery confirmations so they are not tracked (and not pinned in memory).
 - (void)optionalCheckChatMessage:(ChatMessage *)chatMessageActivity atIndex:(NSInteger)index
 {
 	if (chatMessageActivity.deliveryStatus != kChatMessageDeliveryStatusRemoteMessage &&
 		chatMessageActivity.deliveryStatus != kChatMessageDeliveryStatusRemoteSeen &&
+		chatMessageActivity.deliveryStatus != kChatMessageDeliveryStatusGroupChat &&
 		[chatMessageActivity.mId length] > 0) {
 		IndexedChatMessageActivity *indexedActivity = [IndexedChatMessageActivity indexedChatMessageActivityWithChatMessage:chatMessageActivity atIndex:index];
 		[_notSeenSelfMessages setObject:indexedActivity forKey:chatMessageActivity.mId];
+		[self pinActivity:chatMessageActivity atIndex:index];
 	}
 }
 
@@ -39,10 +39,30 @@ typedef enum BuddySortOrder
 BuddySortOrder;
 
 
+/*
+ Describes how list returned by roomDisplayUsersSortedByDisplayName has changed since previous update.
+ Deleted and reloaded indexes refer to the previous list, inserted indexes refer to the new one.
+ Moves are STPair objects with NSNumber indexes, key is index in previous list and value is index in the new one.
+ This maps directly to UITableView batch updates.
+ */
+@interface SMRoomDisplayUsersChange : NSObject
+
+@property (nonatomic, readonly) BOOL isReload; // the whole list has been replaced, there are no indexes in this case
+@property (nonatomic, readonly) NSUInteger previousCount;
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly, strong) NSIndexSet *deletedIndexes;
+@property (nonatomic, readonly, strong) NSIndexSet *insertedIndexes;
+@property (nonatomic, readonly, strong) NSIndexSet *reloadedIndexes;
+@property (nonatomic, readonly, strong) NSArray *moves;
+
+@end
+
+
 @protocol UserUpdatesProtocol <NSObject>
 @optional
 - (void)roomSessionsListReceived;
 - (void)roomUsersListUpdated;
+- (void)roomDisplayUsersHaveChanged:(SMRoomDisplayUsersChange *)change; // sent right before roomUsersListUpdated
 - (void)userHasBeenUpdated:(User *)user;
 - (void)userSessionHasJoinedRoom:(User *)user;
 - (void)userSessionHasLeft:(User *)user disconnectedFromServer:(BOOL)yesNo;
@@ -22,22 +22,22 @@
 
 #import "UsersManager.h"
 
-#import "SortedDictionary/SortedDictionary/Public/MutableSortedDictionary.h"
-#import "SortedDictionary/SortedDictionary/Public/SortedDictionaryEntry.h"
-
 #import "AES256Encryptor.h"
 #import "BuddyParser.h"
 #import "ChatManager.h"
 #import "JSONKit.h"
 #import "NonRetainSubscriptionManager.h"
-#import "NSString+SortedDictionaryAdditions.h"
 #import "NSData+Conversion.h"
 #import "SettingsController.h"
 #import "SMAppIdentityController.h"
 #import "SMConnectionController.h"
 #import "SMDisplayUser.h"
 #import "SMHmacHelper.h"
+#import "SMUserSessionEvent.h"
+#import "SMWriteBehindPersister.h"
+#import "STPair.h"
 #import "STRandomStringGenerator.h"
+#import "STSortedIndex.h"
 
 
 @interface UsersManager ()
@@ -47,10 +47,15 @@
 	// Users
 	// Room users
 	NSMutableDictionary *_roomUsersKeyId;
-	MutableSortedDictionary *_roomUsersKeySort;
+	STSortedIndex *_roomUsersKeySort; // value-> User; key-> sortString of User
 	
 	NSMutableDictionary *_roomDisplayUsersKeyUserId; // value-> SMDisplayUser object; key-> UserId of SMDisplayUser (not the same as User.userId)
-	MutableSortedDictionary *_roomDisplayUsersKeySort; // value-> SMDisplayUser; key-> sortString of SMDisplayUser
+	STSortedIndex *_roomDisplayUsersKeySort; // value-> SMDisplayUser; key-> sortString of SMDisplayUser
+	
+	// Room display users list as subscribers have last seen it and what has changed since then.
+	NSArray *_publishedRoomDisplayUsers;
+	NSHashTable *_touchedRoomDisplayUsers; // display users which were removed from or inserted into _roomDisplayUsersKeySort
+	BOOL _roomDisplayUsersListReset;
 	
 	// Held users
 	NSMutableDictionary *_heldUsersMap; // value->User key->User.sessionId
@@ -69,6 +74,23 @@
 @end
 
 
+@interface SMRoomDisplayUsersChange ()
+
+@property (nonatomic, readwrite) BOOL isReload;
+@property (nonatomic, readwrite) NSUInteger previousCount;
+@property (nonatomic, readwrite) NSUInteger count;
+@property (nonatomic, readwrite, strong) NSIndexSet *deletedIndexes;
+@property (nonatomic, readwrite, strong) NSIndexSet *insertedIndexes;
+@property (nonatomic, readwrite, strong) NSIndexSet *reloadedIndexes;
+@property (nonatomic, readwrite, strong) NSArray *moves;
+
+@end
+
+
+@implementation SMRoomDisplayUsersChange
+@end
+
+
 @implementation UsersManager
 
 #pragma mark - Init
@@ -91,9 +113,11 @@
 		_subscriptionManager = [[NonRetainSubscriptionManager alloc] init];
 		
 		_roomUsersKeyId = [[NSMutableDictionary alloc] init];
-		_roomUsersKeySort = [[MutableSortedDictionary alloc] init];
+		_roomUsersKeySort = [[STSortedIndex alloc] init];
 		_roomDisplayUsersKeyUserId = [[NSMutableDictionary alloc] init];
-		_roomDisplayUsersKeySort = [[MutableSortedDictionary alloc] init];
+		_roomDisplayUsersKeySort = [[STSortedIndex alloc] init];
+		_publishedRoomDisplayUsers = [NSArray array];
+		_touchedRoomDisplayUsers = [NSHashTable hashTableWithOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality];
 		
 		_heldUsersMap = [[NSMutableDictionary alloc] init];
 		
@@ -109,6 +133,7 @@
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(connectionBecomeInactive:) name:ChannelingConnectionBecomeInactiveNotification object:nil];
 		
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(buddyImageHasChanged:) name:BuddyImageHasBeenUpdatedNotification object:nil];
+		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(buddyImagesHaveChanged:) name:BuddyImagesHaveBeenUpdatedNotification object:nil];
 		
 		[[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(localUserDidJoinRoom:) name:LocalUserDidJoinRoomNotification object:nil];
 		
@@ -137,6 +162,7 @@
 
 - (SMLocalUser *)loadUserFromDir:(NSString *)dir
 {
+	[[SMWriteBehindPersister sharedInstance] flushWriteForKey:dir];
 	SMLocalUser *user = [SMLocalUser localUserFromDir:dir];
 	return user;
 }
@@ -185,10 +211,17 @@
 		
 		NSString *hashedName = [SMHmacHelper sha256Hash:userId];
 		NSString *dir = [[self savedUsersDirectory] stringByAppendingPathComponent:hashedName];
-		BOOL success = [self saveUser:userToSave toDir:dir];
-		if (!success) {
+		if (dir.length == 0) {
 			spreed_me_log("Couldn't save current user!");
+			return;
 		}
+		
+		// Take snapshot of the user now, encryption and writing are done later on background queue
+		// and several saves in a row end up in one write.
+		NSDictionary *userDict = [userToSave dictionaryFromUser];
+		[[SMWriteBehindPersister sharedInstance] scheduleWriteForKey:dir withBlock:^BOOL{
+			return [SMLocalUser saveUserDictionary:userDict toDir:dir];
+		}];
 	}
 }
 
@@ -196,6 +229,9 @@
 - (void)deleteAllSavedUsers
 {
 	NSString *dir = [self savedUsersDirectory];
+	if (dir.length > 0) {
+		[[SMWriteBehindPersister sharedInstance] cancelWritesForKeysWithPrefix:dir];
+	}
 	NSArray *userDirs = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:dir error:nil];
 	
 	for (NSString *userDir in userDirs) {
@@ -314,7 +350,7 @@
 
 - (NSArray *)roomUsersSortedByDisplayName
 {
-	return [_roomUsersKeySort allValues];
+	return [_roomUsersKeySort allObjects];
 }
 
 
@@ -332,15 +368,13 @@
 
 - (User *)roomUserForIndex:(NSUInteger)index withSortOrder:(BuddySortOrder)buddySortOrder
 {
-	NSString *keyAtIndex = [[_roomUsersKeySort allKeys] objectAtIndex:index];
-	
-	return [_roomUsersKeySort objectForKey:keyAtIndex];
+	return [_roomUsersKeySort objectAtIndex:index];
 }
 
 
 - (NSArray *)roomDisplayUsersSortedByDisplayName
 {
-	return [_roomDisplayUsersKeySort allValues];
+	return [_roomDisplayUsersKeySort allObjects];
 }
 
 
@@ -358,9 +392,7 @@
 
 - (SMDisplayUser *)roomDisplayUserForIndex:(NSUInteger)index withSortOrder:(BuddySortOrder)buddySortOrder
 {
-	NSString *keyAtIndex = [[_roomDisplayUsersKeySort allKeys] objectAtIndex:index];
-	
-	return [_roomDisplayUsersKeySort objectForKey:keyAtIndex];
+	return [_roomDisplayUsersKeySort objectAtIndex:index];
 }
 
 
@@ -497,7 +529,12 @@
 
 - (void)sendRoomUsersListUpdate
 {
+	SMRoomDisplayUsersChange *change = [self takeRoomDisplayUsersChange];
+	
 	[_subscriptionManager enumerateObjectsUsingBlock:^(id obj, BOOL *stop) {
+		if ([obj respondsToSelector:@selector(roomDisplayUsersHaveChanged:)]) {
+			[obj roomDisplayUsersHaveChanged:change];
+		}
 		if ([obj respondsToSelector:@selector(roomUsersListUpdated)]) {
 			[obj roomUsersListUpdated];
 		}
@@ -549,7 +586,7 @@
 	SMDisplayUser *displayUser = nil;
 	if (displayUserHint) {
 		displayUser = displayUserHint;
-		[_roomDisplayUsersKeySort removeObjectForKey:[displayUser sortString]];
+		[self removeRoomDisplayUserFromSortIndex:displayUser];
 		[displayUser addUserSession:roomUser];
 		[_roomDisplayUsersKeyUserId setObject:displayUser forKey:displayUser.Id];
 	} else {
@@ -566,7 +603,7 @@
 				displayUser = [SMDisplayUser displayUserWithType:dispUserType];
 				[displayUser addUserSession:roomUser];
 			} else {
-				[_roomDisplayUsersKeySort removeObjectForKey:[displayUser sortString]];
+				[self removeRoomDisplayUserFromSortIndex:displayUser];
 				[displayUser addUserSession:roomUser];
 			}
 			
@@ -580,7 +617,7 @@
 	}
 	
 	if (displayUser) {
-		[_roomDisplayUsersKeySort setObject:displayUser forKey:[displayUser sortString]];
+		[self insertRoomDisplayUserIntoSortIndex:displayUser];
 	}
 }
 
@@ -605,14 +642,14 @@
 		displayUser = [_roomDisplayUsersKeyUserId objectForKey:roomUser.userId];
 		if (displayUser) {
 			// sort string can change so delete displayUser here and readd it, if appropriate, later
-			[_roomDisplayUsersKeySort removeObjectForKey:[displayUser sortString]];
+			[self removeRoomDisplayUserFromSortIndex:displayUser];
 			
 			[displayUser removeUserSessionWithId:roomUser.sessionId];
 			if (displayUser.userSessions.count > 0) {
 				[_roomDisplayUsersKeyUserId setObject:displayUser forKey:displayUser.Id];
 				
 				// sort string could have changed, readd displayUser
-				[_roomDisplayUsersKeySort setObject:displayUser forKey:[displayUser sortString]];
+				[self insertRoomDisplayUserIntoSortIndex:displayUser];
 			} else {
 				[_roomDisplayUsersKeyUserId removeObjectForKey:roomUser.userId];
 			}
@@ -622,7 +659,7 @@
 		if (displayUser) {
 			[_roomDisplayUsersKeyUserId removeObjectForKey:roomUser.sessionId];
 			
-			[_roomDisplayUsersKeySort removeObjectForKey:[displayUser sortString]];
+			[self removeRoomDisplayUserFromSortIndex:displayUser];
 		}
 	}
     
@@ -645,6 +682,137 @@
 {
 	[_roomDisplayUsersKeyUserId removeAllObjects];
 	[_roomDisplayUsersKeySort removeAllObjects];
+	_roomDisplayUsersListReset = YES;
+}
+
+
+- (void)insertRoomDisplayUserIntoSortIndex:(SMDisplayUser *)displayUser
+{
+	NSString *sortKey = [displayUser sortString];
+	SMDisplayUser *replacedDisplayUser = [_roomDisplayUsersKeySort objectForKey:sortKey];
+	if (replacedDisplayUser && replacedDisplayUser != displayUser) {
+		[_touchedRoomDisplayUsers addObject:replacedDisplayUser];
+	}
+	
+	if ([_roomDisplayUsersKeySort setObject:displayUser forKey:sortKey] != NSNotFound) {
+		[_touchedRoomDisplayUsers addObject:displayUser];
+	}
+}
+
+
+- (void)removeRoomDisplayUserFromSortIndex:(SMDisplayUser *)displayUser
+{
+	if (displayUser && [_roomDisplayUsersKeySort removeObjectForKey:[displayUser sortString]] != NSNotFound) {
+		[_touchedRoomDisplayUsers addObject:displayUser];
+	}
+}
+
+
+// Returns changes of room display users list since previous call and remembers current list for the next one.
+- (SMRoomDisplayUsersChange *)takeRoomDisplayUsersChange
+{
+	NSArray *previous = _publishedRoomDisplayUsers;
+	NSArray *current = [_roomDisplayUsersKeySort allObjects];
+	
+	NSMutableIndexSet *deletedIndexes = [NSMutableIndexSet indexSet];
+	NSMutableIndexSet *insertedIndexes = [NSMutableIndexSet indexSet];
+	NSMutableIndexSet *reloadedIndexes = [NSMutableIndexSet indexSet];
+	NSMutableArray *moves = [NSMutableArray array];
+	
+	if (!_roomDisplayUsersListReset && _touchedRoomDisplayUsers.count > 0) {
+		/*
+		 Display users which were not touched keep their relative order since their sort keys didn't change,
+		 so it is enough to find out what happened to touched ones.
+		 */
+		NSMapTable *previousIndexes = [self indexMapForDisplayUsers:previous];
+		NSMapTable *currentIndexes = [self indexMapForDisplayUsers:current];
+		
+		NSMutableArray *keptDisplayUsers = [NSMutableArray array];
+		for (SMDisplayUser *displayUser in _touchedRoomDisplayUsers) {
+			NSNumber *from = [previousIndexes objectForKey:displayUser];
+			NSNumber *to = [currentIndexes objectForKey:displayUser];
+			
+			if (from && to) {
+				[keptDisplayUsers addObject:displayUser];
+			} else if (from) {
+				[deletedIndexes addIndex:[from unsignedIntegerValue]];
+			} else if (to) {
+				[insertedIndexes addIndex:[to unsignedIntegerValue]];
+			}
+		}
+		
+		/*
+		 Table view keeps rows which are not moved in their relative order and places them around deleted and inserted ones.
+		 So touched display user can be reloaded in place only if it stays between the same untouched ones and keeps order
+		 of other display users reloaded in place. Otherwise it is moved, even if its index is the same
+		 (e.g. a row before it was deleted and it went after its neighbour).
+		 */
+		NSMapTable *previousUntouchedCounts = [self untouchedCountMapForDisplayUsers:previous];
+		NSMapTable *currentUntouchedCounts = [self untouchedCountMapForDisplayUsers:current];
+		
+		[keptDisplayUsers sortUsingComparator:^NSComparisonResult(SMDisplayUser *obj1, SMDisplayUser *obj2) {
+			return [[previousIndexes objectForKey:obj1] compare:[previousIndexes objectForKey:obj2]];
+		}];
+		
+		NSInteger lastReloadedTo = -1;
+		for (SMDisplayUser *displayUser in keptDisplayUsers) {
+			NSNumber *from = [previousIndexes objectForKey:displayUser];
+			NSNumber *to = [currentIndexes objectForKey:displayUser];
+			
+			if ([[previousUntouchedCounts objectForKey:displayUser] isEqualToNumber:[currentUntouchedCounts objectForKey:displayUser]] &&
+				[to integerValue] > lastReloadedTo) {
+				[reloadedIndexes addIndex:[from unsignedIntegerValue]];
+				lastReloadedTo = [to integerValue];
+			} else {
+				[moves addObject:[STPair pairWithKey:from value:to]];
+			}
+		}
+	}
+	
+	SMRoomDisplayUsersChange *change = [[SMRoomDisplayUsersChange alloc] init];
+	change.isReload = _roomDisplayUsersListReset;
+	change.previousCount = previous.count;
+	change.count = current.count;
+	change.deletedIndexes = deletedIndexes;
+	change.insertedIndexes = insertedIndexes;
+	change.reloadedIndexes = reloadedIndexes;
+	change.moves = moves;
+	
+	_publishedRoomDisplayUsers = current;
+	_roomDisplayUsersListReset = NO;
+	[_touchedRoomDisplayUsers removeAllObjects];
+	
+	return change;
+}
+
+
+// Maps touched display users to number of untouched ones before them in @displayUsers.
+- (NSMapTable *)untouchedCountMapForDisplayUsers:(NSArray *)displayUsers
+{
+	NSMapTable *counts = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+											   valueOptions:NSPointerFunctionsStrongMemory];
+	NSUInteger untouchedCount = 0;
+	for (SMDisplayUser *displayUser in displayUsers) {
+		if ([_touchedRoomDisplayUsers containsObject:displayUser]) {
+			[counts setObject:@(untouchedCount) forKey:displayUser];
+		} else {
+			untouchedCount++;
+		}
+	}
+	return counts;
+}
+
+
+- (NSMapTable *)indexMapForDisplayUsers:(NSArray *)displayUsers
+{
+	NSMapTable *indexes = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+												valueOptions:NSPointerFunctionsStrongMemory];
+	NSUInteger index = 0;
+	for (SMDisplayUser *displayUser in displayUsers) {
+		[indexes setObject:@(index) forKey:displayUser];
+		index++;
+	}
+	return indexes;
 }
 
 
@@ -694,6 +862,16 @@
 
 
 - (void)userSessionHasJoined:(User *)user
+{
+	if ([self addJoinedUserSession:user]) {
+		[self sendRoomUsersListUpdate];
+		[self sendUserSessionJoinedUpdate:user];
+	}
+}
+
+
+// Updates model only, returns YES if user has been added.
+- (BOOL)addJoinedUserSession:(User *)user
 {
 	/*
 	 There can be the situation when buddy has already left and reconnected but server couldn't manage that 
@@ -717,20 +895,32 @@
 	
 	if (user) {
         [self addRoomUser:user displayUser:nil];
-		[self sendRoomUsersListUpdate];
-		[self sendUserSessionJoinedUpdate:user];
+		return YES;
 	}
+	
+	return NO;
 }
 
 
 - (void)userSessionHasLeft:(NSString *)sessionId leftType:(NSString *)leftType
+{
+	User *buddyLeft = [self removeLeftUserSessionWithId:sessionId];
+	
+	if (buddyLeft) {
+		[self sendRoomUsersListUpdate];
+		[self sendUserSessionLeftUpdate:buddyLeft
+				 disconnectedFromServer:[leftType isEqualToString:NSStr(kLCHardKey)]];
+	}
+}
+
+
+// Updates model only, returns user which has left or nil if there was no such user in the room.
+- (User *)removeLeftUserSessionWithId:(NSString *)sessionId
 {
 	User *buddyLeft = [self roomUserForSessionId:sessionId];
 	
 	if (buddyLeft) {
 		[self removeRoomUser:buddyLeft];
-		
-		[self sendRoomUsersListUpdate];
 	}
 
 	//We should probably keep held users forever.
@@ -741,10 +931,7 @@
 //		}
 //	}
 	
-	if (buddyLeft) {
-		[self sendUserSessionLeftUpdate:buddyLeft
-				 disconnectedFromServer:[leftType isEqualToString:NSStr(kLCHardKey)]];
-	}
+	return buddyLeft;
 }
 
 
@@ -754,18 +941,23 @@
 	// we send update for the whole list which shouldn't be the case.
 	// We could do better by checking if display name has changed and track changes
 	// of indices in the list.
-    	
-    NSString *userSessionId = [[info objectForKey:NSStr(kIdKey)] isKindOfClass:
-							   [NSString class]] ? [info objectForKey:NSStr(kIdKey)] :
-													[[info objectForKey:NSStr(kIdKey)] stringValue];
-	uint64_t statusRevision = [[info objectForKey:NSStr(kRevKey)] unsignedLongLongValue];
 	
+	User *snapshot = [_buddyParser createStatusSnapshotFromDictionary:info];
+	User *updatedUser = [self applyUserSessionStatusSnapshot:snapshot];
 	
-	User *buddyToUpdate = [self roomUserForSessionId:userSessionId];
+	[self sendRoomUsersListUpdate];
+	[self sendUserUpdateForUser:updatedUser];
+}
+
+
+// Updates model only, returns updated room user or nil if there is no such user or status is outdated.
+- (User *)applyUserSessionStatusSnapshot:(User *)snapshot
+{
+	User *buddyToUpdate = [self roomUserForSessionId:snapshot.sessionId];
 	
-	if (buddyToUpdate.statusRevision > statusRevision) {
+	if (buddyToUpdate.statusRevision > snapshot.statusRevision) {
 		spreed_me_log("User status revision is more recent than revision of status update. Do not update.");
-		return;
+		return nil;
 	}
 	
 	
@@ -777,33 +969,51 @@
         userToUpdate = [_roomDisplayUsersKeyUserId objectForKey:buddyToUpdate.sessionId];
     }
     
-    [_roomDisplayUsersKeySort removeObjectForKey:[userToUpdate sortString]];
+    [self removeRoomDisplayUserFromSortIndex:userToUpdate];
     
     
 	if (buddyToUpdate) {
 		SMDisplayUser *dispUserHint = [self removeRoomUser:buddyToUpdate];
 		
-		NSString *userId = [info objectForKey:NSStr(kUserIdKey)];
-		[_buddyParser updateBuddy:buddyToUpdate
-				   withDictionary:[info objectForKey:NSStr(kStatusKey)]
-						 withType:kBuddyDictionaryTypeStatus
-						   userId:userId
-				   statusRevision:statusRevision];
+		buddyToUpdate.userId = snapshot.userId;
+		// Snapshot without display name means there was no status dictionary in the message.
+		if (snapshot.displayName) {
+			buddyToUpdate.statusRevision = snapshot.statusRevision;
+			buddyToUpdate.displayName = snapshot.displayName;
+			buddyToUpdate.statusMessage = snapshot.statusMessage;
+			buddyToUpdate.isMixer = snapshot.isMixer;
+			// Pictures given by URL are downloaded asynchronously and delivered with BuddyImageHasBeenUpdatedNotification
+			if (snapshot.iconImage) {
+				buddyToUpdate.base64Image = snapshot.base64Image;
+				buddyToUpdate.iconImage = snapshot.iconImage;
+			}
+		}
 		[self addRoomUser:buddyToUpdate displayUser:dispUserHint];
-			
-//        [_roomDisplayUsersKeySort setObject:userToUpdate forKey:[userToUpdate sortString]];
 	}
-    
-	[self sendRoomUsersListUpdate];
-	[self sendUserUpdateForUser:buddyToUpdate];
+	
+	return buddyToUpdate;
 }
 
 
 - (void)buddyImageHasChanged:(NSNotification *)notification
 {
-	NSString *userSessionId = [notification.userInfo objectForKey:UserSessionIdUserInfoKey];
-	UIImage *buddyImage = [notification.userInfo objectForKey:BuddyImageUserInfoKey];
-	NSNumber *imageRev = [notification.userInfo objectForKey:SMUserImageRevisionUserInfoKey];
+	[self applyBuddyImageUpdate:notification.userInfo];
+}
+
+
+- (void)buddyImagesHaveChanged:(NSNotification *)notification
+{
+	for (NSDictionary *imageUpdate in [notification.userInfo objectForKey:BuddyImageUpdatesUserInfoKey]) {
+		[self applyBuddyImageUpdate:imageUpdate];
+	}
+}
+
+
+- (void)applyBuddyImageUpdate:(NSDictionary *)imageUpdate
+{
+	NSString *userSessionId = [imageUpdate objectForKey:UserSessionIdUserInfoKey];
+	UIImage *buddyImage = [imageUpdate objectForKey:BuddyImageUserInfoKey];
+	NSNumber *imageRev = [imageUpdate objectForKey:SMUserImageRevisionUserInfoKey];
 	
 	User *buddy = [self userForSessionId:userSessionId];
 	
@@ -848,6 +1058,25 @@
 {
 	NSArray *usersList = [_buddyParser createBuddyListFromUsersArray:roomUserSessions];
 	
+	[self replaceRoomUsersWithList:usersList];
+	
+	[self sendRoomSessionsListReceivedUpdate];
+	[self sendRoomUsersListUpdate];
+}
+
+
+// Updates model only
+- (void)replaceRoomUsersWithList:(NSArray *)usersList
+{
+	// Users from the list have default images until their pictures are decoded.
+	// Keep already decoded images of users whose pictures have not changed.
+	for (User *buddy in usersList) {
+		User *previousBuddy = [_roomUsersKeyId objectForKey:buddy.sessionId];
+		if (previousBuddy.iconImage && buddy.base64Image && [previousBuddy.base64Image isEqualToString:buddy.base64Image]) {
+			buddy.iconImage = previousBuddy.iconImage;
+		}
+	}
+	
 	[self purgeRoomUsers];
 	[self purgeRoomDisplayUsers];
 	
@@ -871,9 +1100,6 @@
 			[self addRoomUser:buddy displayUser:nil];
 		}
 	}
-	
-	[self sendRoomSessionsListReceivedUpdate];
-	[self sendRoomUsersListUpdate];
 }
 
 
@@ -969,6 +1195,74 @@ hasReceivedUserSessionStatusEvent:(NSDictionary *)info
 }
 
 
+- (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager
+hasReceivedUserSessionEvents:(NSArray *)events
+{
+	// Apply whole batch to the model first and notify subscribers afterwards,
+	// so room list is reloaded once per batch and not once per event.
+	BOOL sessionsListReceived = NO;
+	BOOL roomUsersChanged = NO;
+	NSMutableArray *userNotifications = [NSMutableArray array];
+	
+	for (SMUserSessionEvent *event in events) {
+		switch (event.type) {
+			case kSMUserSessionEventTypeUsersList:
+				[self replaceRoomUsersWithList:event.users];
+				sessionsListReceived = YES;
+				roomUsersChanged = YES;
+			break;
+				
+			case kSMUserSessionEventTypeJoined: {
+				User *user = event.user;
+				if ([self addJoinedUserSession:user]) {
+					roomUsersChanged = YES;
+					[userNotifications addObject:^{
+						[self sendUserSessionJoinedUpdate:user];
+					}];
+				}
+			}
+			break;
+				
+			case kSMUserSessionEventTypeLeft: {
+				User *user = [self removeLeftUserSessionWithId:event.sessionId];
+				if (user) {
+					BOOL disconnected = [event.leftType isEqualToString:NSStr(kLCHardKey)];
+					roomUsersChanged = YES;
+					[userNotifications addObject:^{
+						[self sendUserSessionLeftUpdate:user disconnectedFromServer:disconnected];
+					}];
+				}
+			}
+			break;
+				
+			case kSMUserSessionEventTypeStatus: {
+				User *user = [self applyUserSessionStatusSnapshot:event.user];
+				roomUsersChanged = YES;
+				if (user) {
+					[userNotifications addObject:^{
+						[self sendUserUpdateForUser:user];
+					}];
+				}
+			}
+			break;
+				
+			default:
+			break;
+		}
+	}
+	
+	if (sessionsListReceived) {
+		[self sendRoomSessionsListReceivedUpdate];
+	}
+	if (roomUsersChanged) {
+		[self sendRoomUsersListUpdate];
+	}
+	for (dispatch_block_t notification in userNotifications) {
+		notification();
+	}
+}
+
+
 - (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager
 hasReceivedMessageWithAttestationToken:(NSDictionary *)info
 {
@@ -100,9 +100,11 @@ ChatMessageDeliveryStatus;
 @property (nonatomic, copy) NSString *fileName;
 @property (nonatomic, assign) uint64_t fileSize;
 @property (nonatomic, copy) NSString *fileType;
+@property (nonatomic, copy) NSString *contentHash; // optional, can be nil
 
 @property (nonatomic, assign) uint64_t downloadedBytes;
 @property (nonatomic, assign) uint64_t sharingSpeed;
+@property (nonatomic, assign) NSTimeInterval estimatedTimeLeft; // is not persisted, negative if unknown
 
 @property (nonatomic, assign) STChatFileTransferType fileTransferType;
 
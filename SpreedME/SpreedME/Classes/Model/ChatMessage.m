@@ -252,6 +252,7 @@
 	self = [super init];
 	if (self) {
 		_type = kChatMessageTypeFileInfo;
+		_estimatedTimeLeft = -1.0;
 	}
 	return self;
 }
@@ -273,6 +274,7 @@
 //- (STChatFileTransferType)fileTransferType; already implemented
 //- (BOOL)hasTransferStarted; already implemented
 //- (BOOL)isCanceled; already implemented
+//- (NSTimeInterval)estimatedTimeLeft; already implemented
 
 
 @end
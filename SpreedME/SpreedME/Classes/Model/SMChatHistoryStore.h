@@ -0,0 +1,64 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "UsersActivityController.h"
+
+
+/*
+ Append-only on-disk log of one conversation (user session or room) activities.
+ Each activity is written as compact binary record. Changed activities are appended again
+ and index points to their latest record, superseded records are dropped when log is opened.
+ Index of record offsets and message ids is kept in memory so lookup by index or by mId is O(1).
+ Records headers carry mId hashes in clear, so index is built without decrypting records.
+ Supported activities are ChatMessage, ChatFileInfo, ChatGeolocation and MissedCall, others are stored as nil.
+ Records are encrypted with AES256 key which SMKeyring derives from app identity (see SMAppIdentityController).
+ All logs share the key, it is derived on first read or write unless +prepareKey has done it already.
+ Not thread safe, should be used on the main thread.
+ */
+@interface SMChatHistoryStore : NSObject
+
+@property (nonatomic, readonly, copy) NSString *conversationId;
+@property (nonatomic, readonly) NSUInteger count;
+@property (nonatomic, readonly) BOOL hasRestoredHistory; // YES if there were activities on disk when store was opened
+
+// Opens log for @conversationId or creates new one. @conversationId should be stable between connections and
+// scoped to server and local user. If it is nil log is temporary and is removed when store is deallocated.
+- (instancetype)initWithConversationId:(NSString *)conversationId;
+
+- (NSUInteger)appendActivity:(id<UserRecentActivity>)activity; // Returns index of activity or NSNotFound on write error.
+- (void)replaceActivityAtIndex:(NSUInteger)index withActivity:(id<UserRecentActivity>)activity;
+
+- (id<UserRecentActivity>)activityAtIndex:(NSUInteger)index;
+- (NSArray *)activitiesInRange:(NSRange)range; // Range is clipped to count. Activities which can't be decoded are NSNull.
+- (NSUInteger)indexOfActivityWithMessageId:(NSString *)mId; // NSNotFound if there is no such message
+
+- (void)removeAllActivities; // Removes log file too
+
++ (void)prepareKey; // Derives logs key in background so opened logs don't wait for it on the main thread.
+
++ (void)removeAllConversations;
++ (void)removeConversationsNotModifiedSince:(NSDate *)date;
++ (void)removeTransientConversations; // Temporary logs left by previous app run
+
+@end
@@ -0,0 +1,944 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "SMChatHistoryStore.h"
+
+#import <CommonCrypto/CommonCryptor.h>
+#import <CommonCrypto/CommonDigest.h>
+
+#import "AES256Encryptor.h"
+#import "ChatMessage.h"
+#import "MissedCall.h"
+#import "NSData+Conversion.h"
+#import "SMAppIdentityController.h"
+#import "SMKeyring.h"
+
+
+static NSString * const kSMChatHistoryDirectoryName = @"ChatHistory";
+static NSString * const kSMChatHistoryFileExtension = @"log";
+static NSString * const kSMChatHistoryKeyMetadataFileName = @"chat_history_key.plist";
+
+static const uint32_t kSMChatHistoryMagic = 0x48434d53; // "SMCH"
+static const uint32_t kSMChatHistoryVersion = 3;
+static const NSUInteger kSMChatHistoryFileHeaderFixedLength = 16; // magic + version + key iterations + key salt length, salt follows
+static const NSUInteger kSMChatHistoryRecordHeaderLength = 16; // payload length + activity index + mId hash
+static const NSUInteger kSMChatHistoryMaxSaltLength = 1024;
+
+// Log is compacted when it is opened and has more superseded records than this and than live ones.
+static const NSUInteger kSMChatHistoryMinSupersededRecordsToCompact = 64;
+
+typedef enum : uint8_t {
+	kSMChatHistoryRecordKindUnsupported = 0,
+	kSMChatHistoryRecordKindChatMessage,
+	kSMChatHistoryRecordKindFileInfo,
+	kSMChatHistoryRecordKindGeolocation,
+	kSMChatHistoryRecordKindMissedCall,
+} SMChatHistoryRecordKind;
+
+typedef enum : uint8_t {
+	kSMChatHistoryFlagStartOfGroup		= 1 << 0,
+	kSMChatHistoryFlagEndOfGroup		= 1 << 1,
+	kSMChatHistoryFlagTransferStarted	= 1 << 2,
+	kSMChatHistoryFlagCanceled			= 1 << 3,
+} SMChatHistoryFlags;
+
+
+#pragma mark - Encoding
+// All numbers are little endian, strings are UTF-8 prefixed with uint32 length (UINT32_MAX for nil).
+
+static void SMAppendUInt8(NSMutableData *data, uint8_t value)
+{
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+
+static void SMAppendUInt32(NSMutableData *data, uint32_t value)
+{
+	value = OSSwapHostToLittleInt32(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+
+static void SMAppendUInt64(NSMutableData *data, uint64_t value)
+{
+	value = OSSwapHostToLittleInt64(value);
+	[data appendBytes:&value length:sizeof(value)];
+}
+
+
+static void SMAppendDouble(NSMutableData *data, double value)
+{
+	uint64_t bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+	SMAppendUInt64(data, bits);
+}
+
+
+static void SMAppendDate(NSMutableData *data, NSDate *date)
+{
+	SMAppendDouble(data, date ? [date timeIntervalSinceReferenceDate] : NAN);
+}
+
+
+static void SMAppendString(NSMutableData *data, NSString *string)
+{
+	if (!string) {
+		SMAppendUInt32(data, UINT32_MAX);
+		return;
+	}
+	
+	NSData *utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+	SMAppendUInt32(data, (uint32_t)[utf8 length]);
+	[data appendData:utf8];
+}
+
+
+typedef struct {
+	const uint8_t *bytes;
+	NSUInteger length;
+	NSUInteger position;
+	BOOL failed;
+} SMChatHistoryReader;
+
+
+static SMChatHistoryReader SMChatHistoryReaderMake(NSData *data, NSUInteger position)
+{
+	SMChatHistoryReader reader = {(const uint8_t *)[data bytes], [data length], position, position > [data length]};
+	return reader;
+}
+
+
+static BOOL SMReadBytes(SMChatHistoryReader *reader, void *buffer, NSUInteger length)
+{
+	if (reader->failed || reader->length - reader->position < length) {
+		reader->failed = YES;
+		memset(buffer, 0, length);
+		return NO;
+	}
+	
+	memcpy(buffer, reader->bytes + reader->position, length);
+	reader->position += length;
+	return YES;
+}
+
+
+static uint8_t SMReadUInt8(SMChatHistoryReader *reader)
+{
+	uint8_t value = 0;
+	SMReadBytes(reader, &value, sizeof(value));
+	return value;
+}
+
+
+static uint32_t SMReadUInt32(SMChatHistoryReader *reader)
+{
+	uint32_t value = 0;
+	SMReadBytes(reader, &value, sizeof(value));
+	return OSSwapLittleToHostInt32(value);
+}
+
+
+static uint64_t SMReadUInt64(SMChatHistoryReader *reader)
+{
+	uint64_t value = 0;
+	SMReadBytes(reader, &value, sizeof(value));
+	return OSSwapLittleToHostInt64(value);
+}
+
+
+static double SMReadDouble(SMChatHistoryReader *reader)
+{
+	uint64_t bits = SMReadUInt64(reader);
+	double value = 0.0;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+static NSDate *SMReadDate(SMChatHistoryReader *reader)
+{
+	double timeInterval = SMReadDouble(reader);
+	return isnan(timeInterval) ? nil : [NSDate dateWithTimeIntervalSinceReferenceDate:timeInterval];
+}
+
+
+static NSString *SMReadString(SMChatHistoryReader *reader)
+{
+	uint32_t length = SMReadUInt32(reader);
+	if (reader->failed || length == UINT32_MAX) {
+		return nil;
+	}
+	
+	if (reader->length - reader->position < length) {
+		reader->failed = YES;
+		return nil;
+	}
+	
+	NSString *string = [[NSString alloc] initWithBytes:reader->bytes + reader->position length:length encoding:NSUTF8StringEncoding];
+	reader->position += length;
+	return string;
+}
+
+
+// First 8 bytes of SHA256 of mId, 0 if there is no mId. It is stored in clear record header
+// so index of message ids is built without decrypting records.
+static uint64_t SMMessageIdHash(NSString *mId)
+{
+	if ([mId length] == 0) {
+		return 0;
+	}
+	
+	NSData *idData = [mId dataUsingEncoding:NSUTF8StringEncoding];
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(idData.bytes, (CC_LONG)idData.length, digest);
+	
+	uint64_t hash = 0;
+	memcpy(&hash, digest, sizeof(hash));
+	hash = OSSwapLittleToHostInt64(hash);
+	return hash ? hash : 1;
+}
+
+
+static uint64_t SMMessageIdHashOfActivity(id<UserRecentActivity> activity)
+{
+	return [activity isKindOfClass:[ChatMessage class]] ? SMMessageIdHash(((ChatMessage *)activity).mId) : 0;
+}
+
+
+static NSData *SMEncodeActivity(id<UserRecentActivity> activity)
+{
+	NSMutableData *payload = [NSMutableData dataWithCapacity:128];
+	
+	if ([activity isKindOfClass:[MissedCall class]]) {
+		MissedCall *missedCall = (MissedCall *)activity;
+		SMAppendUInt8(payload, kSMChatHistoryRecordKindMissedCall);
+		SMAppendString(payload, nil);
+		SMAppendDate(payload, missedCall.date);
+		SMAppendString(payload, missedCall.userSessionId);
+		SMAppendString(payload, missedCall.selfId);
+		SMAppendString(payload, missedCall.userName);
+		
+	} else if ([activity isKindOfClass:[ChatMessage class]] && ![activity isKindOfClass:[ChatTypingNotification class]]) {
+		ChatMessage *message = (ChatMessage *)activity;
+		
+		SMChatHistoryRecordKind kind = kSMChatHistoryRecordKindChatMessage;
+		if ([message isKindOfClass:[ChatFileInfo class]]) {
+			kind = kSMChatHistoryRecordKindFileInfo;
+		} else if ([message isKindOfClass:[ChatGeolocation class]]) {
+			kind = kSMChatHistoryRecordKindGeolocation;
+		}
+		
+		uint8_t flags = (message.isStartOfGroup ? kSMChatHistoryFlagStartOfGroup : 0) | (message.isEndOfGroup ? kSMChatHistoryFlagEndOfGroup : 0);
+		
+		SMAppendUInt8(payload, kind);
+		SMAppendString(payload, message.mId);
+		SMAppendString(payload, message.from);
+		SMAppendString(payload, message.to);
+		SMAppendString(payload, message.message);
+		SMAppendString(payload, message.userName);
+		SMAppendString(payload, message.dateString);
+		SMAppendDate(payload, message.date);
+		SMAppendUInt8(payload, (uint8_t)message.type);
+		SMAppendUInt32(payload, (uint32_t)(int32_t)message.deliveryStatus);
+		
+		if (kind == kSMChatHistoryRecordKindFileInfo) {
+			ChatFileInfo *fileInfo = (ChatFileInfo *)message;
+			flags |= (fileInfo.hasTransferStarted ? kSMChatHistoryFlagTransferStarted : 0) | (fileInfo.isCanceled ? kSMChatHistoryFlagCanceled : 0);
+			SMAppendUInt32(payload, fileInfo.chunks);
+			SMAppendString(payload, fileInfo.token);
+			SMAppendString(payload, fileInfo.fileName);
+			SMAppendUInt64(payload, fileInfo.fileSize);
+			SMAppendString(payload, fileInfo.fileType);
+			SMAppendUInt64(payload, fileInfo.downloadedBytes);
+			SMAppendUInt8(payload, (uint8_t)fileInfo.fileTransferType);
+		} else if (kind == kSMChatHistoryRecordKindGeolocation) {
+			ChatGeolocation *geolocation = (ChatGeolocation *)message;
+			SMAppendDouble(payload, geolocation.accuracy);
+			SMAppendDouble(payload, geolocation.latitude);
+			SMAppendDouble(payload, geolocation.longitude);
+			SMAppendDouble(payload, geolocation.altitude);
+			SMAppendDouble(payload, geolocation.altitudeAccuracy);
+		}
+		
+		SMAppendUInt8(payload, flags);
+		
+	} else {
+		SMAppendUInt8(payload, kSMChatHistoryRecordKindUnsupported);
+		SMAppendString(payload, nil);
+	}
+	
+	return payload;
+}
+
+
+static id<UserRecentActivity> SMDecodeActivity(NSData *payload)
+{
+	SMChatHistoryReader reader = SMChatHistoryReaderMake(payload, 0);
+	
+	SMChatHistoryRecordKind kind = (SMChatHistoryRecordKind)SMReadUInt8(&reader);
+	NSString *mId = SMReadString(&reader);
+	
+	id<UserRecentActivity> activity = nil;
+	
+	switch (kind) {
+		case kSMChatHistoryRecordKindMissedCall: {
+			MissedCall *missedCall = [[MissedCall alloc] init];
+			missedCall.date = SMReadDate(&reader);
+			missedCall.userSessionId = SMReadString(&reader);
+			missedCall.selfId = SMReadString(&reader);
+			missedCall.userName = SMReadString(&reader);
+			activity = missedCall;
+		}
+		break;
+			
+		case kSMChatHistoryRecordKindChatMessage:
+		case kSMChatHistoryRecordKindFileInfo:
+		case kSMChatHistoryRecordKindGeolocation: {
+			ChatMessage *message = nil;
+			if (kind == kSMChatHistoryRecordKindFileInfo) {
+				message = [[ChatFileInfo alloc] init];
+			} else if (kind == kSMChatHistoryRecordKindGeolocation) {
+				message = [[ChatGeolocation alloc] init];
+			} else {
+				message = [[ChatMessage alloc] init];
+			}
+			
+			message.mId = mId;
+			message.from = SMReadString(&reader);
+			message.to = SMReadString(&reader);
+			message.message = SMReadString(&reader);
+			message.userName = SMReadString(&reader);
+			message.dateString = SMReadString(&reader);
+			message.date = SMReadDate(&reader);
+			message.type = (ChatMessageType)SMReadUInt8(&reader);
+			message.deliveryStatus = (ChatMessageDeliveryStatus)(int32_t)SMReadUInt32(&reader);
+			
+			if (kind == kSMChatHistoryRecordKindFileInfo) {
+				ChatFileInfo *fileInfo = (ChatFileInfo *)message;
+				fileInfo.chunks = SMReadUInt32(&reader);
+				fileInfo.token = SMReadString(&reader);
+				fileInfo.fileName = SMReadString(&reader);
+				fileInfo.fileSize = SMReadUInt64(&reader);
+				fileInfo.fileType = SMReadString(&reader);
+				fileInfo.downloadedBytes = SMReadUInt64(&reader);
+				fileInfo.fileTransferType = (STChatFileTransferType)SMReadUInt8(&reader);
+			} else if (kind == kSMChatHistoryRecordKindGeolocation) {
+				ChatGeolocation *geolocation = (ChatGeolocation *)message;
+				geolocation.accuracy = SMReadDouble(&reader);
+				geolocation.latitude = SMReadDouble(&reader);
+				geolocation.longitude = SMReadDouble(&reader);
+				geolocation.altitude = SMReadDouble(&reader);
+				geolocation.altitudeAccuracy = SMReadDouble(&reader);
+			}
+			
+			uint8_t flags = SMReadUInt8(&reader);
+			message.isStartOfGroup = (flags & kSMChatHistoryFlagStartOfGroup) != 0;
+			message.isEndOfGroup = (flags & kSMChatHistoryFlagEndOfGroup) != 0;
+			if (kind == kSMChatHistoryRecordKindFileInfo) {
+				((ChatFileInfo *)message).hasTransferStarted = (flags & kSMChatHistoryFlagTransferStarted) != 0;
+				((ChatFileInfo *)message).isCanceled = (flags & kSMChatHistoryFlagCanceled) != 0;
+			}
+			
+			activity = message;
+		}
+		break;
+			
+		default:
+		break;
+	}
+	
+	return reader.failed ? nil : activity;
+}
+
+
+#pragma mark - SMChatHistoryStore
+
+// Salt and number of iterations of the key shared by all logs. Accessed under @synchronized on SMChatHistoryStore class.
+static NSData *chatHistoryKeySalt = nil;
+static NSUInteger chatHistoryKeyIterations = 0;
+
+
+@implementation SMChatHistoryStore
+{
+	NSString *_filePath;
+	NSFileHandle *_fileHandle;
+	unsigned long long _fileLength;
+	
+	NSData *_keyData; // Payloads are encrypted with it, every record has its own init vector. Derived on first use, see -keyData.
+	NSData *_keySalt;
+	NSUInteger _keyIterations;
+	NSData *_fileHeader;
+	
+	NSMutableData *_recordOffsets; // uint64_t file offset of the latest record for each activity index
+	NSMutableDictionary *_indexesByMessageId; // NSNumber mId hash -> NSNumber activity index
+}
+
+
++ (NSString *)historyDirectoryPath
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES);
+	return [[paths firstObject] stringByAppendingPathComponent:kSMChatHistoryDirectoryName];
+}
+
+
+// Logs of conversations without conversationId live only until store is deallocated or app is restarted.
++ (NSString *)transientHistoryDirectoryPath
+{
+	return [NSTemporaryDirectory() stringByAppendingPathComponent:kSMChatHistoryDirectoryName];
+}
+
+
+// Same password as the rest of locally encrypted data, keys are derived and cached by SMKeyring.
++ (NSString *)keyPassword
+{
+	return [[[SMAppIdentityController sharedInstance] appBigIdentifier] hexadecimalString];
+}
+
+
++ (NSString *)keyMetadataPath
+{
+	return [[[self historyDirectoryPath] stringByDeletingLastPathComponent] stringByAppendingPathComponent:kSMChatHistoryKeyMetadataFileName];
+}
+
+
+/*
+ All logs are encrypted with the same key. Like downloaded files key it is derived with salt and number of iterations
+ which are generated once and saved, so logs of earlier launches don't need key derivation of their own.
+ Returns NO if there is no saved metadata and it couldn't be created.
+ */
++ (BOOL)getKeySalt:(NSData * __autoreleasing *)salt iterations:(NSUInteger *)iterations
+{
+	@synchronized([SMChatHistoryStore class]) {
+		if (!chatHistoryKeySalt) {
+			NSString *metadataPath = [self keyMetadataPath];
+			NSDictionary *metadata = [NSDictionary dictionaryWithContentsOfFile:metadataPath];
+			NSData *savedSalt = [metadata objectForKey:kSMCryptoSaltKey];
+			NSUInteger savedIterations = [[metadata objectForKey:kSMCryptoIterationNumberKey] unsignedIntegerValue];
+			
+			if ([savedSalt isKindOfClass:[NSData class]] && [savedSalt length] > 0 && [savedSalt length] <= kSMChatHistoryMaxSaltLength && savedIterations > 0) {
+				chatHistoryKeySalt = savedSalt;
+				chatHistoryKeyIterations = savedIterations;
+			} else {
+				// Encryption key of this launch is reused for chat history from now on.
+				if (![[SMKeyring sharedInstance] encryptionKeyForPassword:[self keyPassword] salt:&savedSalt iterations:&savedIterations] ||
+					[savedSalt length] == 0) {
+					return NO;
+				}
+				
+				[[NSFileManager defaultManager] createDirectoryAtPath:[metadataPath stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:NULL];
+				metadata = @{kSMCryptoSaltKey : savedSalt, kSMCryptoIterationNumberKey : @(savedIterations)};
+				if (![metadata writeToFile:metadataPath atomically:YES]) {
+					spreed_me_log("Couldn't save chat history key metadata");
+					return NO;
+				}
+				
+				chatHistoryKeySalt = savedSalt;
+				chatHistoryKeyIterations = savedIterations;
+			}
+		}
+		
+		*salt = chatHistoryKeySalt;
+		*iterations = chatHistoryKeyIterations;
+		return YES;
+	}
+}
+
+
++ (void)prepareKey
+{
+	dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+		NSData *salt = nil;
+		NSUInteger iterations = 0;
+		if ([self getKeySalt:&salt iterations:&iterations]) {
+			// SMKeyring caches the key, stores get it from there without waiting for derivation.
+			[[SMKeyring sharedInstance] keyForPassword:[self keyPassword] salt:salt iterations:iterations];
+		}
+	});
+}
+
+
++ (NSString *)filePathForConversationId:(NSString *)conversationId
+{
+	NSData *idData = [conversationId dataUsingEncoding:NSUTF8StringEncoding];
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(idData.bytes, (CC_LONG)idData.length, digest);
+	
+	NSMutableString *fileName = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+	for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+		[fileName appendFormat:@"%02x", digest[i]];
+	}
+	
+	return [[[self historyDirectoryPath] stringByAppendingPathComponent:fileName] stringByAppendingPathExtension:kSMChatHistoryFileExtension];
+}
+
+
+- (instancetype)initWithConversationId:(NSString *)conversationId
+{
+	self = [super init];
+	if (self) {
+		_conversationId = [conversationId copy];
+		if (_conversationId) {
+			_filePath = [[self class] filePathForConversationId:_conversationId];
+		} else {
+			_filePath = [[[[self class] transientHistoryDirectoryPath] stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]]
+						 stringByAppendingPathExtension:kSMChatHistoryFileExtension];
+		}
+		_recordOffsets = [[NSMutableData alloc] init];
+		_indexesByMessageId = [[NSMutableDictionary alloc] init];
+		
+		[self openLog];
+		
+		_hasRestoredHistory = (self.count > 0);
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[_fileHandle closeFile];
+	if (!_conversationId) {
+		[[NSFileManager defaultManager] removeItemAtPath:_filePath error:NULL];
+	}
+}
+
+
+#pragma mark - Public methods
+
+- (NSUInteger)count
+{
+	return [_recordOffsets length] / sizeof(uint64_t);
+}
+
+
+- (NSUInteger)appendActivity:(id<UserRecentActivity>)activity
+{
+	NSUInteger index = self.count;
+	if (![self writeRecordForActivity:activity atIndex:index]) {
+		return NSNotFound;
+	}
+	
+	return index;
+}
+
+
+- (void)replaceActivityAtIndex:(NSUInteger)index withActivity:(id<UserRecentActivity>)activity
+{
+	if (index < self.count) {
+		[self writeRecordForActivity:activity atIndex:index];
+	}
+}
+
+
+- (id<UserRecentActivity>)activityAtIndex:(NSUInteger)index
+{
+	if (index >= self.count) {
+		return nil;
+	}
+	
+	NSData *payload = [self payloadAtIndex:index];
+	return payload ? SMDecodeActivity(payload) : nil;
+}
+
+
+- (NSArray *)activitiesInRange:(NSRange)range
+{
+	NSUInteger count = self.count;
+	if (range.location >= count) {
+		return @[];
+	}
+	range.length = MIN(range.length, count - range.location);
+	
+	NSMutableArray *activities = [[NSMutableArray alloc] initWithCapacity:range.length];
+	for (NSUInteger i = range.location; i < NSMaxRange(range); i++) {
+		id<UserRecentActivity> activity = [self activityAtIndex:i];
+		[activities addObject:activity ? activity : [NSNull null]];
+	}
+	
+	return activities;
+}
+
+
+- (NSUInteger)indexOfActivityWithMessageId:(NSString *)mId
+{
+	uint64_t mIdHash = SMMessageIdHash(mId);
+	NSNumber *index = mIdHash ? [_indexesByMessageId objectForKey:@(mIdHash)] : nil;
+	return index ? [index unsignedIntegerValue] : NSNotFound;
+}
+
+
+- (void)removeAllActivities
+{
+	[_fileHandle closeFile];
+	_fileHandle = nil;
+	
+	[[NSFileManager defaultManager] removeItemAtPath:_filePath error:NULL];
+	
+	[_recordOffsets setLength:0];
+	[_indexesByMessageId removeAllObjects];
+	
+	[self createLog];
+}
+
+
++ (void)removeAllConversations
+{
+	for (NSString *directoryPath in @[[self historyDirectoryPath], [self transientHistoryDirectoryPath]]) {
+		NSError *error = nil;
+		if ([[NSFileManager defaultManager] fileExistsAtPath:directoryPath] &&
+			![[NSFileManager defaultManager] removeItemAtPath:directoryPath error:&error]) {
+			spreed_me_log("Couldn't remove chat history %s", [error cDescription]);
+		}
+	}
+	
+	// New logs get new key
+	@synchronized([SMChatHistoryStore class]) {
+		[[NSFileManager defaultManager] removeItemAtPath:[self keyMetadataPath] error:NULL];
+		chatHistoryKeySalt = nil;
+		chatHistoryKeyIterations = 0;
+	}
+}
+
+
++ (void)removeTransientConversations
+{
+	[[NSFileManager defaultManager] removeItemAtPath:[self transientHistoryDirectoryPath] error:NULL];
+}
+
+
++ (void)removeConversationsNotModifiedSince:(NSDate *)date
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	NSString *directoryPath = [self historyDirectoryPath];
+	
+	for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:directoryPath error:NULL]) {
+		NSString *filePath = [directoryPath stringByAppendingPathComponent:fileName];
+		NSDate *modificationDate = [[fileManager attributesOfItemAtPath:filePath error:NULL] fileModificationDate];
+		if ((modificationDate && [modificationDate compare:date] == NSOrderedAscending) || [self isLogOfOlderVersionAtPath:filePath]) {
+			[fileManager removeItemAtPath:filePath error:NULL];
+		}
+	}
+}
+
+
+#pragma mark - Log file
+
+// Logs of older versions are never opened again. Version 1 logs are unencrypted and keyed by session ids,
+// version 2 logs have no mId hashes in records headers.
+// Unreadable files (e.g. protected while device is locked) are not considered old.
++ (BOOL)isLogOfOlderVersionAtPath:(NSString *)filePath
+{
+	NSData *header = nil;
+	NSFileHandle *fileHandle = [NSFileHandle fileHandleForReadingAtPath:filePath];
+	@try {
+		header = [fileHandle readDataOfLength:2 * sizeof(uint32_t)];
+	}
+	@catch (NSException *exception) {
+		header = nil;
+	}
+	[fileHandle closeFile];
+	
+	SMChatHistoryReader reader = SMChatHistoryReaderMake(header, 0);
+	uint32_t magic = SMReadUInt32(&reader);
+	uint32_t version = SMReadUInt32(&reader);
+	return (!reader.failed && magic == kSMChatHistoryMagic && version < kSMChatHistoryVersion);
+}
+
+
+- (void)openLog
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	if (![fileManager fileExistsAtPath:_filePath] || ![self loadLogIndex]) {
+		[fileManager removeItemAtPath:_filePath error:NULL];
+		[_recordOffsets setLength:0];
+		[_indexesByMessageId removeAllObjects];
+		[self createLog];
+		return;
+	}
+	
+	_fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:_filePath];
+	if (!_fileHandle) {
+		spreed_me_log("Couldn't open chat history log");
+	}
+}
+
+
+/*
+ Log is encrypted with key shared by all logs, its salt and number of iterations are stored in file header too.
+ If there is no key metadata log is not created and nothing is written.
+ */
+- (void)createLog
+{
+	NSFileManager *fileManager = [NSFileManager defaultManager];
+	
+	NSData *salt = nil;
+	NSUInteger iterations = 0;
+	if (![[self class] getKeySalt:&salt iterations:&iterations]) {
+		spreed_me_log("Couldn't get key for chat history log");
+		return;
+	}
+	_keySalt = salt;
+	_keyIterations = iterations;
+	_keyData = nil;
+	
+	NSString *directoryPath = [_filePath stringByDeletingLastPathComponent];
+	if (![fileManager fileExistsAtPath:directoryPath]) {
+		[fileManager createDirectoryAtPath:directoryPath withIntermediateDirectories:YES attributes:nil error:NULL];
+		[[NSURL fileURLWithPath:directoryPath] setResourceValue:@(YES) forKey:NSURLIsExcludedFromBackupKey error:NULL];
+	}
+	
+	NSMutableData *header = [NSMutableData dataWithCapacity:kSMChatHistoryFileHeaderFixedLength + [salt length]];
+	SMAppendUInt32(header, kSMChatHistoryMagic);
+	SMAppendUInt32(header, kSMChatHistoryVersion);
+	SMAppendUInt32(header, (uint32_t)iterations);
+	SMAppendUInt32(header, (uint32_t)[salt length]);
+	[header appendData:salt];
+	_fileHeader = header;
+	
+	// Messages can arrive while device is locked so file is protected only until first unlock.
+	if (![fileManager createFileAtPath:_filePath contents:header attributes:@{NSFileProtectionKey : NSFileProtectionCompleteUntilFirstUserAuthentication}]) {
+		spreed_me_log("Couldn't create chat history log");
+	}
+	
+	_fileLength = [header length];
+	_fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:_filePath];
+}
+
+
+// Reads file header with salt and number of iterations of the log key, key itself is derived on first use.
+// Returns NO if data is not a chat history log of current version.
+- (BOOL)readFileHeaderWithReader:(SMChatHistoryReader *)reader
+{
+	if (SMReadUInt32(reader) != kSMChatHistoryMagic || SMReadUInt32(reader) != kSMChatHistoryVersion) {
+		return NO;
+	}
+	
+	uint32_t iterations = SMReadUInt32(reader);
+	uint32_t saltLength = SMReadUInt32(reader);
+	if (reader->failed || iterations == 0 || saltLength == 0 || saltLength > kSMChatHistoryMaxSaltLength ||
+		reader->length - reader->position < saltLength) {
+		return NO;
+	}
+	
+	_keySalt = [NSData dataWithBytes:reader->bytes + reader->position length:saltLength];
+	_keyIterations = iterations;
+	_keyData = nil;
+	reader->position += saltLength;
+	
+	_fileHeader = [NSData dataWithBytes:reader->bytes length:reader->position];
+	
+	return YES;
+}
+
+
+// Logs normally share salt (see +getKeySalt:iterations:) so key is already in SMKeyring after +prepareKey.
+- (NSData *)keyData
+{
+	if (!_keyData && _keySalt) {
+		NSData *keyData = [[SMKeyring sharedInstance] keyForPassword:[[self class] keyPassword] salt:_keySalt iterations:_keyIterations];
+		if ([keyData length] == kCCKeySizeAES256) {
+			_keyData = keyData;
+		} else {
+			spreed_me_log("Couldn't get key for chat history log");
+		}
+	}
+	
+	return _keyData;
+}
+
+
+// Record payload is init vector followed by encrypted activity.
+- (NSData *)decryptRecordPayloadBytes:(const uint8_t *)bytes length:(NSUInteger)length
+{
+	if (length <= kCCBlockSizeAES128) {
+		return nil;
+	}
+	
+	NSData *iv = [NSData dataWithBytesNoCopy:(void *)bytes length:kCCBlockSizeAES128 freeWhenDone:NO];
+	NSData *ciphertext = [NSData dataWithBytesNoCopy:(void *)(bytes + kCCBlockSizeAES128) length:length - kCCBlockSizeAES128 freeWhenDone:NO];
+	
+	NSData *keyData = [self keyData];
+	if (!keyData) {
+		return nil;
+	}
+	
+	return [[[AES256Encryptor alloc] init] decryptedDataFromData:ciphertext withKeyData:keyData iv:iv];
+}
+
+
+/*
+ Scans records headers and builds index. Records are not decrypted, mId hashes are read from records headers.
+ Truncated tail (e.g. app was killed during write) is cut off. Returns NO if file is not a chat history log.
+ */
+- (BOOL)loadLogIndex
+{
+	NSData *data = [NSData dataWithContentsOfFile:_filePath options:NSDataReadingMappedIfSafe error:NULL];
+	
+	SMChatHistoryReader reader = SMChatHistoryReaderMake(data, 0);
+	if (![self readFileHeaderWithReader:&reader]) {
+		return NO;
+	}
+	
+	NSUInteger supersededRecordsCount = 0;
+	
+	while (reader.length - reader.position >= kSMChatHistoryRecordHeaderLength) {
+		uint64_t offset = reader.position;
+		uint32_t payloadLength = SMReadUInt32(&reader);
+		uint32_t index = SMReadUInt32(&reader);
+		uint64_t mIdHash = SMReadUInt64(&reader);
+		
+		if (reader.length - reader.position < payloadLength || index > self.count) {
+			reader.position = (NSUInteger)offset;
+			break;
+		}
+		
+		if (index == self.count) {
+			[_recordOffsets appendBytes:&offset length:sizeof(offset)];
+		} else {
+			((uint64_t *)[_recordOffsets mutableBytes])[index] = offset;
+			supersededRecordsCount++;
+		}
+		
+		if (mIdHash) {
+			[_indexesByMessageId setObject:@(index) forKey:@(mIdHash)];
+		}
+		
+		reader.position += payloadLength;
+	}
+	
+	_fileLength = reader.position;
+	
+	if (_fileLength < [data length]) {
+		spreed_me_log("Chat history log has truncated record, cut it off.");
+		NSFileHandle *fileHandle = [NSFileHandle fileHandleForWritingAtPath:_filePath];
+		[fileHandle truncateFileAtOffset:_fileLength];
+		[fileHandle closeFile];
+	}
+	
+	if (supersededRecordsCount > kSMChatHistoryMinSupersededRecordsToCompact && supersededRecordsCount > self.count) {
+		[self compactLogWithData:data];
+	}
+	
+	return YES;
+}
+
+
+// Rewrites log with only the latest records. @data should be the current log contents.
+- (void)compactLogWithData:(NSData *)data
+{
+	NSUInteger count = self.count;
+	const uint64_t *offsets = (const uint64_t *)[_recordOffsets bytes];
+	
+	NSMutableData *compacted = [[NSMutableData alloc] initWithCapacity:(NSUInteger)_fileLength];
+	[compacted appendData:_fileHeader];
+	
+	NSMutableData *newOffsets = [[NSMutableData alloc] initWithCapacity:[_recordOffsets length]];
+	for (NSUInteger i = 0; i < count; i++) {
+		SMChatHistoryReader reader = SMChatHistoryReaderMake(data, (NSUInteger)offsets[i]);
+		uint32_t payloadLength = SMReadUInt32(&reader);
+		
+		uint64_t newOffset = [compacted length];
+		[newOffsets appendBytes:&newOffset length:sizeof(newOffset)];
+		[compacted appendBytes:(const uint8_t *)[data bytes] + offsets[i] length:kSMChatHistoryRecordHeaderLength + payloadLength];
+	}
+	
+	if ([compacted writeToFile:_filePath options:NSDataWritingAtomic | NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication error:NULL]) {
+		_recordOffsets = newOffsets;
+		_fileLength = [compacted length];
+	}
+}
+
+
+- (BOOL)writeRecordForActivity:(id<UserRecentActivity>)activity atIndex:(NSUInteger)index
+{
+	NSData *keyData = [self keyData];
+	if (!_fileHandle || !keyData) {
+		return NO;
+	}
+	
+	uint64_t mIdHash = SMMessageIdHashOfActivity(activity);
+	
+	NSData *iv = nil;
+	NSData *ciphertext = [[[AES256Encryptor alloc] init] encryptData:SMEncodeActivity(activity) withKeyData:keyData iv:&iv];
+	if (!ciphertext || [iv length] != kCCBlockSizeAES128) {
+		spreed_me_log("Couldn't encrypt chat history record");
+		return NO;
+	}
+	
+	NSMutableData *record = [NSMutableData dataWithCapacity:kSMChatHistoryRecordHeaderLength + [iv length] + [ciphertext length]];
+	SMAppendUInt32(record, (uint32_t)([iv length] + [ciphertext length]));
+	SMAppendUInt32(record, (uint32_t)index);
+	SMAppendUInt64(record, mIdHash);
+	[record appendData:iv];
+	[record appendData:ciphertext];
+	
+	@try {
+		[_fileHandle seekToFileOffset:_fileLength];
+		[_fileHandle writeData:record];
+	}
+	@catch (NSException *exception) {
+		spreed_me_log("Couldn't write chat history record %s", [exception.reason cDescription]);
+		return NO;
+	}
+	
+	uint64_t offset = _fileLength;
+	_fileLength += [record length];
+	
+	if (index == self.count) {
+		[_recordOffsets appendBytes:&offset length:sizeof(offset)];
+	} else {
+		((uint64_t *)[_recordOffsets mutableBytes])[index] = offset;
+	}
+	
+	if (mIdHash) {
+		[_indexesByMessageId setObject:@(index) forKey:@(mIdHash)];
+	}
+	
+	return YES;
+}
+
+
+- (NSData *)payloadAtIndex:(NSUInteger)index
+{
+	uint64_t offset = ((const uint64_t *)[_recordOffsets bytes])[index];
+	
+	NSData *payload = nil;
+	@try {
+		[_fileHandle seekToFileOffset:offset];
+		NSData *header = [_fileHandle readDataOfLength:kSMChatHistoryRecordHeaderLength];
+		SMChatHistoryReader reader = SMChatHistoryReaderMake(header, 0);
+		uint32_t payloadLength = SMReadUInt32(&reader);
+		if (!reader.failed) {
+			NSData *encryptedPayload = [_fileHandle readDataOfLength:payloadLength];
+			payload = [self decryptRecordPayloadBytes:[encryptedPayload bytes] length:[encryptedPayload length]];
+		}
+	}
+	@catch (NSException *exception) {
+		spreed_me_log("Couldn't read chat history record %s", [exception.reason cDescription]);
+	}
+	
+	return payload;
+}
+
+
+@end
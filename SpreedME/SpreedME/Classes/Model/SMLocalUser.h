@@ -59,6 +59,8 @@
 
 + (instancetype)localUserFromDir:(NSString *)dir;
 - (BOOL)saveToDir:(NSString *)dir;
+// Saves dictionary returned by 'dictionaryFromUser'. Can be called on any thread.
++ (BOOL)saveUserDictionary:(NSDictionary *)dict toDir:(NSString *)dir;
 
 + (instancetype)localUserWithDictionary:(NSDictionary *)dict;
 - (NSDictionary *)dictionaryFromUser;
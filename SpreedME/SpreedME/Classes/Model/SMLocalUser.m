@@ -213,6 +213,12 @@ NSString * const kSMLocalUserSettingsKey            = @"settings";
 
 
 - (BOOL)saveToDir:(NSString *)dir
+{
+	return [SMLocalUser saveUserDictionary:[self dictionaryFromUser] toDir:dir];
+}
+
+
++ (BOOL)saveUserDictionary:(NSDictionary *)dict toDir:(NSString *)dir
 {
 	BOOL success = NO;
 	
@@ -229,7 +235,6 @@ NSString * const kSMLocalUserSettingsKey            = @"settings";
 		}
 		
 		
-		NSDictionary *dict = [self dictionaryFromUser];
 		if (dict) {
 			NSString *userString = [dict JSONString];
 			if (userString) {
@@ -0,0 +1,53 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+@class User;
+
+
+typedef enum : NSUInteger {
+	kSMUserSessionEventTypeUsersList = 0,
+	kSMUserSessionEventTypeJoined,
+	kSMUserSessionEventTypeLeft,
+	kSMUserSessionEventTypeStatus,
+} SMUserSessionEventType;
+
+
+/*
+ Room presence event with all parsing (including pictures decoding) already done.
+ These are produced off the main thread by ChannelingManager and applied in batches by UsersManager.
+ */
+@interface SMUserSessionEvent : NSObject
+
+@property (nonatomic, readonly) SMUserSessionEventType type;
+@property (nonatomic, readonly, strong) NSArray *users; // kSMUserSessionEventTypeUsersList, array of User
+@property (nonatomic, readonly, strong) User *user; // kSMUserSessionEventTypeJoined; for kSMUserSessionEventTypeStatus it is detached status snapshot
+@property (nonatomic, readonly, copy) NSString *sessionId; // kSMUserSessionEventTypeLeft
+@property (nonatomic, readonly, copy) NSString *leftType; // kSMUserSessionEventTypeLeft
+
++ (instancetype)usersListEventWithUsers:(NSArray *)users;
++ (instancetype)joinedEventWithUser:(User *)user;
++ (instancetype)leftEventWithSessionId:(NSString *)sessionId leftType:(NSString *)leftType;
++ (instancetype)statusEventWithSnapshot:(User *)snapshot;
+
+@end
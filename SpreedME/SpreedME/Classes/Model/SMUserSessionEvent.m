@@ -0,0 +1,91 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "SMUserSessionEvent.h"
+
+#import "User.h"
+
+
+@interface SMUserSessionEvent ()
+
+@property (nonatomic, readwrite) SMUserSessionEventType type;
+@property (nonatomic, readwrite, strong) NSArray *users;
+@property (nonatomic, readwrite, strong) User *user;
+@property (nonatomic, readwrite, copy) NSString *sessionId;
+@property (nonatomic, readwrite, copy) NSString *leftType;
+
+@end
+
+
+@implementation SMUserSessionEvent
+
++ (instancetype)usersListEventWithUsers:(NSArray *)users
+{
+	SMUserSessionEvent *event = [[SMUserSessionEvent alloc] init];
+	event.type = kSMUserSessionEventTypeUsersList;
+	event.users = users;
+	return event;
+}
+
+
++ (instancetype)joinedEventWithUser:(User *)user
+{
+	if (!user) {
+		return nil;
+	}
+	
+	SMUserSessionEvent *event = [[SMUserSessionEvent alloc] init];
+	event.type = kSMUserSessionEventTypeJoined;
+	event.user = user;
+	event.sessionId = user.sessionId;
+	return event;
+}
+
+
++ (instancetype)leftEventWithSessionId:(NSString *)sessionId leftType:(NSString *)leftType
+{
+	if (!sessionId) {
+		return nil;
+	}
+	
+	SMUserSessionEvent *event = [[SMUserSessionEvent alloc] init];
+	event.type = kSMUserSessionEventTypeLeft;
+	event.sessionId = sessionId;
+	event.leftType = leftType;
+	return event;
+}
+
+
++ (instancetype)statusEventWithSnapshot:(User *)snapshot
+{
+	if (!snapshot) {
+		return nil;
+	}
+	
+	SMUserSessionEvent *event = [[SMUserSessionEvent alloc] init];
+	event.type = kSMUserSessionEventTypeStatus;
+	event.user = snapshot;
+	event.sessionId = snapshot.sessionId;
+	return event;
+}
+
+@end
@@ -29,6 +29,11 @@ extern NSString * const UserSessionIdUserInfoKey;
 extern NSString * const BuddyImageUserInfoKey;
 extern NSString * const SMUserImageRevisionUserInfoKey;
 
+// Posted on the main thread with decoded pictures of users created by createBuddyListFromUsersArray:.
+// BuddyImageUpdatesUserInfoKey holds array of dictionaries with the same keys as BuddyImageHasBeenUpdatedNotification userInfo.
+extern NSString * const BuddyImagesHaveBeenUpdatedNotification;
+extern NSString * const BuddyImageUpdatesUserInfoKey;
+
 
 typedef enum BuddyDictionaryType {
 	
@@ -42,7 +47,12 @@ typedef enum BuddyDictionaryType {
 @interface BuddyParser : NSObject
 
 - (User *)createBuddyFromDictionary: (NSDictionary*)buddy withType:(BuddyDictionaryType)type;
-- (NSArray *)createBuddyListFromUsersArray:(NSArray *)buddyArray;
+- (NSArray *)createBuddyListFromUsersArray:(NSArray *)buddyArray; // inline pictures are decoded asynchronously, see BuddyImagesHaveBeenUpdatedNotification
+/*
+ Creates detached User which holds only the status from 'Status' message @info (Id, Userid, Rev and Status).
+ Can be called off the main thread, picture is decoded here. Returns nil if @info has no session id.
+ */
+- (User *)createStatusSnapshotFromDictionary:(NSDictionary *)info;
 
 - (void)updateBuddy:(User *)buddy
 	 withDictionary:(NSDictionary *)dictionary
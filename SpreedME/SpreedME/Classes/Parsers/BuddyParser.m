@@ -27,15 +27,27 @@
 #import "ChannelingConstants.h"
 #import "ResourceDownloadManager.h"
 #import "SMConnectionController.h"
+#import "SMUserImageCache.h"
 #import "UIImage+RoundedCorners.h"
 #import "UsersManager.h"
 
 
 NSString * const BuddyImageHasBeenUpdatedNotification		= @"BuddyImageHasBeenUpdatedNotification";
+NSString * const BuddyImagesHaveBeenUpdatedNotification		= @"BuddyImagesHaveBeenUpdatedNotification";
 
 NSString * const UserSessionIdUserInfoKey					= @"UserSessionIdUserInfoKey";
 NSString * const BuddyImageUserInfoKey						= @"BuddyImageUserInfoKey";
 NSString * const SMUserImageRevisionUserInfoKey				= @"SMUserImageRevisionUserInfoKey";
+NSString * const BuddyImageUpdatesUserInfoKey				= @"BuddyImageUpdatesUserInfoKey";
+
+static NSString * const kDeferredPictureKey = @"DeferredPicture";
+static NSString * const kDeferredPictureCacheKey = @"DeferredPictureCacheKey";
+
+
+// Inline pictures longer than this are not decoded when users list is received (about 384KB of jpeg data).
+const NSUInteger kBuddyPictureMaxDeferredDecodingLength = 512 * 1024;
+// Decoded pictures are delivered to the main thread in chunks of this size.
+const NSUInteger kBuddyPictureDecodingChunkSize = 25;
 
 
 NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
@@ -223,13 +235,56 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 
 - (NSArray *)createBuddyListFromUsersArray:(NSArray *)buddyArray
 {
-    NSMutableArray *newBuddyArray = [[NSMutableArray alloc] init];
-        
-    for (NSDictionary *buddyDic in buddyArray) {
-        User *newBuddy = [self createBuddyFromDictionary:buddyDic withType:kBuddyDictionaryTypeUsers];
-        [newBuddyArray addObject:newBuddy];
-    }
-    return [NSArray arrayWithArray:newBuddyArray];
+	// Room can have hundreds of users so inline pictures are not decoded here.
+	// Users get default image and decoded pictures come later with BuddyImagesHaveBeenUpdatedNotification.
+	NSMutableArray *newBuddyArray = [[NSMutableArray alloc] initWithCapacity:[buddyArray count]];
+	NSMutableArray *deferredPictures = [[NSMutableArray alloc] init];
+	
+	NSString *statusKey = NSStr(kStatusKey);
+	NSString *revKey = NSStr(kRevKey);
+	
+	for (NSDictionary *buddyDic in buddyArray) {
+		if (![buddyDic isKindOfClass:[NSDictionary class]]) {
+			continue;
+		}
+		
+		User *newBuddy = [self createBuddyFromUsersDictionary:buddyDic];
+		NSDictionary *statusDic = [buddyDic objectForKey:statusKey];
+		if (![statusDic isKindOfClass:[NSDictionary class]]) {
+			statusDic = nil;
+		}
+		uint64_t statusRev = [[buddyDic objectForKey:revKey] unsignedLongLongValue];
+		
+		[self updateBuddy:newBuddy withDictionary:statusDic withType:kBuddyDictionaryTypeUsers userId:newBuddy.userId statusRevision:statusRev deferredPictures:deferredPictures];
+		
+		[newBuddyArray addObject:newBuddy];
+	}
+	
+	[self decodeDeferredPictures:deferredPictures];
+	
+	return [NSArray arrayWithArray:newBuddyArray];
+}
+
+
+- (User *)createStatusSnapshotFromDictionary:(NSDictionary *)info
+{
+	id sessionId = [info objectForKey:NSStr(kIdKey)];
+	if (!sessionId) {
+		return nil;
+	}
+	
+	User *snapshot = [[User alloc] init];
+	snapshot.sessionId = [sessionId isKindOfClass:[NSString class]] ? sessionId : [sessionId stringValue];
+	
+	NSString *userId = [info objectForKey:NSStr(kUserIdKey)];
+	uint64_t statusRev = [[info objectForKey:NSStr(kRevKey)] unsignedLongLongValue];
+	NSDictionary *statusDic = [[info objectForKey:NSStr(kStatusKey)] isKindOfClass:[NSDictionary class]] ? [info objectForKey:NSStr(kStatusKey)] : nil;
+	
+	snapshot.userId = userId;
+	snapshot.statusRevision = statusRev;
+	[self updateBuddy:snapshot withDictionary:statusDic withType:kBuddyDictionaryTypeStatus userId:userId statusRevision:statusRev];
+	
+	return snapshot;
 }
 
 
@@ -261,6 +316,21 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 		   withType:(BuddyDictionaryType)type
 			 userId:(NSString *)userId
 	 statusRevision:(uint64_t)statusRev
+{
+	[self updateBuddy:buddy withDictionary:dictionary withType:type userId:userId statusRevision:statusRev deferredPictures:nil];
+}
+
+
+/*
+ If @deferredPictures is not nil inline pictures are not decoded. Buddy gets default image
+ and picture to decode is added to @deferredPictures.
+ */
+- (void)updateBuddy:(User *)buddy
+	 withDictionary:(NSDictionary *)dictionary
+		   withType:(BuddyDictionaryType)type
+			 userId:(NSString *)userId
+	 statusRevision:(uint64_t)statusRev
+   deferredPictures:(NSMutableArray *)deferredPictures
 {
 	if (buddy && dictionary) {
 		switch (type) {
@@ -302,13 +372,37 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 				}
 
 				
+				NSString *imageCacheKey = [[self class] imageCacheKeyForUserId:userId sessionId:buddy.sessionId];
+				
 				if (![buddy.base64Image isEqualToString:buddyPicture] && [buddyPicture rangeOfString:@"data:"].location == 0) {
 					buddy.base64Image = buddyPicture;
-					NSString *pureImageString = [buddy.base64Image substringFromIndex:23];
 					
-					UIImage *newBuddyImage = [[self class] imageFromBase64String:pureImageString];
+					UIImage *cachedImage = [[SMUserImageCache sharedInstance] cachedImageForKey:imageCacheKey revision:statusRev pointSize:kSMUserImageCacheDefaultThumbnailSize];
 					
-					[self updateBuddyDisplayImage:buddy withImage:newBuddyImage];
+					if (cachedImage) {
+						buddy.iconImage = cachedImage;
+					} else if (deferredPictures) {
+						[self updateBuddyDisplayImage:buddy withImage:nil];
+						if ([buddyPicture length] <= kBuddyPictureMaxDeferredDecodingLength) {
+							[deferredPictures addObject:@{UserSessionIdUserInfoKey : buddy.sessionId,
+														  kDeferredPictureKey : buddyPicture,
+														  kDeferredPictureCacheKey : imageCacheKey,
+														  SMUserImageRevisionUserInfoKey : @(statusRev)}];
+						} else {
+							spreed_me_log("Inline picture of user %s is too large (%lu), do not decode it.", [buddy.sessionId cDescription], (unsigned long)[buddyPicture length]);
+						}
+					} else {
+						NSData *imageData = [[self class] dataFromBase64String:[buddyPicture substringFromIndex:23]];
+						
+						// Inline pictures come with every status message so there is no need to store them on disk.
+						UIImage *newBuddyImage = [[SMUserImageCache sharedInstance] imageByStoringImageData:imageData
+																									forKey:imageCacheKey
+																								  revision:statusRev
+																								 pointSize:kSMUserImageCacheDefaultThumbnailSize
+																							   storeToDisk:NO];
+						
+						buddy.iconImage = newBuddyImage ? newBuddyImage : [[self class] defaultUserImage];
+					}
 				} else if ([buddyPicture rangeOfString:@"img:"].location == 0) {
 					
 					// static/img/buddy/s46/
@@ -320,16 +414,21 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 					NSString *picturePath = [buddyPicture substringFromIndex:4];
 					pictureURL = [pictureURL stringByAppendingFormat:@"%@", picturePath];
 
-					[[ResourceDownloadManager sharedInstance] enqueueInMemoryDownloadTaskWithURL:[NSURL URLWithString:pictureURL] completionHandler: ^(NSData *data, NSError *error) {
-						if (!error) {
-							
-							UIImage *image = [[UIImage alloc] initWithData:data];
-							[self asynchronousUpdateImageForUserWithSessionId:userSessionId withImage:image imageRevision:statusRev];
+					UIImage *cachedImage = [[SMUserImageCache sharedInstance] cachedImageForKey:imageCacheKey revision:statusRev pointSize:kSMUserImageCacheDefaultThumbnailSize];
+					if (cachedImage) {
+						buddy.iconImage = cachedImage;
+					} else {
+						// ResourceDownloadManager is not thread safe and buddies can be parsed off the main thread.
+						dispatch_block_t loadImage = ^{
+							[self loadImageForUserWithSessionId:userSessionId imageCacheKey:imageCacheKey pictureURL:[NSURL URLWithString:pictureURL] imageRevision:statusRev];
+						};
+						
+						if ([NSThread isMainThread]) {
+							loadImage();
 						} else {
-							spreed_me_log("Error downloading image %s", [error cDescription]);
-							[self asynchronousUpdateImageForUserWithSessionId:userSessionId withImage:nil imageRevision:statusRev];
+							dispatch_async(dispatch_get_main_queue(), loadImage);
 						}
-					}];	
+					}
 				} else {
 					[self updateBuddyDisplayImage:buddy withImage:nil];
 				}
@@ -350,7 +449,8 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 - (void)updateBuddyDisplayImage:(User *)buddy withImage:(UIImage *)image
 {
 	if (!image) {
-		image = [UIImage imageNamed:@"buddy_icon.png"];
+		buddy.iconImage = [[self class] defaultUserImage];
+		return;
 	}
     
     UIImage *roundedImage = [image roundCornersWithRadius:kViewCornerRadius];
@@ -359,17 +459,104 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 }
 
 
+- (void)decodeDeferredPictures:(NSArray *)deferredPictures
+{
+	if ([deferredPictures count] == 0) {
+		return;
+	}
+	
+	static dispatch_once_t once;
+	static dispatch_queue_t decodingQueue;
+	dispatch_once(&once, ^{
+		decodingQueue = dispatch_queue_create("SMBuddyPictureDecoding", DISPATCH_QUEUE_SERIAL);
+		dispatch_set_target_queue(decodingQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+	});
+	
+	dispatch_async(decodingQueue, ^{
+		NSMutableArray *updates = [[NSMutableArray alloc] initWithCapacity:kBuddyPictureDecodingChunkSize];
+		
+		for (NSDictionary *deferredPicture in deferredPictures) {
+			@autoreleasepool {
+				NSData *imageData = [[self class] dataFromBase64String:[[deferredPicture objectForKey:kDeferredPictureKey] substringFromIndex:23]];
+				UIImage *image = [[SMUserImageCache sharedInstance] imageByStoringImageData:imageData
+																					forKey:[deferredPicture objectForKey:kDeferredPictureCacheKey]
+																				  revision:[[deferredPicture objectForKey:SMUserImageRevisionUserInfoKey] unsignedLongLongValue]
+																				 pointSize:kSMUserImageCacheDefaultThumbnailSize
+																			   storeToDisk:NO];
+				if (image) {
+					[updates addObject:@{UserSessionIdUserInfoKey : [deferredPicture objectForKey:UserSessionIdUserInfoKey],
+										 BuddyImageUserInfoKey : image,
+										 SMUserImageRevisionUserInfoKey : [deferredPicture objectForKey:SMUserImageRevisionUserInfoKey]}];
+				}
+			}
+			
+			if ([updates count] >= kBuddyPictureDecodingChunkSize) {
+				[self postImageUpdates:updates];
+				updates = [[NSMutableArray alloc] initWithCapacity:kBuddyPictureDecodingChunkSize];
+			}
+		}
+		
+		[self postImageUpdates:updates];
+	});
+}
+
+
+- (void)postImageUpdates:(NSArray *)updates
+{
+	if ([updates count] == 0) {
+		return;
+	}
+	
+	NSDictionary *userInfo = @{BuddyImageUpdatesUserInfoKey : updates};
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[[NSNotificationCenter defaultCenter] postNotificationName:BuddyImagesHaveBeenUpdatedNotification object:self userInfo:userInfo];
+	});
+}
+
+
+// Should be called on the main thread
+- (void)loadImageForUserWithSessionId:(NSString *)userSessionId
+						imageCacheKey:(NSString *)imageCacheKey
+						   pictureURL:(NSURL *)pictureURL
+						imageRevision:(uint64_t)rev
+{
+	SMUserImageCache *imageCache = [SMUserImageCache sharedInstance];
+	
+	[imageCache loadImageForKey:imageCacheKey revision:rev pointSize:kSMUserImageCacheDefaultThumbnailSize completionHandler:^(UIImage *cachedImage) {
+		if (cachedImage) {
+			[self asynchronousUpdateImageForUserWithSessionId:userSessionId withImage:cachedImage imageRevision:rev];
+			return;
+		}
+		
+		[[ResourceDownloadManager sharedInstance] enqueueInMemoryDownloadTaskWithURL:pictureURL completionHandler: ^(NSData *data, NSError *error) {
+			if (!error) {
+				[imageCache storeImageData:data
+									forKey:imageCacheKey
+								  revision:rev
+								 pointSize:kSMUserImageCacheDefaultThumbnailSize
+							   storeToDisk:YES
+						 completionHandler:^(UIImage *image) {
+							 [self asynchronousUpdateImageForUserWithSessionId:userSessionId withImage:image imageRevision:rev];
+						 }];
+			} else {
+				spreed_me_log("Error downloading image %s", [error cDescription]);
+				[self asynchronousUpdateImageForUserWithSessionId:userSessionId withImage:nil imageRevision:rev];
+			}
+		}];
+	}];
+}
+
+
+// @image should be already rounded. If @image is nil default user image is used.
 - (void)asynchronousUpdateImageForUserWithSessionId:(NSString *)userSessionId withImage:(UIImage *)image imageRevision:(uint64_t)rev
 {
 	if ([userSessionId length]) {
 		if (!image) {
-			image = [UIImage imageNamed:@"buddy_icon.png"];
+			image = [[self class] defaultUserImage];
 		}
 		
-		UIImage *roundedImage = [image roundCornersWithRadius:kViewCornerRadius];
-		
 		NSDictionary *userInfo = @{UserSessionIdUserInfoKey : userSessionId,
-								   BuddyImageUserInfoKey : roundedImage,
+								   BuddyImageUserInfoKey : image,
 								   SMUserImageRevisionUserInfoKey : @(rev)};
 		
 		dispatch_async(dispatch_get_main_queue(), ^{
@@ -379,12 +566,24 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 }
 
 
+// Anonymous users have no user id so their pictures are cached only for the session.
++ (NSString *)imageCacheKeyForUserId:(NSString *)userId sessionId:(NSString *)sessionId
+{
+	return [userId length] ? userId : sessionId;
+}
+
+
 #pragma mark - Convenience default image creation
 
 + (UIImage *)defaultUserImage
 {
-	UIImage *image = [UIImage imageNamed:@"buddy_icon.png"];
-	UIImage *roundedImage = [image roundCornersWithRadius:kViewCornerRadius];
+	// Rounded default image is the same for every user so create it once.
+	static dispatch_once_t once;
+	static UIImage *roundedImage;
+	dispatch_once(&once, ^{
+		UIImage *image = [UIImage imageNamed:@"buddy_icon.png"];
+		roundedImage = [image roundCornersWithRadius:kViewCornerRadius];
+	});
 	return roundedImage;
 }
 
@@ -397,20 +596,29 @@ NSString * const base64APIImageHeader = @"data:image/jpeg;base64,";
 
 #pragma mark - Convenience Base64 string based images conversions
 
-+ (UIImage *)imageFromBase64String:(NSString *)base64ImageString
++ (NSData *)dataFromBase64String:(NSString *)base64ImageString
 {
-	UIImage *image = nil;
+	NSData *imageData = nil;
 	
 	if (![base64ImageString isKindOfClass:[NSNull class]] && [base64ImageString length] > 10)
-    {
-		NSData *imageData = nil;
-		
+	{
 		if ([[[UIDevice currentDevice] systemVersion] floatValue] < 7.0) {
 			imageData = [[NSData alloc] initWithBase64Encoding:base64ImageString];
 		} else {
 			imageData = [[NSData alloc] initWithBase64EncodedString:base64ImageString options:NSDataBase64DecodingIgnoreUnknownCharacters];
 		}
-		
+	}
+	
+	return imageData;
+}
+
+
++ (UIImage *)imageFromBase64String:(NSString *)base64ImageString
+{
+	UIImage *image = nil;
+	
+	NSData *imageData = [self dataFromBase64String:base64ImageString];
+	if (imageData) {
         image = [UIImage imageWithData:imageData];
     }
 	
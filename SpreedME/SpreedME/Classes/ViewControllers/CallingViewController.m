@@ -64,7 +64,8 @@ CallingViewState;
 
 
 @interface CallingViewController () <UICollectionViewDelegate, UICollectionViewDelegateFlowLayout, UICollectionViewDataSource,
-									BuddyListViewControllerDelegate, PopUpListViewDelegate, UserUpdatesProtocol, UserRecentActivityControllerUpdatesListener>
+									BuddyListViewControllerDelegate, PopUpListViewDelegate, UserUpdatesProtocol, UserRecentActivityControllerUpdatesListener,
+									UIScrollViewDelegate>
 {
     MPVolumeView *_systemVolumeSlider;
 	
@@ -145,6 +146,7 @@ CallingViewState;
 @property (nonatomic, strong) UIWindow *secondaryWindow;
 @property (nonatomic, strong) UIView *screenSharingContainerView;
 @property (nonatomic, strong) UIScrollView *screenSharingScrollView;
+@property (nonatomic, strong) UIView *screenSharingZoomView; // is zoomed by screenSharingScrollView, holds screenSharingRenderView
 @property (nonatomic, strong) UIView *screenSharingRenderView;
 @property (nonatomic, assign) CGFloat screenSharingVideoRendererAspectRatio;
 
@@ -1458,6 +1460,7 @@ CallingViewState;
     
     self.screenSharingScrollView = [[UIScrollView alloc] initWithFrame:self.screenSharingContainerView.bounds];
     self.screenSharingScrollView.autoresizingMask = UIViewAutoresizingFlexibleWidth | UIViewAutoresizingFlexibleHeight;
+    self.screenSharingScrollView.delegate = self;
     [self.screenSharingContainerView addSubview:self.screenSharingScrollView];
     
     RoundedRectButton *closeButton = [RoundedRectButton buttonWithType:UIButtonTypeRoundedRect];
@@ -1492,6 +1495,7 @@ CallingViewState;
 	for (UIView *view in self.screenSharingScrollView.subviews) {
 		[view removeFromSuperview];
 	}
+	self.screenSharingZoomView = nil;
 	
 	if (self.secondaryWindow) {
 		for (UIView *view in self.secondaryWindow.subviews) {
@@ -1840,12 +1844,16 @@ CallingViewState;
 	if (self.screenSharingRenderView != view) {
 		CGRect newFrame = CGRectMake(0.0f, 0.0f, 1280.0f, 720.0f); // These are magic numbers. We expect real values in another method
 		
+		self.screenSharingScrollView.zoomScale = 1.0f;
+		self.screenSharingZoomView = [[UIView alloc] initWithFrame:newFrame];
+		
 		view.frame = newFrame;
 		CGAffineTransform transform = CGAffineTransformIdentity;
 		transform = CGAffineTransformScale(transform, -1.0f, 1.0f);
 		transform = CGAffineTransformRotate(transform, M_PI);
 		view.transform = transform;
-		[self.screenSharingScrollView addSubview:view];
+		[self.screenSharingZoomView addSubview:view];
+		[self.screenSharingScrollView addSubview:self.screenSharingZoomView];
 		self.screenSharingScrollView.contentSize = view.bounds.size;
 		self.screenSharingRenderView = view;
 	}
@@ -1861,6 +1869,10 @@ CallingViewState;
     [self hideStartScreenSharingNotification];
     
 	if (self.screenSharingRenderView == view) {
+		
+		// Frames below are in unzoomed coordinates
+		self.screenSharingScrollView.zoomScale = 1.0f;
+		view.transform = CGAffineTransformIdentity;
 	
 		// Since GLKView doesn't allow (or at least we have problems with) frames that are larger than 2048 units
 		// we have to downscale our video frame in order for it to work.
@@ -1882,7 +1894,7 @@ CallingViewState;
 			CGRect frameRect = CGRectMake(0.0f, 0.0f, frameSize.width, frameSize.height);
 			
 			if (CGRectContainsRect(self.secondaryWindow.bounds, frameRect)) {
-				view.frame = frameRect;
+				self.screenSharingZoomView.frame = frameRect;
 			} else {
 				// Fit screensharing frame into secondary display window
 				while (!CGRectContainsRect(self.secondaryWindow.bounds, frameRect)) {
@@ -1892,18 +1904,29 @@ CallingViewState;
 					frameRect.size.height = floorf(frameRect.size.height);
 				}
 				
-				view.frame = frameRect;
+				self.screenSharingZoomView.frame = frameRect;
 			}
 			
 		} else {
-			view.frame = CGRectMake(0.0f, 0.0f, frameSize.width, frameSize.height);
+			self.screenSharingZoomView.frame = CGRectMake(0.0f, 0.0f, frameSize.width, frameSize.height);
 		}
 		
+		view.frame = self.screenSharingZoomView.bounds;
 		CGAffineTransform transform = CGAffineTransformIdentity;
 		transform = CGAffineTransformScale(transform, -1.0f, 1.0f);
 		transform = CGAffineTransformRotate(transform, M_PI);
 		view.transform = transform;
-		self.screenSharingScrollView.contentSize = view.frame.size;
+		self.screenSharingScrollView.contentSize = self.screenSharingZoomView.frame.size;
+		
+		// Screen is shown fitted by default and can be zoomed in up to its full size.
+		// Render view picks its texture resolution from the zoom, so fitted 4K screen costs only as much as the display.
+		CGSize scrollViewSize = self.screenSharingScrollView.bounds.size;
+		CGSize contentSize = self.screenSharingZoomView.bounds.size;
+		CGFloat fitScale = MIN(scrollViewSize.width / contentSize.width, scrollViewSize.height / contentSize.height);
+		self.screenSharingScrollView.minimumZoomScale = MIN(1.0f, fitScale);
+		self.screenSharingScrollView.maximumZoomScale = 1.0f;
+		self.screenSharingScrollView.zoomScale = self.screenSharingScrollView.minimumZoomScale;
+		
 		spreed_me_log("screen sharing framesize %.1f:%.1f; downscale %.3f", frameSize.width, frameSize.height, downscaleRatio);
 	}
 }
@@ -1917,4 +1940,28 @@ CallingViewState;
 }
 
 
+#pragma mark - UIScrollViewDelegate
+
+- (UIView *)viewForZoomingInScrollView:(UIScrollView *)scrollView
+{
+	if (scrollView == self.screenSharingScrollView) {
+		return self.screenSharingZoomView;
+	}
+	return nil;
+}
+
+
+- (void)scrollViewDidZoom:(UIScrollView *)scrollView
+{
+	if (scrollView == self.screenSharingScrollView) {
+		// Keep zoomed out screen in the middle
+		CGSize boundsSize = scrollView.bounds.size;
+		CGSize contentSize = scrollView.contentSize;
+		CGFloat horizontalInset = MAX(0.0f, floorf((boundsSize.width - contentSize.width) / 2.0f));
+		CGFloat verticalInset = MAX(0.0f, floorf((boundsSize.height - contentSize.height) / 2.0f));
+		scrollView.contentInset = UIEdgeInsetsMake(verticalInset, horizontalInset, verticalInset, horizontalInset);
+	}
+}
+
+
 @end
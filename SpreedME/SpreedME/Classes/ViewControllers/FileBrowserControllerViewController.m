@@ -164,6 +164,12 @@
 
 - (BOOL)fileBrowser:(STFileBrowserViewController *)fileBrowser shouldPresentDocumentsControllerForFileAtPath:(NSString *)path
 {
+	// Documents controller can't read encrypted downloaded files, we present it with decrypted copy
+	if ([[FileSharingManagerObjC defaultManager] isEncryptedDownloadedFileAtPath:path]) {
+		[self selectFileWithName:[path lastPathComponent]];
+		return NO;
+	}
+	
     return YES;
 }
 
@@ -173,39 +179,66 @@
 - (void)selectFileWithName:(NSString *)fileName
 {
 	if ([fileName length] > 0) {
-	
-		NSURL *url = [NSURL fileURLWithPathComponents:@[[[FileSharingManagerObjC defaultManager] fileLocation], fileName]];
-		
-		if (!_documentInteractionController) {
-			_documentInteractionController = [UIDocumentInteractionController interactionControllerWithURL:url];
-		}
-		_documentInteractionController.URL = url;
-		_documentInteractionController.delegate = self;
 		
-		BOOL canPreview = [_documentInteractionController presentPreviewAnimated:YES];
+		NSString *filePath = [[[FileSharingManagerObjC defaultManager] fileLocation] stringByAppendingPathComponent:fileName];
 		
-		if (!canPreview) {
-			BOOL canShowActions = [_documentInteractionController presentOpenInMenuFromRect:self.view.frame inView:self.view animated:YES];
-			if (!canShowActions) {
-				UIAlertView *alert = [[UIAlertView alloc] initWithTitle:self.noAppToOpenFileAlertTitle
-																message:self.noAppToOpenFileAlertMessage
-															   delegate:nil
-													  cancelButtonTitle:self.noAppToOpenFileAlertOkButtonLabel
-													  otherButtonTitles:nil];
-				
-				[alert show];
+		__weak FileBrowserControllerViewController *weakSelf = self;
+		[[FileSharingManagerObjC defaultManager] openableFileForDownloadedFileAtPath:filePath completion:^(NSString *openableFilePath) {
+			if (openableFilePath) {
+				[weakSelf presentDocumentInteractionControllerWithURL:[NSURL fileURLWithPath:openableFilePath]];
+			} else {
+				[weakSelf showNoAppToOpenFileAlert];
 			}
+		}];
+	}
+}
+
+
+- (void)presentDocumentInteractionControllerWithURL:(NSURL *)url
+{
+	if (!_documentInteractionController) {
+		_documentInteractionController = [UIDocumentInteractionController interactionControllerWithURL:url];
+	}
+	_documentInteractionController.URL = url;
+	_documentInteractionController.delegate = self;
+	
+	BOOL canPreview = [_documentInteractionController presentPreviewAnimated:YES];
+	
+	if (!canPreview) {
+		BOOL canShowActions = [_documentInteractionController presentOpenInMenuFromRect:self.view.frame inView:self.view animated:YES];
+		if (!canShowActions) {
+			[self showNoAppToOpenFileAlert];
 		}
 	}
 }
 
 
+- (void)showNoAppToOpenFileAlert
+{
+	UIAlertView *alert = [[UIAlertView alloc] initWithTitle:self.noAppToOpenFileAlertTitle
+													message:self.noAppToOpenFileAlertMessage
+												   delegate:nil
+										  cancelButtonTitle:self.noAppToOpenFileAlertOkButtonLabel
+										  otherButtonTitles:nil];
+	
+	[alert show];
+}
+
+
 #pragma mark - Public methods
 
 - (void)tryToOpenFileName:(NSString *)fileName recursive:(BOOL)recursive
 {
 	if ([fileName length] > 0) {
 		NSUInteger fileIndex = [_directoryContentsArray indexOfObject:fileName];
+		if (fileIndex == NSNotFound) {
+			// File could have been stored encrypted
+			NSString *encryptedFileName = [fileName stringByAppendingString:kEncryptedDownloadedFileSuffix];
+			fileIndex = [_directoryContentsArray indexOfObject:encryptedFileName];
+			if (fileIndex != NSNotFound) {
+				fileName = encryptedFileName;
+			}
+		}
 		if (fileIndex != NSNotFound) {
 			NSIndexPath *fileIndexPath = [NSIndexPath indexPathForRow:fileIndex inSection:0];
 			//TODO: This has minor issue. If VC view is not loaded corresponding row will not be selected.
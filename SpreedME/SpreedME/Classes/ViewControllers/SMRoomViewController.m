@@ -33,6 +33,7 @@
 #import "SMConnectionController.h"
 #import "SMLocalizedStrings.h"
 #import "STNoUsersInRoomTableViewCell.h"
+#import "STPair.h"
 #import "UserInterfaceManager.h"
 #import "UsersManager.h"
 
@@ -197,15 +198,52 @@
 
 #pragma mark - BuddyUpdates Protocol
 
-- (void)roomUsersListUpdated
+- (void)roomDisplayUsersHaveChanged:(SMRoomDisplayUsersChange *)change
 {
     [self setUIForState:_state];
     
-    if (self.isViewLoaded && self.view.window) {
-        [self.roomUsersTableView reloadSections:[NSIndexSet indexSetWithIndex:0] withRowAnimation:UITableViewRowAnimationAutomatic];
-    } else {
+    if (!(self.isViewLoaded && self.view.window)) {
         [self.roomUsersTableView reloadData];
+        return;
     }
+    
+    // Placeholder row is shown instead of users when room is empty so we can't map indexes in that case.
+    BOOL canApplyIndexes = !change.isReload && change.previousCount > 0 && change.count > 0 &&
+                           _state == kSMRoomViewControllerStateConnected &&
+                           [self.roomUsersTableView numberOfRowsInSection:0] == change.previousCount;
+    
+    if (canApplyIndexes) {
+        [self.roomUsersTableView beginUpdates];
+        [self.roomUsersTableView deleteRowsAtIndexPaths:[self indexPathsForIndexes:change.deletedIndexes] withRowAnimation:UITableViewRowAnimationAutomatic];
+        [self.roomUsersTableView insertRowsAtIndexPaths:[self indexPathsForIndexes:change.insertedIndexes] withRowAnimation:UITableViewRowAnimationAutomatic];
+        [self.roomUsersTableView reloadRowsAtIndexPaths:[self indexPathsForIndexes:change.reloadedIndexes] withRowAnimation:UITableViewRowAnimationNone];
+        for (STPair *move in change.moves) {
+            [self.roomUsersTableView moveRowAtIndexPath:[NSIndexPath indexPathForRow:[move.key unsignedIntegerValue] inSection:0]
+                                            toIndexPath:[NSIndexPath indexPathForRow:[move.value unsignedIntegerValue] inSection:0]];
+        }
+        [self.roomUsersTableView endUpdates];
+        
+        // Moved rows are not reloaded by table view
+        for (STPair *move in change.moves) {
+            NSIndexPath *indexPath = [NSIndexPath indexPathForRow:[move.value unsignedIntegerValue] inSection:0];
+            BuddyTableViewCell *cell = (BuddyTableViewCell *)[self.roomUsersTableView cellForRowAtIndexPath:indexPath];
+            if (cell) {
+                [cell setupWithDisplayUser:[[UsersManager defaultManager] roomDisplayUserForIndex:indexPath.row]];
+            }
+        }
+    } else {
+        [self.roomUsersTableView reloadSections:[NSIndexSet indexSetWithIndex:0] withRowAnimation:UITableViewRowAnimationAutomatic];
+    }
+}
+
+
+- (NSArray *)indexPathsForIndexes:(NSIndexSet *)indexes
+{
+    NSMutableArray *indexPaths = [NSMutableArray arrayWithCapacity:indexes.count];
+    [indexes enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+        [indexPaths addObject:[NSIndexPath indexPathForRow:idx inSection:0]];
+    }];
+    return indexPaths;
 }
 
 
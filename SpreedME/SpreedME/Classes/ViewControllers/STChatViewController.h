@@ -120,6 +120,9 @@ typedef enum : NSUInteger {
  */
 - (BOOL)isCanceled;
 
+@optional
+- (NSTimeInterval)estimatedTimeLeft; // in seconds, negative if unknown
+
 @end
 
 @protocol STGeolocationChatMessage <STChatMessage>
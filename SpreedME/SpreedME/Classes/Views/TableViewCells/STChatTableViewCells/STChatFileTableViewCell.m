@@ -253,6 +253,13 @@ typedef enum : NSUInteger {
 						CGFloat progress = (CGFloat)[fileMessage downloadedBytes] / (CGFloat)[fileMessage fileSize];
 						self.progressView.progress = progress;
 						fileSizeString = [fileSizeString stringByAppendingFormat:@" / %3.0f%%", progress * 100.0f];
+						if ([fileMessage respondsToSelector:@selector(estimatedTimeLeft)] && ![fileMessage isCanceled]) {
+							NSTimeInterval timeLeft = [fileMessage estimatedTimeLeft];
+							if (timeLeft >= 1.0) {
+								NSUInteger seconds = (NSUInteger)ceil(timeLeft);
+								fileSizeString = [fileSizeString stringByAppendingFormat:@" / %lu:%02lu", (unsigned long)(seconds / 60), (unsigned long)(seconds % 60)];
+							}
+						}
 						self.fileSizeLabel.text = fileSizeString;
 					} else {
 //						NSLog(@"Avoided division by zero. File size is zero");
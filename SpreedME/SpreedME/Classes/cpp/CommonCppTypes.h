@@ -25,6 +25,7 @@
 
 #include <map>
 
+#include <webrtc/base/json.h>
 #include <webrtc/base/refcount.h>
 #include <webrtc/base/messagehandler.h>
 
@@ -53,6 +54,12 @@ struct BooleanMessageData : public rtc::MessageData {
 	
 	bool value;
 };
+	
+struct IntegerMessageData : public rtc::MessageData {
+	explicit IntegerMessageData(int value) : value(value) {};
+	
+	int value;
+};
 
 struct SignallingMessageData : public rtc::MessageData {
     SignallingMessageData (const std::string& msg, ChannelingMessageTransportType transportType, std::string wrapperId) :
@@ -65,6 +72,19 @@ struct SignallingMessageData : public rtc::MessageData {
 	std::string wrapperId;
 	std::string token;
 };
+
+// Carries already parsed signalling message so receiving thread doesn't have to parse it again.
+struct JsonSignallingMessageData : public rtc::MessageData {
+	JsonSignallingMessageData (const Json::Value &root, ChannelingMessageTransportType transportType, const std::string &wrapperId) :
+	root(root), transportType(transportType), wrapperId(wrapperId) {};
+	JsonSignallingMessageData (const Json::Value &root, ChannelingMessageTransportType transportType, const std::string &wrapperId, const std::string &token) :
+	root(root), transportType(transportType), wrapperId(wrapperId), token(token) {};
+	
+	Json::Value root;
+	ChannelingMessageTransportType transportType;
+	std::string wrapperId;
+	std::string token;
+};
 	
 struct VideoRendererMessageData : public rtc::MessageData {
 	explicit VideoRendererMessageData(const std::string &userId,
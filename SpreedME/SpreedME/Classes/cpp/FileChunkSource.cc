@@ -0,0 +1,111 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileChunkSource.h"
+
+#include <stdio.h>
+#include <sys/clonefile.h>
+
+using namespace spreedme;
+
+
+PlainFileChunkSource::PlainFileChunkSource(const std::string &filePath, bool deleteOnClose) :
+	filePath_(filePath),
+	deleteOnClose_(deleteOnClose),
+	size_(0)
+{
+}
+
+
+PlainFileChunkSource::~PlainFileChunkSource()
+{
+	this->Close();
+}
+
+
+bool PlainFileChunkSource::Open()
+{
+	fileHandle_.open(filePath_.c_str(), std::ios::in | std::ios::binary);
+	
+	if (!fileHandle_.is_open()) {
+		spreed_me_log("Couldn't open file handle to filePath %s", filePath_.c_str());
+		return false;
+	}
+	
+	fileHandle_.seekg(0, std::ios::end);
+	size_ = fileHandle_.tellg();
+	fileHandle_.seekg(0);
+	spreed_me_log("Opened file handle to filePath %s", filePath_.c_str());
+	
+	return true;
+}
+
+
+bool PlainFileChunkSource::ReadAt(uint64 offset, char *buffer, uint32 size)
+{
+	if (!fileHandle_.is_open()) {
+		return false;
+	}
+	
+	fileHandle_.clear();
+	fileHandle_.seekg(offset);
+	fileHandle_.read(buffer, size);
+	
+	return fileHandle_.gcount() == size;
+}
+
+
+void PlainFileChunkSource::Close()
+{
+	if (fileHandle_.is_open()) {
+		fileHandle_.close();
+	}
+	
+	if (deleteOnClose_) {
+		remove(filePath_.c_str());
+		deleteOnClose_ = false;
+	}
+}
+
+
+ClonedFileChunkSource::ClonedFileChunkSource(const std::string &originalFilePath, const std::string &clonePath) :
+	PlainFileChunkSource(originalFilePath, false),
+	originalFilePath_(originalFilePath),
+	clonePath_(clonePath)
+{
+}
+
+
+bool ClonedFileChunkSource::Open()
+{
+	// clonefile() is weak linked since we still support systems without it
+	if (clonefile != NULL && !clonePath_.empty()) {
+		if (clonefile(originalFilePath_.c_str(), clonePath_.c_str(), 0) == 0) {
+			filePath_ = clonePath_;
+			deleteOnClose_ = true;
+		} else {
+			spreed_me_log("Couldn't clone file %s, will read it directly", originalFilePath_.c_str());
+		}
+	}
+	
+	return PlainFileChunkSource::Open();
+}
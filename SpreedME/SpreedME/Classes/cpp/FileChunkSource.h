@@ -0,0 +1,135 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__FileChunkSource__
+#define __SpreedME__FileChunkSource__
+
+#include <fstream>
+#include <string>
+
+#include <webrtc/base/basictypes.h>
+
+namespace spreedme {
+
+/*
+ FileChunkSource is where FileUploader reads file contents from. Chunks are requested in any order,
+ so every source has to support random access reads. Sources are created on any thread, after that
+ they are used only from files worker thread.
+ */
+class FileChunkSource
+{
+public:
+	virtual ~FileChunkSource() {};
+	
+	virtual bool Open() = 0;
+	virtual uint64 Size() = 0;
+	// Reads exactly @size bytes at @offset. Returns false if it couldn't.
+	virtual bool ReadAt(uint64 offset, char *buffer, uint32 size) = 0;
+	// Releases file handles and removes temporary data if source owns any. Source can't be used after this.
+	virtual void Close() = 0;
+	
+	// Path of a persistent file with the same contents, it is used to remember content hash of the file.
+	// Empty if there is no such file.
+	virtual std::string OriginalFilePath() {return std::string();};
+};
+
+
+// Reads file at path directly. If @deleteOnClose is true file is removed on Close() or destruction.
+class PlainFileChunkSource : public FileChunkSource
+{
+public:
+	PlainFileChunkSource(const std::string &filePath, bool deleteOnClose);
+	virtual ~PlainFileChunkSource();
+	
+	virtual bool Open();
+	virtual uint64 Size() {return size_;};
+	virtual bool ReadAt(uint64 offset, char *buffer, uint32 size);
+	virtual void Close();
+	virtual std::string OriginalFilePath() {return deleteOnClose_ ? std::string() : filePath_;};
+	
+protected:
+	std::string filePath_;
+	bool deleteOnClose_;
+	
+private:
+	PlainFileChunkSource(const PlainFileChunkSource &);
+	PlainFileChunkSource &operator=(const PlainFileChunkSource &);
+	
+	std::ifstream fileHandle_;
+	uint64 size_;
+};
+
+
+/*
+ Makes a copy-on-write clone of the file at @clonePath on Open() and reads the clone,
+ so later changes to the original don't affect transfer. Clone takes no time and no
+ additional space until one of files is modified. If file system can't clone (or system is older than iOS 10)
+ original file is read directly.
+ */
+class ClonedFileChunkSource : public PlainFileChunkSource
+{
+public:
+	ClonedFileChunkSource(const std::string &originalFilePath, const std::string &clonePath);
+	
+	virtual bool Open();
+	virtual std::string OriginalFilePath() {return originalFilePath_;};
+	
+private:
+	std::string originalFilePath_;
+	std::string clonePath_;
+};
+
+
+// Something that can read bytes at random offsets, e.g. photo library asset.
+class FileChunkSourceProviderInterface
+{
+public:
+	virtual ~FileChunkSourceProviderInterface() {};
+	
+	virtual uint64 Size() = 0;
+	virtual bool ReadAt(uint64 offset, char *buffer, uint32 size) = 0;
+	virtual void Close() {};
+};
+
+
+// Reads data from provider without copying it anywhere. Takes ownership of provider.
+class StreamingChunkSource : public FileChunkSource
+{
+public:
+	explicit StreamingChunkSource(FileChunkSourceProviderInterface *provider) : provider_(provider) {};
+	virtual ~StreamingChunkSource() {delete provider_;};
+	
+	virtual bool Open() {return provider_ != NULL;};
+	virtual uint64 Size() {return provider_ ? provider_->Size() : 0;};
+	virtual bool ReadAt(uint64 offset, char *buffer, uint32 size) {return provider_ ? provider_->ReadAt(offset, buffer, size) : false;};
+	virtual void Close() {if (provider_) {provider_->Close(); delete provider_; provider_ = NULL;}};
+	
+private:
+	StreamingChunkSource(const StreamingChunkSource &);
+	StreamingChunkSource &operator=(const StreamingChunkSource &);
+	
+	FileChunkSourceProviderInterface *provider_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__FileChunkSource__) */
@@ -0,0 +1,467 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileContentIndex.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <CommonCrypto/CommonDigest.h>
+#include <webrtc/base/json.h>
+
+#include "cpp_utils.h"
+#include "MerkleTree.h"
+#include "SegmentedFileCrypto.h"
+
+using namespace spreedme;
+
+namespace {
+
+const int kFileContentIndexVersion = 1;
+const char kIndexVersionKey[] = "v";
+const char kIndexFilesKey[] = "files";
+const char kIndexPathKey[] = "path";
+const char kIndexHashKey[] = "hash";
+const char kIndexSizeKey[] = "size";
+const char kIndexModificationTimeKey[] = "mtime";
+const char kIndexEncryptedKey[] = "enc"; // saved only for encrypted files, older indexes don't have it
+
+
+bool CopyFile(const std::string &src, const std::string &dst)
+{
+	std::ifstream in(src.c_str(), std::ios::in | std::ios::binary);
+	std::ofstream out(dst.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!in.is_open() || !out.is_open()) {
+		return false;
+	}
+	
+	char buffer[64 * 1024];
+	while (in.good()) {
+		in.read(buffer, sizeof(buffer));
+		out.write(buffer, in.gcount());
+	}
+	
+	out.flush();
+	return in.eof() && out.good();
+}
+	
+} // namespace
+
+
+/*-------------------------------------- FileContentHasher -----------------------------------------*/
+
+FileContentHasher::FileContentHasher(uint32 chunkSize, uint32 chunks) :
+	chunkSize_(chunkSize),
+	chunkHashes_(chunks),
+	hashedChunks_(0)
+{
+}
+
+
+void FileContentHasher::AddChunk(uint32 chunkNumber, const char *data, uint32 size)
+{
+	if (chunkNumber >= chunkHashes_.size() || !chunkHashes_[chunkNumber].empty()) {
+		return;
+	}
+	
+	chunkHashes_[chunkNumber] = MerkleTree::LeafHash(data, size);
+	++hashedChunks_;
+}
+
+
+std::string FileContentHasher::ContentHash() const
+{
+	if (!this->IsComplete()) {
+		return std::string();
+	}
+	
+	return ContentHashForMerkleRoot(chunkSize_, (uint32)chunkHashes_.size(), MerkleTree(chunkHashes_).Root());
+}
+
+
+std::string FileContentHasher::ContentHashForMerkleRoot(uint32 chunkSize, uint32 chunks, const std::string &merkleRoot)
+{
+	// Downloader learns chunk size from the first chunk, which for one chunk file is just file size.
+	if (chunks <= 1) {
+		chunkSize = 0;
+	}
+	
+	unsigned char chunkSizeLE[4] = {(unsigned char)(chunkSize & 0xff), (unsigned char)((chunkSize >> 8) & 0xff),
+									(unsigned char)((chunkSize >> 16) & 0xff), (unsigned char)((chunkSize >> 24) & 0xff)};
+	
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	CC_SHA256_Update(&ctx, chunkSizeLE, sizeof(chunkSizeLE));
+	CC_SHA256_Update(&ctx, merkleRoot.data(), (CC_LONG)merkleRoot.size());
+	
+	unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256_Final(digest, &ctx);
+	
+	return hex_encode(std::string((const char *)digest, sizeof(digest)));
+}
+
+
+/*-------------------------------------- FileContentIndex -----------------------------------------*/
+
+FileContentIndex::FileContentIndex(const std::string &indexFilePath) :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	indexFilePath_(indexFilePath)
+{
+	critSect_->Enter();
+	this->Load_l();
+	critSect_->Leave();
+}
+
+
+FileContentIndex::~FileContentIndex()
+{
+	delete critSect_;
+}
+
+
+bool FileContentIndex::StatFile(const std::string &filePath, uint64 *fileSize, int64 *modificationTime)
+{
+	struct stat st;
+	if (stat(filePath.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+		return false;
+	}
+	
+	*fileSize = st.st_size;
+	*modificationTime = st.st_mtime;
+	return true;
+}
+
+
+bool FileContentIndex::EntryIsValid_l(const std::string &filePath, const Entry &entry)
+{
+	uint64 fileSize = 0;
+	int64 modificationTime = 0;
+	return StatFile(filePath, &fileSize, &modificationTime) &&
+		fileSize == entry.fileSize && modificationTime == entry.modificationTime;
+}
+
+
+// Encrypted file is bigger than its plaintext, its header tells plaintext size.
+bool FileContentIndex::EntryHasContentSize(const std::string &filePath, const Entry &entry, uint64 contentSize)
+{
+	if (!entry.encrypted) {
+		return entry.fileSize == contentSize;
+	}
+	
+	uint64_t plaintextSize = 0;
+	return SegmentedFileReader::PlaintextSizeOfFile(filePath, &plaintextSize) && plaintextSize == contentSize;
+}
+
+
+std::string FileContentIndex::PathForContentHash_l(const std::string &contentHash, uint64 fileSize, bool encrypted)
+{
+	std::string path;
+	bool removedEntries = false;
+	
+	typedef std::multimap<std::string, std::string>::iterator HashIterator;
+	std::pair<HashIterator, HashIterator> range = contentHashToPaths_.equal_range(contentHash);
+	for (HashIterator it = range.first; it != range.second;) {
+		PathToEntryMap::iterator entryIt = entries_.find(it->second);
+		if (entryIt != entries_.end() && this->EntryIsValid_l(entryIt->first, entryIt->second)) {
+			if (entryIt->second.encrypted == encrypted && EntryHasContentSize(entryIt->first, entryIt->second, fileSize)) {
+				path = entryIt->first;
+				break;
+			}
+			++it;
+		} else {
+			// file was changed or removed since we've seen it
+			if (entryIt != entries_.end()) {
+				entries_.erase(entryIt);
+			}
+			contentHashToPaths_.erase(it++);
+			removedEntries = true;
+		}
+	}
+	
+	if (removedEntries) {
+		this->RemoveChunkHashesIfUnused_l(contentHash);
+	}
+	
+	if (removedEntries) {
+		this->Save_l();
+	}
+	
+	return path;
+}
+
+
+std::string FileContentIndex::PathForContentHash(const std::string &contentHash, uint64 fileSize, bool encrypted)
+{
+	if (contentHash.empty()) {
+		return std::string();
+	}
+	
+	critSect_->Enter();
+	std::string path = this->PathForContentHash_l(contentHash, fileSize, encrypted);
+	critSect_->Leave();
+	
+	return path;
+}
+
+
+std::string FileContentIndex::ContentHashForPath(const std::string &filePath)
+{
+	std::string contentHash;
+	
+	critSect_->Enter();
+	PathToEntryMap::iterator it = entries_.find(filePath);
+	if (it != entries_.end() && !it->second.encrypted && this->EntryIsValid_l(it->first, it->second)) {
+		contentHash = it->second.contentHash;
+	}
+	critSect_->Leave();
+	
+	return contentHash;
+}
+
+
+void FileContentIndex::AddFile(const std::string &filePath, const std::string &contentHash, bool encrypted)
+{
+	Entry entry;
+	if (contentHash.empty() || !StatFile(filePath, &entry.fileSize, &entry.modificationTime)) {
+		return;
+	}
+	entry.contentHash = contentHash;
+	entry.encrypted = encrypted;
+	
+	critSect_->Enter();
+	
+	PathToEntryMap::iterator it = entries_.find(filePath);
+	if (it != entries_.end()) {
+		if (it->second.contentHash == contentHash &&
+			it->second.fileSize == entry.fileSize &&
+			it->second.modificationTime == entry.modificationTime &&
+			it->second.encrypted == encrypted) {
+			critSect_->Leave();
+			return;
+		}
+		this->RemoveFile_l(filePath);
+	}
+	
+	entries_[filePath] = entry;
+	contentHashToPaths_.insert(std::make_pair(contentHash, filePath));
+	this->Save_l();
+	
+	critSect_->Leave();
+}
+
+
+void FileContentIndex::RemoveFile(const std::string &filePath)
+{
+	critSect_->Enter();
+	if (this->RemoveFile_l(filePath)) {
+		this->Save_l();
+	}
+	critSect_->Leave();
+}
+
+
+bool FileContentIndex::RemoveFile_l(const std::string &filePath)
+{
+	PathToEntryMap::iterator it = entries_.find(filePath);
+	if (it != entries_.end()) {
+		typedef std::multimap<std::string, std::string>::iterator HashIterator;
+		std::pair<HashIterator, HashIterator> range = contentHashToPaths_.equal_range(it->second.contentHash);
+		for (HashIterator hashIt = range.first; hashIt != range.second; ++hashIt) {
+			if (hashIt->second == filePath) {
+				contentHashToPaths_.erase(hashIt);
+				break;
+			}
+		}
+		std::string contentHash = it->second.contentHash;
+		entries_.erase(it);
+		this->RemoveChunkHashesIfUnused_l(contentHash);
+		return true;
+	}
+	
+	return false;
+}
+
+
+bool FileContentIndex::LinkContentToPath(const std::string &contentHash, uint64 fileSize, const std::string &dstPath, bool encrypted)
+{
+	std::string srcPath = this->PathForContentHash(contentHash, fileSize, encrypted);
+	if (srcPath.empty()) {
+		return false;
+	}
+	
+	if (srcPath == dstPath) {
+		return true;
+	}
+	
+	if (link(srcPath.c_str(), dstPath.c_str()) != 0) {
+		spreed_me_log("Couldn't hard link %s, copying it", srcPath.c_str());
+		if (!CopyFile(srcPath, dstPath)) {
+			remove(dstPath.c_str());
+			return false;
+		}
+	}
+	
+	this->AddFile(dstPath, contentHash, encrypted);
+	
+	return true;
+}
+
+
+std::string FileContentIndex::ChunkHashesFilePath(const std::string &contentHash)
+{
+	return indexFilePath_ + "." + contentHash + ".chunks";
+}
+
+
+void FileContentIndex::SaveChunkHashes(const std::string &contentHash, const std::vector<std::string> &chunkHashes)
+{
+	if (contentHash.empty()) {
+		return;
+	}
+	
+	critSect_->Enter();
+	
+	std::string path = this->ChunkHashesFilePath(contentHash);
+	std::ofstream out(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	for (std::vector<std::string>::const_iterator it = chunkHashes.begin(); it != chunkHashes.end(); ++it) {
+		out.write(it->data(), it->size());
+	}
+	out.close();
+	if (!out.good()) {
+		remove(path.c_str());
+	}
+	
+	critSect_->Leave();
+}
+
+
+bool FileContentIndex::LoadChunkHashes(const std::string &contentHash, uint32 chunks, std::vector<std::string> *chunkHashes)
+{
+	if (contentHash.empty()) {
+		return false;
+	}
+	
+	critSect_->Enter();
+	std::ifstream in(this->ChunkHashesFilePath(contentHash).c_str(), std::ios::in | std::ios::binary);
+	critSect_->Leave();
+	
+	if (!in.is_open()) {
+		return false;
+	}
+	
+	chunkHashes->assign(chunks, std::string());
+	char hash[CC_SHA256_DIGEST_LENGTH];
+	for (uint32 i = 0; i < chunks; ++i) {
+		in.read(hash, sizeof(hash));
+		if (in.gcount() != sizeof(hash)) {
+			chunkHashes->clear();
+			return false;
+		}
+		(*chunkHashes)[i].assign(hash, sizeof(hash));
+	}
+	
+	return in.peek() == EOF;
+}
+
+
+void FileContentIndex::RemoveChunkHashesIfUnused_l(const std::string &contentHash)
+{
+	if (contentHashToPaths_.count(contentHash) == 0) {
+		remove(this->ChunkHashesFilePath(contentHash).c_str());
+	}
+}
+
+
+void FileContentIndex::Load_l()
+{
+	std::ifstream in(indexFilePath_.c_str(), std::ios::in | std::ios::binary);
+	if (!in.is_open()) {
+		return;
+	}
+	
+	std::stringstream contents;
+	contents << in.rdbuf();
+	
+	Json::Reader reader;
+	Json::Value root;
+	if (!reader.parse(contents.str(), root) || root.get(kIndexVersionKey, Json::Value()).asInt() != kFileContentIndexVersion) {
+		spreed_me_log("Couldn't read file content index, starting with empty one");
+		return;
+	}
+	
+	Json::Value files = root.get(kIndexFilesKey, Json::Value());
+	for (Json::Value::ArrayIndex i = 0; i < files.size(); ++i) {
+		const Json::Value &file = files[i];
+		
+		std::string path = file.get(kIndexPathKey, Json::Value()).asString();
+		Entry entry;
+		entry.contentHash = file.get(kIndexHashKey, Json::Value()).asString();
+		// sizes and times are saved as doubles since they are exact up to 2^53
+		entry.fileSize = (uint64)file.get(kIndexSizeKey, Json::Value()).asDouble();
+		entry.modificationTime = (int64)file.get(kIndexModificationTimeKey, Json::Value()).asDouble();
+		entry.encrypted = file.get(kIndexEncryptedKey, Json::Value(false)).asBool();
+		
+		if (!path.empty() && !entry.contentHash.empty()) {
+			entries_[path] = entry;
+			contentHashToPaths_.insert(std::make_pair(entry.contentHash, path));
+		}
+	}
+}
+
+
+void FileContentIndex::Save_l()
+{
+	Json::Value files(Json::arrayValue);
+	for (PathToEntryMap::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+		Json::Value file;
+		file[kIndexPathKey] = it->first;
+		file[kIndexHashKey] = it->second.contentHash;
+		file[kIndexSizeKey] = (double)it->second.fileSize;
+		file[kIndexModificationTimeKey] = (double)it->second.modificationTime;
+		if (it->second.encrypted) {
+			file[kIndexEncryptedKey] = true;
+		}
+		files.append(file);
+	}
+	
+	Json::Value root;
+	root[kIndexVersionKey] = kFileContentIndexVersion;
+	root[kIndexFilesKey] = files;
+	
+	Json::FastWriter writer;
+	std::string contents = writer.write(root);
+	
+	// write to temporary file and rename so index is never half written
+	std::string tmpPath = indexFilePath_ + ".tmp";
+	std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	out.write(contents.data(), contents.size());
+	out.close();
+	
+	if (!out.good() || rename(tmpPath.c_str(), indexFilePath_.c_str()) != 0) {
+		spreed_me_log("Couldn't save file content index to %s", indexFilePath_.c_str());
+		remove(tmpPath.c_str());
+	}
+}
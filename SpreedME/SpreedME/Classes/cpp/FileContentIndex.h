@@ -0,0 +1,128 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__FileContentIndex__
+#define __SpreedME__FileContentIndex__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <webrtc/base/basictypes.h>
+#include <system_wrappers/interface/critical_section_wrapper.h>
+
+namespace spreedme {
+
+/*
+ Content hash of a file is SHA-256 over chunk size (uint32 LE, 0 for files of one chunk) followed by root of MerkleTree of its chunks.
+ It can be computed chunk by chunk in any order while file is being read or downloaded,
+ so we never need an extra pass over the file, and every chunk can be checked against it
+ with a Merkle proof. Files chunked differently have different hashes,
+ which only means we miss deduplication for them.
+ */
+class FileContentHasher
+{
+public:
+	FileContentHasher(uint32 chunkSize, uint32 chunks);
+	
+	void AddChunk(uint32 chunkNumber, const char *data, uint32 size); // Chunks added twice are ignored
+	bool IsComplete() const {return hashedChunks_ == chunkHashes_.size();};
+	std::string ContentHash() const; // Hex string, empty if not all chunks were added
+	const std::vector<std::string> &chunkHashes() const {return chunkHashes_;}; // MerkleTree leaves
+	
+	static std::string ContentHashForMerkleRoot(uint32 chunkSize, uint32 chunks, const std::string &merkleRoot);
+	
+private:
+	uint32 chunkSize_;
+	std::vector<std::string> chunkHashes_; // raw 32 byte leaf hashes, empty for chunks not added yet
+	uint32 hashedChunks_;
+};
+
+
+/*
+ Content addressed index of files we have shared or downloaded. It doesn't own files, it only remembers
+ where a file with a given content lives together with its size and modification time.
+ Entries whose files were changed or removed are dropped when they are looked up.
+ Encrypted downloads (see SegmentedFileCrypto.h) are indexed by content hash of their plaintext
+ and are only ever linked to other encrypted paths, plain files only to plain paths.
+ Index is kept in a small JSON file. Methods are thread safe.
+ */
+class FileContentIndex
+{
+public:
+	explicit FileContentIndex(const std::string &indexFilePath);
+	~FileContentIndex();
+	
+	// Returns path of existing unchanged file with given content or empty string. @fileSize is plaintext size.
+	std::string PathForContentHash(const std::string &contentHash, uint64 fileSize, bool encrypted = false);
+	// Returns content hash of the file if file didn't change since it was added or empty string.
+	// Encrypted files have no content hash of their own, so it is always empty for them.
+	std::string ContentHashForPath(const std::string &filePath);
+	
+	void AddFile(const std::string &filePath, const std::string &contentHash, bool encrypted = false);
+	void RemoveFile(const std::string &filePath);
+	
+	// Chunk hashes (Merkle leaves) of indexed content, so files can be reshared with proofs without hashing them again.
+	// They are kept in separate files next to the index and removed with the last file of that content.
+	void SaveChunkHashes(const std::string &contentHash, const std::vector<std::string> &chunkHashes);
+	bool LoadChunkHashes(const std::string &contentHash, uint32 chunks, std::vector<std::string> *chunkHashes);
+	
+	// Makes file with @contentHash available at @dstPath without copying data: hard links it
+	// and copies only if hard link isn't possible. Returns false if we don't have such file.
+	bool LinkContentToPath(const std::string &contentHash, uint64 fileSize, const std::string &dstPath, bool encrypted = false);
+	
+private:
+	struct Entry
+	{
+		Entry() : fileSize(0), modificationTime(0), encrypted(false) {};
+		
+		std::string contentHash;
+		uint64 fileSize; // size on disk
+		int64 modificationTime;
+		bool encrypted;
+	};
+	
+	typedef std::map<std::string, Entry> PathToEntryMap;
+	
+	FileContentIndex(const FileContentIndex &);
+	FileContentIndex &operator=(const FileContentIndex &);
+	
+	static bool StatFile(const std::string &filePath, uint64 *fileSize, int64 *modificationTime);
+	bool EntryIsValid_l(const std::string &filePath, const Entry &entry);
+	static bool EntryHasContentSize(const std::string &filePath, const Entry &entry, uint64 contentSize);
+	std::string PathForContentHash_l(const std::string &contentHash, uint64 fileSize, bool encrypted);
+	bool RemoveFile_l(const std::string &filePath);
+	void RemoveChunkHashesIfUnused_l(const std::string &contentHash);
+	std::string ChunkHashesFilePath(const std::string &contentHash);
+	
+	void Load_l();
+	void Save_l();
+	
+	webrtc::CriticalSectionWrapper *critSect_;
+	std::string indexFilePath_;
+	PathToEntryMap entries_;
+	std::multimap<std::string, std::string> contentHashToPaths_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__FileContentIndex__) */
@@ -186,6 +186,18 @@ bool DownloadFileInfo::AreAllDownloadersFree()
 };
 
 
+void DownloadFileInfo::RemoveDownloader(const UniqueDownloadDataChannelId &dataChannelId)
+{
+	FreeDownloadersMap::iterator it = freeDownloaders_.find(dataChannelId);
+	if (it != freeDownloaders_.end()) {
+		if (it->second.isCurrentlyDownloading && this->ChunkStatus(it->second.chunkNumber) != kChunkDownloaded) {
+			chunksToDownload_.push(it->second.chunkNumber);
+		}
+		freeDownloaders_.erase(it);
+	}
+};
+
+
 void DownloadFileInfo::AddDownloadStatusPair(const UniqueDownloadDataChannelId &dataChannelId, const DownloadStatusPair &pair)
 {
 	FreeDownloadersMap::iterator it = freeDownloaders_.find(dataChannelId);
@@ -24,6 +24,7 @@
 #define __SpreedME__FileDownloadInfo__
 
 #include <iostream>
+#include <queue>
 
 #include <webrtc/base/basictypes.h>
 
@@ -73,6 +74,7 @@ public:
 	void AddDownloadStatusPair(const UniqueDownloadDataChannelId &dataChannelId, const DownloadStatusPair &pair); // If pair exist changes its contents to given argument, if not inserts new
 	void SetDownloadStatusPair(const UniqueDownloadDataChannelId &dataChannelId, const DownloadStatusPair &pair); // if pair doesn't exist does nothing
 	DownloadStatusPair GetDownloadStatusPair(const UniqueDownloadDataChannelId &dataChannelId);
+	void RemoveDownloader(const UniqueDownloadDataChannelId &dataChannelId); // Chunk which was being downloaded by removed downloader is requested again
 	
 	FreeDownloadersMap freeDownloaders_;
 	
@@ -24,10 +24,16 @@
 
 #include <stdexcept>
 
+#include <webrtc/base/timeutils.h>
+
+#include "cpp_utils.h"
 #include "crc32.h"
 
 using namespace spreedme;
 
+const uint32 kFileChunkSizeEstimate = 60000; // Chunk size of our uploaders, used until we receive the first chunk
+const int kDownloadProgressUpdateIntervalMs = 250;
+
 // '_c' - callbacks; '_s' - signallingThread; '_w' - workerThread
 enum {
 	MSG_FD_START_FILE_DOWNLOAD_s = 0,
@@ -40,7 +46,10 @@ enum {
 	MSG_FD_RESUME_DOWNLOADING_FILE_s,
 	MSG_FD_DOWNLOAD_FINISHED_c,
 	MSG_FD_DOWNLOAD_CANCELED_c,
-	MSG_FD_CLEANED_UP_c
+	MSG_FD_CLEANED_UP_c,
+	MSG_FD_DROP_PEER_s,
+	MSG_FD_DOWNLOAD_FAILED_c,
+	MSG_FD_FLUSH_DOWNLOAD_PROGRESS_s
 };
 
 
@@ -53,9 +62,17 @@ FileDownloader::FileDownloader(PeerConnectionWrapperFactory *peerConnectionWrapp
 	FileTransfererBase(peerConnectionWrapperFactory, signallingHandler, workerQueue, callbacksMessageQueue),
 	delegate_(NULL),
 	downloadFileInfo_(NULL),
+	encryptedFileWriter_(NULL),
+	contentIndex_(NULL),
+	contentHasher_(NULL),
+	bandwidthBucket_(NULL),
+	bytesDownloaded_(0),
+	lastProgressUpdateTime_(0),
+	progressFlushScheduled_(false),
 	isDownloadStarted_(false),
 	firstChunkDownloaded_(false),
-	downloadingFirstChunk_(false)
+	downloadingFirstChunk_(false),
+	usesTempFile_(false)
 {
 }
 
@@ -66,15 +83,25 @@ FileDownloader::~FileDownloader()
 		delete downloadFileInfo_;
 	}
 	
+	delete encryptedFileWriter_;
+	delete contentHasher_;
+	
 	this->EraseAllWrappers();
 	
-	if (tmpFilePath_ != filePath_) {
+	if (usesTempFile_ && tmpFilePath_ != filePath_) {
 		remove(tmpFilePath_.c_str());
 	}
 }
 
 
 void FileDownloader::DownloadFileForToken(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath)
+{
+	this->PrepareDownloadForToken(fileInfo, fileLocation, userIds, tempFilePath);
+	this->StartFileDownload();
+}
+
+
+void FileDownloader::PrepareDownloadForToken(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath)
 {
 	critSect_->Enter();
 	
@@ -85,12 +112,19 @@ void FileDownloader::DownloadFileForToken(const FileInfo &fileInfo, const std::s
 	fileInfo_ = fileInfo;
 	filePath_ = std::string(fileLocation + fileInfo_.fileName);
 	
-	if (tempFilePath.length() > 0) {
+	usesTempFile_ = (tempFilePath.length() > 0);
+	if (usesTempFile_) {
 		tmpFilePath_ = tempFilePath;
 	} else {
 		tmpFilePath_ = filePath_;
 	}
 	
+	// filePath_ stays plain until download ends, see FreeFilePath()
+	if (!encryptionKey_.empty()) {
+		tmpFilePath_ += kEncryptedDownloadFileSuffix;
+		encryptedFileWriter_ = new SegmentedFileWriter();
+	}
+	
 	/* 
 	 All chunks are the same size (except the last one, which can be smaller)
 	 so we will setup chunk size as the size of first received packet. 
@@ -99,8 +133,6 @@ void FileDownloader::DownloadFileForToken(const FileInfo &fileInfo, const std::s
 	fileInfo_.chunkSize = 0;
 	
 	critSect_->Leave();
-	
-	this->StartFileDownload();
 }
 
 
@@ -140,7 +172,17 @@ void FileDownloader::ResumeFileTransfer()
 
 void FileDownloader::StartFileDownload_s(int maxSimultaneousPeers, int maxSimultaneousConnectionsPerPeer)
 {
-	fileHandle_.open(tmpFilePath_.c_str(), std::ios::out | std::ios::binary);
+	if (this->UseExistingContent(fileInfo_.contentHash)) {
+		spreed_me_log("We already have file with content %s at %s, not downloading it.", fileInfo_.contentHash.c_str(), filePath_.c_str());
+		tmpFilePath_ = filePath_; // nothing temporary was created
+		callbacksMessageQueue_->Post(this, MSG_FD_DOWNLOAD_FINISHED_c);
+		return;
+	}
+	
+	// Encrypted file is opened when we receive the first chunk and know segment size
+	if (!encryptedFileWriter_) {
+		fileHandle_.open(tmpFilePath_.c_str(), std::ios::out | std::ios::binary);
+	}
 	
 	critSect_->Enter();
 	
@@ -169,25 +211,83 @@ void FileDownloader::StartFileDownload_s(int maxSimultaneousPeers, int maxSimult
 	int i = 0;
 	for (std::set<std::string>::iterator it = userIds_.begin(); it != userIds_.end() && i < maxSimultaneousPeers_; ++it) {
 		++i;
-		std::string userId = *it;
-		
-		for (int j = 0; j < maxSimultaneousConnectionsPerPeer_; j++) {
-			rtc::scoped_refptr<PeerConnectionWrapper> wrapper = this->CreatePeerConnectionWrapper(userId);
-			if (wrapper) {
-				wrapper->SetCustomIdentifier(this->WrapperIdForIdTokenUserId(wrapper->factoryId(), fileInfo_.token, userId));
-				this->InsertWrapperForUserIdAndWrapperId(userId, wrapper->customIdentifier(), wrapper);
-				
-				downloadFileInfo_->freeDownloaders_.insert(std::pair<UniqueDownloadDataChannelId, DownloadStatusPair>
-														   (UniqueDownloadDataChannelId(wrapper->factoryId(),kDefaultDataChannelLabel),
-															DownloadStatusPair()));
-				
-				wrapper->CreateOffer(userId);
-			}
+		this->ConnectToUser_s(*it);
+	}
+}
+
+
+void FileDownloader::ConnectToUser_s(const std::string &userId)
+{
+	for (int j = 0; j < maxSimultaneousConnectionsPerPeer_; j++) {
+		rtc::scoped_refptr<PeerConnectionWrapper> wrapper = this->CreatePeerConnectionWrapper(userId);
+		if (wrapper) {
+			wrapper->SetCustomIdentifier(this->WrapperIdForIdTokenUserId(wrapper->factoryId(), fileInfo_.token, userId));
+			this->InsertWrapperForUserIdAndWrapperId(userId, wrapper->customIdentifier(), wrapper);
+			
+			critSect_->Enter();
+			downloadFileInfo_->freeDownloaders_.insert(std::pair<UniqueDownloadDataChannelId, DownloadStatusPair>
+													   (UniqueDownloadDataChannelId(wrapper->factoryId(),kDefaultDataChannelLabel),
+														DownloadStatusPair()));
+			critSect_->Leave();
+			
+			wrapper->CreateOffer(userId);
 		}
 	}
 }
 
 
+void FileDownloader::DropPeer(const std::string &userId)
+{
+	// This has to be async, we are usually called from inside data channel callback and can't close wrappers there.
+	workerQueue_->Post(this, MSG_FD_DROP_PEER_s, new rtc::TypedMessageData<std::string>(userId));
+}
+
+
+void FileDownloader::DropPeer_s(const std::string &userId)
+{
+	if (!downloadFileInfo_ || userIds_.find(userId) == userIds_.end()) {
+		return;
+	}
+	
+	spreed_me_log("Dropping peer %s from download of %s", userId.c_str(), fileInfo_.token.c_str());
+	
+	userIds_.erase(userId);
+	
+	bool hasConnectionsToOtherUsers = false;
+	for (WrapperIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end();) {
+		rtc::scoped_refptr<PeerConnectionWrapper> wrapper = it->second;
+		if (wrapper->userId() == userId) {
+			critSect_->Enter();
+			downloadFileInfo_->RemoveDownloader(UniqueDownloadDataChannelId(wrapper->factoryId(), kDefaultDataChannelLabel));
+			this->EraseChunkProofsFromWrapper_l(wrapper->factoryId()); // we will request these chunks again from other peers
+			critSect_->Leave();
+			wrapper->Close();
+			activeConnections_.erase(it++);
+		} else {
+			hasConnectionsToOtherUsers = true;
+			++it;
+		}
+	}
+	
+	critSect_->Enter();
+	if (downloadFileInfo_->ChunkStatus(0) != kChunkDownloaded) {
+		downloadingFirstChunk_ = false;
+	}
+	critSect_->Leave();
+	
+	if (hasConnectionsToOtherUsers) {
+		this->RequestNextChunk();
+	} else if (!userIds_.empty()) {
+		this->ConnectToUser_s(*userIds_.begin());
+	} else {
+		spreed_me_log("No peers left to download %s from.", fileInfo_.token.c_str());
+		signallingHandler_->UnRegisterMessageReceiver(this);
+		workerQueue_->Clear(this);
+		callbacksMessageQueue_->Post(this, MSG_FD_DOWNLOAD_FAILED_c);
+	}
+}
+
+
 void FileDownloader::StopFileTransfer_s()
 {
 	signallingHandler_->UnRegisterMessageReceiver(this);
@@ -231,29 +331,25 @@ void FileDownloader::OnMessage(rtc::Message* msg)
 		
 		case MSG_FD_UPDATE_DOWNLOAD_PROGRESS_c: {
 			if (delegate_) {
+				uint32 now = rtc::Time();
 				critSect_->Enter();
-#warning CHECK if here type conversion happens correctly
-				FileInfo tempInfo = this->fileInfo();
-				bool lastChunkDownloaded = downloadFileInfo_->ChunkStatus(tempInfo.chunks - 1) == kChunkDownloaded;
-				uint64 downloadProgress = 0;
-				if (lastChunkDownloaded) {
-					uint32 lastChunkSize = tempInfo.fileSize % tempInfo.chunks;
-					if (lastChunkSize == 0) {
-						lastChunkSize = tempInfo.chunkSize;
-					}
-					downloadProgress = (downloadFileInfo_->downloadedChunksCount() - 1) * tempInfo.chunkSize + lastChunkSize;
-				} else {
-					downloadProgress = downloadFileInfo_->downloadedChunksCount() * tempInfo.chunkSize;
-				}
+				uint64 bytesDownloaded = bytesDownloaded_;
+				uint64 bytesLeft = fileInfo_.fileSize > bytesDownloaded_ ? fileInfo_.fileSize - bytesDownloaded_ : 0;
+				double bytesPerSecond = rateEstimator_.BytesPerSecond(now);
+				double estimatedFinishTimeInterval = rateEstimator_.EstimatedSecondsLeft(bytesLeft, now);
 				critSect_->Leave();
 				
-				delegate_->DownloadProgressHasChanged(this, downloadProgress);
+				delegate_->DownloadProgressHasChanged(this, bytesDownloaded, bytesPerSecond, estimatedFinishTimeInterval);
 			}
 			break;
 		}
+		case MSG_FD_FLUSH_DOWNLOAD_PROGRESS_s: {
+			this->FlushDownloadProgress_s();
+			break;
+		}
 		case MSG_FD_RECEIVED_MESSAGE_s: {
-			SignallingMessageData *param = static_cast<SignallingMessageData*>(msg->pdata);
-			this->MessageReceived_s(param->msg, param->transportType, param->wrapperId, param->token);
+			JsonSignallingMessageData *param = static_cast<JsonSignallingMessageData*>(msg->pdata);
+			this->MessageReceived_s(param->root, param->transportType, param->wrapperId, param->token);
 			delete param;
 			break;
 		}
@@ -288,6 +384,18 @@ void FileDownloader::OnMessage(rtc::Message* msg)
 			}
 			break;
 		}
+		case MSG_FD_DROP_PEER_s: {
+			rtc::TypedMessageData<std::string> *param = static_cast<rtc::TypedMessageData<std::string> *>(msg->pdata);
+			this->DropPeer_s(param->data());
+			delete param;
+			break;
+		}
+		case MSG_FD_DOWNLOAD_FAILED_c: {
+			if (delegate_) {
+				delegate_->DownloadHasFailed(this);
+			}
+			break;
+		}
 		
 		default:
 		break;
@@ -333,6 +441,17 @@ void FileDownloader::RequestNextChunk_s()
 		if (isDownloadStarted_ == true && wrapper) {
 			
 			if (downloadFileInfo_->HasChunksToDownload()) {
+				critSect_->Enter();
+				TokenBucket *bucket = bandwidthBucket_;
+				uint32 expectedChunkSize = fileInfo_.chunkSize > 0 ? fileInfo_.chunkSize : kFileChunkSizeEstimate;
+				critSect_->Leave();
+				
+				uint32 delay = bucket ? bucket->DelayForBytes(expectedChunkSize) : 0;
+				if (delay > 0) {
+					this->RequestNextChunkDelayed(delay);
+					return;
+				}
+				
 				if (firstChunkDownloaded_) {
 					uint32 nextChunkNumber = downloadFileInfo_->GetNextChunkNumberToDownload();
 					if (nextChunkNumber != UINT32_MAX) {
@@ -362,11 +481,26 @@ void FileDownloader::RequestNextChunk_s()
 
 void FileDownloader::RequestChunkNumber(int chunkNumber, PeerConnectionWrapper *wrapper, const std::string &dataChannelName)
 {
+	critSect_->Enter();
+	if (bandwidthBucket_) {
+		bandwidthBucket_->TakeBytes(fileInfo_.chunkSize > 0 ? fileInfo_.chunkSize : kFileChunkSizeEstimate);
+	}
+	critSect_->Leave();
+	
+	critSect_->Enter();
+	bool wantsProof = !this->ContentHashForWrapper_l(wrapper->factoryId()).empty();
+	requestedChunks_[ChunkProofKey(UniqueDownloadDataChannelId(wrapper->factoryId(), dataChannelName), chunkNumber)] = wantsProof;
+	critSect_->Leave();
+	
 	Json::Value chunkRequestJson;
 	chunkRequestJson[kDataChannelChunkRequestModeKey] = kDataChannelChunkRequestModeRequestKey;
 	chunkRequestJson[kDataChannelChunkSequenceNumberKey] = chunkNumber;
+	if (wantsProof) {
+		chunkRequestJson[kDataChannelChunkWantsProofKey] = true;
+	}
 	
-	std::string msg = chunkRequestJson.toStyledString();
+	Json::FastWriter writer;
+	std::string msg = writer.write(chunkRequestJson);
 	spreed_me_log("Asking for chunk %d with message %s", chunkNumber, msg.c_str());
 	
 	FreeDownloadersMap::iterator mappingIt = downloadFileInfo_->freeDownloaders_.find(UniqueDownloadDataChannelId(wrapper->factoryId(), dataChannelName));
@@ -381,45 +515,299 @@ void FileDownloader::RequestChunkNumber(int chunkNumber, PeerConnectionWrapper *
 }
 
 
+// Callbacks queue can't cancel delayed messages and we can be deleted right after we finish,
+// so late updates are delayed in worker queue which we clear, and only then posted to callbacks.
 void FileDownloader::UpdateDownloadProgress()
 {
+	uint32 now = rtc::Time();
+	
+	critSect_->Enter();
+	int sinceLastUpdate = rtc::TimeDiff(now, lastProgressUpdateTime_);
+	bool postNow = sinceLastUpdate >= kDownloadProgressUpdateIntervalMs;
+	bool scheduleFlush = !postNow && !progressFlushScheduled_;
+	if (postNow) {
+		lastProgressUpdateTime_ = now;
+	} else if (scheduleFlush) {
+		progressFlushScheduled_ = true;
+	}
+	critSect_->Leave();
+	
+	if (postNow) {
+		callbacksMessageQueue_->Post(this, MSG_FD_UPDATE_DOWNLOAD_PROGRESS_c);
+	} else if (scheduleFlush) {
+		workerQueue_->PostDelayed(kDownloadProgressUpdateIntervalMs - sinceLastUpdate, this, MSG_FD_FLUSH_DOWNLOAD_PROGRESS_s);
+	}
+}
+
+
+void FileDownloader::FlushDownloadProgress_s()
+{
+	critSect_->Enter();
+	progressFlushScheduled_ = false;
+	lastProgressUpdateTime_ = rtc::Time();
+	critSect_->Leave();
+	
 	callbacksMessageQueue_->Post(this, MSG_FD_UPDATE_DOWNLOAD_PROGRESS_c);
 }
 
 
 void FileDownloader::FileHasBeenDownloaded()
 {
+	workerQueue_->Clear(this, MSG_FD_FLUSH_DOWNLOAD_PROGRESS_s);
+	
 	if (fileHandle_.is_open()) {
 		fileHandle_.close();
 	}
 	
+	if (encryptedFileWriter_) {
+		encryptedFileWriter_->Close();
+	}
+	
 	this->EraseAllWrappers();
 	
-	if (tmpFilePath_ != filePath_) {
+	bool encrypted = (encryptedFileWriter_ != NULL);
+	
+	critSect_->Enter();
+	std::string contentHash = contentHasher_ ? contentHasher_->ContentHash() : std::string();
+	critSect_->Leave();
+	
+	if (!contentHash.empty() && !fileInfo_.contentHash.empty() && contentHash != fileInfo_.contentHash) {
+		spreed_me_log("Content hash of downloaded file %s differs from announced %s", contentHash.c_str(), fileInfo_.contentHash.c_str());
+	}
+	
+	// Same content could have been downloaded under another token meanwhile, don't keep the second copy.
+	if (usesTempFile_ && this->UseExistingContent(contentHash)) {
+		remove(tmpFilePath_.c_str());
+		tmpFilePath_ = filePath_;
+		callbacksMessageQueue_->Post(this, MSG_FD_DOWNLOAD_FINISHED_c);
+		return;
+	}
+	
+	if (usesTempFile_) {
+		std::string freeFilePath = this->FreeFilePath();
+		bool success = moveFile(tmpFilePath_.c_str(), freeFilePath.c_str());
+		if (!success) {
+			spreed_me_log("File couldn't be moved from '%s' to '%s'!", tmpFilePath_.c_str(), freeFilePath.c_str());
+			assert(false);
+		}
+		filePath_ = freeFilePath;
+	} else {
+		filePath_ = tmpFilePath_; // encrypted file has got its suffix
+	}
+	tmpFilePath_ = filePath_;
+	
+	if (contentIndex_ && !contentHash.empty()) {
+		contentIndex_->AddFile(filePath_, contentHash, encrypted);
+		critSect_->Enter();
+		std::vector<std::string> chunkHashes = contentHasher_->chunkHashes();
+		critSect_->Leave();
+		contentIndex_->SaveChunkHashes(contentHash, chunkHashes); // so we can serve proofs if we share this file further
+	}
+	
+	callbacksMessageQueue_->Post(this, MSG_FD_DOWNLOAD_FINISHED_c);
+}
+
 
-		char *suggestedFileLocation = NULL;
-		makeFileNameSuggestion(filePath_.c_str(), &suggestedFileLocation);
-		if (suggestedFileLocation) {
-			bool success = moveFile(tmpFilePath_.c_str(), suggestedFileLocation);
-			if (!success) {
-				spreed_me_log("File couldn't be moved from '%s' to '%s'!", tmpFilePath_.c_str(), filePath_.c_str());
-				assert(false);
+// Checks chunk against merkle root announced as content hash. Files from peers which don't announce it are checked with crc only.
+bool FileDownloader::VerifyChunk(const UniqueDownloadDataChannelId &dataChannelId, uint32 chunkNumber, const char *buf, uint32 size)
+{
+	ChunkProofKey key(dataChannelId, chunkNumber);
+	
+	critSect_->Enter();
+	std::string contentHash = this->ContentHashForWrapper_l(dataChannelId.first);
+	uint32 chunkSize = fileInfo_.chunkSize;
+	uint32 chunks = fileInfo_.chunks;
+	std::vector<std::string> proof;
+	bool hasProof = false;
+	std::map<ChunkProofKey, std::vector<std::string> >::iterator it = chunkProofs_.find(key);
+	if (it != chunkProofs_.end()) {
+		proof.swap(it->second);
+		chunkProofs_.erase(it);
+		hasProof = true;
+	}
+	bool requestedWithoutProof = false;
+	std::map<ChunkProofKey, bool>::iterator requestIt = requestedChunks_.find(key);
+	if (requestIt != requestedChunks_.end()) {
+		requestedWithoutProof = !requestIt->second;
+		requestedChunks_.erase(requestIt);
+	}
+	critSect_->Leave();
+	
+	if (contentHash.empty()) {
+		return true;
+	}
+	
+	if (!hasProof && requestedWithoutProof) {
+		return true; // we learned content hash from this peer after requesting chunk, crc check is all we can do
+	}
+	
+	if (!hasProof) {
+		spreed_me_log("No proof received for chunk %u", chunkNumber);
+		return false;
+	}
+	
+	std::string root = MerkleTree::RootFromProof(chunkNumber, chunks, MerkleTree::LeafHash(buf, size), proof);
+	if (root.empty()) {
+		spreed_me_log("Malformed proof for chunk %u", chunkNumber);
+		return false;
+	}
+	
+	return FileContentHasher::ContentHashForMerkleRoot(chunkSize, chunks, root) == contentHash;
+}
+
+
+bool FileDownloader::HandleChunkProof(const UniqueDownloadDataChannelId &dataChannelId, const Json::Value &proofJson)
+{
+	if (proofJson.get(kDataChannelChunkRequestModeKey, Json::Value()).asString() != kDataChannelChunkRequestModeProofKey) {
+		return false;
+	}
+	
+	uint32 chunkNumber = proofJson.get(kDataChannelChunkSequenceNumberKey, Json::Value(UINT32_MAX)).asUInt();
+	const Json::Value &hashes = proofJson[kDataChannelChunkProofHashesKey];
+	
+	std::vector<std::string> proof;
+	if (hashes.isArray()) {
+		for (Json::ArrayIndex i = 0; i < hashes.size(); ++i) {
+			std::string hash;
+			if (!hex_decode(hashes[i].asString(), &hash)) {
+				proof.clear();
+				break;
 			}
-			filePath_ = std::string(suggestedFileLocation);
-			free(suggestedFileLocation);
+			proof.push_back(hash);
+		}
+	}
+	
+	// Malformed proof is stored as empty and fails verification when chunk arrives
+	critSect_->Enter();
+	chunkProofs_[ChunkProofKey(dataChannelId, chunkNumber)] = proof;
+	critSect_->Leave();
+	
+	return true;
+}
+
+
+bool FileDownloader::HandleContentHash(const std::string &wrapperFactoryId, const Json::Value &contentHashJson)
+{
+	if (contentHashJson.get(kDataChannelChunkRequestModeKey, Json::Value()).asString() != kDataChannelChunkRequestModeContentHashKey) {
+		return false;
+	}
+	
+	std::string contentHash = contentHashJson.get(kDataChannelChunkContentHashKey, Json::Value()).asString();
+	
+	critSect_->Enter();
+	if (!fileInfo_.contentHash.empty() && contentHash != fileInfo_.contentHash) {
+		spreed_me_log("Peer sent content hash %s which differs from announced %s", contentHash.c_str(), fileInfo_.contentHash.c_str());
+	}
+	if (!contentHash.empty()) {
+		peerContentHashes_[wrapperFactoryId] = contentHash;
+	}
+	critSect_->Leave();
+	
+	return true;
+}
+
+
+// Should be called under critSect_. Announced content hash wins over the one peer has sent later.
+std::string FileDownloader::ContentHashForWrapper_l(const std::string &wrapperFactoryId)
+{
+	if (!fileInfo_.contentHash.empty()) {
+		return fileInfo_.contentHash;
+	}
+	
+	std::map<std::string, std::string>::iterator it = peerContentHashes_.find(wrapperFactoryId);
+	return it != peerContentHashes_.end() ? it->second : std::string();
+}
+
+
+// Should be called under critSect_
+void FileDownloader::EraseChunkProofsFromWrapper_l(const std::string &wrapperFactoryId)
+{
+	for (std::map<ChunkProofKey, std::vector<std::string> >::iterator it = chunkProofs_.begin(); it != chunkProofs_.end();) {
+		if (it->first.first.first == wrapperFactoryId) {
+			chunkProofs_.erase(it++);
 		} else {
-			spreed_me_log("Something went wrong with file names. TempFilePath %s filePath %s", tmpFilePath_.c_str(), filePath_.c_str());
-			assert(false);
+			++it;
 		}
 	}
+	for (std::map<ChunkProofKey, bool>::iterator it = requestedChunks_.begin(); it != requestedChunks_.end();) {
+		if (it->first.first.first == wrapperFactoryId) {
+			requestedChunks_.erase(it++);
+		} else {
+			++it;
+		}
+	}
+	peerContentHashes_.erase(wrapperFactoryId);
+}
+
+
+// If we have file with this content we hard link (or copy) it into our download location.
+// We never point to the existing file itself since it belongs to another download and can be removed with it.
+// Encrypted downloads are linked only to encrypted files, they are encrypted with the same downloads key.
+bool FileDownloader::UseExistingContent(const std::string &contentHash)
+{
+	if (!contentIndex_ || contentHash.empty()) {
+		return false;
+	}
 	
-	callbacksMessageQueue_->Post(this, MSG_FD_DOWNLOAD_FINISHED_c);
+	std::string linkPath = this->FreeFilePath();
+	if (!contentIndex_->LinkContentToPath(contentHash, fileInfo_.fileSize, linkPath, encryptedFileWriter_ != NULL)) {
+		return false;
+	}
+	
+	filePath_ = linkPath;
+	return true;
 }
 
 
-void FileDownloader::MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+// Picks a name which isn't taken yet for the downloaded file, like makeFileNameSuggestion does. Number goes before
+// extension of the plain name and encrypted file suffix after it, so the second 'report.pdf' becomes
+// 'report_(1).pdf.smse' and keeps its extension when suffix is dropped for viewing.
+std::string FileDownloader::FreeFilePath()
 {
-	SignallingMessageData *msgData = new SignallingMessageData(msg, transportType, wrapperId, token);
+	std::string suffix = encryptedFileWriter_ ? kEncryptedDownloadFileSuffix : "";
+	
+	size_t slash = filePath_.rfind('/');
+	size_t dot = filePath_.rfind('.');
+	bool hasExtension = (dot != std::string::npos && (slash == std::string::npos || dot > slash + 1));
+	std::string nameWithoutExtension = hasExtension ? filePath_.substr(0, dot) : filePath_;
+	std::string extension = hasExtension ? filePath_.substr(dot) : std::string();
+	
+	std::string path = filePath_ + suffix;
+	for (int fileIndex = 1; checkIfFileExists(path.c_str()); ++fileIndex) {
+		char number[16];
+		snprintf(number, sizeof(number), "_(%d)", fileIndex);
+		path = nameWithoutExtension + number + extension + suffix;
+	}
+	
+	return path;
+}
+
+
+bool FileDownloader::WriteChunk(uint32 chunkNumber, const char *buf, uint32 size)
+{
+	if (encryptedFileWriter_) {
+		// All chunks except the last one have fileInfo_.chunkSize, so chunk number is also segment number.
+		if (!encryptedFileWriter_->isOpen() &&
+			!encryptedFileWriter_->Open(tmpFilePath_, encryptionKey_, fileInfo_.chunkSize)) {
+			return false;
+		}
+		return encryptedFileWriter_->WriteSegment(chunkNumber, buf, size, chunkNumber == fileInfo_.chunks - 1);
+	}
+	
+	if (fileHandle_.is_open()) {
+		fileHandle_.seekp((uint64)chunkNumber * fileInfo_.chunkSize);
+		fileHandle_.write(buf, size);
+		return true;
+	}
+	
+	spreed_me_log("file handle is not opened!");
+	return false;
+}
+
+
+void FileDownloader::MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+{
+	JsonSignallingMessageData *msgData = new JsonSignallingMessageData(root, transportType, wrapperId, token);
 	workerQueue_->Post(this, MSG_FD_RECEIVED_MESSAGE_s, msgData);
 }
 
@@ -564,14 +952,30 @@ void FileDownloader::ReceivedDataChannelData(webrtc::DataBuffer *buffer,
 		
 		uint32 calcCrc32 = crc32buf(buf, size);
 		
+		if (calcCrc32 == crc32 && !this->VerifyChunk(UniqueDownloadDataChannelId(wrapper->factoryId(), data_channel->label()), chunkSequenceNumber, buf, size)) {
+			spreed_me_log("Chunk %u doesn't match content hash. Peer %s sends bad data.", chunkSequenceNumber, wrapper->userId().c_str());
+			this->DropPeer(wrapper->userId());
+			delete buffer;
+			return;
+		}
+		
 		if (calcCrc32 == crc32) {
-			if (fileHandle_.is_open()) {
-				
-				fileHandle_.seekp(chunkSequenceNumber * fileInfo_.chunkSize);
-				fileHandle_.write(buf, size);
+			// Content hash is of plaintext, so chunk is hashed before it is written, encrypted or not
+			critSect_->Enter();
+			if (!contentHasher_) {
+				contentHasher_ = new FileContentHasher(fileInfo_.chunkSize, fileInfo_.chunks);
+			}
+			contentHasher_->AddChunk(chunkSequenceNumber, buf, size);
+			critSect_->Leave();
+			
+			if (this->WriteChunk(chunkSequenceNumber, buf, size)) {
 				
 				//TODO: Check if there is no race conditions here in chunk status setting
 				critSect_->Enter();
+				if (downloadFileInfo_->ChunkStatus(chunkSequenceNumber) != kChunkDownloaded) {
+					bytesDownloaded_ += size;
+					rateEstimator_.AddBytes(size, rtc::Time());
+				}
 				downloadFileInfo_->SetChunkStatus(chunkSequenceNumber, kChunkDownloaded);
 				if (chunkSequenceNumber == 0) {
 					firstChunkDownloaded_ = true;
@@ -585,7 +989,7 @@ void FileDownloader::ReceivedDataChannelData(webrtc::DataBuffer *buffer,
 				//This should be asynchronous
 				this->RequestNextChunk();
 			} else {
-				spreed_me_log("file handle is not opened!");
+				spreed_me_log("Couldn't write chunk %u!", chunkSequenceNumber);
 			}
 		} else {
 			spreed_me_log("Crc checksum doesn't match! Given %lu calculated %lu", crc32, calcCrc32);
@@ -598,7 +1002,15 @@ void FileDownloader::ReceivedDataChannelData(webrtc::DataBuffer *buffer,
 		
 		delete buffer;
 	} else {
-		signallingHandler_->ReceivedDataChannelData(buffer, data_channel, wrapper);
+		Json::Reader reader;
+		Json::Value jsonMsg;
+		if (reader.parse(std::string(buffer->data.data(), buffer->data.length()), jsonMsg) &&
+			(this->HandleChunkProof(UniqueDownloadDataChannelId(wrapper->factoryId(), data_channel->label()), jsonMsg) ||
+			 this->HandleContentHash(wrapper->factoryId(), jsonMsg))) {
+			delete buffer;
+		} else {
+			signallingHandler_->ReceivedDataChannelData(buffer, data_channel, wrapper);
+		}
 	}
 }
 /*--------------------End PeerConnectionWrapperDelegateInterface---------------------------------*/
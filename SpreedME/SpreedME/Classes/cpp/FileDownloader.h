@@ -25,18 +25,28 @@
 
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <vector>
 
 #include "FileTransfererBase.h"
+#include "FileContentIndex.h"
 #include "FileDownloadInfo.h"
+#include "MerkleTree.h"
+#include "SegmentedFileCrypto.h"
+#include "TransferRateEstimator.h"
+#include "TransferScheduler.h"
 
 namespace spreedme {
 		
+const char kEncryptedDownloadFileSuffix[] = ".smse";
+	
 class FileDownloader;
 	
 class FileDownloaderDelegateInterface {
 public:
 	virtual void DownloadHasBeenFinished(FileDownloader *fileDownloader, const std::string &filePath) = 0;
-	virtual void DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded) = 0;
+	// Is called at most every kDownloadProgressUpdateIntervalMs. Rate and time left are negative while unknown.
+	virtual void DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval) = 0;
 	virtual void DownloadHasBeenCanceled(FileDownloader *fileDownloader) = 0; // This signals that download has been canceled, at this point FileDownloader still lives and can have all internal structure.
 	virtual void DownloadHasFailed(FileDownloader *fileDownloader) = 0;
 	virtual void DownloadHasBeenPaused(FileDownloader *fileDownloader) = 0;
@@ -59,6 +69,17 @@ public:
 	
 	// @fileLocation should be a directory where to store the file with write permission, string itself has to have ending '/'.
 	virtual void DownloadFileForToken(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath = "");
+	// Same as DownloadFileForToken but download waits for StartFileDownload(). Used to queue downloads.
+	virtual void PrepareDownloadForToken(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath = "");
+	void StartFileDownload();
+	// If key (32 bytes) is set before download starts the file is stored in segmented encrypted format (see SegmentedFileCrypto.h)
+	// and kEncryptedDownloadFileSuffix is appended to its name. Every received chunk becomes one segment.
+	// Content hash is still checked and indexed, it is the hash of plaintext.
+	virtual void SetEncryptionKey(const std::string &key) {critSect_->Enter(); encryptionKey_ = key; critSect_->Leave();};
+	// If index is set files with content we already have are not downloaded again and downloaded files are added to index.
+	virtual void SetContentIndex(FileContentIndex *contentIndex) {critSect_->Enter(); contentIndex_ = contentIndex; critSect_->Leave();};
+	// Every chunk request takes chunk size bytes from bucket, requests wait when it is empty. NULL means no limit.
+	virtual void SetBandwidthBucket(TokenBucket *bucket) {critSect_->Enter(); bandwidthBucket_ = bucket; critSect_->Leave();};
 	// Now you can only add userIds
 	virtual void UpdateUserIds(std::set<std::string> userIds);
 	
@@ -75,8 +96,10 @@ protected:
 	
 	virtual void OnMessage(rtc::Message* msg);
 	
-	void StartFileDownload();
 	void StartFileDownload_s(int maxSimultaneousPeers, int maxSimultaneousConnectionsPerPeer); //For now it ignores arguments and uses 1 peer and 1 connection per peer.
+	void ConnectToUser_s(const std::string &userId);
+	void DropPeer(const std::string &userId);
+	void DropPeer_s(const std::string &userId); // Closes connections to peer, forgets it and switches to another one. If there is no one else download fails.
 	void StopFileTransfer_s();
 	void PauseFileTransfer_s();
 	void ResumeFileTransfer_s();
@@ -85,7 +108,8 @@ protected:
 	
 	std::string CreateWrapperIdForOutgoingOffer(const std::string &token, const std::string &to);
 
-	void UpdateDownloadProgress();
+	void UpdateDownloadProgress(); // throttled, see kDownloadProgressUpdateIntervalMs
+	void FlushDownloadProgress_s();
 	
 	// Peer connection wrapper delegate interface implementation
 	virtual void IceConnectionStateChanged(webrtc::PeerConnectionInterface::IceConnectionState new_state, PeerConnectionWrapper *spreedPeerConnection) {};
@@ -100,7 +124,7 @@ protected:
 										 webrtc::DataChannelInterface *data_channel,
 										 PeerConnectionWrapper *wrapper);
 	
-	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
 	virtual void ReceivedOffer_s(const Json::Value &offerJson, const std::string &from); // expects inner JSON (without Data :{})
 	virtual void ReceivedAnswer_s(const Json::Value &answerJson, const std::string &from); // expects inner JSON (without Data :{})
 		
@@ -112,6 +136,14 @@ private:
 	void RequestChunkNumber(int chunkNumber, PeerConnectionWrapper *wrapper, const std::string &dataChannelName);
 	rtc::scoped_refptr<PeerConnectionWrapper> GetFreeWrapperForChunkRequest();
 	void FileHasBeenDownloaded();
+	bool WriteChunk(uint32 chunkNumber, const char *buf, uint32 size);
+	bool UseExistingContent(const std::string &contentHash);
+	std::string FreeFilePath();
+	bool VerifyChunk(const UniqueDownloadDataChannelId &dataChannelId, uint32 chunkNumber, const char *buf, uint32 size);
+	bool HandleChunkProof(const UniqueDownloadDataChannelId &dataChannelId, const Json::Value &proofJson);
+	bool HandleContentHash(const std::string &wrapperFactoryId, const Json::Value &contentHashJson);
+	std::string ContentHashForWrapper_l(const std::string &wrapperFactoryId);
+	void EraseChunkProofsFromWrapper_l(const std::string &wrapperFactoryId);
 	
 	// Instance variables ----------------------------------------------------------------------
 	std::set<std::string> tokenPeerConnectionWrapperIds_;
@@ -122,9 +154,30 @@ private:
 	
 	std::string tmpFilePath_;
 	
+	std::string encryptionKey_;
+	SegmentedFileWriter *encryptedFileWriter_; // is created only if we have encryption key
+	
+	FileContentIndex *contentIndex_; // We do not own it!
+	FileContentHasher *contentHasher_; // hashes chunks as they arrive, is created with the first chunk
+	// (data channel, chunk number) -> merkle proof received before the chunk. Proof is only used for the chunk
+	// coming over the same data channel so peers can't replace each other's proofs.
+	typedef std::pair<UniqueDownloadDataChannelId, uint32> ChunkProofKey;
+	std::map<ChunkProofKey, std::vector<std::string> > chunkProofs_;
+	std::map<ChunkProofKey, bool> requestedChunks_; // -> whether proof was asked for, chunks requested before we knew hash come without it
+	// Content hashes sent over data channel by uploaders which announced file before hashing it. wrapper factory id -> hash.
+	// Such hash is only used for chunks from the same peer, so a peer can't make chunks of other peers fail.
+	std::map<std::string, std::string> peerContentHashes_;
+	TokenBucket *bandwidthBucket_; // We do not own it!
+	
+	uint64 bytesDownloaded_;
+	TransferRateEstimator rateEstimator_;
+	uint32 lastProgressUpdateTime_;
+	bool progressFlushScheduled_;
+	
 	bool isDownloadStarted_;
 	bool firstChunkDownloaded_;
 	bool downloadingFirstChunk_;
+	bool usesTempFile_; // otherwise file is written at its final path
 	
 	int maxSimultaneousPeers_;
 	int maxSimultaneousConnectionsPerPeer_;
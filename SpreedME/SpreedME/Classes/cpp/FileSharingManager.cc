@@ -38,18 +38,34 @@ FileSharingManager::FileSharingManager(PeerConnectionWrapperFactory *peerConnect
 	signallingHandler_(signallingHandler),
 	workerQueue_(workerQueue),
 	callbackQueue_(callbackQueue),
-	delegate_(NULL)
+	delegate_(NULL),
+	contentIndex_(NULL),
+	scheduler_(new TransferScheduler())
 {
 }
 
 
 FileSharingManager::~FileSharingManager()
 {
+	this->EraseAllTransferers(); // transferers use scheduler buckets
+	delete scheduler_;
+	delete contentIndex_;
 	delete critSect_;
 }
 
 
-void FileSharingManager::DownloadFile(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath)
+void FileSharingManager::SetContentIndexFilePath(const std::string &indexFilePath)
+{
+	if (contentIndex_) {
+		spreed_me_log("Content index is already created");
+		return;
+	}
+	contentIndex_ = new FileContentIndex(indexFilePath);
+}
+
+
+void FileSharingManager::DownloadFile(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath,
+									  TransferPriority priority)
 {
 	rtc::scoped_refptr<spreedme::FileDownloader> downloader = this->FileDownloaderForToken(fileInfo.token);
 	
@@ -60,9 +76,16 @@ void FileSharingManager::DownloadFile(const FileInfo &fileInfo, const std::strin
 		if (downloader) {
 		
 			downloader->SetDelegate(this);
+			critSect_->Enter();
+			downloader->SetEncryptionKey(downloadEncryptionKey_);
+			critSect_->Leave();
+			downloader->SetContentIndex(contentIndex_);
+			downloader->SetBandwidthBucket(scheduler_->downloadBucket());
 			this->InsertDownloader(fileInfo.token, downloader, activeFileDownloaders_);
 							
-			downloader->DownloadFileForToken(fileInfo, fileLocation, userIds, tempFilePath);
+			downloader->PrepareDownloadForToken(fileInfo, fileLocation, userIds, tempFilePath);
+			scheduler_->AddDownload(fileInfo.token, priority);
+			this->StartScheduledDownloads();
 		}
 	} else {
 		spreed_me_log("We already have downloader for this token (%s)!", fileInfo.token.c_str());
@@ -88,6 +111,8 @@ void FileSharingManager::StopFileDownloadForToken(const std::string &token)
 	if (downloader) {
 		this->MoveDownloader(downloader->fileInfo().token, activeFileDownloaders_, stoppedFileDownloaders_);
 		downloader->StopFileTransfer();
+		scheduler_->RemoveDownload(token);
+		this->StartScheduledDownloads();
 	}
 }
 
@@ -105,6 +130,8 @@ void FileSharingManager::StartSharingFile(const std::string &filePath,
 	if (uploader) {
 
 		uploader->SetDelegate(this);
+		uploader->SetContentIndex(contentIndex_);
+		uploader->SetBandwidthBucket(scheduler_->uploadBucket());
 		this->InsertUploader(token, uploader, activeFileUploaders_);
 		
 		uploader->StartSharingFile(filePath, fileType, fileName, token, shouldDeleteOnFinish);
@@ -112,6 +139,27 @@ void FileSharingManager::StartSharingFile(const std::string &filePath,
 }
 
 
+void FileSharingManager::StartSharingFromChunkSource(FileChunkSource *chunkSource,
+													 const std::string &fileType,
+													 const std::string &fileName,
+													 const std::string &token)
+{
+	rtc::scoped_refptr<spreedme::FileUploader> uploader = this->CreateFileUploader();
+	
+	if (uploader) {
+		
+		uploader->SetDelegate(this);
+		uploader->SetContentIndex(contentIndex_);
+		uploader->SetBandwidthBucket(scheduler_->uploadBucket());
+		this->InsertUploader(token, uploader, activeFileUploaders_);
+		
+		uploader->StartSharingFromChunkSource(chunkSource, fileType, fileName, token);
+	} else {
+		delete chunkSource;
+	}
+}
+
+
 void FileSharingManager::StopSharingFileForToken(const std::string &token)
 {
 	rtc::scoped_refptr<FileUploader> fileUploader = this->FileUploaderForToken(token);
@@ -122,6 +170,46 @@ void FileSharingManager::StopSharingFileForToken(const std::string &token)
 }
 
 
+void FileSharingManager::SetMaxConcurrentDownloads(int maxDownloads, int maxDownloadsDuringCall)
+{
+	scheduler_->SetMaxConcurrentDownloads(maxDownloads, maxDownloadsDuringCall);
+	this->StartScheduledDownloads();
+}
+
+
+void FileSharingManager::SetBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond)
+{
+	scheduler_->SetBandwidthLimits(downloadBytesPerSecond, uploadBytesPerSecond);
+}
+
+
+void FileSharingManager::SetCallBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond)
+{
+	scheduler_->SetCallBandwidthLimits(downloadBytesPerSecond, uploadBytesPerSecond);
+}
+
+
+void FileSharingManager::SetCallIsActive(bool callIsActive)
+{
+	scheduler_->SetCallIsActive(callIsActive);
+	this->StartScheduledDownloads(); // downloads which waited for the call to finish
+}
+
+
+void FileSharingManager::StartScheduledDownloads()
+{
+	std::vector<std::string> tokens = scheduler_->DownloadsToStart();
+	for (std::vector<std::string>::iterator it = tokens.begin(); it != tokens.end(); ++it) {
+		rtc::scoped_refptr<FileDownloader> downloader = this->FileDownloaderForToken(*it);
+		if (downloader) {
+			downloader->StartFileDownload();
+		} else {
+			scheduler_->RemoveDownload(*it);
+		}
+	}
+}
+
+
 std::set<std::string> FileSharingManager::CurrentlyDownloadingFileTokens()
 {
 	std::set<std::string> set;
@@ -169,14 +257,17 @@ void FileSharingManager::DownloadHasBeenFinished(FileDownloader *fileDownloader,
 		delegate_->DownloadHasBeenFinished(fileDownloader->fileInfo().token, filePath);
 	}
 	
-	this->DeleteTransferer(fileDownloader->fileInfo().token);
+	std::string token = fileDownloader->fileInfo().token;
+	this->DeleteTransferer(token);
+	scheduler_->RemoveDownload(token);
+	this->StartScheduledDownloads();
 }
 
 
-void FileSharingManager::DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded)
+void FileSharingManager::DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval)
 {
 	if (delegate_) {
-		delegate_->DownloadProgressHasChanged(fileDownloader->fileInfo().token, bytesDownloaded, 0.0);
+		delegate_->DownloadProgressHasChanged(fileDownloader->fileInfo().token, bytesDownloaded, bytesPerSecond, estimatedFinishTimeInterval);
 	}
 }
 
@@ -191,7 +282,10 @@ void FileSharingManager::DownloadHasBeenCanceled(FileDownloader *fileDownloader)
 
 void FileSharingManager::DownloadHasFailed(FileDownloader *fileDownloader)
 {
-	this->DeleteTransferer(fileDownloader->fileInfo().token);
+	std::string token = fileDownloader->fileInfo().token;
+	this->DeleteTransferer(token);
+	scheduler_->RemoveDownload(token);
+	this->StartScheduledDownloads();
 }
 
 
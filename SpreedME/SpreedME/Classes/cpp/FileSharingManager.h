@@ -31,6 +31,7 @@
 #include "FileDownloader.h"
 #include "FileTransfererBase.h"
 #include "FileUploader.h"
+#include "TransferScheduler.h"
 
 
 namespace spreedme {
@@ -43,7 +44,8 @@ class FileSharingManagerDelegateInterface
 {
 public:
 	virtual void DownloadHasBeenFinished(const std::string &token, const std::string &filePath) = 0;
-	virtual void DownloadProgressHasChanged(const std::string &token, uint64 bytesDownloaded, double estimatedFinishTimeInterval) = 0;
+	// Rate is in bytes per second, finish time interval in seconds, both are negative while unknown.
+	virtual void DownloadProgressHasChanged(const std::string &token, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval) = 0;
 	virtual void DownloadHasBeenCanceled(const std::string &token) = 0;
 	virtual void DownloadHasFailed(const std::string &token) = 0;
 	virtual void DownloadHasBeenPaused(const std::string &token) = 0;
@@ -70,7 +72,13 @@ public:
 	virtual void SetDelegate(FileSharingManagerDelegateInterface *delegate) {delegate_ = delegate;};
 	
 	
-	virtual void DownloadFile(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath = "");
+	// Files downloaded after this call are stored encrypted with given 32 byte key. Empty key turns encryption off.
+	// Creates index of shared and downloaded files used for deduplication. Should be called before any transfer.
+	virtual void SetContentIndexFilePath(const std::string &indexFilePath);
+	virtual void SetDownloadEncryptionKey(const std::string &key) {critSect_->Enter(); downloadEncryptionKey_ = key; critSect_->Leave();};
+	// Download is queued and starts when scheduler lets it, see TransferScheduler.
+	virtual void DownloadFile(const FileInfo &fileInfo, const std::string &fileLocation, const std::set<std::string> &userIds, const std::string &tempFilePath = "",
+							  TransferPriority priority = kTransferPriorityUserInitiated);
 	virtual void PauseFileDownloadForToken(const std::string &token);
 	virtual void ResumeFileDownloadForToken(const std::string &token);
 	virtual void StopFileDownloadForToken(const std::string &token);
@@ -80,9 +88,20 @@ public:
 								  const std::string &fileName,
 								  const std::string &token,
 								  bool shouldDeleteOnFinish = false);
+	// Takes ownership of chunkSource
+	virtual void StartSharingFromChunkSource(FileChunkSource *chunkSource,
+											 const std::string &fileType,
+											 const std::string &fileName,
+											 const std::string &token);
 	virtual void StopSharingFileForToken(const std::string &token);
 	
-	virtual std::set<std::string> CurrentlyDownloadingFileTokens();
+	// Bandwidth limits are in bytes per second, 0 means unlimited. Call limits apply while call is active.
+	virtual void SetMaxConcurrentDownloads(int maxDownloads, int maxDownloadsDuringCall);
+	virtual void SetBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond);
+	virtual void SetCallBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond);
+	virtual void SetCallIsActive(bool callIsActive);
+	
+	virtual std::set<std::string> CurrentlyDownloadingFileTokens(); // includes queued downloads
 	virtual std::set<std::string> CurrentlySharedFileTokens();
 	virtual FileInfo FileInfoForToken(const std::string &token);
 	
@@ -97,7 +116,7 @@ protected:
 	
 	// FileDownloaderDelegateInterface implementation
 	virtual void DownloadHasBeenFinished(FileDownloader *fileDownloader, const std::string &filePath);
-	virtual void DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded);
+	virtual void DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval);
 	virtual void DownloadHasBeenCanceled(FileDownloader *fileDownloader);
 	virtual void DownloadHasFailed(FileDownloader *fileDownloader);
 	virtual void DownloadHasBeenPaused(FileDownloader *fileDownloader);
@@ -136,8 +155,13 @@ private:
 	void DeleteTransferer(const std::string &token); // deletes every transferer for given token in all transfer maps (activeFileUploaders_, stoppedFileUploaders_, ...)
 	void DeleteStoppedTransferer(const std::string &token); // deletes every transferer for given token in only in stooped transfer maps (stoppedFileUploaders_, ...)
 	void EraseAllTransferers();
+	void StartScheduledDownloads();
 	
 	FileSharingManagerDelegateInterface *delegate_;
+	
+	std::string downloadEncryptionKey_;
+	FileContentIndex *contentIndex_;
+	TransferScheduler *scheduler_;
 };
 	
 	
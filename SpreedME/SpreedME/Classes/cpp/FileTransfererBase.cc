@@ -96,7 +96,8 @@ void FileTransfererBase::EraseAllWrappers()
 		Json::Value chunkRequestJson;
 		chunkRequestJson[kDataChannelChunkRequestModeKey] = kDataChannelChunkRequestModeByeKey;
 		
-		std::string msg = chunkRequestJson.toStyledString();
+		Json::FastWriter writer;
+		std::string msg = writer.write(chunkRequestJson);
 		spreed_me_log("Sending bye on data channel %s", msg.c_str());
 		it->second->SendData(msg, kDefaultDataChannelLabel);
 	}
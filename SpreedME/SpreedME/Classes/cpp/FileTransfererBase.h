@@ -38,6 +38,7 @@ struct FileInfo
 	std::string fileName;
 	std::string fileType;
 	unsigned long long fileSize;
+	std::string contentHash; // optional, empty if peer doesn't know or doesn't announce it
 	
 	// calculated fields
 	uint32 chunkSize;
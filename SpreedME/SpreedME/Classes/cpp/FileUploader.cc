@@ -22,8 +22,11 @@
 
 #include "FileUploader.h"
 
+#include <algorithm>
+
 #include <webrtc/base/helpers.h>
 
+#include "cpp_utils.h"
 #include "crc32.h"
 
 using namespace spreedme;
@@ -33,14 +36,13 @@ namespace spreedme {
 				
 
 struct FileSharingMessageData : public rtc::MessageData {
-	explicit FileSharingMessageData(std::string filePath, std::string fileType, std::string fileName, std::string token, bool shouldDeleteOnFinish) :
-	filePath(filePath), fileType(fileType), fileName(fileName), token(token), shouldDeleteOnFinish(shouldDeleteOnFinish) {};
+	explicit FileSharingMessageData(FileChunkSource *chunkSource, std::string fileType, std::string fileName, std::string token) :
+	chunkSource(chunkSource), fileType(fileType), fileName(fileName), token(token) {};
 	
-	std::string filePath;
+	FileChunkSource *chunkSource; // ownership is passed to uploader
 	std::string fileType;
 	std::string fileName;
 	std::string token;
-	bool shouldDeleteOnFinish;
 };
 	
 	
@@ -50,6 +52,16 @@ struct UserIdWrapperIdMessageData : public rtc::MessageData {
 	std::string userId;
 	std::string wrapperId;
 };
+	
+	
+struct ChunkRequestMessageData : public rtc::MessageData {
+	explicit ChunkRequestMessageData(uint32 chunkNumber, bool wantsProof, rtc::scoped_refptr<PeerConnectionWrapper> wrapper) :
+	chunkNumber(chunkNumber), wantsProof(wantsProof), wrapper(wrapper) {};
+	
+	uint32 chunkNumber;
+	bool wantsProof;
+	rtc::scoped_refptr<PeerConnectionWrapper> wrapper;
+};
 
 }
 
@@ -61,10 +73,16 @@ enum {
 	MSG_FU_STOP_SHARING_s,
 	MSG_FU_DELETE_CLOSED_WRAPPER_s,
 	MSG_FU_FILESHARING_HAS_STARTED_c,
-	MSG_FU_CLEANED_UP_c
+	MSG_FU_CLEANED_UP_c,
+	MSG_FU_SEND_CHUNK_s,
+	MSG_FU_HASH_CONTENT_s
 };
 
 
+// Content is hashed in steps of this many chunks so chunk requests are served in between.
+static const uint32 kContentHashChunksPerStep = 16;
+
+
 FileUploader::FileUploader(PeerConnectionWrapperFactory *peerConnectionWrapperFactory,
 						   SignallingHandler *signallingHandler,
 						   MessageQueueInterface *workerQueue,
@@ -73,7 +91,12 @@ FileUploader::FileUploader(PeerConnectionWrapperFactory *peerConnectionWrapperFa
 					   signallingHandler,
 					   workerQueue,
 					   callbacksMessageQueue),
-	shouldDeleteFileOnFinish_(true)
+	chunkSource_(NULL),
+	contentIndex_(NULL),
+	merkleTree_(NULL),
+	contentHasher_(NULL),
+	nextChunkToHash_(0),
+	bandwidthBucket_(NULL)
 {
 	
 }
@@ -81,9 +104,9 @@ FileUploader::FileUploader(PeerConnectionWrapperFactory *peerConnectionWrapperFa
 
 FileUploader::~FileUploader()
 {
-	if (shouldDeleteFileOnFinish_) {
-		remove(filePath_.c_str());
-	}
+	delete chunkSource_;
+	delete merkleTree_;
+	delete contentHasher_;
 }
 
 
@@ -105,28 +128,28 @@ std::string FileUploader::CreateFileUploadTokenForFileName(const std::string &fi
 
 void FileUploader::StartSharingFile(const std::string &filePath, const std::string &fileType, const std::string &fileName, const std::string &token, bool shouldDeleteOnFinish)
 {
-	FileSharingMessageData *msgData = new FileSharingMessageData(filePath, fileType, fileName, token, shouldDeleteOnFinish);
+	this->StartSharingFromChunkSource(new PlainFileChunkSource(filePath, shouldDeleteOnFinish), fileType, fileName, token);
+}
+
+
+void FileUploader::StartSharingFromChunkSource(FileChunkSource *chunkSource, const std::string &fileType, const std::string &fileName, const std::string &token)
+{
+	FileSharingMessageData *msgData = new FileSharingMessageData(chunkSource, fileType, fileName, token);
 	workerQueue_->Post(this, MSG_FU_START_FILE_SHARING_s, msgData);
 }
 
 
-void FileUploader::StartSharingFile_s(const std::string &filePath, const std::string &fileType, const std::string &fileName, const std::string &token, bool shouldDeleteOnFinish)
+void FileUploader::StartSharingFile_s(FileChunkSource *chunkSource, const std::string &fileType, const std::string &fileName, const std::string &token)
 {
 	token_ = token;
 	
-	shouldDeleteFileOnFinish_ = shouldDeleteOnFinish;
+	delete chunkSource_;
+	chunkSource_ = chunkSource;
 	
-	filePath_ = filePath;
-	
-	fileHandle_.open(filePath_.c_str(), std::ios::in | std::ios::binary);
-	
-	if (fileHandle_.is_open()) {
-		fileHandle_.seekg(0, std::ios::end);
-		fileInfo_.fileSize = fileHandle_.tellg();
-		fileHandle_.seekg(0);
-		spreed_me_log("Opened file handle to filePath %s", filePath.c_str());
+	if (chunkSource_ && chunkSource_->Open()) {
+		fileInfo_.fileSize = chunkSource_->Size();
 	} else {
-		spreed_me_log("Couldn't open file handle to filePath %s", filePath.c_str());
+		spreed_me_log("Couldn't open chunk source for file %s", fileName.c_str());
 		assert(false);
 	}
 	
@@ -135,12 +158,22 @@ void FileUploader::StartSharingFile_s(const std::string &filePath, const std::st
 	fileInfo_.fileType = fileType;
 
 	this->DecideOnFileChunksForFileSize();
-
+	
+	// File is announced right away. If we don't remember its content hash we hash it while serving chunks
+	// and send the hash to downloaders over data channel when it is ready.
+	bool hasContentHash = this->LoadRememberedContentHash();
 	
 	spreed_me_log("Starting file share with parameters: \n name: %s \n type: %s \n size: %llu \n chunks: %u",
 				  fileInfo_.fileName.c_str(), fileInfo_.fileType.c_str(), fileInfo_.fileSize, fileInfo_.chunks);
 	
-	callbacksMessageQueue_->Post(this, MSG_FU_FILESHARING_HAS_STARTED_c);
+	callbacksMessageQueue_->Post(this, MSG_FU_FILESHARING_HAS_STARTED_c, new rtc::TypedMessageData<FileInfo>(fileInfo_));
+	
+	if (!hasContentHash && chunkSource_ && fileInfo_.chunks > 0) {
+		delete contentHasher_;
+		contentHasher_ = new FileContentHasher(fileInfo_.chunkSize, fileInfo_.chunks);
+		nextChunkToHash_ = 0;
+		workerQueue_->Post(this, MSG_FU_HASH_CONTENT_s);
+	}
 }
 
 
@@ -162,9 +195,8 @@ void FileUploader::StopSharingFile_s()
 	
 	activeConnections_.clear();
 	
-	if (shouldDeleteFileOnFinish_) {
-		remove(filePath_.c_str());
-		shouldDeleteFileOnFinish_ = false; // to prevent 'remove()' call in destructor
+	if (chunkSource_) {
+		chunkSource_->Close(); // this also removes temporary files
 	}
 	
 	workerQueue_->Clear(this);
@@ -191,19 +223,174 @@ void FileUploader::DecideOnFileChunksForFileSize()
 }
 
 
+// Content hash is announced in file info, so receivers which already have the file don't download it again.
+// It is also the root receivers check every chunk against, so we announce it only if we can send proofs.
+// Only hashes remembered in content index are used here, this doesn't read the file.
+bool FileUploader::LoadRememberedContentHash()
+{
+	std::string originalFilePath = chunkSource_ ? chunkSource_->OriginalFilePath() : std::string();
+	if (!contentIndex_ || originalFilePath.empty()) {
+		return false;
+	}
+	
+	std::vector<std::string> chunkHashes;
+	std::string contentHash = contentIndex_->ContentHashForPath(originalFilePath);
+	if (!contentIndex_->LoadChunkHashes(contentHash, fileInfo_.chunks, &chunkHashes)) {
+		return false;
+	}
+	
+	fileInfo_.contentHash = contentHash;
+	delete merkleTree_;
+	merkleTree_ = new MerkleTree(chunkHashes);
+	
+	return true;
+}
+
+
+void FileUploader::HashNextContentChunks_s()
+{
+	if (!contentHasher_) {
+		return;
+	}
+	
+	char *buff = (char *)malloc(fileInfo_.chunkSize);
+	uint32 lastChunk = std::min(nextChunkToHash_ + kContentHashChunksPerStep, fileInfo_.chunks);
+	for (; nextChunkToHash_ < lastChunk; ++nextChunkToHash_) {
+		uint64 offset = (uint64)nextChunkToHash_ * fileInfo_.chunkSize;
+		uint32 size = fileInfo_.fileSize - offset > fileInfo_.chunkSize ? fileInfo_.chunkSize : (uint32)(fileInfo_.fileSize - offset);
+		if (!chunkSource_->ReadAt(offset, buff, size)) {
+			spreed_me_log("Couldn't read chunk %u to calculate content hash. File is shared without it.", nextChunkToHash_);
+			free(buff);
+			delete contentHasher_;
+			contentHasher_ = NULL;
+			return;
+		}
+		contentHasher_->AddChunk(nextChunkToHash_, buff, size);
+	}
+	free(buff);
+	
+	if (nextChunkToHash_ < fileInfo_.chunks) {
+		// Go through queue so chunk requests which came meanwhile are not delayed by hashing.
+		workerQueue_->Post(this, MSG_FU_HASH_CONTENT_s);
+		return;
+	}
+	
+	std::string contentHash = contentHasher_->ContentHash();
+	std::vector<std::string> chunkHashes = contentHasher_->chunkHashes();
+	delete contentHasher_;
+	contentHasher_ = NULL;
+	
+	if (!contentHash.empty()) {
+		fileInfo_.contentHash = contentHash;
+		this->ContentHashIsReady_s(chunkHashes);
+	}
+}
+
+
+void FileUploader::ContentHashIsReady_s(const std::vector<std::string> &chunkHashes)
+{
+	delete merkleTree_;
+	merkleTree_ = new MerkleTree(chunkHashes);
+	
+	std::string originalFilePath = chunkSource_->OriginalFilePath();
+	if (contentIndex_ && !originalFilePath.empty()) {
+		contentIndex_->AddFile(originalFilePath, fileInfo_.contentHash);
+		contentIndex_->SaveChunkHashes(fileInfo_.contentHash, chunkHashes);
+	}
+	
+	// Downloaders which have connected before hash was ready start asking for proofs from now on.
+	for (WrapperIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end(); ++it) {
+		if (it->second->HasOpenedDataChannel()) {
+			this->SendContentHash(it->second);
+		}
+	}
+}
+
+
+void FileUploader::SendContentHash(PeerConnectionWrapper *wrapper)
+{
+	Json::Value contentHashJson;
+	contentHashJson[kDataChannelChunkRequestModeKey] = kDataChannelChunkRequestModeContentHashKey;
+	contentHashJson[kDataChannelChunkContentHashKey] = fileInfo_.contentHash;
+	
+	Json::FastWriter writer;
+	std::string msg = writer.write(contentHashJson);
+	wrapper->SendData(msg);
+}
+
+
+// Is called directly from data channel callback or from worker thread when chunk had to wait for bandwidth.
+void FileUploader::SendChunk_s(uint32 chunkNumber, bool wantsProof, rtc::scoped_refptr<PeerConnectionWrapper> wrapper)
+{
+	uint64 offset = (uint64)chunkNumber * fileInfo_.chunkSize;
+	uint32 size = fileInfo_.fileSize - offset > fileInfo_.chunkSize ? fileInfo_.chunkSize : (uint32)(fileInfo_.fileSize - offset);
+	
+	if (bandwidthBucket_) {
+		uint32 delay = bandwidthBucket_->DelayForBytes(size);
+		if (delay > 0) {
+			workerQueue_->PostDelayed(delay, this, MSG_FU_SEND_CHUNK_s, new ChunkRequestMessageData(chunkNumber, wantsProof, wrapper));
+			return;
+		}
+		bandwidthBucket_->TakeBytes(size);
+	}
+	
+	char *buff = (char *)malloc(size + 12);
+	if (!chunkSource_->ReadAt(offset, buff+12, size)) {
+		spreed_me_log("Couldn't read chunk %u from chunk source", chunkNumber);
+		free(buff);
+		return;
+	}
+	
+	// Proof goes first through the same channel as chunk, channel is ordered so downloader has it when chunk arrives
+	if (merkleTree_ && wantsProof) {
+		this->SendChunkProof(chunkNumber, wrapper);
+	}
+	
+	buff[0] = 0; //This is version;
+	
+	uint32 calcCrc32 = crc32buf(buff+12, size);
+	memcpy(&buff[8], &calcCrc32, 4); // this is checksum
+	memcpy(&buff[4], &chunkNumber, 4); // this is chunk num
+	
+	// wrapper doesn't take ownership of data buffer we provide to it
+	wrapper->SendData(buff, size + 12);
+	free(buff);
+}
+
+
+void FileUploader::SendChunkProof(uint32 chunkNumber, PeerConnectionWrapper *wrapper)
+{
+	std::vector<std::string> proof = merkleTree_->ProofForLeaf(chunkNumber);
+	
+	Json::Value hashes(Json::arrayValue);
+	for (std::vector<std::string>::iterator it = proof.begin(); it != proof.end(); ++it) {
+		hashes.append(hex_encode(*it));
+	}
+	
+	Json::Value proofJson;
+	proofJson[kDataChannelChunkRequestModeKey] = kDataChannelChunkRequestModeProofKey;
+	proofJson[kDataChannelChunkSequenceNumberKey] = chunkNumber;
+	proofJson[kDataChannelChunkProofHashesKey] = hashes;
+	
+	Json::FastWriter writer;
+	std::string msg = writer.write(proofJson);
+	wrapper->SendData(msg);
+}
+
+
 void FileUploader::OnMessage(rtc::Message* msg)
 {
 	switch (msg->message_id) {
 		case MSG_FU_RECEIVED_MESSAGE_s: {
-			SignallingMessageData *param = static_cast<SignallingMessageData*>(msg->pdata);
-			this->MessageReceived_s(param->msg, param->transportType, param->wrapperId, param->token);
+			JsonSignallingMessageData *param = static_cast<JsonSignallingMessageData*>(msg->pdata);
+			this->MessageReceived_s(param->root, param->transportType, param->wrapperId, param->token);
 			delete param;
 			break;
 		}
 			
 		case MSG_FU_START_FILE_SHARING_s: {
 			FileSharingMessageData *param = static_cast<FileSharingMessageData*>(msg->pdata);
-			this->StartSharingFile_s(param->filePath, param->fileType, param->fileName, param->token, param->shouldDeleteOnFinish);
+			this->StartSharingFile_s(param->chunkSource, param->fileType, param->fileName, param->token);
 			delete param;
 			break;
 		}
@@ -222,9 +409,12 @@ void FileUploader::OnMessage(rtc::Message* msg)
 		}
 		
 		case MSG_FU_FILESHARING_HAS_STARTED_c: {
+			// File info is passed as a copy since content hash can be set on worker thread meanwhile.
+			rtc::TypedMessageData<FileInfo> *param = static_cast<rtc::TypedMessageData<FileInfo> *>(msg->pdata);
 			if (delegate_) {
-				delegate_->FileSharingHasStarted(fileInfo_, this);
+				delegate_->FileSharingHasStarted(param->data(), this);
 			}
+			delete param;
 			break;
 		}
 		
@@ -232,6 +422,19 @@ void FileUploader::OnMessage(rtc::Message* msg)
 			if (delegate_) {
 				delegate_->FileUploaderHasStoppedAndCleanedUp(this);
 			}
+			break;
+		}
+		
+		case MSG_FU_SEND_CHUNK_s: {
+			ChunkRequestMessageData *param = static_cast<ChunkRequestMessageData*>(msg->pdata);
+			this->SendChunk_s(param->chunkNumber, param->wantsProof, param->wrapper);
+			delete param;
+			break;
+		}
+		
+		case MSG_FU_HASH_CONTENT_s: {
+			this->HashNextContentChunks_s();
+			break;
 		}
 			
 		default:
@@ -240,9 +443,9 @@ void FileUploader::OnMessage(rtc::Message* msg)
 }
 
 
-void FileUploader::MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+void FileUploader::MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
 {
-	SignallingMessageData *msgData = new SignallingMessageData(msg, transportType, wrapperId, token);
+	JsonSignallingMessageData *msgData = new JsonSignallingMessageData(root, transportType, wrapperId, token);
 	workerQueue_->Post(this, MSG_FU_RECEIVED_MESSAGE_s, msgData);
 }
 
@@ -316,6 +519,10 @@ void FileUploader::DataChannelStateChanged(webrtc::DataChannelInterface::DataSta
 		case webrtc::DataChannelInterface::kConnecting:
 			break;
 		case webrtc::DataChannelInterface::kOpen:
+			if (merkleTree_) {
+				// Downloader might not have got content hash with file info if we were hashing when file was announced.
+				this->SendContentHash(wrapper);
+			}
 			break;
 		case webrtc::DataChannelInterface::kClosing:
 			break;
@@ -347,22 +554,14 @@ void FileUploader::ReceivedDataChannelData(webrtc::DataBuffer *buffer,
 		if (success) {
 			std::string requestMode = jsonMsg.get(kDataChannelChunkRequestModeKey, Json::Value()).asString();
 			uint32 chunkNum = jsonMsg.get(kDataChannelChunkSequenceNumberKey, Json::Value()).asUInt();
-			if (requestMode == kDataChannelChunkRequestModeRequestKey && chunkNum < fileInfo_.chunks) {
-				fileHandle_.seekg(chunkNum * fileInfo_.chunkSize);
-				uint32 size = fileInfo_.fileSize - chunkNum * fileInfo_.chunkSize > fileInfo_.chunkSize ? fileInfo_.chunkSize : fileInfo_.fileSize - chunkNum * fileInfo_.chunkSize;
-				
-				char *buff = (char *)malloc(size + 12);
-				fileHandle_.read(buff+12, size);
-				
-				buff[0] = 0; //This is version;
-				
-				uint32 calcCrc32 = crc32buf(buff+12, size);
-				memcpy(&buff[8], &calcCrc32, 4); // this is checksum
-				memcpy(&buff[4], &chunkNum, 4); // this is chunk num
-				
-				// wrapper doesn't take ownership of data buffer we provide to it
-				wrapper->SendData(buff, size + 12);
-				free(buff);
+			if (requestMode == kDataChannelChunkRequestModeRequestKey && chunkNum < fileInfo_.chunks && chunkSource_) {
+				bool wantsProof = jsonMsg.get(kDataChannelChunkWantsProofKey, Json::Value(false)).asBool();
+				uint32 delay = bandwidthBucket_ ? bandwidthBucket_->DelayForBytes(fileInfo_.chunkSize) : 0;
+				if (delay > 0) {
+					workerQueue_->PostDelayed(delay, this, MSG_FU_SEND_CHUNK_s, new ChunkRequestMessageData(chunkNum, wantsProof, wrapper));
+				} else {
+					this->SendChunk_s(chunkNum, wantsProof, wrapper);
+				}
 				
 				delete buffer;
 				
@@ -25,7 +25,11 @@
 
 #include <iostream>
 
+#include "FileChunkSource.h"
+#include "FileContentIndex.h"
 #include "FileTransfererBase.h"
+#include "MerkleTree.h"
+#include "TransferScheduler.h"
 
 namespace spreedme {
 	
@@ -48,8 +52,14 @@ public:
 				 MessageQueueInterface *callbacksMessageQueue);
 	
 	virtual void StartSharingFile(const std::string &filePath, const std::string &fileType, const std::string &fileName, const std::string &token, bool shouldDeleteOnFinish = false);
+	// Takes ownership of chunkSource. Source is opened in worker thread, so this call returns immediately.
+	virtual void StartSharingFromChunkSource(FileChunkSource *chunkSource, const std::string &fileType, const std::string &fileName, const std::string &token);
 	
 	virtual void SetDelegate(FileUploaderDelegateInterface *delegate) { delegate_ = delegate; };
+	// Index is used to remember content hashes of shared files so we don't hash them again when they are reshared.
+	virtual void SetContentIndex(FileContentIndex *contentIndex) { contentIndex_ = contentIndex; };
+	// Every sent chunk takes its size from bucket, chunk requests wait when it is empty. NULL means no limit.
+	virtual void SetBandwidthBucket(TokenBucket *bucket) { bandwidthBucket_ = bucket; };
 	
 	static std::string CreateFileUploadTokenForFileName(const std::string &fileName);
 	
@@ -64,7 +74,7 @@ protected:
 	
 	virtual void OnMessage(rtc::Message* msg);
 		
-	virtual void StartSharingFile_s(const std::string &filePath, const std::string &fileType, const std::string &fileName, const std::string &token, bool shouldDeleteOnFinish = false);
+	virtual void StartSharingFile_s(FileChunkSource *chunkSource, const std::string &fileType, const std::string &fileName, const std::string &token);
 	
 	virtual void AsyncDeleteWrapperForUserIdWrapperId(const std::string &userId, const std::string &wrapperId);
 	
@@ -82,16 +92,27 @@ protected:
 	virtual void StopSharingFile_s();
 	
 	// These methods are called in signallingThread
-	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
 	virtual void ReceivedOffer_s(const Json::Value &offerJson, const std::string &from); // expects inner JSON (without Data :{})
 	virtual void ReceivedAnswer_s(const Json::Value &answerJson, const std::string &from); // expects inner JSON (without Data :{})
 		
 	virtual void DecideOnFileChunksForFileSize();
+	virtual bool LoadRememberedContentHash();
+	virtual void HashNextContentChunks_s();
+	virtual void ContentHashIsReady_s(const std::vector<std::string> &chunkHashes);
+	virtual void SendContentHash(PeerConnectionWrapper *wrapper);
+	virtual void SendChunkProof(uint32 chunkNumber, PeerConnectionWrapper *wrapper);
+	virtual void SendChunk_s(uint32 chunkNumber, bool wantsProof, rtc::scoped_refptr<PeerConnectionWrapper> wrapper);
 	
 private:
 	FileUploaderDelegateInterface *delegate_; // We do not own it!
 	
-	bool shouldDeleteFileOnFinish_;
+	FileChunkSource *chunkSource_; // owned
+	FileContentIndex *contentIndex_; // We do not own it!
+	MerkleTree *merkleTree_; // is built together with content hash, used to send chunk proofs
+	FileContentHasher *contentHasher_; // exists while content is being hashed after file has been announced
+	uint32 nextChunkToHash_;
+	TokenBucket *bandwidthBucket_; // We do not own it!
 };
 	
 } // namespace spreedme
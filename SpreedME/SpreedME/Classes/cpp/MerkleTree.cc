@@ -0,0 +1,146 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "MerkleTree.h"
+
+#include <CommonCrypto/CommonDigest.h>
+
+using namespace spreedme;
+
+namespace {
+
+const unsigned char kMerkleLeafPrefix = 0x00;
+const unsigned char kMerkleNodePrefix = 0x01;
+const size_t kMerkleHashSize = CC_SHA256_DIGEST_LENGTH;
+
+} // namespace
+
+
+MerkleTree::MerkleTree(const std::vector<std::string> &leafHashes)
+{
+	if (leafHashes.empty()) {
+		return;
+	}
+	
+	levels_.push_back(leafHashes);
+	
+	while (levels_.back().size() > 1) {
+		const std::vector<std::string> &level = levels_.back();
+		std::vector<std::string> nextLevel;
+		nextLevel.reserve((level.size() + 1) / 2);
+		
+		for (size_t i = 0; i < level.size(); i += 2) {
+			if (i + 1 < level.size()) {
+				nextLevel.push_back(NodeHash(level[i], level[i + 1]));
+			} else {
+				nextLevel.push_back(level[i]);
+			}
+		}
+		
+		levels_.push_back(nextLevel);
+	}
+}
+
+
+std::string MerkleTree::LeafHash(const char *data, uint32 size)
+{
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	CC_SHA256_Update(&ctx, &kMerkleLeafPrefix, 1);
+	CC_SHA256_Update(&ctx, data, size);
+	
+	unsigned char digest[kMerkleHashSize];
+	CC_SHA256_Final(digest, &ctx);
+	
+	return std::string((const char *)digest, sizeof(digest));
+}
+
+
+std::string MerkleTree::NodeHash(const std::string &left, const std::string &right)
+{
+	CC_SHA256_CTX ctx;
+	CC_SHA256_Init(&ctx);
+	CC_SHA256_Update(&ctx, &kMerkleNodePrefix, 1);
+	CC_SHA256_Update(&ctx, left.data(), (CC_LONG)left.size());
+	CC_SHA256_Update(&ctx, right.data(), (CC_LONG)right.size());
+	
+	unsigned char digest[kMerkleHashSize];
+	CC_SHA256_Final(digest, &ctx);
+	
+	return std::string((const char *)digest, sizeof(digest));
+}
+
+
+std::string MerkleTree::Root() const
+{
+	return levels_.empty() ? std::string() : levels_.back()[0];
+}
+
+
+std::vector<std::string> MerkleTree::ProofForLeaf(uint32 leafIndex) const
+{
+	std::vector<std::string> proof;
+	
+	if (leafIndex >= this->leafCount()) {
+		return proof;
+	}
+	
+	size_t index = leafIndex;
+	for (size_t l = 0; l + 1 < levels_.size(); ++l) {
+		size_t sibling = index ^ 1;
+		if (sibling < levels_[l].size()) {
+			proof.push_back(levels_[l][sibling]);
+		}
+		index /= 2;
+	}
+	
+	return proof;
+}
+
+
+std::string MerkleTree::RootFromProof(uint32 leafIndex, uint32 leafCount,
+									  const std::string &leafHash, const std::vector<std::string> &proof)
+{
+	if (leafIndex >= leafCount) {
+		return std::string();
+	}
+	
+	std::string hash = leafHash;
+	size_t index = leafIndex;
+	size_t levelSize = leafCount;
+	size_t used = 0;
+	
+	while (levelSize > 1) {
+		size_t sibling = index ^ 1;
+		if (sibling < levelSize) {
+			if (used >= proof.size() || proof[used].size() != kMerkleHashSize) {
+				return std::string();
+			}
+			hash = (index & 1) ? NodeHash(proof[used], hash) : NodeHash(hash, proof[used]);
+			++used;
+		}
+		index /= 2;
+		levelSize = (levelSize + 1) / 2;
+	}
+	
+	return used == proof.size() ? hash : std::string();
+}
@@ -0,0 +1,65 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__MerkleTree__
+#define __SpreedME__MerkleTree__
+
+#include <string>
+#include <vector>
+
+#include <webrtc/base/basictypes.h>
+
+namespace spreedme {
+
+/*
+ Binary hash tree over file chunks.
+ leaf = SHA-256(0x00 | chunk), node = SHA-256(0x01 | left | right). Last node of a level without
+ a pair is moved to the next level as it is. Shape of the tree depends only on number of leaves,
+ so anyone who knows number of chunks can check a chunk against the root with log2(chunks) sibling hashes.
+ All hashes are raw 32 byte strings. SHA-256 comes from CommonCrypto which uses
+ hardware SHA instructions where CPU has them.
+ */
+class MerkleTree
+{
+public:
+	explicit MerkleTree(const std::vector<std::string> &leafHashes);
+	
+	static std::string LeafHash(const char *data, uint32 size);
+	static std::string NodeHash(const std::string &left, const std::string &right);
+	
+	std::string Root() const;
+	uint32 leafCount() const {return levels_.empty() ? 0 : (uint32)levels_[0].size();};
+	
+	// Sibling hashes from leaf level up to the root.
+	std::vector<std::string> ProofForLeaf(uint32 leafIndex) const;
+	
+	// Calculates root from leaf and its proof. Returns empty string if proof doesn't fit tree shape.
+	static std::string RootFromProof(uint32 leafIndex, uint32 leafCount,
+									 const std::string &leafHash, const std::vector<std::string> &proof);
+	
+private:
+	std::vector< std::vector<std::string> > levels_; // levels_[0] are leaves, last level is the root
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__MerkleTree__) */
@@ -23,8 +23,8 @@
 #ifndef __SpreedME__MessageQueueInterface__
 #define __SpreedME__MessageQueueInterface__
 
-#include <webrtc/base/messageQueue.h>
-#include <webrtc/base/messageHandler.h>
+#include <webrtc/base/messagequeue.h>
+#include <webrtc/base/messagehandler.h>
 
 
 namespace spreedme {
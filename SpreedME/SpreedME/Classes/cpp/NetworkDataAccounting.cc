@@ -0,0 +1,173 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "NetworkDataAccounting.h"
+
+using namespace spreedme;
+
+
+#pragma mark - NetworkDataCounter
+
+void NetworkDataCounter::Add(uint64_t bytes)
+{
+	bytes_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+
+STByteCount NetworkDataCounter::ByteCount() const
+{
+	STByteCount byteCount = STByteCountMakeZero();
+	byteCount.bytes = bytes_.load(std::memory_order_relaxed);
+	return byteCount;
+}
+
+
+#pragma mark - NetworkDataAccounting
+
+NetworkDataAccounting *NetworkDataAccounting::Instance()
+{
+	static NetworkDataAccounting *sharedInstance = new NetworkDataAccounting(); // never deleted, can be used during app termination
+	return sharedInstance;
+}
+
+
+NetworkDataAccounting::NetworkDataAccounting() :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection())
+{
+}
+
+
+NetworkDataAccounting::~NetworkDataAccounting()
+{
+	delete critSect_;
+}
+
+
+void NetworkDataAccounting::AddSentBytes(NetworkDataService service, uint64_t bytes)
+{
+	if (service >= 0 && service < kNetworkDataServiceCount) {
+		services_[service].sent.Add(bytes);
+	}
+}
+
+
+void NetworkDataAccounting::AddReceivedBytes(NetworkDataService service, uint64_t bytes)
+{
+	if (service >= 0 && service < kNetworkDataServiceCount) {
+		services_[service].received.Add(bytes);
+	}
+}
+
+
+STByteCount NetworkDataAccounting::SentByteCount(NetworkDataService service) const
+{
+	if (service >= 0 && service < kNetworkDataServiceCount) {
+		return services_[service].sent.ByteCount();
+	}
+	return STByteCountMakeInvalid();
+}
+
+
+STByteCount NetworkDataAccounting::ReceivedByteCount(NetworkDataService service) const
+{
+	if (service >= 0 && service < kNetworkDataServiceCount) {
+		return services_[service].received.ByteCount();
+	}
+	return STByteCountMakeInvalid();
+}
+
+
+std::shared_ptr<NetworkDataPeerCounters> NetworkDataAccounting::CreatePeerCounters(const std::string &peerId, NetworkDataService service)
+{
+	if (service < 0 || service >= kNetworkDataServiceCount) {
+		service = kNetworkDataServiceDataChannel;
+	}
+	
+	std::shared_ptr<NetworkDataPeerCounters> counters = std::make_shared<NetworkDataPeerCounters>(peerId, service, &services_[service]);
+	
+	webrtc::CriticalSectionScoped sc(critSect_);
+	this->RemoveReleasedPeers_l();
+	peers_.push_back(counters);
+	
+	return counters;
+}
+
+
+std::vector<NetworkDataPeerSnapshot> NetworkDataAccounting::PeerSnapshots()
+{
+	std::vector<NetworkDataPeerSnapshot> snapshots;
+	
+	webrtc::CriticalSectionScoped sc(critSect_);
+	this->RemoveReleasedPeers_l();
+	for (std::vector< std::weak_ptr<NetworkDataPeerCounters> >::iterator it = peers_.begin(); it != peers_.end(); ++it) {
+		std::shared_ptr<NetworkDataPeerCounters> counters = it->lock();
+		if (counters) {
+			NetworkDataPeerSnapshot snapshot;
+			snapshot.peerId = counters->peerId();
+			snapshot.service = counters->service();
+			snapshot.sent = counters->sentByteCount();
+			snapshot.received = counters->receivedByteCount();
+			snapshots.push_back(snapshot);
+		}
+	}
+	
+	return snapshots;
+}
+
+
+void NetworkDataAccounting::RemoveReleasedPeers_l()
+{
+	std::vector< std::weak_ptr<NetworkDataPeerCounters> >::iterator it = peers_.begin();
+	while (it != peers_.end()) {
+		if (it->expired()) {
+			it = peers_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+
+#pragma mark - C interface
+
+void NetworkDataAccountingAddSentBytes(NetworkDataService service, uint64_t bytes)
+{
+	NetworkDataAccounting::Instance()->AddSentBytes(service, bytes);
+}
+
+
+void NetworkDataAccountingAddReceivedBytes(NetworkDataService service, uint64_t bytes)
+{
+	NetworkDataAccounting::Instance()->AddReceivedBytes(service, bytes);
+}
+
+
+STByteCount NetworkDataAccountingSentByteCount(NetworkDataService service)
+{
+	return NetworkDataAccounting::Instance()->SentByteCount(service);
+}
+
+
+STByteCount NetworkDataAccountingReceivedByteCount(NetworkDataService service)
+{
+	return NetworkDataAccounting::Instance()->ReceivedByteCount(service);
+}
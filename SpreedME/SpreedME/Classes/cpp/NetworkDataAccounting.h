@@ -0,0 +1,164 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__NetworkDataAccounting__
+#define __SpreedME__NetworkDataAccounting__
+
+#include <stdint.h>
+
+#include "STByteCount.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum NetworkDataService
+{
+	kNetworkDataServiceDataChannel = 0,
+	kNetworkDataServiceFileTransfer,
+	kNetworkDataServiceResourceDownload,
+	kNetworkDataServiceCount
+}
+NetworkDataService;
+
+// Plain C interface to the shared NetworkDataAccounting instance, so it can be fed from Objective-C code.
+// All functions are lock free and can be called from any thread.
+void NetworkDataAccountingAddSentBytes(NetworkDataService service, uint64_t bytes);
+void NetworkDataAccountingAddReceivedBytes(NetworkDataService service, uint64_t bytes);
+STByteCount NetworkDataAccountingSentByteCount(NetworkDataService service);
+STByteCount NetworkDataAccountingReceivedByteCount(NetworkDataService service);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <system_wrappers/interface/critical_section_wrapper.h>
+
+namespace spreedme {
+
+// Lock free byte counter. Adding is a single relaxed atomic add, reading never blocks writers.
+// Counts up to 2^64 - 1 bytes, which can't be reached by network traffic of one app run,
+// so ByteCount() never reports 64 bit overflows.
+class NetworkDataCounter
+{
+public:
+	NetworkDataCounter() : bytes_(0) {};
+	
+	void Add(uint64_t bytes);
+	STByteCount ByteCount() const;
+	
+private:
+	NetworkDataCounter(const NetworkDataCounter &);
+	NetworkDataCounter &operator=(const NetworkDataCounter &);
+	
+	std::atomic<uint64_t> bytes_;
+};
+
+
+struct NetworkDataCounters
+{
+	NetworkDataCounter sent;
+	NetworkDataCounter received;
+};
+
+
+// Counters of one peer connection. Bytes added here are also added to the totals of the service.
+class NetworkDataPeerCounters
+{
+public:
+	NetworkDataPeerCounters(const std::string &peerId, NetworkDataService service, NetworkDataCounters *serviceCounters) :
+		peerId_(peerId), service_(service), serviceCounters_(serviceCounters) {};
+	
+	void AddSentBytes(uint64_t bytes) {counters_.sent.Add(bytes); serviceCounters_->sent.Add(bytes);};
+	void AddReceivedBytes(uint64_t bytes) {counters_.received.Add(bytes); serviceCounters_->received.Add(bytes);};
+	
+	STByteCount sentByteCount() const {return counters_.sent.ByteCount();};
+	STByteCount receivedByteCount() const {return counters_.received.ByteCount();};
+	
+	std::string peerId() const {return peerId_;};
+	NetworkDataService service() const {return service_;};
+	
+private:
+	const std::string peerId_;
+	const NetworkDataService service_;
+	NetworkDataCounters counters_;
+	NetworkDataCounters *serviceCounters_;
+};
+
+
+struct NetworkDataPeerSnapshot
+{
+	std::string peerId;
+	NetworkDataService service;
+	STByteCount sent;
+	STByteCount received;
+};
+
+
+// NetworkDataAccounting counts network traffic per service and per peer connection.
+// Counters only grow and are never reset, whoever persists statistics should keep
+// its own baseline and take snapshots when it wants to save them.
+class NetworkDataAccounting
+{
+public:
+	static NetworkDataAccounting *Instance();
+	
+	void AddSentBytes(NetworkDataService service, uint64_t bytes);
+	void AddReceivedBytes(NetworkDataService service, uint64_t bytes);
+	
+	STByteCount SentByteCount(NetworkDataService service) const;
+	STByteCount ReceivedByteCount(NetworkDataService service) const;
+	
+	// Creates counters for peer connection. Caller owns returned counters and should keep them
+	// as long as connection lives. Counters of released connections disappear from PeerSnapshots().
+	std::shared_ptr<NetworkDataPeerCounters> CreatePeerCounters(const std::string &peerId, NetworkDataService service);
+	std::vector<NetworkDataPeerSnapshot> PeerSnapshots();
+	
+private:
+	NetworkDataAccounting();
+	~NetworkDataAccounting();
+	NetworkDataAccounting(const NetworkDataAccounting &);
+	NetworkDataAccounting &operator=(const NetworkDataAccounting &);
+	
+	void RemoveReleasedPeers_l();
+	
+	NetworkDataCounters services_[kNetworkDataServiceCount];
+	
+	webrtc::CriticalSectionWrapper *critSect_; // guards peers_ only, counters are lock free
+	std::vector< std::weak_ptr<NetworkDataPeerCounters> > peers_;
+};
+
+} // namespace spreedme
+
+#endif // __cplusplus
+
+#endif /* defined(__SpreedME__NetworkDataAccounting__) */
@@ -82,8 +82,8 @@ void ScreenSharingHandler::OnMessage(rtc::Message* msg)
 {
 	switch (msg->message_id) {
 		case MSG_SSH_RECEIVED_MESSAGE_w: {
-			SignallingMessageData *param = static_cast<SignallingMessageData*>(msg->pdata);
-			this->MessageReceived_s(param->msg, param->transportType, param->wrapperId, param->token);
+			JsonSignallingMessageData *param = static_cast<JsonSignallingMessageData*>(msg->pdata);
+			this->MessageReceived_s(param->root, param->transportType, param->wrapperId, param->token);
 			delete param;
 			break;
 		}
@@ -200,7 +200,7 @@ void ScreenSharingHandler::RemoteStreamHasBeenAdded(webrtc::MediaStreamInterface
 	// setup renderer
 	if (wrapper_.get() == peerConnectionWrapper && videoTracksIds.size() > 0 && rendererName_.empty()) {
 		rendererName_ = "ScreenSharingHandler" + videoTracksIds[0];
-		wrapper_->SetupVideoRenderer(scoped_stream->label(), videoTracksIds[0], rendererName_);
+		wrapper_->SetupVideoRenderer(scoped_stream->label(), videoTracksIds[0], rendererName_, kVideoRendererKindScreen);
 	}
 }
 
@@ -407,9 +407,9 @@ void ScreenSharingHandler::PeerConnectionWrapperHasFailedToReceiveStats(PeerConn
 
 #pragma mark - Signalling messages handling
 
-void ScreenSharingHandler::MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+void ScreenSharingHandler::MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
 {
-	SignallingMessageData *msgData = new SignallingMessageData(msg, transportType, wrapperId, token);
+	JsonSignallingMessageData *msgData = new JsonSignallingMessageData(root, transportType, wrapperId, token);
 	workerQueue_->Post(this, MSG_SSH_RECEIVED_MESSAGE_w, msgData);
 }
 
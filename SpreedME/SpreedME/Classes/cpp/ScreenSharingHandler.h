@@ -147,7 +147,7 @@ protected:
 	virtual void PeerConnectionWrapperHasFailedToReceiveStats(PeerConnectionWrapper *peerConnectionWrapper);
 	
 	// Message receiver interface implementation
-	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
 	
 	virtual void ReceivedOffer_s(const Json::Value &offerJson, const std::string &from); // expects inner JSON (without Data :{})
 	virtual void ReceivedAnswer_s(const Json::Value &answerJson, const std::string &from); // expects inner JSON (without Data :{})
@@ -0,0 +1,534 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SegmentedFileCrypto.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <CommonCrypto/CommonCryptor.h>
+#include <CommonCrypto/CommonHMAC.h>
+
+using namespace spreedme;
+
+namespace {
+
+const char kSegmentedFileMagic[4] = {'S', 'M', 'S', 'E'};
+const uint8_t kSegmentedFileVersion = 1;
+const size_t kSegmentedFileSaltSize = 16;
+const size_t kSegmentedFileSaltOffset = 12;
+	
+	
+void WriteUInt32LE(uint32_t value, char *buf)
+{
+	buf[0] = (char)(value & 0xff);
+	buf[1] = (char)((value >> 8) & 0xff);
+	buf[2] = (char)((value >> 16) & 0xff);
+	buf[3] = (char)((value >> 24) & 0xff);
+}
+
+
+uint32_t ReadUInt32LE(const char *buf)
+{
+	return (uint32_t)(uint8_t)buf[0] | (uint32_t)(uint8_t)buf[1] << 8 | (uint32_t)(uint8_t)buf[2] << 16 | (uint32_t)(uint8_t)buf[3] << 24;
+}
+
+
+// Returns segment size or 0 if header is not valid
+uint32_t ParseHeader(const std::string &header)
+{
+	if (header.size() != kSegmentedFileHeaderSize ||
+		memcmp(header.data(), kSegmentedFileMagic, sizeof(kSegmentedFileMagic)) != 0 ||
+		(uint8_t)header[4] != kSegmentedFileVersion) {
+		return 0;
+	}
+	
+	return ReadUInt32LE(header.data() + 8);
+}
+
+
+void DeriveKeys(const std::string &masterKey, const std::string &header, std::string *encryptionKey, std::string *macKey)
+{
+	const std::string salt = header.substr(kSegmentedFileSaltOffset, kSegmentedFileSaltSize);
+	
+	unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+	
+	std::string info = salt + "enc";
+	CCHmac(kCCHmacAlgSHA256, masterKey.data(), masterKey.size(), info.data(), info.size(), digest);
+	encryptionKey->assign((const char *)digest, sizeof(digest));
+	
+	info = salt + "mac";
+	CCHmac(kCCHmacAlgSHA256, masterKey.data(), masterKey.size(), info.data(), info.size(), digest);
+	macKey->assign((const char *)digest, sizeof(digest));
+	
+	memset(digest, 0, sizeof(digest));
+}
+
+
+void CounterBlockForSegment(uint32_t segmentIndex, bool isLast, uint8_t block[kCCBlockSizeAES128])
+{
+	memset(block, 0, kCCBlockSizeAES128);
+	block[0] = (uint8_t)(segmentIndex >> 24);
+	block[1] = (uint8_t)(segmentIndex >> 16);
+	block[2] = (uint8_t)(segmentIndex >> 8);
+	block[3] = (uint8_t)segmentIndex;
+	block[4] = isLast ? 1 : 0;
+}
+
+
+// CTR mode is symmetric so this is used for both encryption and decryption
+bool CryptSegment(const std::string &encryptionKey, uint32_t segmentIndex, bool isLast,
+				  const char *in, size_t size, char *out)
+{
+	if (size == 0) {
+		return true;
+	}
+	
+	uint8_t counterBlock[kCCBlockSizeAES128];
+	CounterBlockForSegment(segmentIndex, isLast, counterBlock);
+	
+	CCCryptorRef cryptor = NULL;
+	CCCryptorStatus status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES, ccNoPadding,
+													 counterBlock, encryptionKey.data(), kCCKeySizeAES256,
+													 NULL, 0, 0, kCCModeOptionCTR_BE, &cryptor);
+	if (status != kCCSuccess) {
+		spreed_me_log("Couldn't create AES CTR cryptor (%d)", status);
+		return false;
+	}
+	
+	size_t moved = 0;
+	status = CCCryptorUpdate(cryptor, in, size, out, size, &moved);
+	CCCryptorRelease(cryptor);
+	
+	return status == kCCSuccess && moved == size;
+}
+
+
+void SegmentTag(const std::string &macKey, const std::string &header, uint32_t segmentIndex, bool isLast,
+				const char *cipherText, size_t size, uint8_t tag[kSegmentedFileTagSize])
+{
+	uint8_t counterBlock[kCCBlockSizeAES128];
+	CounterBlockForSegment(segmentIndex, isLast, counterBlock); // first 5 bytes of counter block are exactly what we need
+	
+	CCHmacContext ctx;
+	CCHmacInit(&ctx, kCCHmacAlgSHA256, macKey.data(), macKey.size());
+	CCHmacUpdate(&ctx, header.data(), header.size());
+	CCHmacUpdate(&ctx, counterBlock, 5);
+	CCHmacUpdate(&ctx, cipherText, size);
+	
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CCHmacFinal(&ctx, digest);
+	memcpy(tag, digest, kSegmentedFileTagSize);
+}
+
+
+bool TagsAreEqual(const uint8_t *tag1, const uint8_t *tag2)
+{
+	uint8_t diff = 0;
+	for (size_t i = 0; i < kSegmentedFileTagSize; ++i) {
+		diff |= tag1[i] ^ tag2[i];
+	}
+	return diff == 0;
+}
+
+
+// Segment count and plaintext size from encrypted file size. Returns false if file size is impossible.
+bool LayoutForFileSize(uint64_t fileSize, uint32_t segmentSize, uint32_t *segmentCount, uint64_t *plaintextSize)
+{
+	if (fileSize < kSegmentedFileHeaderSize + kSegmentedFileTagSize) {
+		return false;
+	}
+	
+	uint64_t body = fileSize - kSegmentedFileHeaderSize;
+	uint64_t fullSegmentSize = (uint64_t)segmentSize + kSegmentedFileTagSize;
+	uint64_t fullSegments = body / fullSegmentSize;
+	uint64_t remainder = body % fullSegmentSize;
+	
+	if (remainder == 0) {
+		// last segment is a full one
+		*plaintextSize = fullSegments * segmentSize;
+	} else if (remainder >= kSegmentedFileTagSize) {
+		*plaintextSize = fullSegments * segmentSize + (remainder - kSegmentedFileTagSize);
+		++fullSegments;
+	} else {
+		return false;
+	}
+	
+	if (fullSegments > UINT32_MAX) {
+		return false;
+	}
+	
+	*segmentCount = (uint32_t)fullSegments;
+	return true;
+}
+	
+} // namespace
+
+
+/*-------------------------------------- SegmentedFileWriter -----------------------------------------*/
+
+SegmentedFileWriter::SegmentedFileWriter() :
+	segmentSize_(0),
+	nextSegmentIndex_(0)
+{
+}
+
+
+SegmentedFileWriter::~SegmentedFileWriter()
+{
+	this->Close();
+}
+
+
+bool SegmentedFileWriter::Open(const std::string &path, const std::string &key, uint32_t segmentSize)
+{
+	if (key.size() != kSegmentedFileKeySize || segmentSize == 0) {
+		spreed_me_log("Wrong key size %lu or segment size %u", key.size(), segmentSize);
+		return false;
+	}
+	
+	this->Close();
+	
+	file_.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file_.is_open()) {
+		spreed_me_log("Couldn't open file for segmented encryption %s", path.c_str());
+		return false;
+	}
+	
+	char header[kSegmentedFileHeaderSize];
+	memset(header, 0, sizeof(header));
+	memcpy(header, kSegmentedFileMagic, sizeof(kSegmentedFileMagic));
+	header[4] = (char)kSegmentedFileVersion;
+	WriteUInt32LE(segmentSize, header + 8);
+	arc4random_buf(header + kSegmentedFileSaltOffset, kSegmentedFileSaltSize);
+	
+	header_.assign(header, sizeof(header));
+	segmentSize_ = segmentSize;
+	nextSegmentIndex_ = 0;
+	pending_.clear();
+	DeriveKeys(key, header_, &encryptionKey_, &macKey_);
+	
+	file_.write(header_.data(), header_.size());
+	
+	return file_.good();
+}
+
+
+bool SegmentedFileWriter::WriteSegment(uint32_t segmentIndex, const char *data, uint32_t size, bool isLast)
+{
+	if (!file_.is_open()) {
+		return false;
+	}
+	
+	if (size > segmentSize_ || (!isLast && size != segmentSize_)) {
+		spreed_me_log("Wrong segment size %u for segment %u, segment size is %u", size, segmentIndex, segmentSize_);
+		return false;
+	}
+	
+	cipherText_.resize(size + kSegmentedFileTagSize);
+	char *cipherText = &cipherText_[0];
+	
+	if (!CryptSegment(encryptionKey_, segmentIndex, isLast, data, size, cipherText)) {
+		return false;
+	}
+	SegmentTag(macKey_, header_, segmentIndex, isLast, cipherText, size, (uint8_t *)(cipherText + size));
+	
+	uint64_t offset = kSegmentedFileHeaderSize + (uint64_t)segmentIndex * (segmentSize_ + kSegmentedFileTagSize);
+	file_.seekp(offset);
+	file_.write(cipherText, cipherText_.size());
+	
+	return file_.good();
+}
+
+
+bool SegmentedFileWriter::Append(const char *data, size_t size)
+{
+	pending_.append(data, size);
+	
+	// Keep at least one full segment buffered, we don't know yet if it is the last one.
+	size_t written = 0;
+	while (pending_.size() - written > segmentSize_) {
+		if (!this->WriteSegment(nextSegmentIndex_, pending_.data() + written, segmentSize_, false)) {
+			return false;
+		}
+		++nextSegmentIndex_;
+		written += segmentSize_;
+	}
+	pending_.erase(0, written);
+	
+	return true;
+}
+
+
+bool SegmentedFileWriter::Finish()
+{
+	bool success = this->WriteSegment(nextSegmentIndex_, pending_.data(), (uint32_t)pending_.size(), true);
+	
+	file_.flush();
+	success = success && file_.good();
+	
+	this->Close();
+	
+	return success;
+}
+
+
+void SegmentedFileWriter::Close()
+{
+	if (file_.is_open()) {
+		file_.close();
+	}
+	
+	// don't keep keys around longer than needed
+	encryptionKey_.assign(encryptionKey_.size(), '\0');
+	macKey_.assign(macKey_.size(), '\0');
+	pending_.clear();
+}
+
+
+/*-------------------------------------- SegmentedFileReader -----------------------------------------*/
+
+SegmentedFileReader::SegmentedFileReader() :
+	segmentSize_(0),
+	segmentCount_(0),
+	plaintextSize_(0)
+{
+}
+
+
+bool SegmentedFileReader::ReadHeader(std::string *header, uint64_t *fileSize)
+{
+	file_.seekg(0, std::ios::end);
+	*fileSize = file_.tellg();
+	file_.seekg(0);
+	
+	char buf[kSegmentedFileHeaderSize];
+	file_.read(buf, sizeof(buf));
+	if (!file_.good()) {
+		return false;
+	}
+	
+	header->assign(buf, sizeof(buf));
+	return true;
+}
+
+
+bool SegmentedFileReader::Open(const std::string &path, const std::string &key)
+{
+	if (key.size() != kSegmentedFileKeySize) {
+		spreed_me_log("Wrong key size %lu", key.size());
+		return false;
+	}
+	
+	file_.open(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file_.is_open()) {
+		spreed_me_log("Couldn't open segmented encrypted file %s", path.c_str());
+		return false;
+	}
+	
+	uint64_t fileSize = 0;
+	if (!this->ReadHeader(&header_, &fileSize)) {
+		file_.close();
+		return false;
+	}
+	
+	segmentSize_ = ParseHeader(header_);
+	if (segmentSize_ == 0 || !LayoutForFileSize(fileSize, segmentSize_, &segmentCount_, &plaintextSize_)) {
+		spreed_me_log("File %s is not a segmented encrypted file", path.c_str());
+		file_.close();
+		return false;
+	}
+	
+	DeriveKeys(key, header_, &encryptionKey_, &macKey_);
+	
+	return true;
+}
+
+
+bool SegmentedFileReader::ReadSegment(uint32_t segmentIndex, std::string *plainText)
+{
+	if (!file_.is_open() || segmentIndex >= segmentCount_) {
+		return false;
+	}
+	
+	bool isLast = (segmentIndex == segmentCount_ - 1);
+	uint32_t size = isLast ? (uint32_t)(plaintextSize_ - (uint64_t)segmentIndex * segmentSize_) : segmentSize_;
+	
+	segment_.resize(size + kSegmentedFileTagSize);
+	char *cipherText = &segment_[0];
+	
+	file_.clear();
+	file_.seekg(kSegmentedFileHeaderSize + (uint64_t)segmentIndex * (segmentSize_ + kSegmentedFileTagSize));
+	file_.read(cipherText, segment_.size());
+	if (!file_.good()) {
+		spreed_me_log("Couldn't read segment %u", segmentIndex);
+		return false;
+	}
+	
+	uint8_t tag[kSegmentedFileTagSize];
+	SegmentTag(macKey_, header_, segmentIndex, isLast, cipherText, size, tag);
+	if (!TagsAreEqual(tag, (const uint8_t *)(cipherText + size))) {
+		spreed_me_log("Segment %u authentication failed", segmentIndex);
+		return false;
+	}
+	
+	plainText->resize(size);
+	if (size > 0) {
+		return CryptSegment(encryptionKey_, segmentIndex, isLast, cipherText, size, &(*plainText)[0]);
+	}
+	
+	return true;
+}
+
+
+bool SegmentedFileReader::ReadRange(uint64_t offset, char *buffer, size_t length, size_t *bytesRead)
+{
+	*bytesRead = 0;
+	
+	if (offset >= plaintextSize_) {
+		return offset == plaintextSize_;
+	}
+	
+	if (length > plaintextSize_ - offset) {
+		length = (size_t)(plaintextSize_ - offset);
+	}
+	
+	std::string plainText;
+	while (*bytesRead < length) {
+		uint64_t position = offset + *bytesRead;
+		uint32_t segmentIndex = (uint32_t)(position / segmentSize_);
+		size_t inSegmentOffset = (size_t)(position % segmentSize_);
+		
+		if (!this->ReadSegment(segmentIndex, &plainText)) {
+			return false;
+		}
+		
+		size_t toCopy = plainText.size() - inSegmentOffset;
+		if (toCopy > length - *bytesRead) {
+			toCopy = length - *bytesRead;
+		}
+		memcpy(buffer + *bytesRead, plainText.data() + inSegmentOffset, toCopy);
+		*bytesRead += toCopy;
+	}
+	
+	return true;
+}
+
+
+bool SegmentedFileReader::PlaintextSizeOfFile(const std::string &path, uint64_t *plaintextSize)
+{
+	SegmentedFileReader reader;
+	reader.file_.open(path.c_str(), std::ios::in | std::ios::binary);
+	if (!reader.file_.is_open()) {
+		return false;
+	}
+	
+	std::string header;
+	uint64_t fileSize = 0;
+	uint32_t segmentCount = 0;
+	if (!reader.ReadHeader(&header, &fileSize)) {
+		return false;
+	}
+	
+	uint32_t segmentSize = ParseHeader(header);
+	return segmentSize != 0 && LayoutForFileSize(fileSize, segmentSize, &segmentCount, plaintextSize);
+}
+
+
+/*-------------------------------------- C interface -----------------------------------------*/
+
+bool SegmentedFileEncryptFile(const char *srcPath, const char *dstPath, const uint8_t *key, size_t keyLength, uint32_t segmentSize)
+{
+	std::ifstream src(srcPath, std::ios::in | std::ios::binary);
+	if (!src.is_open()) {
+		spreed_me_log("Couldn't open file for encryption %s", srcPath);
+		return false;
+	}
+	
+	if (segmentSize == 0) {
+		segmentSize = kSegmentedFileDefaultSegmentSize;
+	}
+	
+	SegmentedFileWriter writer;
+	if (!writer.Open(dstPath, std::string((const char *)key, keyLength), segmentSize)) {
+		return false;
+	}
+	
+	std::string buffer(segmentSize, '\0');
+	while (src.good()) {
+		src.read(&buffer[0], buffer.size());
+		if (src.gcount() > 0 && !writer.Append(buffer.data(), (size_t)src.gcount())) {
+			return false;
+		}
+	}
+	
+	if (!src.eof()) {
+		spreed_me_log("Error reading file for encryption %s", srcPath);
+		return false;
+	}
+	
+	return writer.Finish();
+}
+
+
+bool SegmentedFileDecryptFile(const char *srcPath, const char *dstPath, const uint8_t *key, size_t keyLength)
+{
+	SegmentedFileReader reader;
+	if (!reader.Open(srcPath, std::string((const char *)key, keyLength))) {
+		return false;
+	}
+	
+	std::ofstream dst(dstPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!dst.is_open()) {
+		spreed_me_log("Couldn't open file for decrypted data %s", dstPath);
+		return false;
+	}
+	
+	std::string plainText;
+	for (uint32_t i = 0; i < reader.segmentCount(); ++i) {
+		if (!reader.ReadSegment(i, &plainText)) {
+			return false;
+		}
+		dst.write(plainText.data(), plainText.size());
+	}
+	
+	dst.flush();
+	return dst.good();
+}
+
+
+bool SegmentedFileReadRange(const char *path, const uint8_t *key, size_t keyLength,
+							uint64_t offset, void *buffer, size_t length, size_t *bytesRead)
+{
+	SegmentedFileReader reader;
+	if (!reader.Open(path, std::string((const char *)key, keyLength))) {
+		return false;
+	}
+	
+	return reader.ReadRange(offset, (char *)buffer, length, bytesRead);
+}
+
+
+bool SegmentedFilePlaintextSize(const char *path, uint64_t *plaintextSize)
+{
+	return SegmentedFileReader::PlaintextSizeOfFile(path, plaintextSize);
+}
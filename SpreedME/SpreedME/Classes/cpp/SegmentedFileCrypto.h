@@ -0,0 +1,158 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__SegmentedFileCrypto__
+#define __SpreedME__SegmentedFileCrypto__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ Segmented encrypted file format. Plaintext is split into segments of fixed size (the last one can be shorter),
+ every segment is encrypted and authenticated on its own so files can be written and read in O(segment) memory
+ and any segment can be decrypted without touching the rest of the file.
+ 
+ header:  "SMSE" | version (1 byte) | 3 zero bytes | segment size (uint32 LE) | salt (16 bytes)
+ segment: AES-256-CTR ciphertext | HMAC-SHA256 tag truncated to 16 bytes
+ 
+ Encryption and MAC keys are derived per file from the 32 byte master key and the salt.
+ Counter block of a segment is (segment index BE32 | last segment flag | zeros), the tag covers
+ the header, segment index, last segment flag and ciphertext, so segments can't be
+ reordered, dropped from the end or moved to another file.
+ */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Plain C interface for Objective-C code. Key has to be 32 bytes long. Functions return false on any I/O,
+// format or authentication error, output files are not removed in this case. segmentSize 0 means default segment size.
+bool SegmentedFileEncryptFile(const char *srcPath, const char *dstPath, const uint8_t *key, size_t keyLength, uint32_t segmentSize);
+bool SegmentedFileDecryptFile(const char *srcPath, const char *dstPath, const uint8_t *key, size_t keyLength);
+// Reads up to @length plaintext bytes starting from @offset. Only segments covering requested range are decrypted.
+bool SegmentedFileReadRange(const char *path, const uint8_t *key, size_t keyLength,
+							uint64_t offset, void *buffer, size_t length, size_t *bytesRead);
+bool SegmentedFilePlaintextSize(const char *path, uint64_t *plaintextSize);
+
+#ifdef __cplusplus
+} // extern C
+#endif
+
+
+#ifdef __cplusplus
+
+#include <fstream>
+#include <string>
+
+namespace spreedme {
+
+const uint32_t kSegmentedFileDefaultSegmentSize = 64 * 1024;
+const uint32_t kSegmentedFileHeaderSize = 28;
+const uint32_t kSegmentedFileTagSize = 16;
+const uint32_t kSegmentedFileKeySize = 32;
+	
+
+class SegmentedFileWriter
+{
+public:
+	SegmentedFileWriter();
+	~SegmentedFileWriter(); // closes file if it is still opened
+	
+	// Creates (truncates) file at @path and writes header with a new random salt.
+	bool Open(const std::string &path, const std::string &key, uint32_t segmentSize);
+	
+	// Writes segment at its place in the file, segments can come in any order.
+	// Every segment but the last has to be exactly segmentSize() long.
+	// Segment must not be written twice with different contents since its counter block doesn't change.
+	bool WriteSegment(uint32_t segmentIndex, const char *data, uint32_t size, bool isLast);
+	
+	// Sequential interface. Buffers data up to one segment and writes full segments.
+	bool Append(const char *data, size_t size);
+	bool Finish(); // writes buffered data as the last segment and closes file
+	
+	void Close();
+	
+	bool isOpen() const {return file_.is_open();};
+	uint32_t segmentSize() const {return segmentSize_;};
+	
+private:
+	SegmentedFileWriter(const SegmentedFileWriter &);
+	SegmentedFileWriter &operator=(const SegmentedFileWriter &);
+	
+	std::fstream file_;
+	std::string header_;
+	std::string encryptionKey_;
+	std::string macKey_;
+	uint32_t segmentSize_;
+	
+	std::string pending_; // Append() buffer
+	uint32_t nextSegmentIndex_;
+	
+	std::string cipherText_; // reused between segments
+};
+	
+
+class SegmentedFileReader
+{
+public:
+	SegmentedFileReader();
+	~SegmentedFileReader() {};
+	
+	// Reads and checks header. Doesn't check any segment yet.
+	bool Open(const std::string &path, const std::string &key);
+	void Close() {file_.close();};
+	
+	// Decrypts and authenticates segment into @plainText.
+	bool ReadSegment(uint32_t segmentIndex, std::string *plainText);
+	// Reads plaintext range, decrypts only segments which intersect it.
+	bool ReadRange(uint64_t offset, char *buffer, size_t length, size_t *bytesRead);
+	
+	uint32_t segmentSize() const {return segmentSize_;};
+	uint32_t segmentCount() const {return segmentCount_;};
+	uint64_t plaintextSize() const {return plaintextSize_;};
+	
+	static bool PlaintextSizeOfFile(const std::string &path, uint64_t *plaintextSize);
+	
+private:
+	SegmentedFileReader(const SegmentedFileReader &);
+	SegmentedFileReader &operator=(const SegmentedFileReader &);
+	
+	bool ReadHeader(std::string *header, uint64_t *fileSize);
+	
+	std::ifstream file_;
+	std::string header_;
+	std::string encryptionKey_;
+	std::string macKey_;
+	uint32_t segmentSize_;
+	uint32_t segmentCount_;
+	uint64_t plaintextSize_;
+	
+	std::string segment_; // reused between segments
+};
+
+} // namespace spreedme
+
+#endif // __cplusplus
+
+#endif /* defined(__SpreedME__SegmentedFileCrypto__) */
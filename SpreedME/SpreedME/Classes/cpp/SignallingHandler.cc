@@ -100,26 +100,93 @@ void SignallingHandler::ReceiveMessage(const std::string &msg, ChannelingMessage
 	
 	bool isJsonValid = reader.parse(msg, root);
 	if (isJsonValid) {
-		
-		Json::Value innerJson = root[kDataKey];
-		if (!innerJson.isNull()) {
-			std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
-			if (!messageType.empty()) {
-				if (messageType == kOfferKey || messageType == kAnswerKey || messageType == kCandidateKey) {
-					Json::Value offerAnswerCand = innerJson[messageType];
-					std::string token = offerAnswerCand.get(kDataChannelTokenKey, Json::Value()).asString();
-					if (!token.empty()) {
-						for (std::set<SignallingMessageReceiverInterface *>::iterator it = tokenMessageReceivers_.begin(); it != tokenMessageReceivers_.end(); ++it) {
-							(*it)->MessageReceived(msg, transportType, wrapperId, token);
+		this->ReceiveMessage(root, msg, transportType, wrapperId);
+	}
+}
+
+
+void SignallingHandler::ReceiveMessage(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+{
+	const Json::Value &innerJson = root[kDataKey];
+	if (!innerJson.isNull()) {
+		std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
+		if (!messageType.empty()) {
+			if (messageType == kOfferKey || messageType == kAnswerKey || messageType == kCandidateKey) {
+				const Json::Value &offerAnswerCand = innerJson[messageType];
+				std::string token = offerAnswerCand.get(kDataChannelTokenKey, Json::Value()).asString();
+				if (!token.empty()) {
+					receiversCritSect_->Enter();
+					std::set<SignallingMessageReceiverInterface *> tokenMessageReceivers = tokenMessageReceivers_;
+					receiversCritSect_->Leave();
+					
+					for (std::set<SignallingMessageReceiverInterface *>::iterator it = tokenMessageReceivers.begin(); it != tokenMessageReceivers.end(); ++it) {
+						if (this->BeginDispatch(*it, tokenMessageReceivers_)) {
+							(*it)->MessageReceived(root, msg, transportType, wrapperId, token);
+							this->EndDispatch(*it);
 						}
-						return;
-                    }
+					}
+					return;
 				}
 			}
 		}
+	}
 	
-		for (std::set<SignallingMessageReceiverInterface *>::iterator it = messageReceivers_.begin(); it != messageReceivers_.end(); ++it) {
-			(*it)->MessageReceived(msg, transportType, wrapperId);
+	receiversCritSect_->Enter();
+	std::set<SignallingMessageReceiverInterface *> messageReceivers = messageReceivers_;
+	receiversCritSect_->Leave();
+	
+	for (std::set<SignallingMessageReceiverInterface *>::iterator it = messageReceivers.begin(); it != messageReceivers.end(); ++it) {
+		// Receiver might have been unregistered by one of previous receivers.
+		if (this->BeginDispatch(*it, messageReceivers_)) {
+			(*it)->MessageReceived(root, msg, transportType, wrapperId);
+			this->EndDispatch(*it);
+		}
+	}
+}
+
+
+bool SignallingHandler::BeginDispatch(SignallingMessageReceiverInterface *receiver, const std::set<SignallingMessageReceiverInterface *> &receivers)
+{
+	webrtc::CriticalSectionScoped sc(receiversCritSect_);
+	if (receivers.find(receiver) == receivers.end()) {
+		return false;
+	}
+	dispatchingReceivers_.insert(std::make_pair(receiver, pthread_self()));
+	return true;
+}
+
+
+void SignallingHandler::EndDispatch(SignallingMessageReceiverInterface *receiver)
+{
+	webrtc::CriticalSectionScoped sc(receiversCritSect_);
+	typedef std::multimap<SignallingMessageReceiverInterface *, pthread_t>::iterator DispatchIterator;
+	std::pair<DispatchIterator, DispatchIterator> range = dispatchingReceivers_.equal_range(receiver);
+	for (DispatchIterator it = range.first; it != range.second; ++it) {
+		if (pthread_equal(it->second, pthread_self())) {
+			dispatchingReceivers_.erase(it);
+			break;
+		}
+	}
+	dispatchFinished_->WakeAll();
+}
+
+
+void SignallingHandler::WaitForDispatchToFinish_l(SignallingMessageReceiverInterface *receiver)
+{
+	// Calls on current thread are up the stack of the caller and can't be waited for.
+	typedef std::multimap<SignallingMessageReceiverInterface *, pthread_t>::iterator DispatchIterator;
+	bool isCalledOnOtherThread = true;
+	while (isCalledOnOtherThread) {
+		isCalledOnOtherThread = false;
+		std::pair<DispatchIterator, DispatchIterator> range = dispatchingReceivers_.equal_range(receiver);
+		for (DispatchIterator it = range.first; it != range.second; ++it) {
+			if (!pthread_equal(it->second, pthread_self())) {
+				isCalledOnOtherThread = true;
+				break;
+			}
+		}
+		if (isCalledOnOtherThread) {
+			dispatchFinished_->SleepCS(*receiversCritSect_);
 		}
 	}
 }
@@ -128,6 +195,7 @@ void SignallingHandler::ReceiveMessage(const std::string &msg, ChannelingMessage
 void SignallingHandler::RegisterMessageReceiver(SignallingMessageReceiverInterface *receiver)
 {
 	if (receiver) {
+		webrtc::CriticalSectionScoped sc(receiversCritSect_);
 		messageReceivers_.insert(receiver);
 	}
 }
@@ -136,7 +204,9 @@ void SignallingHandler::RegisterMessageReceiver(SignallingMessageReceiverInterfa
 void SignallingHandler::UnRegisterMessageReceiver(SignallingMessageReceiverInterface *receiver)
 {
 	if (receiver) {
+		webrtc::CriticalSectionScoped sc(receiversCritSect_);
 		messageReceivers_.erase(receiver);
+		this->WaitForDispatchToFinish_l(receiver);
 	}
 }
 
@@ -144,6 +214,7 @@ void SignallingHandler::UnRegisterMessageReceiver(SignallingMessageReceiverInter
 void SignallingHandler::RegisterTokenMessageReceiver(SignallingMessageReceiverInterface *receiver)
 {
 	if (receiver) {
+		webrtc::CriticalSectionScoped sc(receiversCritSect_);
 		tokenMessageReceivers_.insert(receiver);
 	}
 }
@@ -152,7 +223,9 @@ void SignallingHandler::RegisterTokenMessageReceiver(SignallingMessageReceiverIn
 void SignallingHandler::UnRegisterTokenMessageReceiver(SignallingMessageReceiverInterface *receiver)
 {
 	if (receiver) {
+		webrtc::CriticalSectionScoped sc(receiversCritSect_);
 		tokenMessageReceivers_.erase(receiver);
+		this->WaitForDispatchToFinish_l(receiver);
 	}
 }
 
@@ -346,9 +419,11 @@ void SignallingHandler::ReceivedDataChannelData(webrtc::DataBuffer *buffer,
 				
 				SignallingHandler::WrapP2PJson(message, to, from, root);
 				
-				std::string msg = root.toStyledString();
+				// Receivers get parsed tree, string is only needed for recording and string based receivers.
+				Json::FastWriter writer;
+				std::string msg = writer.write(root);
 				
-				this->ReceiveMessage(msg, kPeerToPeer, wrapper->factoryId());
+				this->ReceiveMessage(root, msg, kPeerToPeer, wrapper->factoryId());
 			} else {
 				spreed_me_log("JSON message is not recognized! %s", strMsg.c_str());
 			}
@@ -384,6 +459,7 @@ bool SignallingHandler::IsChannelingMessage(const Json::Value &msg)
 			messageType == kChatKey ||
 			messageType == kTalkingKey ||
 			messageType == kScreenShareKey ||
+			messageType == kVideoSubscriptionKey ||
 			messageType == kHelloKey ||
 			messageType == kSelfKey
 			) {
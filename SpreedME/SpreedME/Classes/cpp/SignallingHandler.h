@@ -27,10 +27,14 @@
 #include <map>
 #include <set>
 
+#include <pthread.h>
+
 #include "SignallingHandlerInterface.h"
 
 #include <webrtc/base/json.h>
 #include <talk/app/webrtc/datachannelinterface.h>
+#include <system_wrappers/interface/condition_variable_wrapper.h>
+#include <system_wrappers/interface/critical_section_wrapper.h>
 
 #include "WebrtcCommonDefinitions.h"
 
@@ -52,7 +56,10 @@ class SignallingHandler : public SignallingHandlerInterface,
 public:
 	
 	SignallingHandler(std::string selfId, ServerBasedMessageSenderInterface *serverSender) :
-		serverSender_(serverSender), wrapperProvider_(NULL), selfId_(selfId) {};
+		serverSender_(serverSender), wrapperProvider_(NULL),
+		receiversCritSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+		dispatchFinished_(webrtc::ConditionVariableWrapper::CreateConditionVariable()), selfId_(selfId) {};
+	virtual ~SignallingHandler() {delete dispatchFinished_; delete receiversCritSect_;};
 	
 	virtual void SetSelfId(const std::string &selfId) {selfId_ = selfId;};
 	virtual std::string selfId() {return selfId_;};
@@ -66,11 +73,17 @@ public:
 	virtual void SendMessage(const std::string &type, const std::string &msg, const std::string &userId, const std::string &wrapperId);
 	
 	virtual void ReceiveMessage(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId);
+	virtual void ReceiveMessage(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId);
 	
 	virtual void RegisterMessageReceiver(SignallingMessageReceiverInterface *receiver);
+	/*
+	 After this returns the receiver is not called anymore and is not being called on any other thread,
+	 so it can be deleted. When called from receiver's own MessageReceived() it doesn't wait for that call.
+	 */
 	virtual void UnRegisterMessageReceiver(SignallingMessageReceiverInterface *receiver);
 
 	virtual void RegisterTokenMessageReceiver(SignallingMessageReceiverInterface *receiver);
+	// Waits for calls on other threads the same way UnRegisterMessageReceiver() does.
 	virtual void UnRegisterTokenMessageReceiver(SignallingMessageReceiverInterface *receiver);
 	
 	//================= Convenience methods ==============
@@ -125,11 +138,25 @@ public:
 private:
 	SignallingHandler();
 	
+	// Returns false if receiver is not in receivers anymore. Otherwise marks receiver as being called on current thread.
+	bool BeginDispatch(SignallingMessageReceiverInterface *receiver, const std::set<SignallingMessageReceiverInterface *> &receivers);
+	void EndDispatch(SignallingMessageReceiverInterface *receiver);
+	void WaitForDispatchToFinish_l(SignallingMessageReceiverInterface *receiver);
+	
 	ServerBasedMessageSenderInterface *serverSender_; // we do not own it
 	PeerConnectionWrapperProviderInterface *wrapperProvider_; // we do not own it
 	
+	// Receivers are registered and unregistered from main and worker threads and messages
+	// arrive from main thread (channeling server) and signalling thread (P2P).
+	// Receivers sets are only accessed under receiversCritSect_. Receivers are called outside of lock
+	// so they can (un)register themselves while handling a message.
 	std::set<SignallingMessageReceiverInterface *> messageReceivers_;
 	std::set<SignallingMessageReceiverInterface *> tokenMessageReceivers_;
+	webrtc::CriticalSectionWrapper *receiversCritSect_;
+	// Receivers which are being called right now and threads calling them. Accessed under receiversCritSect_.
+	// Unregistering waits on dispatchFinished_ until receiver is not called from other threads.
+	std::multimap<SignallingMessageReceiverInterface *, pthread_t> dispatchingReceivers_;
+	webrtc::ConditionVariableWrapper *dispatchFinished_;
 	
 	
 	std::string selfId_;
@@ -27,6 +27,7 @@
 #include <string>
 
 #include <talk/app/webrtc/jsep.h>
+#include <webrtc/base/json.h>
 
 #include "ChannelingConstants.h"
 
@@ -54,6 +55,19 @@ class SignallingMessageReceiverInterface {
 public:
 	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId) = 0;
 	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token) = 0;
+	
+	/*
+	 Same as above but with already parsed @root of @msg. Default implementations fall back to string variants.
+	 Receivers which work on json should override these to avoid parsing the same message again.
+	 */
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+	{
+		this->MessageReceived(msg, transportType, wrapperId);
+	}
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+	{
+		this->MessageReceived(msg, transportType, wrapperId, token);
+	}
 };
 
 
@@ -88,6 +102,10 @@ public:
 	 Receives message and dispatches it to message receivers.
 	 */
 	virtual void ReceiveMessage(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId) = 0;
+	/*
+	 Same as above for messages which were already parsed by the caller. @root must be the parsed @msg.
+	 */
+	virtual void ReceiveMessage(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId) = 0;
 	
 	/* 
 	 Registers and unregisters message receivers. Uses std:set inside, so you can't register one object twice.
@@ -0,0 +1,329 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SignallingMessageAnonymizer.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "ChannelingConstants.h"
+
+using namespace spreedme;
+
+
+namespace {
+
+typedef enum Anonymization {
+	kAnonymizationNone = 0,
+	kAnonymizationPseudonym,
+	kAnonymizationMask,
+	kAnonymizationPicture,
+	kAnonymizationSdp,
+	kAnonymizationLocation,
+}
+Anonymization;
+
+
+Anonymization AnonymizationForKey(const std::string &key)
+{
+	if (key == kIdKey || key == kLCIdKey || key == kSIdKey || key == kIidKey ||
+		key == kFromKey || key == kToKey ||
+		key == kUserIdKey || key == kLCUserIdKey || key == kSUserIdKey ||
+		key == kTokenKey || key == kLCTokenKey || key == kAttestationTokenKey ||
+		key == kNonceKey || key == kLCNonceKey ||
+		key == kDataChannelTokenKey || key == kDataChannelIdKey || key == kOfferConferenceKey ||
+		key == kConferenceKey || key == kMidKey || key == kSeenMidsKey || key == kNameKey ||
+		key == kLCUserIdComboKey || key == kLCUserComboKey ||
+		key == kLCAccess_TokenKey || key == kLCRefresh_TokenKey || key == kLCApplication_TokenKey) {
+		return kAnonymizationPseudonym;
+	} else if (key == kMessageKey || key == kLCMessageKey ||
+			   key == kLCDisplayNameKey || key == kOCDisplayNameKey || key == kLCNameKey ||
+			   key == kLCUserNameKey || key == kLCPasswordKey || key == kLCSecretKey ||
+			   key == kLCUrlKey || key == kLCUrlsKey) {
+		return kAnonymizationMask;
+	} else if (key == kLCBuddyPictureKey) {
+		return kAnonymizationPicture;
+	} else if (key == kSessionDescriptionSdpKey || key == kCandidateSdpKey) {
+		return kAnonymizationSdp;
+	} else if (key == kLCLatitudeKey || key == kLCLongitudeKey || key == kLCAltitudeKey) {
+		return kAnonymizationLocation;
+	}
+	
+	return kAnonymizationNone;
+}
+
+
+bool EndsWith(const std::string &string, const std::string &suffix)
+{
+	return string.size() >= suffix.size() && string.compare(string.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+
+bool IsHexDigit(char c)
+{
+	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+} // namespace
+
+
+std::string SignallingMessageAnonymizer::AnonymizeMessage(const std::string &msg)
+{
+	Json::Reader reader;
+	Json::Value root;
+	if (!reader.parse(msg, root)) {
+		return std::string();
+	}
+	
+	this->AnonymizeJson(&root);
+	
+	Json::FastWriter writer;
+	std::string anonymized = writer.write(root);
+	while (!anonymized.empty() && anonymized[anonymized.size() - 1] == '\n') {
+		anonymized.resize(anonymized.size() - 1);
+	}
+	
+	return anonymized;
+}
+
+
+void SignallingMessageAnonymizer::AnonymizeJson(Json::Value *value)
+{
+	this->AnonymizeValue(std::string(), value);
+}
+
+
+void SignallingMessageAnonymizer::Reset()
+{
+	ids_.clear();
+	addresses_.clear();
+}
+
+
+void SignallingMessageAnonymizer::AnonymizeValue(const std::string &key, Json::Value *value)
+{
+	if (value->isObject()) {
+		Json::Value::Members members = value->getMemberNames();
+		for (Json::Value::Members::iterator it = members.begin(); it != members.end(); ++it) {
+			this->AnonymizeValue(*it, &(*value)[*it]);
+		}
+	} else if (value->isArray()) {
+		// Elements of arrays inherit key of the array, e.g. ids in Conference
+		for (Json::ArrayIndex i = 0; i < value->size(); ++i) {
+			this->AnonymizeValue(key, &(*value)[i]);
+		}
+	} else if (value->isString()) {
+		std::string string = value->asString();
+		switch (AnonymizationForKey(key)) {
+			case kAnonymizationPseudonym:
+				*value = this->PseudonymForId(string);
+				break;
+			case kAnonymizationMask:
+				*value = SignallingMessageAnonymizer::Masked(string);
+				break;
+			case kAnonymizationPicture: {
+				// Keep data url header, e.g. 'data:image/jpeg;base64,'
+				size_t comma = string.find(',');
+				size_t keep = comma != std::string::npos ? comma + 1 : 0;
+				*value = string.substr(0, keep) + std::string(string.size() - keep, 'A');
+			}
+				break;
+			case kAnonymizationSdp:
+				*value = this->AnonymizeSdp(string);
+				break;
+			case kAnonymizationLocation:
+				*value = SignallingMessageAnonymizer::Masked(string);
+				break;
+			case kAnonymizationNone:
+			default:
+				break;
+		}
+	} else if (value->isNumeric() && AnonymizationForKey(key) == kAnonymizationLocation) {
+		*value = 0;
+	}
+}
+
+
+std::string SignallingMessageAnonymizer::AnonymizeSdp(const std::string &sdp)
+{
+	std::string anonymized;
+	anonymized.reserve(sdp.size());
+	
+	size_t lineStart = 0;
+	while (lineStart < sdp.size()) {
+		size_t lineEnd = sdp.find_first_of("\r\n", lineStart);
+		if (lineEnd == std::string::npos) {
+			lineEnd = sdp.size();
+		}
+		anonymized += this->AnonymizeSdpLine(sdp.substr(lineStart, lineEnd - lineStart));
+		
+		size_t nextLineStart = sdp.find_first_not_of("\r\n", lineEnd);
+		if (nextLineStart == std::string::npos) {
+			nextLineStart = sdp.size();
+		}
+		anonymized.append(sdp, lineEnd, nextLineStart - lineEnd);
+		lineStart = nextLineStart;
+	}
+	
+	return anonymized;
+}
+
+
+std::string SignallingMessageAnonymizer::AnonymizeSdpLine(const std::string &line)
+{
+	static const std::string kIceUfrag("a=ice-ufrag:");
+	static const std::string kIcePwd("a=ice-pwd:");
+	static const std::string kFingerprint("a=fingerprint:");
+	static const std::string kSsrc("a=ssrc:");
+	static const std::string kCname("cname:");
+	static const std::string kCandidate("candidate:");
+	static const std::string kCandidateAttribute("a=candidate:");
+	
+	if (line.compare(0, kIceUfrag.size(), kIceUfrag) == 0 ||
+		line.compare(0, kIcePwd.size(), kIcePwd) == 0) {
+		size_t colon = line.find(':');
+		return line.substr(0, colon + 1) + SignallingMessageAnonymizer::Masked(line.substr(colon + 1));
+	}
+	
+	if (line.compare(0, kFingerprint.size(), kFingerprint) == 0) {
+		// Keep algorithm and format, drop the digest
+		std::string anonymized = line;
+		size_t space = anonymized.find(' ');
+		for (size_t i = space != std::string::npos ? space + 1 : anonymized.size(); i < anonymized.size(); ++i) {
+			if (IsHexDigit(anonymized[i])) {
+				anonymized[i] = '0';
+			}
+		}
+		return anonymized;
+	}
+	
+	if (line.compare(0, kSsrc.size(), kSsrc) == 0) {
+		size_t cname = line.find(kCname);
+		if (cname != std::string::npos) {
+			size_t valueStart = cname + kCname.size();
+			return line.substr(0, valueStart) + SignallingMessageAnonymizer::Masked(line.substr(valueStart));
+		}
+		return line;
+	}
+	
+	// Split into space separated fields, fields are replaced in place
+	std::vector<std::string> fields;
+	size_t fieldStart = 0;
+	while (true) {
+		size_t space = line.find(' ', fieldStart);
+		fields.push_back(line.substr(fieldStart, space == std::string::npos ? std::string::npos : space - fieldStart));
+		if (space == std::string::npos) {
+			break;
+		}
+		fieldStart = space + 1;
+	}
+	
+	bool isCandidate = line.compare(0, kCandidate.size(), kCandidate) == 0 ||
+					   line.compare(0, kCandidateAttribute.size(), kCandidateAttribute) == 0;
+	if (isCandidate) {
+		// candidate:foundation component transport priority address port typ type [raddr address rport port] [ufrag ufrag] ...
+		if (fields.size() > 4) {
+			fields[4] = this->PseudonymForAddress(fields[4]);
+		}
+		for (size_t i = 5; i + 1 < fields.size(); ++i) {
+			if (fields[i] == "raddr") {
+				fields[i + 1] = this->PseudonymForAddress(fields[i + 1]);
+			} else if (fields[i] == "ufrag") {
+				fields[i + 1] = SignallingMessageAnonymizer::Masked(fields[i + 1]);
+			}
+		}
+	} else if (line.compare(0, 2, "o=") == 0 || line.compare(0, 2, "c=") == 0 || line.compare(0, 7, "a=rtcp:") == 0) {
+		// Address is the last field after 'IN IP4'/'IN IP6'
+		if (fields.size() >= 3 && EndsWith(fields[fields.size() - 3], "IN")) {
+			fields.back() = this->PseudonymForAddress(fields.back());
+		}
+	} else {
+		return line;
+	}
+	
+	std::string anonymized;
+	anonymized.reserve(line.size());
+	for (size_t i = 0; i < fields.size(); ++i) {
+		if (i > 0) {
+			anonymized += ' ';
+		}
+		anonymized += fields[i];
+	}
+	return anonymized;
+}
+
+
+std::string SignallingMessageAnonymizer::PseudonymForId(const std::string &id)
+{
+	if (id.empty()) {
+		return id;
+	}
+	
+	std::map<std::string, std::string>::iterator it = ids_.find(id);
+	if (it != ids_.end()) {
+		return it->second;
+	}
+	
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "anon%lu", (unsigned long)ids_.size() + 1);
+	std::string pseudonym(buffer);
+	if (pseudonym.size() < id.size()) {
+		pseudonym.append(id.size() - pseudonym.size(), 'x');
+	}
+	
+	ids_[id] = pseudonym;
+	return pseudonym;
+}
+
+
+std::string SignallingMessageAnonymizer::PseudonymForAddress(const std::string &address)
+{
+	if (address.empty() || address == "0.0.0.0" || address == "127.0.0.1" || address == "::" || address == "::1") {
+		return address;
+	}
+	
+	std::map<std::string, std::string>::iterator it = addresses_.find(address);
+	if (it != addresses_.end()) {
+		return it->second;
+	}
+	
+	unsigned long n = (unsigned long)addresses_.size() + 1;
+	char buffer[48];
+	if (address.find(':') != std::string::npos) {
+		snprintf(buffer, sizeof(buffer), "fd00::%lx", n);
+	} else if (address.find_first_not_of("0123456789.") == std::string::npos) {
+		snprintf(buffer, sizeof(buffer), "10.%lu.%lu.%lu", (n >> 16) & 0xff, (n >> 8) & 0xff, n & 0xff);
+	} else {
+		snprintf(buffer, sizeof(buffer), "anon%lu.local", n); // mDNS host names
+	}
+	
+	std::string pseudonym(buffer);
+	addresses_[address] = pseudonym;
+	return pseudonym;
+}
+
+
+std::string SignallingMessageAnonymizer::Masked(const std::string &value)
+{
+	return std::string(value.size(), 'x');
+}
@@ -0,0 +1,68 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__SignallingMessageAnonymizer__
+#define __SpreedME__SignallingMessageAnonymizer__
+
+#include <map>
+#include <string>
+
+#include <webrtc/base/json.h>
+
+namespace spreedme {
+
+/*
+ Removes personal data from channeling messages so recorded traffic can be shared.
+ Session, user and room ids, tokens and nonces get pseudonyms which are consistent for the lifetime
+ of the anonymizer, so From/To/Id references between messages still match.
+ Chat texts, names, pictures and credentials are masked. Addresses, ICE credentials,
+ fingerprints and cnames in SDP and candidates are replaced.
+ Replacements keep the length of original values where possible, so parsing cost of anonymized
+ messages stays close to the real one. Not thread safe.
+ */
+class SignallingMessageAnonymizer
+{
+public:
+	SignallingMessageAnonymizer() {};
+	
+	// Returns anonymized message as single line json or empty string if @msg is not json.
+	std::string AnonymizeMessage(const std::string &msg);
+	void AnonymizeJson(Json::Value *value);
+	
+	void Reset();
+	
+private:
+	void AnonymizeValue(const std::string &key, Json::Value *value);
+	std::string AnonymizeSdp(const std::string &sdp);
+	std::string AnonymizeSdpLine(const std::string &line);
+	std::string PseudonymForId(const std::string &id);
+	std::string PseudonymForAddress(const std::string &address);
+	
+	static std::string Masked(const std::string &value);
+	
+	std::map<std::string, std::string> ids_;
+	std::map<std::string, std::string> addresses_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__SignallingMessageAnonymizer__) */
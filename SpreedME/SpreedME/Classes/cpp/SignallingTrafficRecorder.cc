@@ -0,0 +1,110 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SignallingTrafficRecorder.h"
+
+#include <webrtc/base/timeutils.h>
+
+using namespace spreedme;
+
+
+SignallingTrafficRecorder::SignallingTrafficRecorder() :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	startTime_(0)
+{
+}
+
+
+SignallingTrafficRecorder::~SignallingTrafficRecorder()
+{
+	this->Stop();
+	delete critSect_;
+}
+
+
+bool SignallingTrafficRecorder::Start(const std::string &filePath)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (file_.is_open()) {
+		file_.close();
+	}
+	
+	file_.open(filePath.c_str(), std::ios::out | std::ios::trunc);
+	if (!file_.is_open()) {
+		spreed_me_log("Couldn't open signalling recording file %s", filePath.c_str());
+		return false;
+	}
+	
+	anonymizer_.Reset();
+	startTime_ = rtc::Time();
+	file_ << kSignallingRecordingHeader << '\n';
+	
+	return true;
+}
+
+
+void SignallingTrafficRecorder::Stop()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (file_.is_open()) {
+		file_.flush();
+		file_.close();
+	}
+}
+
+
+bool SignallingTrafficRecorder::isRecording()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	return file_.is_open();
+}
+
+
+void SignallingTrafficRecorder::RecordReceivedMessage(const std::string &msg, ChannelingMessageTransportType transportType)
+{
+	this->RecordMessage(transportType == kPeerToPeer ? kSignallingRecordReceivedP2P : kSignallingRecordReceived, msg);
+}
+
+
+void SignallingTrafficRecorder::RecordSentMessage(const std::string &msg)
+{
+	this->RecordMessage(kSignallingRecordSent, msg);
+}
+
+
+void SignallingTrafficRecorder::RecordMessage(SignallingRecordDirection direction, const std::string &msg)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	std::string anonymized = anonymizer_.AnonymizeMessage(msg);
+	if (anonymized.empty()) {
+		return; // we record only json messages
+	}
+	
+	file_ << rtc::TimeDiff(rtc::Time(), startTime_) << ' ' << (char)direction << ' ' << anonymized << '\n';
+}
@@ -0,0 +1,83 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__SignallingTrafficRecorder__
+#define __SpreedME__SignallingTrafficRecorder__
+
+#include <fstream>
+#include <string>
+
+#include <system_wrappers/interface/critical_section_wrapper.h>
+#include <webrtc/base/basictypes.h>
+
+#include "ChannelingConstants.h"
+#include "SignallingMessageAnonymizer.h"
+
+namespace spreedme {
+
+/*
+ Recording format. The first line is kSignallingRecordingHeader, every following line is one message:
+   <milliseconds since recording start> <direction> <anonymized message json on one line>
+ Lines starting with '#' are comments.
+ */
+const char kSignallingRecordingHeader[] = "# SpreedME signalling recording 1";
+
+typedef enum SignallingRecordDirection {
+	kSignallingRecordReceived = 'r', // received from channeling server
+	kSignallingRecordReceivedP2P = 'p', // received thru data channel, wrapped by SignallingHandler::WrapP2PJson
+	kSignallingRecordSent = 's', // sent to channeling server
+}
+SignallingRecordDirection;
+
+
+/*
+ Records anonymized channeling traffic for tools/signalling_replay_bench and tools/websocket_deflate_bench.
+ Recording is off until Start() is called, Record* methods do nothing then.
+ Thread safe.
+ */
+class SignallingTrafficRecorder
+{
+public:
+	SignallingTrafficRecorder();
+	~SignallingTrafficRecorder();
+	
+	// Starts new recording to @filePath, truncating it. Ids get new pseudonyms for every recording.
+	bool Start(const std::string &filePath);
+	void Stop();
+	bool isRecording();
+	
+	void RecordReceivedMessage(const std::string &msg, ChannelingMessageTransportType transportType);
+	void RecordSentMessage(const std::string &msg);
+	
+private:
+	void RecordMessage(SignallingRecordDirection direction, const std::string &msg);
+	
+	webrtc::CriticalSectionWrapper *critSect_;
+	
+	SignallingMessageAnonymizer anonymizer_;
+	std::ofstream file_;
+	uint32 startTime_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__SignallingTrafficRecorder__) */
@@ -112,6 +112,7 @@ rtc::scoped_refptr<PeerConnectionWrapper> TokenBasedConnectionsHandler::CreatePe
 	if (wrapper) {
         rtc::scoped_refptr<webrtc::MediaStreamInterface> stream = peerConnectionWrapperFactory_->CreateLocalStream(false, false);
 		wrapper->AddLocalStream(stream, NULL);
+		wrapper->SetNetworkDataService(kNetworkDataServiceFileTransfer);
 		if (!wrapperId.empty()) {
 			wrapper->SetCustomIdentifier(wrapperId);
 		}
@@ -120,39 +121,45 @@ rtc::scoped_refptr<PeerConnectionWrapper> TokenBasedConnectionsHandler::CreatePe
 }
 
 
-void TokenBasedConnectionsHandler::MessageReceived_s(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+void TokenBasedConnectionsHandler::MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
 {
-	if (token != token_) {
-		spreed_me_log("Received alien token message. Ignore it. Our token %s token received %s", token_.c_str(), token.c_str());
-		return;
-	}
-	
 	Json::Reader jsonReader;
 	Json::Value root;
 	
 	bool success = jsonReader.parse(msg, root);
 	if (success) {
-		Json::Value innerJson = root[kDataKey];
-		if (!innerJson.isNull()) {
-			std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
-			std::string from = root.get(kFromKey, Json::Value()).asString();
-			if (!messageType.empty()) {
-				if (messageType == kOfferKey) {
-					this->ReceivedOffer_s(innerJson, from);
-				} else if (messageType == kAnswerKey) {
-					this->ReceivedAnswer_s(innerJson, from);
-				} else if (messageType == kCandidateKey) {
-					this->ReceivedCandidate_s(innerJson, from);
-				} else {
-					// ignore this message. It was not meant for us.
-					//spreed_me_log("This message is no Offer, Answer, Conference or Candidate. Ignore it.\n");
-				}
+		this->MessageReceived(root, msg, transportType, wrapperId, token);
+	} else {
+		spreed_me_log("Error, couldn't parse message!\n");
+	}
+}
+
+
+void TokenBasedConnectionsHandler::MessageReceived_s(const Json::Value &root, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+{
+	if (token != token_) {
+		spreed_me_log("Received alien token message. Ignore it. Our token %s token received %s", token_.c_str(), token.c_str());
+		return;
+	}
+	
+	const Json::Value &innerJson = root[kDataKey];
+	if (!innerJson.isNull()) {
+		std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
+		std::string from = root.get(kFromKey, Json::Value()).asString();
+		if (!messageType.empty()) {
+			if (messageType == kOfferKey) {
+				this->ReceivedOffer_s(innerJson, from);
+			} else if (messageType == kAnswerKey) {
+				this->ReceivedAnswer_s(innerJson, from);
+			} else if (messageType == kCandidateKey) {
+				this->ReceivedCandidate_s(innerJson, from);
 			} else {
-				spreed_me_log("Error, couldn't parse message type!\n");
+				// ignore this message. It was not meant for us.
+				//spreed_me_log("This message is no Offer, Answer, Conference or Candidate. Ignore it.\n");
 			}
+		} else {
+			spreed_me_log("Error, couldn't parse message type!\n");
 		}
-	} else {
-		spreed_me_log("Error, couldn't parse message!\n");
 	}
 }
 
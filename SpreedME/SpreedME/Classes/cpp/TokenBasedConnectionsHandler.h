@@ -83,10 +83,11 @@ protected:
 	// Message receiver interface implementation
 	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
 	{ spreed_me_log("Received non token message. This should not happen!\n"); };
-	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token) = 0; // should be implemented in subclasses
+	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token); // parses and calls Json variant
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token) = 0; // should be implemented in subclasses
 	
 	// generic signalling methods which should be run in signalling thread
-	virtual void MessageReceived_s(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
+	virtual void MessageReceived_s(const Json::Value &root, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token);
 	virtual void ReceivedOffer_s(const Json::Value &offerJson, const std::string &from) = 0; // expects inner JSON (without Data :{})
 	virtual void ReceivedAnswer_s(const Json::Value &answerJson, const std::string &from) = 0; // expects inner JSON (without Data :{})
 	virtual void ReceivedCandidate_s(const Json::Value &candidateJson, const std::string &from) = 0; // expects inner JSON (without Data :{})
@@ -0,0 +1,102 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "TransferRateEstimator.h"
+
+#include <math.h>
+
+#include <webrtc/base/timeutils.h>
+
+using namespace spreedme;
+
+
+TransferRateEstimator::TransferRateEstimator(uint32 windowMs, double smoothingFactor) :
+	windowMs_(windowMs > 0 ? windowMs : 1),
+	smoothingFactor_(smoothingFactor),
+	started_(false),
+	windowStart_(0),
+	windowBytes_(0),
+	totalBytes_(0),
+	hasRate_(false),
+	rate_(0.0)
+{
+}
+
+
+void TransferRateEstimator::AddBytes(uint64 bytes, uint32 now)
+{
+	if (!started_) {
+		started_ = true;
+		windowStart_ = now;
+	}
+	
+	this->CloseWindows(now);
+	
+	windowBytes_ += bytes;
+	totalBytes_ += bytes;
+}
+
+
+void TransferRateEstimator::CloseWindows(uint32 now)
+{
+	if (!started_) {
+		return;
+	}
+	
+	int elapsed = rtc::TimeDiff(now, windowStart_);
+	if (elapsed < (int)windowMs_) {
+		return;
+	}
+	
+	uint32 windows = elapsed / windowMs_;
+	
+	// The first closed window carries bytes, the rest were empty.
+	double sample = (double)windowBytes_ * 1000.0 / windowMs_;
+	rate_ = hasRate_ ? smoothingFactor_ * sample + (1.0 - smoothingFactor_) * rate_ : sample;
+	hasRate_ = true;
+	
+	if (windows > 1) {
+		rate_ *= pow(1.0 - smoothingFactor_, windows - 1);
+	}
+	
+	windowBytes_ = 0;
+	windowStart_ += windows * windowMs_;
+}
+
+
+double TransferRateEstimator::BytesPerSecond(uint32 now)
+{
+	this->CloseWindows(now);
+	return hasRate_ ? rate_ : -1.0;
+}
+
+
+double TransferRateEstimator::EstimatedSecondsLeft(uint64 bytesLeft, uint32 now)
+{
+	double rate = this->BytesPerSecond(now);
+	if (bytesLeft == 0) {
+		return 0.0;
+	}
+	if (rate < 1.0) {
+		return -1.0;
+	}
+	return (double)bytesLeft / rate;
+}
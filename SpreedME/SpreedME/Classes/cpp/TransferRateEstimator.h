@@ -0,0 +1,67 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__TransferRateEstimator__
+#define __SpreedME__TransferRateEstimator__
+
+#include <webrtc/base/basictypes.h>
+
+namespace spreedme {
+
+/*
+ Estimates transfer rate and time left from byte arrivals.
+ Bytes are summed in fixed windows and rate of every closed window is mixed into
+ exponentially weighted moving average, so one late chunk doesn't make the estimate jump.
+ Windows without arrivals count with zero rate, so stalls show up in the estimate.
+ Times are rtc::Time() milliseconds. Not thread safe.
+ */
+class TransferRateEstimator
+{
+public:
+	explicit TransferRateEstimator(uint32 windowMs = 500, double smoothingFactor = 0.3);
+	
+	void AddBytes(uint64 bytes, uint32 now);
+	
+	// Both return negative value until the first window is closed.
+	double BytesPerSecond(uint32 now);
+	double EstimatedSecondsLeft(uint64 bytesLeft, uint32 now); // also negative if transfer is stalled
+	
+	uint64 totalBytes() const {return totalBytes_;};
+	
+private:
+	void CloseWindows(uint32 now);
+	
+	uint32 windowMs_;
+	double smoothingFactor_;
+	
+	bool started_;
+	uint32 windowStart_;
+	uint64 windowBytes_;
+	uint64 totalBytes_;
+	
+	bool hasRate_;
+	double rate_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__TransferRateEstimator__) */
@@ -0,0 +1,260 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "TransferScheduler.h"
+
+#include <algorithm>
+
+#include <webrtc/base/timeutils.h>
+
+using namespace spreedme;
+
+namespace {
+
+const int kDefaultMaxConcurrentDownloads = 3;
+const int kDefaultMaxConcurrentDownloadsDuringCall = 1;
+// About 1 Mbit/s down and 512 kbit/s up leaves room for video on typical mobile connections.
+const uint32 kDefaultCallDownloadBytesPerSecond = 128 * 1024;
+const uint32 kDefaultCallUploadBytesPerSecond = 64 * 1024;
+// One file chunk is 60000 bytes, bucket should hold at least one.
+const uint32 kMinBurstBytes = 64 * 1024;
+
+uint32 BurstForRate(uint32 bytesPerSecond)
+{
+	return std::max(bytesPerSecond / 4, kMinBurstBytes); // 250ms worth of data
+}
+
+} // namespace
+
+
+/*-------------------------------------- TokenBucket -----------------------------------------*/
+
+TokenBucket::TokenBucket(uint32 bytesPerSecond, uint32 burstBytes) :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	bytesPerSecond_(bytesPerSecond),
+	burstBytes_(burstBytes),
+	tokens_(burstBytes),
+	lastRefillTime_(rtc::Time())
+{
+}
+
+
+TokenBucket::~TokenBucket()
+{
+	delete critSect_;
+}
+
+
+void TokenBucket::SetRate(uint32 bytesPerSecond, uint32 burstBytes)
+{
+	critSect_->Enter();
+	this->Refill_l(rtc::Time());
+	bytesPerSecond_ = bytesPerSecond;
+	burstBytes_ = burstBytes;
+	if (tokens_ > burstBytes_) {
+		tokens_ = burstBytes_;
+	}
+	critSect_->Leave();
+}
+
+
+void TokenBucket::Refill_l(uint32 now)
+{
+	int elapsedMs = rtc::TimeDiff(now, lastRefillTime_);
+	lastRefillTime_ = now;
+	if (elapsedMs > 0) {
+		tokens_ = std::min((double)burstBytes_, tokens_ + (double)bytesPerSecond_ * elapsedMs / 1000.0);
+	}
+}
+
+
+uint32 TokenBucket::DelayForBytes(uint32 bytes)
+{
+	uint32 delay = 0;
+	
+	critSect_->Enter();
+	if (bytesPerSecond_ > 0) {
+		this->Refill_l(rtc::Time());
+		double needed = std::min(bytes, burstBytes_);
+		if (tokens_ < needed) {
+			delay = (uint32)((needed - tokens_) * 1000.0 / bytesPerSecond_) + 1;
+		}
+	}
+	critSect_->Leave();
+	
+	return delay;
+}
+
+
+void TokenBucket::TakeBytes(uint32 bytes)
+{
+	critSect_->Enter();
+	if (bytesPerSecond_ > 0) {
+		this->Refill_l(rtc::Time());
+		tokens_ -= bytes;
+	}
+	critSect_->Leave();
+}
+
+
+/*-------------------------------------- TransferScheduler -----------------------------------------*/
+
+TransferScheduler::TransferScheduler() :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	maxDownloads_(kDefaultMaxConcurrentDownloads),
+	maxDownloadsDuringCall_(kDefaultMaxConcurrentDownloadsDuringCall),
+	downloadBytesPerSecond_(0),
+	uploadBytesPerSecond_(0),
+	callDownloadBytesPerSecond_(kDefaultCallDownloadBytesPerSecond),
+	callUploadBytesPerSecond_(kDefaultCallUploadBytesPerSecond),
+	callIsActive_(false),
+	downloadBucket_(new TokenBucket(0, kMinBurstBytes)),
+	uploadBucket_(new TokenBucket(0, kMinBurstBytes))
+{
+}
+
+
+TransferScheduler::~TransferScheduler()
+{
+	delete downloadBucket_;
+	delete uploadBucket_;
+	delete critSect_;
+}
+
+
+void TransferScheduler::SetMaxConcurrentDownloads(int maxDownloads, int maxDownloadsDuringCall)
+{
+	critSect_->Enter();
+	maxDownloads_ = std::max(maxDownloads, 1);
+	maxDownloadsDuringCall_ = std::max(maxDownloadsDuringCall, 1);
+	critSect_->Leave();
+}
+
+
+void TransferScheduler::SetBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond)
+{
+	critSect_->Enter();
+	downloadBytesPerSecond_ = downloadBytesPerSecond;
+	uploadBytesPerSecond_ = uploadBytesPerSecond;
+	this->ApplyBandwidthLimits_l();
+	critSect_->Leave();
+}
+
+
+void TransferScheduler::SetCallBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond)
+{
+	critSect_->Enter();
+	callDownloadBytesPerSecond_ = downloadBytesPerSecond;
+	callUploadBytesPerSecond_ = uploadBytesPerSecond;
+	this->ApplyBandwidthLimits_l();
+	critSect_->Leave();
+}
+
+
+void TransferScheduler::SetCallIsActive(bool callIsActive)
+{
+	critSect_->Enter();
+	if (callIsActive_ != callIsActive) {
+		callIsActive_ = callIsActive;
+		this->ApplyBandwidthLimits_l();
+	}
+	critSect_->Leave();
+}
+
+
+bool TransferScheduler::callIsActive()
+{
+	critSect_->Enter();
+	bool callIsActive = callIsActive_;
+	critSect_->Leave();
+	return callIsActive;
+}
+
+
+// Effective limit is the lower of the two while in call, 0 (unlimited) doesn't count as lower.
+void TransferScheduler::ApplyBandwidthLimits_l()
+{
+	uint32 download = downloadBytesPerSecond_;
+	uint32 upload = uploadBytesPerSecond_;
+	
+	if (callIsActive_) {
+		if (callDownloadBytesPerSecond_ > 0 && (download == 0 || callDownloadBytesPerSecond_ < download)) {
+			download = callDownloadBytesPerSecond_;
+		}
+		if (callUploadBytesPerSecond_ > 0 && (upload == 0 || callUploadBytesPerSecond_ < upload)) {
+			upload = callUploadBytesPerSecond_;
+		}
+	}
+	
+	downloadBucket_->SetRate(download, BurstForRate(download));
+	uploadBucket_->SetRate(upload, BurstForRate(upload));
+}
+
+
+void TransferScheduler::AddDownload(const std::string &token, TransferPriority priority)
+{
+	if (priority < kTransferPriorityAutomatic || priority > kTransferPriorityUserInitiated) {
+		priority = kTransferPriorityUserInitiated;
+	}
+	
+	critSect_->Enter();
+	queuedDownloads_[priority].push_back(token);
+	critSect_->Leave();
+}
+
+
+void TransferScheduler::RemoveDownload(const std::string &token)
+{
+	critSect_->Enter();
+	runningDownloads_.erase(token);
+	for (int i = kTransferPriorityAutomatic; i <= kTransferPriorityUserInitiated; ++i) {
+		std::deque<std::string> &queue = queuedDownloads_[i];
+		queue.erase(std::remove(queue.begin(), queue.end(), token), queue.end());
+	}
+	critSect_->Leave();
+}
+
+
+std::vector<std::string> TransferScheduler::DownloadsToStart()
+{
+	std::vector<std::string> tokens;
+	
+	critSect_->Enter();
+	
+	size_t maxDownloads = callIsActive_ ? maxDownloadsDuringCall_ : maxDownloads_;
+	
+	for (int i = kTransferPriorityUserInitiated; i >= kTransferPriorityAutomatic; --i) {
+		if (i == kTransferPriorityAutomatic && callIsActive_) {
+			break;
+		}
+		
+		std::deque<std::string> &queue = queuedDownloads_[i];
+		while (!queue.empty() && runningDownloads_.size() < maxDownloads) {
+			runningDownloads_.insert(queue.front());
+			tokens.push_back(queue.front());
+			queue.pop_front();
+		}
+	}
+	
+	critSect_->Leave();
+	
+	return tokens;
+}
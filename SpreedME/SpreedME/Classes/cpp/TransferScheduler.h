@@ -0,0 +1,120 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__TransferScheduler__
+#define __SpreedME__TransferScheduler__
+
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <webrtc/base/basictypes.h>
+#include <system_wrappers/interface/critical_section_wrapper.h>
+
+namespace spreedme {
+
+typedef enum TransferPriority {
+	kTransferPriorityAutomatic = 0, // transfers app starts on its own, e.g. auto-download of images
+	kTransferPriorityUserInitiated, // transfers user explicitly asked for, always go first
+} TransferPriority;
+
+
+/*
+ Token bucket used to limit transfer rate. It is shared by all transferers of one direction,
+ so it is thread safe. Rate 0 means unlimited.
+ */
+class TokenBucket
+{
+public:
+	TokenBucket(uint32 bytesPerSecond, uint32 burstBytes);
+	~TokenBucket();
+	
+	void SetRate(uint32 bytesPerSecond, uint32 burstBytes);
+	
+	// Returns milliseconds to wait before 'bytes' can be taken, 0 if they can be taken now.
+	// Amounts bigger than burst can be taken once bucket is full, bucket goes into debt then.
+	uint32 DelayForBytes(uint32 bytes);
+	void TakeBytes(uint32 bytes);
+	
+private:
+	void Refill_l(uint32 now);
+	
+	webrtc::CriticalSectionWrapper *critSect_;
+	uint32 bytesPerSecond_;
+	uint32 burstBytes_;
+	double tokens_;
+	uint32 lastRefillTime_;
+};
+
+
+/*
+ Decides which queued downloads can run and how fast transfers may go.
+ Downloads are started in priority order, in order of arrival within the same priority,
+ while number of running downloads is below the limit. While a call is active
+ limits are lowered so file transfers don't take bandwidth from call media,
+ and automatic downloads wait until the call is over.
+ Running downloads are never preempted, they just slow down.
+ */
+class TransferScheduler
+{
+public:
+	TransferScheduler();
+	~TransferScheduler();
+	
+	// Bandwidth limits are in bytes per second, 0 means unlimited.
+	void SetMaxConcurrentDownloads(int maxDownloads, int maxDownloadsDuringCall);
+	void SetBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond);
+	void SetCallBandwidthLimits(uint32 downloadBytesPerSecond, uint32 uploadBytesPerSecond);
+	void SetCallIsActive(bool callIsActive);
+	bool callIsActive();
+	
+	void AddDownload(const std::string &token, TransferPriority priority);
+	void RemoveDownload(const std::string &token); // Should be called for running and queued downloads when they finish, fail or are stopped
+	std::vector<std::string> DownloadsToStart(); // Marks returned downloads as running
+	
+	TokenBucket *downloadBucket() {return downloadBucket_;};
+	TokenBucket *uploadBucket() {return uploadBucket_;};
+	
+private:
+	void ApplyBandwidthLimits_l();
+	
+	webrtc::CriticalSectionWrapper *critSect_;
+	
+	std::deque<std::string> queuedDownloads_[kTransferPriorityUserInitiated + 1]; // indexed by priority
+	std::set<std::string> runningDownloads_;
+	
+	int maxDownloads_;
+	int maxDownloadsDuringCall_;
+	uint32 downloadBytesPerSecond_;
+	uint32 uploadBytesPerSecond_;
+	uint32 callDownloadBytesPerSecond_;
+	uint32 callUploadBytesPerSecond_;
+	bool callIsActive_;
+	
+	TokenBucket *downloadBucket_;
+	TokenBucket *uploadBucket_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__TransferScheduler__) */
@@ -98,3 +98,48 @@ std::string spreedme::trim_sdp(const std::string &sdp)
 	
 	return trimmedSdp;
 }
+
+
+std::string spreedme::hex_encode(const std::string &data)
+{
+	static const char digits[] = "0123456789abcdef";
+	
+	std::string hex(data.size() * 2, '0');
+	for (size_t i = 0; i < data.size(); ++i) {
+		unsigned char c = (unsigned char)data[i];
+		hex[2 * i] = digits[c >> 4];
+		hex[2 * i + 1] = digits[c & 0x0f];
+	}
+	
+	return hex;
+}
+
+
+static int hex_digit_value(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+
+bool spreedme::hex_decode(const std::string &hex, std::string *data)
+{
+	if (hex.size() % 2 != 0) {
+		return false;
+	}
+	
+	data->resize(hex.size() / 2);
+	for (size_t i = 0; i < data->size(); ++i) {
+		int high = hex_digit_value(hex[2 * i]);
+		int low = hex_digit_value(hex[2 * i + 1]);
+		if (high < 0 || low < 0) {
+			data->clear();
+			return false;
+		}
+		(*data)[i] = (char)(high << 4 | low);
+	}
+	
+	return true;
+}
@@ -40,6 +40,9 @@ std::string trim_sdp(const std::string &sdp);
 
 std::string join(std::vector<std::string> &strings, const std::string &theDelimiter);
 	
+std::string hex_encode(const std::string &data); // lower case
+bool hex_decode(const std::string &hex, std::string *data); // returns false if string is not valid hex
+	
 }
 
 
@@ -76,7 +76,9 @@ public:
 											 const VideoRendererInfo &rendererInfo,
 											 VideoRendererManagementError error);
 	
-	virtual void CallHasReceivedStatistics(Call *call, const webrtc::StatsReports &reports);
+	virtual void CallHasReceivedStatistics(Call *call, const CallStatistics &statistics);
+	
+	virtual void DominantSpeakerChanged(Call *call, const std::string &userId);
 	
 private:
 	
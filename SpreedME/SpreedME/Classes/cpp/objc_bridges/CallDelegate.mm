@@ -331,14 +331,24 @@ void CallDelegate::FailedToDeleteVideoRenderer(spreedme::Call *call,
 }
 
 
-void CallDelegate::CallHasReceivedStatistics(Call *call, const webrtc::StatsReports &reports)
+void CallDelegate::CallHasReceivedStatistics(Call *call, const CallStatistics &statistics)
 {
 	PeerConnectionController *messageReceiver = peerConnectionController_;
-	webrtc::StatsReports reports_copy = reports;
+	CallStatistics statistics_copy = statistics;
 	
 	dispatch_async(dispatch_get_main_queue(), ^{
 		[messageReceiver callHasReceivedStatistics:call
-											 stats:reports_copy];
+										statistics:statistics_copy];
+	});
+}
+
+
+void CallDelegate::DominantSpeakerChanged(Call *call, const std::string &userId)
+{
+	PeerConnectionController *messageReceiver = peerConnectionController_;
+	NSString *userSessionId_objc = [NSString stringWithCString:userId.c_str() encoding:NSUTF8StringEncoding];
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[messageReceiver dominantSpeakerChanged:userSessionId_objc inCall:call];
 	});
 }
 
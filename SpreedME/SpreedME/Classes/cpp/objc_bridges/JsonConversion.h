@@ -0,0 +1,38 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__JsonConversion__
+#define __SpreedME__JsonConversion__
+
+#import <Foundation/Foundation.h>
+
+#include <webrtc/base/json.h>
+
+/*
+ Converts already parsed jsoncpp trees to Foundation objects.
+ This is a plain tree walk, so it is much cheaper than serializing to string and parsing again.
+ */
+
+// Returns NSDictionary, NSArray, NSString, NSNumber or NSNull. Containers are mutable.
+id convertJsonValueToObjC(const Json::Value &value);
+
+#endif /* defined(__SpreedME__JsonConversion__) */
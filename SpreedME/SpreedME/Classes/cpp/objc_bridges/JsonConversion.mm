@@ -0,0 +1,74 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "JsonConversion.h"
+
+
+id convertJsonValueToObjC(const Json::Value &value)
+{
+	switch (value.type()) {
+		case Json::nullValue:
+			return [NSNull null];
+			
+		case Json::intValue:
+			return [NSNumber numberWithLongLong:value.asInt64()];
+			
+		case Json::uintValue:
+			return [NSNumber numberWithUnsignedLongLong:value.asUInt64()];
+			
+		case Json::realValue:
+			return [NSNumber numberWithDouble:value.asDouble()];
+			
+		case Json::booleanValue:
+			return [NSNumber numberWithBool:value.asBool()];
+			
+		case Json::stringValue: {
+			const std::string &string = value.asString();
+			NSString *result = [[NSString alloc] initWithBytes:string.data() length:string.size() encoding:NSUTF8StringEncoding];
+			return result ? result : @"";
+		}
+			
+		case Json::arrayValue: {
+			NSMutableArray *array = [NSMutableArray arrayWithCapacity:value.size()];
+			for (Json::Value::ArrayIndex i = 0; i < value.size(); ++i) {
+				[array addObject:convertJsonValueToObjC(value[i])];
+			}
+			return array;
+		}
+			
+		case Json::objectValue: {
+			NSMutableDictionary *dict = [NSMutableDictionary dictionaryWithCapacity:value.size()];
+			for (Json::Value::const_iterator it = value.begin(); it != value.end(); ++it) {
+				const char *key = it.memberName();
+				NSString *keyString = [NSString stringWithUTF8String:key];
+				if (keyString) {
+					[dict setObject:convertJsonValueToObjC(*it) forKey:keyString];
+				}
+			}
+			return dict;
+		}
+			
+		default:
+			return [NSNull null];
+	}
+}
+
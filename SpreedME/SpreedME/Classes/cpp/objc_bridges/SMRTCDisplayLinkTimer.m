@@ -0,0 +1,99 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+#import "SMRTCDisplayLinkTimer.h"
+
+
+@implementation SMRTCDisplayLinkTimer
+{
+	CADisplayLink* _displayLink;
+	void (^_timerHandler)(CADisplayLink *displayLink);
+}
+
+
+- (instancetype)initWithTimerHandler:(void (^)(CADisplayLink *displayLink))timerHandler
+{
+	NSParameterAssert(timerHandler);
+	if (self = [super init]) {
+		_timerHandler = timerHandler;
+		_displayLink =
+        [CADisplayLink displayLinkWithTarget:self
+                                    selector:@selector(displayLinkDidFire:)];
+		_displayLink.paused = YES;
+		// Set to half of screen refresh, which should be 30fps.
+		[_displayLink setFrameInterval:2];
+		[_displayLink addToRunLoop:[NSRunLoop mainRunLoop]
+						   forMode:NSRunLoopCommonModes];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[self invalidate];
+}
+
+
+- (BOOL)isPaused
+{
+	return _displayLink.paused;
+}
+
+
+- (void)setIsPaused:(BOOL)isPaused
+{
+	_displayLink.paused = isPaused;
+}
+
+
+- (NSInteger)frameInterval
+{
+	return _displayLink.frameInterval;
+}
+
+
+- (void)setFrameInterval:(NSInteger)frameInterval
+{
+	if (_displayLink.frameInterval != frameInterval) {
+		[_displayLink setFrameInterval:frameInterval];
+	}
+}
+
+
+- (void)invalidate
+{
+	[_displayLink invalidate];
+}
+
+
+- (void)displayLinkDidFire:(CADisplayLink*)displayLink
+{
+	_timerHandler(displayLink);
+}
+
+
+@end
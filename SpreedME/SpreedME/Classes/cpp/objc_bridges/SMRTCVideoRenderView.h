@@ -24,10 +24,27 @@
 
 @class RTCI420Frame;
 
+// Frame source is polled by the view on display refreshes. All methods are called on main thread.
+@protocol SMRTCVideoFrameSource <NSObject>
+
+// Returns frame which should be drawn now or nil if there is nothing new to draw.
+- (RTCI420Frame *)frameToPresentAtDisplayTime:(CFTimeInterval)displayTime refreshPeriod:(CFTimeInterval)refreshPeriod;
+// Returns how many screen refreshes should pass between polls to follow source frame rate.
+- (NSInteger)preferredFrameIntervalForRefreshPeriod:(CFTimeInterval)refreshPeriod;
+// View is not visible when it is not in window, hidden or application is not active.
+- (void)setVisible:(BOOL)visible;
+
+@end
+
+
 @interface SMRTCVideoRenderView : UIView
 
 // |i420Frame| is set when we receive a frame from a worker thread and is read
 // from the display link callback so atomicity is required.
+// It is ignored when |frameSource| is set.
 @property(atomic, strong) RTCI420Frame *i420Frame;
 
+// Should be set and reset only on main thread.
+@property(nonatomic, strong) id<SMRTCVideoFrameSource> frameSource;
+
 @end
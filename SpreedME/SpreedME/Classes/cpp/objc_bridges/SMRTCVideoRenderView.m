@@ -26,89 +26,19 @@
 
 #import "SMRTCVideoRenderView.h"
 
+#import "SMRTCDisplayLinkTimer.h"
+
 #import <GLKit/GLKit.h>
 
 #import <talk/app/webrtc/objc/public/RTCOpenGLVideoRenderer.h>
 
 
-// RTCDisplayLinkTimer wraps a CADisplayLink and is set to fire every two screen
-// refreshes, which should be 30fps. We wrap the display link in order to avoid
-// a retain cycle since CADisplayLink takes a strong reference onto its target.
-// The timer is paused by default.
-@interface SMRTCDisplayLinkTimer : NSObject
-
-@property(nonatomic) BOOL isPaused;
-
-- (instancetype)initWithTimerHandler:(void (^)(void))timerHandler;
-- (void)invalidate;
-
-@end
-
-@implementation SMRTCDisplayLinkTimer
-{
-	CADisplayLink* _displayLink;
-	void (^_timerHandler)(void);
-}
-
-
-- (instancetype)initWithTimerHandler:(void (^)(void))timerHandler
-{
-	NSParameterAssert(timerHandler);
-	if (self = [super init]) {
-		_timerHandler = timerHandler;
-		_displayLink =
-        [CADisplayLink displayLinkWithTarget:self
-                                    selector:@selector(displayLinkDidFire:)];
-		_displayLink.paused = YES;
-		// Set to half of screen refresh, which should be 30fps.
-		[_displayLink setFrameInterval:2];
-		[_displayLink addToRunLoop:[NSRunLoop mainRunLoop]
-						   forMode:NSRunLoopCommonModes];
-	}
-	return self;
-}
-
-
-- (void)dealloc
-{
-	[self invalidate];
-}
-
-
-- (BOOL)isPaused
-{
-	return _displayLink.paused;
-}
-
-
-- (void)setIsPaused:(BOOL)isPaused
-{
-	_displayLink.paused = isPaused;
-}
-
-
-- (void)invalidate
-{
-	[_displayLink invalidate];
-}
-
-
-- (void)displayLinkDidFire:(CADisplayLink*)displayLink
-{
-	_timerHandler();
-}
-
-
-@end
-
-
-
-
 @interface SMRTCVideoRenderView () <GLKViewDelegate>
 {
 	SMRTCDisplayLinkTimer* _timer;
 	GLKView* _glkView;
 	RTCOpenGLVideoRenderer* _glRenderer;
+	BOOL _isGLSetup;
 }
 
 @property(nonatomic, readonly) GLKView* glkView;
@@ -153,13 +83,8 @@
 		// using a refresh rate proportional to screen refresh frequency. This
 		// occurs on the main thread.
 		__weak SMRTCVideoRenderView *weakSelf = self;
-		_timer = [[SMRTCDisplayLinkTimer alloc] initWithTimerHandler:^{
-			if (weakSelf.glRenderer.lastDrawnFrame == weakSelf.i420Frame) {
-				return;
-			}
-			// This tells the GLKView that it's dirty, which will then call the
-			// GLKViewDelegate method implemented below.
-			[weakSelf.glkView setNeedsDisplay];
+		_timer = [[SMRTCDisplayLinkTimer alloc] initWithTimerHandler:^(CADisplayLink *displayLink) {
+			[weakSelf displayLinkDidFire:displayLink];
 		}];
 		[self setupGL];
 	}
@@ -188,6 +113,51 @@
 }
 
 
+- (void)didMoveToWindow
+{
+	[super didMoveToWindow];
+	[self updateVisibility];
+}
+
+
+- (void)setHidden:(BOOL)hidden
+{
+	[super setHidden:hidden];
+	[self updateVisibility];
+}
+
+
+#pragma mark - Frame source
+
+- (void)setFrameSource:(id<SMRTCVideoFrameSource>)frameSource
+{
+	_frameSource = frameSource;
+	[self updateVisibility];
+}
+
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink
+{
+	if (_frameSource) {
+		// displayLink.duration is a single screen refresh regardless of frame interval.
+		CFTimeInterval refreshPeriod = displayLink.duration;
+		RTCI420Frame *frame = [_frameSource frameToPresentAtDisplayTime:displayLink.timestamp
+														   refreshPeriod:refreshPeriod * _timer.frameInterval];
+		_timer.frameInterval = [_frameSource preferredFrameIntervalForRefreshPeriod:refreshPeriod];
+		if (!frame) {
+			return;
+		}
+		self.i420Frame = frame;
+	} else if (_glRenderer.lastDrawnFrame == self.i420Frame) {
+		return;
+	}
+	
+	// This tells the GLKView that it's dirty, which will then call the
+	// GLKViewDelegate method implemented below.
+	[_glkView setNeedsDisplay];
+}
+
+
 #pragma mark - GLKViewDelegate
 
 // This method is called when the GLKView's content is dirty and needs to be
@@ -207,18 +177,30 @@
 - (void)setupGL
 {
 	[_glRenderer setupGL];
-	_timer.isPaused = NO;
+	_isGLSetup = YES;
+	[self updateVisibility];
 }
 
 
 - (void)teardownGL
 {
-	_timer.isPaused = YES;
+	_isGLSetup = NO;
+	[self updateVisibility];
 	[_glkView deleteDrawable];
 	[_glRenderer teardownGL];
 }
 
 
+// Off-screen views neither poll for frames nor upload them to GL.
+- (void)updateVisibility
+{
+	BOOL isVisible = _isGLSetup && !self.hidden && self.window != nil;
+	// Views without frame source keep the old behaviour and are polled as long as GL is set up.
+	_timer.isPaused = _frameSource ? !isVisible : !_isGLSetup;
+	[_frameSource setVisible:isVisible];
+}
+
+
 - (void)didBecomeActive
 {
 	[self setupGL];
@@ -0,0 +1,63 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <UIKit/UIKit.h>
+
+
+// Changed rectangle of screen share canvas in canvas pixels, x and y are even.
+// Planes are tightly packed: Y rows are |width| bytes, U and V rows are (width + 1) / 2 bytes.
+typedef struct SMScreenShareRegion {
+	NSInteger x;
+	NSInteger y;
+	NSInteger width;
+	NSInteger height;
+	const uint8_t *yPlane;
+	const uint8_t *uPlane;
+	const uint8_t *vPlane;
+} SMScreenShareRegion;
+
+
+// Screen share source is polled by the view on display refreshes. All methods are called on main thread.
+@protocol SMScreenShareFrameSource <NSObject>
+
+// Returns NO if canvas hasn't changed since previous call. Otherwise |regionHandler| is called for every changed region,
+// region planes are valid only inside the handler. When canvas size changes the only region covers whole canvas.
+- (BOOL)takeChangesWithRegionHandler:(void (^)(CGSize canvasSize, SMScreenShareRegion region))regionHandler;
+// Next call to takeChangesWithRegionHandler: reports whole canvas, it is used when view has lost its textures.
+- (void)requestFullUpdate;
+// Size in pixels the view currently occupies on screen, it includes zoom of enclosing scroll views.
+- (void)setDisplayPixelSize:(CGSize)displayPixelSize maxTextureSize:(NSInteger)maxTextureSize;
+// View is not visible when it is not in window, hidden or application is not active.
+- (void)setVisible:(BOOL)visible;
+
+@end
+
+
+// SMScreenShareRenderView draws remote screen. Unlike SMRTCVideoRenderView it keeps the picture in textures
+// and uploads only regions which have changed. Texture resolution and drawable size follow the size
+// the view is shown at, so zoomed out screen doesn't cost full resolution.
+@interface SMScreenShareRenderView : UIView
+
+// Should be set and reset only on main thread.
+@property(nonatomic, strong) id<SMScreenShareFrameSource> frameSource;
+
+@end
@@ -0,0 +1,450 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#if !defined(__has_feature) || !__has_feature(objc_arc)
+#error "This file requires ARC support."
+#endif
+
+#import "SMScreenShareRenderView.h"
+
+#import "SMRTCDisplayLinkTimer.h"
+
+#import <GLKit/GLKit.h>
+
+
+// Drawable is recreated only when zoom changes noticeably.
+static const CGFloat kDrawableScaleTolerance = 0.1;
+static const CGFloat kMinDrawableScale = 0.25;
+
+enum { kNumberOfPlanes = 3 };
+
+static NSString * const kVertexShaderSource =
+	@"attribute vec2 position;\n"
+	@"attribute vec2 texcoord;\n"
+	@"varying vec2 v_texcoord;\n"
+	@"void main() {\n"
+	@"    gl_Position = vec4(position.x, position.y, 0.0, 1.0);\n"
+	@"    v_texcoord = texcoord;\n"
+	@"}\n";
+
+// Same conversion as RTCOpenGLVideoRenderer so screen looks the same as it did with camera video path.
+static NSString * const kFragmentShaderSource =
+	@"precision highp float;\n"
+	@"varying vec2 v_texcoord;\n"
+	@"uniform lowp sampler2D s_textureY;\n"
+	@"uniform lowp sampler2D s_textureU;\n"
+	@"uniform lowp sampler2D s_textureV;\n"
+	@"void main() {\n"
+	@"    float y, u, v, r, g, b;\n"
+	@"    y = texture2D(s_textureY, v_texcoord).r;\n"
+	@"    u = texture2D(s_textureU, v_texcoord).r;\n"
+	@"    v = texture2D(s_textureV, v_texcoord).r;\n"
+	@"    u = u - 0.5;\n"
+	@"    v = v - 0.5;\n"
+	@"    r = y + 1.403 * v;\n"
+	@"    g = y - 0.344 * u - 0.714 * v;\n"
+	@"    b = y + 1.770 * u;\n"
+	@"    gl_FragColor = vec4(r, g, b, 1.0);\n"
+	@"}\n";
+
+// Vertex positions and texture coordinates for a triangle fan covering the viewport.
+static const GLfloat kVertices[16] = {
+	-1.0f, -1.0f, 0.0f, 1.0f,
+	1.0f, -1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f, 0.0f,
+	-1.0f, 1.0f, 0.0f, 0.0f,
+};
+
+
+static GLuint CreateShader(GLenum type, NSString *source)
+{
+	GLuint shader = glCreateShader(type);
+	if (!shader) {
+		return 0;
+	}
+	
+	const GLchar *sourceString = [source UTF8String];
+	glShaderSource(shader, 1, &sourceString, NULL);
+	glCompileShader(shader);
+	
+	GLint compileStatus = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+	if (compileStatus == GL_FALSE) {
+		spreed_me_log("Couldn't compile screen share shader");
+		glDeleteShader(shader);
+		return 0;
+	}
+	
+	return shader;
+}
+
+
+static GLuint CreateProgram(void)
+{
+	GLuint vertexShader = CreateShader(GL_VERTEX_SHADER, kVertexShaderSource);
+	GLuint fragmentShader = CreateShader(GL_FRAGMENT_SHADER, kFragmentShaderSource);
+	GLuint program = 0;
+	
+	if (vertexShader && fragmentShader) {
+		program = glCreateProgram();
+		if (program) {
+			glAttachShader(program, vertexShader);
+			glAttachShader(program, fragmentShader);
+			glLinkProgram(program);
+			
+			GLint linkStatus = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+			if (linkStatus == GL_FALSE) {
+				spreed_me_log("Couldn't link screen share program");
+				glDeleteProgram(program);
+				program = 0;
+			}
+		}
+	}
+	
+	if (vertexShader) {
+		glDeleteShader(vertexShader);
+	}
+	if (fragmentShader) {
+		glDeleteShader(fragmentShader);
+	}
+	
+	return program;
+}
+
+
+@interface SMScreenShareRenderView () <GLKViewDelegate>
+{
+	SMRTCDisplayLinkTimer *_timer;
+	GLKView *_glkView;
+	EAGLContext *_glContext;
+	BOOL _isGLSetup;
+	
+	GLuint _program;
+	GLuint _vertexBuffer;
+	GLuint _textures[kNumberOfPlanes];
+	GLint _positionLocation;
+	GLint _texcoordLocation;
+	GLint _maxTextureSize;
+	
+	// Size of allocated textures, zero if they don't have content yet.
+	GLsizei _canvasWidth;
+	GLsizei _canvasHeight;
+	
+	CGSize _displayPixelSize;
+}
+
+@end
+
+
+@implementation SMScreenShareRenderView
+
+- (instancetype)initWithFrame:(CGRect)frame
+{
+	if (self = [super initWithFrame:frame]) {
+		_glContext = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+		
+		_glkView = [[GLKView alloc] initWithFrame:CGRectZero context:_glContext];
+		_glkView.drawableColorFormat = GLKViewDrawableColorFormatRGBA8888;
+		_glkView.drawableDepthFormat = GLKViewDrawableDepthFormatNone;
+		_glkView.drawableStencilFormat = GLKViewDrawableStencilFormatNone;
+		_glkView.drawableMultisample = GLKViewDrawableMultisampleNone;
+		_glkView.delegate = self;
+		_glkView.layer.masksToBounds = YES;
+		// Keep orientation of SMRTCVideoRenderView, users of the view apply their transforms on top of it.
+		_glkView.transform = CGAffineTransformMakeScale(1, -1);
+		[self addSubview:_glkView];
+		
+		NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
+		[notificationCenter addObserver:self
+							   selector:@selector(willResignActive)
+								   name:UIApplicationWillResignActiveNotification
+								 object:nil];
+		[notificationCenter addObserver:self
+							   selector:@selector(didBecomeActive)
+								   name:UIApplicationDidBecomeActiveNotification
+								 object:nil];
+		
+		__weak SMScreenShareRenderView *weakSelf = self;
+		_timer = [[SMRTCDisplayLinkTimer alloc] initWithTimerHandler:^(CADisplayLink *displayLink) {
+			[weakSelf displayLinkDidFire:displayLink];
+		}];
+		[self setupGL];
+	}
+	return self;
+}
+
+
+- (void)dealloc
+{
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	UIApplicationState appState = [UIApplication sharedApplication].applicationState;
+	_glkView.delegate = nil;
+	if (appState == UIApplicationStateActive) {
+		[self teardownGL];
+	}
+	[_timer invalidate];
+}
+
+
+#pragma mark - UIView
+
+- (void)layoutSubviews
+{
+	[super layoutSubviews];
+	_glkView.frame = self.bounds;
+	[self updateDisplayPixelSize];
+}
+
+
+- (void)didMoveToWindow
+{
+	[super didMoveToWindow];
+	[self updateVisibility];
+	[self updateDisplayPixelSize];
+}
+
+
+- (void)setHidden:(BOOL)hidden
+{
+	[super setHidden:hidden];
+	[self updateVisibility];
+}
+
+
+#pragma mark - Frame source
+
+- (void)setFrameSource:(id<SMScreenShareFrameSource>)frameSource
+{
+	_frameSource = frameSource;
+	_displayPixelSize = CGSizeZero;
+	[_frameSource requestFullUpdate];
+	[self updateVisibility];
+	[self updateDisplayPixelSize];
+}
+
+
+- (void)displayLinkDidFire:(CADisplayLink *)displayLink
+{
+	// Zooming of enclosing scroll view doesn't relayout us, so it is checked on every poll.
+	[self updateDisplayPixelSize];
+	
+	if (!_frameSource || !_isGLSetup) {
+		return;
+	}
+	
+	[EAGLContext setCurrentContext:_glContext];
+	
+	BOOL hasChanges = [_frameSource takeChangesWithRegionHandler:^(CGSize canvasSize, SMScreenShareRegion region) {
+		[self uploadRegion:region canvasSize:canvasSize];
+	}];
+	
+	if (hasChanges) {
+		[_glkView setNeedsDisplay];
+	}
+}
+
+
+// The view is usually bigger than the screen and is scaled down by scroll view zoom, so we look at its size in window.
+- (void)updateDisplayPixelSize
+{
+	if (!self.window || self.bounds.size.width <= 0.0 || self.bounds.size.height <= 0.0) {
+		return;
+	}
+	
+	CGFloat screenScale = self.window.screen.scale;
+	CGRect rectInWindow = [self convertRect:self.bounds toView:nil];
+	CGSize displayPixelSize = CGSizeMake(ceil(rectInWindow.size.width * screenScale),
+										 ceil(rectInWindow.size.height * screenScale));
+	
+	CGFloat drawableScale = MIN(screenScale, MAX(kMinDrawableScale, displayPixelSize.width / self.bounds.size.width));
+	if (fabs(drawableScale - _glkView.contentScaleFactor) > kDrawableScaleTolerance * _glkView.contentScaleFactor) {
+		_glkView.contentScaleFactor = drawableScale;
+		[_glkView setNeedsDisplay];
+	}
+	
+	if (!CGSizeEqualToSize(displayPixelSize, _displayPixelSize)) {
+		_displayPixelSize = displayPixelSize;
+		[_frameSource setDisplayPixelSize:displayPixelSize maxTextureSize:_maxTextureSize];
+	}
+}
+
+
+#pragma mark - GLKViewDelegate
+
+- (void)glkView:(GLKView *)view drawInRect:(CGRect)rect
+{
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	if (!_program || _canvasWidth == 0 || _canvasHeight == 0) {
+		return;
+	}
+	
+	glUseProgram(_program);
+	
+	for (GLsizei i = 0; i < kNumberOfPlanes; ++i) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, _textures[i]);
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	glVertexAttribPointer(_positionLocation, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void *)0);
+	glEnableVertexAttribArray(_positionLocation);
+	glVertexAttribPointer(_texcoordLocation, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void *)(2 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(_texcoordLocation);
+	
+	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+}
+
+
+#pragma mark - Textures
+
+- (void)uploadRegion:(SMScreenShareRegion)region canvasSize:(CGSize)canvasSize
+{
+	GLsizei canvasWidth = (GLsizei)canvasSize.width;
+	GLsizei canvasHeight = (GLsizei)canvasSize.height;
+	if (canvasWidth != _canvasWidth || canvasHeight != _canvasHeight) {
+		[self allocateTexturesWithWidth:canvasWidth height:canvasHeight];
+	}
+	
+	GLint x = (GLint)region.x;
+	GLint y = (GLint)region.y;
+	GLsizei width = (GLsizei)region.width;
+	GLsizei height = (GLsizei)region.height;
+	const uint8_t *planes[kNumberOfPlanes] = {region.yPlane, region.uPlane, region.vPlane};
+	
+	for (GLsizei i = 0; i < kNumberOfPlanes; ++i) {
+		glBindTexture(GL_TEXTURE_2D, _textures[i]);
+		if (i == 0) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_LUMINANCE, GL_UNSIGNED_BYTE, planes[i]);
+		} else {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, x / 2, y / 2, (width + 1) / 2, (height + 1) / 2,
+							GL_LUMINANCE, GL_UNSIGNED_BYTE, planes[i]);
+		}
+	}
+}
+
+
+- (void)allocateTexturesWithWidth:(GLsizei)width height:(GLsizei)height
+{
+	for (GLsizei i = 0; i < kNumberOfPlanes; ++i) {
+		GLsizei planeWidth = (i == 0) ? width : (width + 1) / 2;
+		GLsizei planeHeight = (i == 0) ? height : (height + 1) / 2;
+		glBindTexture(GL_TEXTURE_2D, _textures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, planeWidth, planeHeight, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, NULL);
+	}
+	_canvasWidth = width;
+	_canvasHeight = height;
+}
+
+
+#pragma mark - Private
+
+- (void)setupGL
+{
+	if (_isGLSetup) {
+		return;
+	}
+	
+	[EAGLContext setCurrentContext:_glContext];
+	
+	_program = CreateProgram();
+	if (_program) {
+		_positionLocation = glGetAttribLocation(_program, "position");
+		_texcoordLocation = glGetAttribLocation(_program, "texcoord");
+		glUseProgram(_program);
+		glUniform1i(glGetUniformLocation(_program, "s_textureY"), 0);
+		glUniform1i(glGetUniformLocation(_program, "s_textureU"), 1);
+		glUniform1i(glGetUniformLocation(_program, "s_textureV"), 2);
+	}
+	
+	glGenBuffers(1, &_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(kVertices), kVertices, GL_STATIC_DRAW);
+	
+	// Regions are tightly packed and chroma rows can have odd length.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glGenTextures(kNumberOfPlanes, _textures);
+	for (GLsizei i = 0; i < kNumberOfPlanes; ++i) {
+		glBindTexture(GL_TEXTURE_2D, _textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	_canvasWidth = 0;
+	_canvasHeight = 0;
+	
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &_maxTextureSize);
+	
+	_isGLSetup = YES;
+	// Textures are empty, so the whole canvas has to come again.
+	_displayPixelSize = CGSizeZero;
+	[_frameSource requestFullUpdate];
+	[self updateVisibility];
+}
+
+
+- (void)teardownGL
+{
+	if (!_isGLSetup) {
+		return;
+	}
+	
+	_isGLSetup = NO;
+	[self updateVisibility];
+	[_glkView deleteDrawable];
+	
+	[EAGLContext setCurrentContext:_glContext];
+	glDeleteTextures(kNumberOfPlanes, _textures);
+	glDeleteBuffers(1, &_vertexBuffer);
+	if (_program) {
+		glDeleteProgram(_program);
+		_program = 0;
+	}
+	_canvasWidth = 0;
+	_canvasHeight = 0;
+}
+
+
+- (void)updateVisibility
+{
+	BOOL isVisible = _isGLSetup && !self.hidden && self.window != nil;
+	_timer.isPaused = !isVisible;
+	[_frameSource setVisible:isVisible];
+}
+
+
+- (void)didBecomeActive
+{
+	[self setupGL];
+}
+
+
+- (void)willResignActive
+{
+	[self teardownGL];
+}
+
+
+@end
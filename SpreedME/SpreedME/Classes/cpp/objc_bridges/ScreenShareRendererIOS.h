@@ -0,0 +1,55 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__ScreenShareRendererIOS__
+#define __SpreedME__ScreenShareRendererIOS__
+
+#include "VideoRenderer.h"
+#include "ScreenShareCanvas.h"
+
+
+namespace spreedme {
+	
+	// Renders remote screen into SMScreenShareRenderView. Frames don't go through frameSlot_,
+	// they are merged into canvas_ which keeps only what has changed for the view to upload.
+	class ScreenShareRendererIOS : public VideoRenderer {
+		
+	public:
+		
+		ScreenShareRendererIOS(VideoRendererDelegateInterface *delegate,
+							   const std::string &name,
+							   const std::string &videoTrackId,
+							   const std::string &streamLabel);
+		~ScreenShareRendererIOS();
+		
+		virtual void RenderFrame(const cricket::VideoFrame* frame);
+		
+		virtual void Shutdown();
+		
+	private:
+		ScreenShareCanvas canvas_;
+	};
+	
+	
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__ScreenShareRendererIOS__) */
@@ -0,0 +1,172 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "ScreenShareRendererIOS.h"
+
+#import "SMScreenShareRenderView.h"
+
+using namespace spreedme;
+
+
+// Bridges ScreenShareCanvas to SMScreenShareRenderView. Is used only on main thread.
+@interface SMScreenShareCanvasSource : NSObject <SMScreenShareFrameSource>
+
+- (instancetype)initWithCanvas:(ScreenShareCanvas *)canvas;
+// After invalidation source doesn't touch canvas anymore.
+- (void)invalidate;
+
+@end
+
+
+@implementation SMScreenShareCanvasSource
+{
+	ScreenShareCanvas *_canvas; // We don't own it
+	ScreenShareCanvasUpdate _update; // reused to avoid allocations on every change
+}
+
+
+- (instancetype)initWithCanvas:(ScreenShareCanvas *)canvas
+{
+	self = [super init];
+	if (self) {
+		_canvas = canvas;
+	}
+	return self;
+}
+
+
+- (void)invalidate
+{
+	_canvas = NULL;
+}
+
+
+- (BOOL)takeChangesWithRegionHandler:(void (^)(CGSize canvasSize, SMScreenShareRegion region))regionHandler
+{
+	if (!_canvas || !_canvas->TakeUpdate(&_update)) {
+		return NO;
+	}
+	
+	CGSize canvasSize = CGSizeMake(_update.canvasWidth, _update.canvasHeight);
+	const uint8_t *data = &_update.data[0];
+	for (std::vector<ScreenShareCanvasRegion>::const_iterator it = _update.regions.begin(); it != _update.regions.end(); ++it) {
+		SMScreenShareRegion region;
+		region.x = it->x;
+		region.y = it->y;
+		region.width = it->width;
+		region.height = it->height;
+		region.yPlane = data + it->yOffset;
+		region.uPlane = data + it->uOffset;
+		region.vPlane = data + it->vOffset;
+		regionHandler(canvasSize, region);
+	}
+	
+	return YES;
+}
+
+
+- (void)requestFullUpdate
+{
+	if (_canvas) {
+		_canvas->RequestFullUpdate();
+	}
+}
+
+
+- (void)setDisplayPixelSize:(CGSize)displayPixelSize maxTextureSize:(NSInteger)maxTextureSize
+{
+	if (_canvas) {
+		_canvas->SetDisplaySize((int)displayPixelSize.width, (int)displayPixelSize.height);
+		_canvas->SetMaxCanvasSize((int)maxTextureSize);
+	}
+}
+
+
+- (void)setVisible:(BOOL)visible
+{
+	if (_canvas) {
+		_canvas->SetVisible(visible);
+	}
+}
+
+
+@end
+
+
+
+ScreenShareRendererIOS::ScreenShareRendererIOS(VideoRendererDelegateInterface *delegate,
+											   const std::string &name,
+											   const std::string &videoTrackId,
+											   const std::string &streamLabel) :
+VideoRenderer(delegate, name, videoTrackId, streamLabel)
+
+{
+	ScreenShareCanvas *canvas = &canvas_;
+	
+	// Check in order not to deadlock in main queue
+	if ([NSThread isMainThread]) {
+		SMScreenShareRenderView *renderView = [[SMScreenShareRenderView alloc] initWithFrame:CGRectZero];
+		renderView.frameSource = [[SMScreenShareCanvasSource alloc] initWithCanvas:canvas];
+		videoView_ = (void *)CFBridgingRetain(renderView);
+	} else {
+		void * __block view = NULL;
+		dispatch_sync(dispatch_get_main_queue(), ^{
+			SMScreenShareRenderView *renderView = [[SMScreenShareRenderView alloc] initWithFrame:CGRectZero];
+			renderView.frameSource = [[SMScreenShareCanvasSource alloc] initWithCanvas:canvas];
+			view = (void *)CFBridgingRetain(renderView);
+		});
+		videoView_ = view;
+	}
+}
+
+
+ScreenShareRendererIOS::~ScreenShareRendererIOS()
+{
+	SMScreenShareRenderView *renderView = (__bridge_transfer SMScreenShareRenderView *)videoView_;
+	videoView_ = NULL;
+	
+	// View can outlive us, so detach it from our canvas on main thread where the canvas is polled.
+	void (^detachFrameSource)(void) = ^{
+		[(SMScreenShareCanvasSource *)renderView.frameSource invalidate];
+		renderView.frameSource = nil;
+	};
+	if ([NSThread isMainThread]) {
+		detachFrameSource();
+	} else {
+		dispatch_sync(dispatch_get_main_queue(), detachFrameSource);
+	}
+	
+	renderView = nil;
+}
+
+
+void ScreenShareRendererIOS::RenderFrame(const cricket::VideoFrame* frame)
+{
+	// Unchanged frames and tiles stop here, view uploads only what has changed on its next display refresh.
+	canvas_.UpdateWithFrame(frame);
+}
+
+
+void ScreenShareRendererIOS::Shutdown()
+{
+	canvas_.SetVisible(false);
+}
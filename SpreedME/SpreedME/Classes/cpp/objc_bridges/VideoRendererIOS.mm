@@ -30,6 +30,77 @@
 using namespace spreedme;
 
 
+// Bridges VideoFrameSlot to SMRTCVideoRenderView. Is used only on main thread.
+@interface SMVideoFrameSlotSource : NSObject <SMRTCVideoFrameSource>
+
+- (instancetype)initWithFrameSlot:(VideoFrameSlot *)frameSlot;
+// After invalidation source doesn't touch frame slot anymore.
+- (void)invalidate;
+
+@end
+
+
+@implementation SMVideoFrameSlotSource
+{
+	VideoFrameSlot *_frameSlot; // We don't own it
+}
+
+
+- (instancetype)initWithFrameSlot:(VideoFrameSlot *)frameSlot
+{
+	self = [super init];
+	if (self) {
+		_frameSlot = frameSlot;
+	}
+	return self;
+}
+
+
+- (void)invalidate
+{
+	_frameSlot = NULL;
+}
+
+
+- (RTCI420Frame *)frameToPresentAtDisplayTime:(CFTimeInterval)displayTime refreshPeriod:(CFTimeInterval)refreshPeriod
+{
+	if (!_frameSlot) {
+		return nil;
+	}
+	
+	const cricket::VideoFrame *frame = _frameSlot->FrameToPresent((int64)(displayTime * 1000000.0), (int64)(refreshPeriod * 1000000.0));
+	if (!frame) {
+		return nil;
+	}
+	
+	// RTCI420Frame keeps only a shallow copy, frame planes stay in the slot buffer. The slot doesn't give this buffer
+	// back to producer until it returns the next frame, which replaces this one in the view.
+	return [[RTCI420Frame alloc] initWithVideoFrame:frame];
+}
+
+
+- (NSInteger)preferredFrameIntervalForRefreshPeriod:(CFTimeInterval)refreshPeriod
+{
+	if (!_frameSlot) {
+		return 1;
+	}
+	
+	return _frameSlot->PreferredRefreshInterval((int64)(refreshPeriod * 1000000.0));
+}
+
+
+- (void)setVisible:(BOOL)visible
+{
+	if (_frameSlot) {
+		_frameSlot->SetVisible(visible);
+	}
+}
+
+
+@end
+
+
+
 VideoRendererIOS::VideoRendererIOS(VideoRendererDelegateInterface *delegate,
 								   const std::string &name,
 								   const std::string &videoTrackId,
@@ -37,15 +108,21 @@ VideoRendererIOS::VideoRendererIOS(VideoRendererDelegateInterface *delegate,
 VideoRenderer(delegate, name, videoTrackId, streamLabel)
 
 {
+	VideoFrameSlot *frameSlot = &frameSlot_;
+	
 	// Check in order not to deadlock in main queue
 	if ([NSThread isMainThread]) {
 		spreed_me_log("Already in main queue. Instantiate SMRTCVideoRenderView");
-		videoView_ = (void *)CFBridgingRetain([[SMRTCVideoRenderView alloc] initWithFrame:CGRectZero]);
+		SMRTCVideoRenderView *renderView = [[SMRTCVideoRenderView alloc] initWithFrame:CGRectZero];
+		renderView.frameSource = [[SMVideoFrameSlotSource alloc] initWithFrameSlot:frameSlot];
+		videoView_ = (void *)CFBridgingRetain(renderView);
 	} else {
 		spreed_me_log("Dispatch sync to instantiate SMRTCVideoRenderView in main queue");
 		void * __block view = NULL;
 		dispatch_sync(dispatch_get_main_queue(), ^{
-			view = (void *)CFBridgingRetain([[SMRTCVideoRenderView alloc] initWithFrame:CGRectZero]);
+			SMRTCVideoRenderView *renderView = [[SMRTCVideoRenderView alloc] initWithFrame:CGRectZero];
+			renderView.frameSource = [[SMVideoFrameSlotSource alloc] initWithFrameSlot:frameSlot];
+			view = (void *)CFBridgingRetain(renderView);
 		});
 		videoView_ = view;
 	}
@@ -56,17 +133,29 @@ VideoRendererIOS::~VideoRendererIOS()
 {
 	// release reference to renderView
 	SMRTCVideoRenderView *renderView = (__bridge_transfer SMRTCVideoRenderView *)videoView_;
+	videoView_ = NULL;
+	
+	// View can outlive us, so detach it from our frame slot on main thread where the slot is polled.
+	// Its current frame shares a buffer of our slot, drop it as well.
+	void (^detachFrameSource)(void) = ^{
+		[(SMVideoFrameSlotSource *)renderView.frameSource invalidate];
+		renderView.frameSource = nil;
+		renderView.i420Frame = nil;
+	};
+	if ([NSThread isMainThread]) {
+		detachFrameSource();
+	} else {
+		dispatch_sync(dispatch_get_main_queue(), detachFrameSource);
+	}
+	
 	renderView = nil;
 }
 
 
 void VideoRendererIOS::RenderFrame(const cricket::VideoFrame* frame)
 {
-	RTCI420Frame* i420Frame = [[RTCI420Frame alloc] initWithVideoFrame:frame];
-	
-	SMRTCVideoRenderView *renderView = (__bridge SMRTCVideoRenderView *)videoView_;
-	
-	renderView.i420Frame = i420Frame;
+	// Frame is copied into a reused buffer, view picks the latest one on its display refresh.
+	frameSlot_.PushFrame(frame);
 };
 
 
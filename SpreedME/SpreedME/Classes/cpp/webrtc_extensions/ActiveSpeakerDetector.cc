@@ -0,0 +1,120 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ActiveSpeakerDetector.h"
+
+#include <webrtc/base/timeutils.h>
+
+using namespace spreedme;
+
+
+// Smoothing factors for rising and falling level.
+const double kLevelAttack = 0.5;
+const double kLevelDecay = 0.15;
+// Smoothed level below this is considered silence (full scale is 32767).
+const double kSpeechLevelThreshold = 1500.0;
+const double kSwitchRatio = 1.5;
+const int kSwitchHoldMs = 1000;
+// Participants without level updates for this time are not considered.
+const int kStaleLevelMs = 5000;
+
+
+void ActiveSpeakerDetector::UpdateLevel(const std::string &userId, int level, uint32 timestamp)
+{
+	ParticipantLevel &participant = participants_[userId];
+	
+	double factor = level > participant.smoothedLevel ? kLevelAttack : kLevelDecay;
+	participant.smoothedLevel += factor * (level - participant.smoothedLevel);
+	participant.lastUpdate = timestamp;
+}
+
+
+void ActiveSpeakerDetector::RemoveParticipant(const std::string &userId)
+{
+	participants_.erase(userId);
+}
+
+
+bool ActiveSpeakerDetector::Evaluate(uint32 now)
+{
+	const ParticipantLevel *dominant = NULL;
+	ParticipantLevelMap::const_iterator dominantIt = participants_.find(dominantSpeaker_);
+	if (dominantIt != participants_.end()) {
+		dominant = &dominantIt->second;
+	} else if (!dominantSpeaker_.empty()) {
+		// Dominant speaker has left
+		dominantSpeaker_.clear();
+		candidate_.clear();
+		return true;
+	}
+	
+	const std::string *loudestId = NULL;
+	double loudestLevel = kSpeechLevelThreshold;
+	for (ParticipantLevelMap::const_iterator it = participants_.begin(); it != participants_.end(); ++it) {
+		if (rtc::TimeDiff(now, it->second.lastUpdate) > kStaleLevelMs) {
+			continue;
+		}
+		if (it->second.smoothedLevel >= loudestLevel) {
+			loudestLevel = it->second.smoothedLevel;
+			loudestId = &it->first;
+		}
+	}
+	
+	if (!loudestId || *loudestId == dominantSpeaker_) {
+		candidate_.clear();
+		return false;
+	}
+	
+	if (!dominant) {
+		dominantSpeaker_ = *loudestId;
+		candidate_.clear();
+		return true;
+	}
+	
+	if (loudestLevel < dominant->smoothedLevel * kSwitchRatio) {
+		candidate_.clear();
+		return false;
+	}
+	
+	if (candidate_ != *loudestId) {
+		candidate_ = *loudestId;
+		candidateSince_ = now;
+		return false;
+	}
+	
+	if (rtc::TimeDiff(now, candidateSince_) < kSwitchHoldMs) {
+		return false;
+	}
+	
+	dominantSpeaker_ = candidate_;
+	candidate_.clear();
+	return true;
+}
+
+
+void ActiveSpeakerDetector::Reset()
+{
+	participants_.clear();
+	dominantSpeaker_.clear();
+	candidate_.clear();
+	candidateSince_ = 0;
+}
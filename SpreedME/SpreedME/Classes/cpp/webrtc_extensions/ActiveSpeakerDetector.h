@@ -0,0 +1,76 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__ActiveSpeakerDetector__
+#define __SpreedME__ActiveSpeakerDetector__
+
+#include <map>
+#include <string>
+
+#include <webrtc/base/basictypes.h>
+
+
+namespace spreedme {
+
+// Picks dominant speaker of the call from audio levels reported by webrtc statistics.
+// Levels are smoothed with fast attack and slow decay. To take over, another participant has to be
+// louder than current dominant speaker by 'kSwitchRatio' for at least 'kSwitchHoldMs',
+// so short noises and interjections don't flip the speaker.
+// Dominant speaker stays dominant during silence until somebody else speaks.
+// ActiveSpeakerDetector is NOT thread safe.
+class ActiveSpeakerDetector
+{
+public:
+	ActiveSpeakerDetector() : candidateSince_(0) {};
+	~ActiveSpeakerDetector() {};
+	
+	// 'level' is in webrtc audio level units [0..32767]. 'timestamp' is rtc::Time().
+	void UpdateLevel(const std::string &userId, int level, uint32 timestamp);
+	void RemoveParticipant(const std::string &userId);
+	
+	// Returns true if dominant speaker has changed since the previous evaluation.
+	bool Evaluate(uint32 now);
+	
+	const std::string &dominantSpeaker() const {return dominantSpeaker_;};
+	
+	void Reset();
+	
+private:
+	struct ParticipantLevel {
+		ParticipantLevel() : smoothedLevel(0.0), lastUpdate(0) {};
+		
+		double smoothedLevel;
+		uint32 lastUpdate;
+	};
+	
+	typedef std::map<std::string, ParticipantLevel> ParticipantLevelMap;
+	
+	ParticipantLevelMap participants_;
+	std::string dominantSpeaker_;
+	std::string candidate_;
+	uint32 candidateSince_;
+};
+
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__ActiveSpeakerDetector__) */
@@ -22,6 +22,7 @@
 
 #include "Call.h"
 
+#include <algorithm>
 #include <stdexcept>
 
 #include <webrtc/base/base64.h>
@@ -35,6 +36,15 @@
 using namespace spreedme;
 
 namespace spreedme {
+
+// Video size which we send when no remote user shows our video.
+const int kInactiveVideoSubscriptionWidth = 160;
+const int kInactiveVideoSubscriptionHeight = 120;
+// Video size which we request from users who are not dominant speaker when speaker video is prioritized.
+const int kNonSpeakerVideoWidth = 320;
+const int kNonSpeakerVideoHeight = 240;
+// Non-speaker video is limited only in conferences. In 1:1 call the only remote video is never limited.
+const size_t kMinRemoteUsersToLimitNonSpeakerVideo = 2;
 	
 struct SignallingByeMessageData : public rtc::MessageData {
 	explicit SignallingByeMessageData(std::string userId, ByeReason reason) : userId(userId), reason(reason) {};
@@ -76,6 +86,22 @@ struct EstablishOutgoingCallMessageData : public rtc::MessageData {
     bool automatic;
 };
 	
+struct VideoSubscriptionMessageData : public rtc::MessageData {
+	explicit VideoSubscriptionMessageData(std::string userId, const VideoSubscription &subscription) :
+		userId(userId), subscription(subscription) {};
+	
+	std::string userId;
+	VideoSubscription subscription;
+};
+	
+struct ActiveSpeakerDetectionMessageData : public rtc::MessageData {
+	explicit ActiveSpeakerDetectionMessageData(bool enabled, bool prioritizeSpeakerVideo) :
+		enabled(enabled), prioritizeSpeakerVideo(prioritizeSpeakerVideo) {};
+	
+	bool enabled;
+	bool prioritizeSpeakerVideo;
+};
+	
 
 // '_w' - workerQueue, '_c' - callbacks queue
 enum CallThreadingMessageId
@@ -83,6 +109,7 @@ enum CallThreadingMessageId
 	MSG_SMC_ESTABLISH_OUTGOING_CALL_w = 0, // SMC == SpreedMeCall
 	MSG_SMC_ACCEPT_INCOMING_CALL_w,
 	MSG_SMC_RECEIVED_MESSAGE_w,
+	MSG_SMC_RECEIVED_PARSED_MESSAGE_w,
 	MSG_SMC_RECEIVED_BYE_MESSAGE_w,
 	MSG_SMC_HANGUP_w,
 	MSG_SMC_SET_MUTE_AUDIO_w,
@@ -97,6 +124,12 @@ enum CallThreadingMessageId
 	MSG_SMC_ENABLE_ALL_VIDEO_w,
 	MSG_SMC_DISPOSE_OF_CALL_w,
 	MSG_SMC_REQUEST_STATISTICS_w,
+	MSG_SMC_SET_STATISTICS_INTERVAL_w,
+	MSG_SMC_PERIODIC_STATISTICS_REQUEST_w,
+	MSG_SMC_REQUEST_FINAL_STATISTICS_w,
+	MSG_SMC_SET_REMOTE_VIDEO_SUBSCRIPTION_w,
+	MSG_SMC_DATA_CHANNEL_OPENED_w,
+	MSG_SMC_SET_ACTIVE_SPEAKER_DETECTION_w,
 	MSG_SMC_CALL_HAS_BEEN_CLEANED_UP_c
 };
 
@@ -122,7 +155,14 @@ Call::Call(std::string selfId,
 	audioConstraints_(NULL),
 	videoConstraints_(NULL),
 	workerQueue_(workerQueue),
-	callbackQueue_(callbackQueue)
+	callbackQueue_(callbackQueue),
+	activeSpeakerDetectionEnabled_(false),
+	prioritizeSpeakerVideo_(false),
+	isLimitingNonSpeakerVideo_(false),
+	statisticsIntervalMs_(0),
+	telemetryRecorder_(NULL),
+	hasPendingFinalStatisticsRequest_(false),
+	isGatheringFinalStatistics_(false)
 {
 	ASSERT(workerQueue_ != callbackQueue_);
 	callDeleter_ = new CallDeleter(this);
@@ -155,6 +195,11 @@ Call::~Call()
 		delete videoConstraints_;
 	}
 	
+	if (telemetryRecorder_) {
+		delete telemetryRecorder_;
+		telemetryRecorder_ = NULL;
+	}
+	
 	callbackQueue_ = NULL;
 	workerQueue_ = NULL;
 	
@@ -182,6 +227,10 @@ void Call::Dispose_w()
 	pendingOffers_.clear();
     pendingOutgoingCallOffers_.clear();
 	
+	remoteVideoSubscriptions_.clear();
+	localVideoSubscriptions_.clear();
+	activeSpeakerDetector_.Reset();
+	
 	callbackQueue_->Post(this, MSG_SMC_CALL_HAS_BEEN_CLEANED_UP_c);
 }
 
@@ -320,6 +369,246 @@ void Call::RequestToDeleteVideoRenderer_w(const std::string &userId, const std::
 }
 
 
+#pragma mark - Video subscriptions
+
+void Call::SetRemoteVideoSubscription(const std::string &userId, bool isVisible, int targetWidth, int targetHeight)
+{
+	VideoSubscriptionMessageData *msgData = new VideoSubscriptionMessageData(userId, VideoSubscription(isVisible, targetWidth, targetHeight));
+	workerQueue_->Post(this, MSG_SMC_SET_REMOTE_VIDEO_SUBSCRIPTION_w, msgData);
+}
+
+
+void Call::SetRemoteVideoSubscription_w(const std::string &userId, const VideoSubscription &subscription)
+{
+	if (userId.empty()) {
+		spreed_me_log("UserId is empty in set video subscription method!");
+		return;
+	}
+	
+	remoteVideoSubscriptions_[userId] = subscription;
+	
+	rtc::scoped_refptr<PeerConnectionWrapper> wrapper = this->WrapperForUserId(userId);
+	if (wrapper) {
+		this->ApplyRemoteVideoSubscription_w(wrapper);
+	}
+}
+
+
+VideoSubscription Call::EffectiveRemoteVideoSubscription_w(const std::string &userId)
+{
+	VideoSubscription subscription;
+	UserIdToVideoSubscriptionMap::iterator it = remoteVideoSubscriptions_.find(userId);
+	if (it != remoteVideoSubscriptions_.end()) {
+		subscription = it->second;
+	}
+	
+	const std::string &dominantSpeaker = activeSpeakerDetector_.dominantSpeaker();
+	if (isLimitingNonSpeakerVideo_ && subscription.isVisible && !dominantSpeaker.empty() && dominantSpeaker != userId) {
+		if (subscription.width <= 0 || subscription.width > kNonSpeakerVideoWidth) {
+			subscription.width = kNonSpeakerVideoWidth;
+		}
+		if (subscription.height <= 0 || subscription.height > kNonSpeakerVideoHeight) {
+			subscription.height = kNonSpeakerVideoHeight;
+		}
+	}
+	
+	return subscription;
+}
+
+
+bool Call::ShouldSendRemoteVideoSubscription_w(const std::string &userId)
+{
+	// We don't bother users with default subscription
+	return remoteVideoSubscriptions_.count(userId) > 0 || isLimitingNonSpeakerVideo_;
+}
+
+
+void Call::UpdateNonSpeakerVideoLimits_w()
+{
+	bool isLimiting = activeSpeakerDetectionEnabled_ && prioritizeSpeakerVideo_ &&
+		activeConnections_.size() >= kMinRemoteUsersToLimitNonSpeakerVideo;
+	if (isLimiting == isLimitingNonSpeakerVideo_) {
+		return;
+	}
+	
+	bool wasLimiting = isLimitingNonSpeakerVideo_;
+	isLimitingNonSpeakerVideo_ = isLimiting;
+	// Users which have got thumbnail limits have to be told that limits are lifted
+	this->ApplyAllRemoteVideoSubscriptions_w(wasLimiting);
+}
+
+
+void Call::ApplyAllRemoteVideoSubscriptions_w(bool force)
+{
+	for (UserIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end(); ++it) {
+		if (force || this->ShouldSendRemoteVideoSubscription_w(it->first)) {
+			this->ApplyRemoteVideoSubscription_w(it->second);
+		}
+	}
+}
+
+
+void Call::ApplyRemoteVideoSubscription_w(rtc::scoped_refptr<PeerConnectionWrapper> wrapper)
+{
+	VideoSubscription subscription = this->EffectiveRemoteVideoSubscription_w(wrapper->userId());
+	
+	wrapper->SetRemoteVideoEnabled(subscription.isVisible);
+	
+	Json::Value subscriptionJson;
+	subscriptionJson[kVideoSubscriptionActiveKey] = subscription.isVisible;
+	subscriptionJson[kVideoSubscriptionWidthKey] = subscription.width;
+	subscriptionJson[kVideoSubscriptionHeightKey] = subscription.height;
+	
+	Json::Value jmessage;
+	jmessage[kTypeKey] = kVideoSubscriptionKey;
+	jmessage[kVideoSubscriptionKey] = subscriptionJson;
+	
+	// Subscription is a hint for remote user so we send it only P2P. If data channel is not opened yet
+	// we will resend it when it opens.
+	Json::StyledWriter writer;
+	signallingHandler_->SendP2PMessage(writer.write(jmessage), wrapper.get());
+}
+
+
+void Call::ReceivedVideoSubscription(const Json::Value &videoSubscriptionMessage, const std::string &from)
+{
+	if (!this->WrapperForUserIdExists(from)) {
+		spreed_me_log("Video subscription from user who is not in the call. Ignore.");
+		return;
+	}
+	
+	Json::Value subscriptionJson = videoSubscriptionMessage.get(kVideoSubscriptionKey, Json::Value());
+	if (!subscriptionJson.isObject()) {
+		spreed_me_log("Couldn't parse video subscription message!");
+		return;
+	}
+	
+	VideoSubscription subscription(subscriptionJson.get(kVideoSubscriptionActiveKey, true).asBool(),
+								   subscriptionJson.get(kVideoSubscriptionWidthKey, 0).asInt(),
+								   subscriptionJson.get(kVideoSubscriptionHeightKey, 0).asInt());
+	localVideoSubscriptions_[from] = subscription;
+	
+	this->UpdateLocalVideoOutputSize_w();
+}
+
+
+void Call::ForgetVideoSubscriptions_w(const std::string &userId)
+{
+	activeSpeakerDetector_.RemoveParticipant(userId);
+	remoteVideoSubscriptions_.erase(userId);
+	if (localVideoSubscriptions_.erase(userId) > 0) {
+		this->UpdateLocalVideoOutputSize_w();
+	}
+}
+
+
+void Call::UpdateLocalVideoOutputSize_w()
+{
+	// We have only one video source for all peers so we send the biggest video somebody wants to see.
+	int maxWidth = 0;
+	int maxHeight = 0;
+	bool isVisibleForSomebody = false;
+	
+	for (UserIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end(); ++it) {
+		UserIdToVideoSubscriptionMap::iterator subscriptionIt = localVideoSubscriptions_.find(it->first);
+		if (subscriptionIt == localVideoSubscriptions_.end()) {
+			// This user hasn't told us anything, so we don't limit video for him.
+			peerConnectionWrapperFactory_->SetMaxVideoOutputSize(0, 0);
+			return;
+		}
+		
+		const VideoSubscription &subscription = subscriptionIt->second;
+		if (subscription.isVisible) {
+			if (subscription.width <= 0 || subscription.height <= 0) {
+				peerConnectionWrapperFactory_->SetMaxVideoOutputSize(0, 0);
+				return;
+			}
+			isVisibleForSomebody = true;
+			maxWidth = std::max(maxWidth, subscription.width);
+			maxHeight = std::max(maxHeight, subscription.height);
+		}
+	}
+	
+	if (!isVisibleForSomebody) {
+		maxWidth = kInactiveVideoSubscriptionWidth;
+		maxHeight = kInactiveVideoSubscriptionHeight;
+	}
+	
+	peerConnectionWrapperFactory_->SetMaxVideoOutputSize(maxWidth, maxHeight);
+}
+
+
+void Call::DataChannelOpened_w(const std::string &userId)
+{
+	if (this->ShouldSendRemoteVideoSubscription_w(userId)) {
+		rtc::scoped_refptr<PeerConnectionWrapper> wrapper = this->WrapperForUserId(userId);
+		if (wrapper) {
+			this->ApplyRemoteVideoSubscription_w(wrapper);
+		}
+	}
+}
+
+
+#pragma mark - Active speaker
+
+void Call::SetActiveSpeakerDetection(bool enabled, bool prioritizeSpeakerVideo)
+{
+	ActiveSpeakerDetectionMessageData *msgData = new ActiveSpeakerDetectionMessageData(enabled, prioritizeSpeakerVideo);
+	workerQueue_->Post(this, MSG_SMC_SET_ACTIVE_SPEAKER_DETECTION_w, msgData);
+}
+
+
+void Call::SetActiveSpeakerDetection_w(bool enabled, bool prioritizeSpeakerVideo)
+{
+	bool hadDominantSpeaker = !activeSpeakerDetector_.dominantSpeaker().empty();
+	
+	activeSpeakerDetectionEnabled_ = enabled;
+	prioritizeSpeakerVideo_ = prioritizeSpeakerVideo;
+	
+	if (!enabled) {
+		activeSpeakerDetector_.Reset();
+		if (hadDominantSpeaker && delegate_) {
+			delegate_->DominantSpeakerChanged(this, std::string());
+		}
+	}
+	
+	this->UpdateNonSpeakerVideoLimits_w();
+}
+
+
+void Call::UpdateActiveSpeaker_w(const CallStatistics &statistics)
+{
+	if (!activeSpeakerDetectionEnabled_) {
+		return;
+	}
+	
+	// Only remote users compete for dominant speaker, local user talking must not shrink video of the others.
+	for (ConnectionStatisticsVector::const_iterator it = statistics.connections.begin(); it != statistics.connections.end(); ++it) {
+		if (it->isClosed) {
+			// User might have reconnected with another wrapper
+			if (!this->WrapperForUserIdExists(it->userId)) {
+				activeSpeakerDetector_.RemoveParticipant(it->userId);
+			}
+			continue;
+		}
+		activeSpeakerDetector_.UpdateLevel(it->userId, it->audioOutputLevel, it->timestamp);
+	}
+	
+	if (activeSpeakerDetector_.Evaluate(statistics.timestamp)) {
+		const std::string &dominantSpeaker = activeSpeakerDetector_.dominantSpeaker();
+		spreed_me_log("Dominant speaker has changed to %s", dominantSpeaker.c_str());
+		
+		if (isLimitingNonSpeakerVideo_) {
+			this->ApplyAllRemoteVideoSubscriptions_w(false);
+		}
+		
+		if (delegate_) {
+			delegate_->DominantSpeakerChanged(this, dominantSpeaker);
+		}
+	}
+}
+
+
 #pragma mark - PeerConnection management
 
 rtc::scoped_refptr<PeerConnectionWrapper> Call::CreatePeerConnectionWrapper(const std::string &userId)
@@ -334,6 +623,16 @@ bool Call::InsertNewWrapperWithUserId(rtc::scoped_refptr<PeerConnectionWrapper>
 	critSect_->Enter();
 	std::pair<UserIdToWrapperMap::iterator , bool> ret = activeConnections_.insert(std::pair< std::string, rtc::scoped_refptr<PeerConnectionWrapper> >(userId, wrapper));
 	critSect_->Leave();
+	
+	// New user hasn't sent us his subscription yet so our video might be limited too much for him.
+	if (ret.second && !localVideoSubscriptions_.empty()) {
+		this->UpdateLocalVideoOutputSize_w();
+	}
+	
+	if (ret.second) {
+		this->UpdateNonSpeakerVideoLimits_w();
+	}
+	
 	return ret.second;
 }
 
@@ -640,6 +939,8 @@ void Call::ReceivedByeMessage(const std::string &userId, ByeReason reason)
 
 void Call::ReceivedByeMessage_w(const std::string &userId, ByeReason reason)
 {
+	this->RecordSignallingEvent(userId, telemetry::kSignallingEventHangUp);
+	
 	// TODO: Find a better way to deal with this
 	/*
 	 Added scope in order to release wrapper since we need it only to check if there is userId registered. 
@@ -713,6 +1014,7 @@ void Call::CloseCall(ByeReason reason, bool sendBye)
 		closedConnections_.insert(WrapperIdToWrapperPair(it->first, it->second));
 	}
     activeConnections_.clear();
+	isLimitingNonSpeakerVideo_ = false;
 	
 	pendingOffers_.clear();
     pendingOutgoingCallOffers_.clear();
@@ -739,12 +1041,16 @@ void Call::HangUpUser(const std::string &userId)
 	
 	critSect_->Leave();
 	
+	this->ForgetVideoSubscriptions_w(userId);
+	this->UpdateNonSpeakerVideoLimits_w();
 	this->SendBye(userId, kByeReasonNotSpecified);
 }
 
 
 void Call::SendBye(const std::string &userId, ByeReason reason)
 {
+	this->RecordSignallingEvent(userId, telemetry::kSignallingEventHangUp);
+	
 	//first clean up any pending offers/conferences for this user
 	UserIdToPendindOfferPackageMap::iterator it = pendingOffers_.find(userId);
 	if (it != pendingOffers_.end()) {
@@ -832,6 +1138,12 @@ void Call::EnableAllVideo_w()
 {
 	for (UserIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end(); it++) {
 		it->second->EnableAllVideo();
+		
+		// Keep video of users who are not on screen disabled
+		UserIdToVideoSubscriptionMap::iterator subscriptionIt = remoteVideoSubscriptions_.find(it->first);
+		if (subscriptionIt != remoteVideoSubscriptions_.end() && !subscriptionIt->second.isVisible) {
+			it->second->SetRemoteVideoEnabled(false);
+		}
 	}
 	
 	peerConnectionWrapperFactory_->StartVideoCapturing();
@@ -938,37 +1250,52 @@ void Call::MessageReceived(const std::string &msg, ChannelingMessageTransportTyp
 }
 
 
+void Call::MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+{
+	JsonSignallingMessageData *msgData = new JsonSignallingMessageData(root, transportType, wrapperId);
+	workerQueue_->Post(this, MSG_SMC_RECEIVED_PARSED_MESSAGE_w, msgData);
+}
+
+
 void Call::MessageReceived_w(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
 {
 	Json::Reader jsonReader;
 	Json::Value root;
 	
-    spreed_me_log("MSG: %s", msg.c_str());
 	bool success = jsonReader.parse(msg, root);
 	if (success) {
-		Json::Value innerJson = root[kDataKey];
-		if (!innerJson.isNull()) {
-			std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
-			std::string from = root.get(kFromKey, Json::Value()).asString();
-			if (!messageType.empty()) {
-				if (messageType == kOfferKey) {
-					this->ReceivedOffer(innerJson, from);
-				} else if (messageType == kAnswerKey) {
-					this->ReceivedAnswer(innerJson, from);
-				} else if (messageType == kCandidateKey) {
-					this->ReceivedCandidate(innerJson, from);
-				} else if (messageType == kConferenceKey) {
-					this->ReceivedConferenceDocument(innerJson);
-				} else {
-					// ignore this message. It was not meant for us.
-					//spreed_me_log("This message is no Offer, Answer, Conference or Candidate. Ignore it.\n");
-				}
+		this->MessageReceived_w(root, transportType, wrapperId);
+	} else {
+		spreed_me_log("Error, couldn't parse message!\n");
+	}
+}
+
+
+void Call::MessageReceived_w(const Json::Value &root, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+{
+	const Json::Value &innerJson = root[kDataKey];
+	if (!innerJson.isNull()) {
+		std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
+		std::string from = root.get(kFromKey, Json::Value()).asString();
+		spreed_me_log("MSG: %s from %s", messageType.c_str(), from.c_str());
+		if (!messageType.empty()) {
+			if (messageType == kOfferKey) {
+				this->ReceivedOffer(innerJson, from);
+			} else if (messageType == kAnswerKey) {
+				this->ReceivedAnswer(innerJson, from);
+			} else if (messageType == kCandidateKey) {
+				this->ReceivedCandidate(innerJson, from);
+			} else if (messageType == kConferenceKey) {
+				this->ReceivedConferenceDocument(innerJson);
+			} else if (messageType == kVideoSubscriptionKey) {
+				this->ReceivedVideoSubscription(innerJson, from);
 			} else {
-				spreed_me_log("Error, couldn't parse message type!\n");
+				// ignore this message. It was not meant for us.
+				//spreed_me_log("This message is no Offer, Answer, Conference or Candidate. Ignore it.\n");
 			}
+		} else {
+			spreed_me_log("Error, couldn't parse message type!\n");
 		}
-	} else {
-		spreed_me_log("Error, couldn't parse message!\n");
 	}
 }
 
@@ -981,6 +1308,8 @@ void Call::MessageReceived(const std::string &msg, ChannelingMessageTransportTyp
 
 void Call::ProcessDefaultAudioVideoOffer(const Json::Value &unwrappedOffer, const std::string &from)
 {
+	this->RecordSignallingEvent(from, telemetry::kSignallingEventOfferReceived);
+	
 	std::string conferenceId = unwrappedOffer.get(kOfferConferenceKey, Json::Value()).asString();
 	
 	switch (state_) {
@@ -1070,6 +1399,7 @@ void Call::ReceivedAnswer(const Json::Value &answerJson, const std::string &from
 				
 				std::string sdp = wrappedAnswer.get(kSessionDescriptionSdpKey, Json::Value()).asString();
 				if (!sdp.empty()) {
+					this->RecordSignallingEvent(from, telemetry::kSignallingEventAnswerReceived);
 					wrapper->SetupRemoteAnswer(sdp);
 					
 					if (activeConnections_.size() > 1) {
@@ -1102,6 +1432,7 @@ void Call::ReceivedCandidate(const Json::Value &candidateJson, const std::string
 			std::string candidateString = wrappedCandidate.get(kCandidateSdpKey, Json::Value()).asString();
 
 			if (sdpMLineIndex > -1) {
+				this->RecordSignallingEvent(from, telemetry::kSignallingEventFirstCandidateReceived);
 				wrapper->SetupRemoteCandidate(sdpMid, sdpMLineIndex, candidateString);
 			} else {
 				throw std::runtime_error("Candidate inline index is not correct!!!");
@@ -1170,8 +1501,16 @@ void Call::IceConnectionStateChanged(webrtc::PeerConnectionInterface::IceConnect
 	critSect_->Enter();
 	bool isWrapperRegistered = this->CheckIfRegisteredWrapper(peerConnectionWrapper);
 	std::string userId = peerConnectionWrapper->userId();
+	CallTelemetryRecorder *telemetryRecorder = telemetryRecorder_;
 	critSect_->Leave();
 	if (isWrapperRegistered) {
+		if (telemetryRecorder) {
+			telemetryRecorder->RecordIceConnectionState(userId, new_state);
+			if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected) {
+				telemetryRecorder->RecordSignallingEvent(userId, telemetry::kSignallingEventConnectionEstablished);
+			}
+		}
+		
 		switch (new_state) {
 			case webrtc::PeerConnectionInterface::kIceConnectionNew:
 			case webrtc::PeerConnectionInterface::kIceConnectionChecking:
@@ -1230,6 +1569,7 @@ void Call::PeerConnectionObjectHasBeenCreated(PeerConnectionWrapper *peerConnect
 
 void Call::AnswerIsReadyToBeSent(const std::string &sdType, const std::string &sdp, PeerConnectionWrapper *peerConnectionWrapper)
 {
+	this->RecordSignallingEvent(peerConnectionWrapper->userId(), telemetry::kSignallingEventAnswerSent);
 	signallingHandler_->SendAnswer(sdType, sdp, std::string(), std::string(), peerConnectionWrapper);
 }
 
@@ -1250,19 +1590,24 @@ void Call::OfferIsReadyToBeSent(const std::string &sdType, const std::string &sd
         pendingOutgoingCallOffers_.erase(it);
     }
 	
+	this->RecordSignallingEvent(peerConnectionWrapper->userId(), telemetry::kSignallingEventOfferSent);
 	signallingHandler_->SendOffer(sdType, sdp, std::string(), std::string(), confId, peerConnectionWrapper);
 }
 
 
 void Call::CandidateIsReadyToBeSent(IceCandidateStringRepresentation* candidate, PeerConnectionWrapper *peerConnectionWrapper)
 {
+	this->RecordSignallingEvent(peerConnectionWrapper->userId(), telemetry::kSignallingEventFirstCandidateSent);
 	signallingHandler_->SendCandidate(candidate, std::string(), std::string(), peerConnectionWrapper);
 }
 
 
 void Call::DataChannelStateChanged(webrtc::DataChannelInterface::DataState state, webrtc::DataChannelInterface *data_channel, PeerConnectionWrapper *wrapper)
 {
-	
+	if (state == webrtc::DataChannelInterface::kOpen && data_channel->label() == kDefaultDataChannelLabel) {
+		StringMessageData *msgData = new StringMessageData(wrapper->userId());
+		workerQueue_->Post(this, MSG_SMC_DATA_CHANNEL_OPENED_w, msgData);
+	}
 }
 
 
@@ -1381,6 +1726,13 @@ void Call::VideoRendererWasSetup(PeerConnectionWrapper *peerConnectionWrapper,
 void Call::VideoRendererHasChangedFrameSize(PeerConnectionWrapper *peerConnectionWrapper,
 											const VideoRendererInfo &info)
 {
+	critSect_->Enter();
+	CallTelemetryRecorder *telemetryRecorder = telemetryRecorder_;
+	critSect_->Leave();
+	if (telemetryRecorder) {
+		telemetryRecorder->RecordFrameSize(info.userSessionId, info.rendererName, info.frameWidth, info.frameHeight);
+	}
+	
 	if (delegate_) {
 		delegate_->VideoRendererHasSetFrame(this, info);
 	}
@@ -1424,15 +1776,16 @@ void Call::PeerConnectionWrapperHasReceivedStats(spreedme::PeerConnectionWrapper
 {
 	std::string factoryId = peerConnectionWrapper->factoryId();
 	if (statisticsWaitSet_.count(factoryId)) {
-		collectedStatReports_.insert(collectedStatReports_.end(), reports.begin(), reports.end());
+		bool isClosed = !this->CheckIfRegisteredWrapper(peerConnectionWrapper);
+		statisticsCollector_.UpdateConnection(factoryId, peerConnectionWrapper->userId(), isClosed, reports);
 		statisticsWaitSet_.erase(factoryId);
 		
 		// Check if we have gathered all statistics we were eaiting for
 		if (statisticsWaitSet_.size() == 0) {
-			
-			webrtc::StatsReports reports = collectedStatReports_;
-			
-			delegate_->CallHasReceivedStatistics(this, reports);
+			this->PublishStatistics_w();
+			if (hasPendingFinalStatisticsRequest_) {
+				this->StartFinalStatisticsRequest_w();
+			}
 		}
 		
 	} else {
@@ -1552,8 +1905,6 @@ void Call::RequestStatistics_w()
 {
 	if (!statisticsWaitSet_.size()) {
 		
-		collectedStatReports_.clear();
-		
 		for (WrapperIdToWrapperMap::iterator it = activeConnections_.begin(); it != activeConnections_.end(); ++it) {
 			statisticsWaitSet_.insert(it->second->factoryId());
 			it->second->RequestStatisticsReportsForAllStreams();
@@ -1570,6 +1921,137 @@ void Call::RequestStatistics_w()
 }
 
 
+void Call::SetStatisticsInterval(int intervalMs)
+{
+	IntegerMessageData *msgData = new IntegerMessageData(intervalMs);
+	workerQueue_->Post(this, MSG_SMC_SET_STATISTICS_INTERVAL_w, msgData);
+}
+
+
+void Call::SetStatisticsInterval_w(int intervalMs)
+{
+	statisticsIntervalMs_ = intervalMs > 0 ? intervalMs : 0;
+	workerQueue_->Clear(this, MSG_SMC_PERIODIC_STATISTICS_REQUEST_w);
+	if (statisticsIntervalMs_ > 0) {
+		workerQueue_->PostDelayed(statisticsIntervalMs_, this, MSG_SMC_PERIODIC_STATISTICS_REQUEST_w);
+	}
+}
+
+
+void Call::RequestFinalStatistics()
+{
+	workerQueue_->Post(this, MSG_SMC_REQUEST_FINAL_STATISTICS_w);
+}
+
+
+void Call::RequestFinalStatistics_w()
+{
+	if (hasPendingFinalStatisticsRequest_ || isGatheringFinalStatistics_) {
+		return;
+	}
+	
+	this->SetStatisticsInterval_w(0);
+	
+	if (statisticsWaitSet_.size()) {
+		// Periodic request is in progress, its snapshot is not final. Start final request when it is gathered.
+		hasPendingFinalStatisticsRequest_ = true;
+	} else {
+		this->StartFinalStatisticsRequest_w();
+	}
+}
+
+
+void Call::StartFinalStatisticsRequest_w()
+{
+	hasPendingFinalStatisticsRequest_ = false;
+	isGatheringFinalStatistics_ = true;
+	
+	this->RequestStatistics_w();
+	if (statisticsWaitSet_.size() == 0) {
+		// There are no connections to wait for, publish what we have.
+		this->PublishStatistics_w();
+	}
+}
+
+
+void Call::PublishStatistics_w()
+{
+	bool isFinal = isGatheringFinalStatistics_;
+	isGatheringFinalStatistics_ = false;
+	
+	const CallStatistics &statistics = statisticsCollector_.PublishSnapshot(isFinal);
+	this->RecordTelemetryStatistics(statistics);
+	this->UpdateActiveSpeaker_w(statistics);
+	if (delegate_) {
+		delegate_->CallHasReceivedStatistics(this, statistics);
+	}
+}
+
+
+void Call::PeriodicStatisticsRequest_w()
+{
+	if (state_ == kSMCStateFinished || statisticsIntervalMs_ <= 0) {
+		return;
+	}
+	
+	if (activeConnections_.size()) {
+		this->RequestStatistics_w();
+	}
+	
+	workerQueue_->PostDelayed(statisticsIntervalMs_, this, MSG_SMC_PERIODIC_STATISTICS_REQUEST_w);
+}
+
+
+#pragma mark - Telemetry
+
+void Call::StartTelemetryRecording(const std::string &filePath, size_t maxFileSize, int maxRotatedFiles)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!telemetryRecorder_) {
+		telemetryRecorder_ = new CallTelemetryRecorder(filePath, callId_, maxFileSize, maxRotatedFiles);
+	}
+	
+	if (!telemetryRecorder_->Start()) {
+		spreed_me_log("Couldn't start telemetry recording for call %s", callId_.c_str());
+	}
+}
+
+
+void Call::StopTelemetryRecording()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (telemetryRecorder_) {
+		telemetryRecorder_->Stop();
+	}
+}
+
+
+void Call::RecordSignallingEvent(const std::string &userId, telemetry::SignallingEvent event)
+{
+	critSect_->Enter();
+	CallTelemetryRecorder *telemetryRecorder = telemetryRecorder_;
+	critSect_->Leave();
+	
+	if (telemetryRecorder) {
+		telemetryRecorder->RecordSignallingEvent(userId, event);
+	}
+}
+
+
+void Call::RecordTelemetryStatistics(const CallStatistics &statistics)
+{
+	critSect_->Enter();
+	CallTelemetryRecorder *telemetryRecorder = telemetryRecorder_;
+	critSect_->Leave();
+	
+	if (telemetryRecorder) {
+		telemetryRecorder->RecordStatistics(statistics);
+	}
+}
+
+
 #pragma mark - rtc::MessageHandler
 
 void Call::OnMessage(rtc::Message *msg)
@@ -1598,6 +2080,13 @@ void Call::OnMessage(rtc::Message *msg)
 			break;
 		}
 
+		case MSG_SMC_RECEIVED_PARSED_MESSAGE_w: {
+			JsonSignallingMessageData *param = static_cast<JsonSignallingMessageData*>(msg->pdata);
+			this->MessageReceived_w(param->root, param->transportType, param->wrapperId);
+			delete param;
+			break;
+		}
+
 		case MSG_SMC_RECEIVED_BYE_MESSAGE_w: {
 			SignallingByeMessageData *param = static_cast<SignallingByeMessageData*>(msg->pdata);
 			this->ReceivedByeMessage_w(param->userId, param->reason);
@@ -1647,6 +2136,27 @@ void Call::OnMessage(rtc::Message *msg)
 			break;
 		}
 			
+		case MSG_SMC_SET_REMOTE_VIDEO_SUBSCRIPTION_w: {
+			VideoSubscriptionMessageData *param = static_cast<VideoSubscriptionMessageData*>(msg->pdata);
+			this->SetRemoteVideoSubscription_w(param->userId, param->subscription);
+			delete param;
+			break;
+		}
+			
+		case MSG_SMC_DATA_CHANNEL_OPENED_w: {
+			StringMessageData *param = static_cast<StringMessageData*>(msg->pdata);
+			this->DataChannelOpened_w(param->value); // value == userId
+			delete param;
+			break;
+		}
+			
+		case MSG_SMC_SET_ACTIVE_SPEAKER_DETECTION_w: {
+			ActiveSpeakerDetectionMessageData *param = static_cast<ActiveSpeakerDetectionMessageData*>(msg->pdata);
+			this->SetActiveSpeakerDetection_w(param->enabled, param->prioritizeSpeakerVideo);
+			delete param;
+			break;
+		}
+			
 		case MSG_SMC_SET_VIDEO_DEVICE_ID_w: {
 			StringMessageData *param = static_cast<StringMessageData*>(msg->pdata);
 			this->SetVideoDeviceId_w(param->value); // value == videoDeviceId
@@ -1691,6 +2201,21 @@ void Call::OnMessage(rtc::Message *msg)
 			this->RequestStatistics_w();
 			break;
 			
+		case MSG_SMC_REQUEST_FINAL_STATISTICS_w:
+			this->RequestFinalStatistics_w();
+			break;
+			
+		case MSG_SMC_SET_STATISTICS_INTERVAL_w: {
+			IntegerMessageData *param = static_cast<IntegerMessageData*>(msg->pdata);
+			this->SetStatisticsInterval_w(param->value);
+			delete param;
+			break;
+		}
+			
+		case MSG_SMC_PERIODIC_STATISTICS_REQUEST_w:
+			this->PeriodicStatisticsRequest_w();
+			break;
+			
 		default:
 			ASSERT(false && "Not implemented");
 			break;
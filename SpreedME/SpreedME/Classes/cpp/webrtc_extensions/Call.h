@@ -28,6 +28,9 @@
 
 #include <talk/app/webrtc/mediastreaminterface.h>
 
+#include "ActiveSpeakerDetector.h"
+#include "CallStatistics.h"
+#include "CallTelemetryRecorder.h"
 #include "CommonCppTypes.h"
 #include "MessageQueueInterface.h"
 #include "PeerConnectionWrapper.h"
@@ -118,7 +121,14 @@ public:
 	
 	
 	// ----------- Statistics
-	virtual void CallHasReceivedStatistics(Call *call, const webrtc::StatsReports &reports) = 0;
+	// 'statistics' contains every active and closed connection of the call. It is only valid during the call,
+	// copy it if you need it later.
+	virtual void CallHasReceivedStatistics(Call *call, const CallStatistics &statistics) = 0;
+	
+	// ----------- Active speaker
+	// 'userId' is always a remote user, local user doesn't take part in detection.
+	// It is empty when there is no dominant speaker anymore.
+	virtual void DominantSpeakerChanged(Call *call, const std::string &userId) = 0;
 	
 	
 	virtual ~CallDelegateInterface() {};
@@ -146,6 +156,19 @@ typedef std::pair<std::string, PendingOfferPackage> UserIdToPendingOfferPackageP
 typedef std::map<std::string, bool> AutomaticOutgoingCallPendingOfferMap;
 typedef std::pair<std::string, bool> UserIdToAutomaticOfferPair;
 
+
+struct VideoSubscription {
+	// Describes how video of one user is shown. Size 0x0 means no size limit.
+	VideoSubscription() : isVisible(true), width(0), height(0) {};
+	VideoSubscription(bool isVisible, int width, int height) : isVisible(isVisible), width(width), height(height) {};
+	
+	bool isVisible;
+	int width;
+	int height;
+};
+
+typedef std::map<std::string, VideoSubscription> UserIdToVideoSubscriptionMap;
+
 	
 class Call : public PeerConnectionWrapperDelegateInterface,
 			 public SignallingMessageReceiverInterface,
@@ -181,6 +204,18 @@ public:
 	// Requests statistics for every audio and video track in every peer connection in the call.
 	// This call does nothing if previous call has not finished gathering statistics.
 	virtual void RequestStatistics();
+	// Requests statistics every 'intervalMs' milliseconds until call is finished. Pass 0 to stop periodic requests.
+	virtual void SetStatisticsInterval(int intervalMs);
+	// Stops periodic requests and requests statistics once more. Unlike 'RequestStatistics()' this is never dropped,
+	// if a request is in progress it is started after it. Delegate gets CallStatistics with isFinal set for it.
+	// Use it after call is finished to get call totals.
+	virtual void RequestFinalStatistics();
+
+	// Starts recording of statistics, ICE states, renderer frame sizes and signalling timings to 'filePath'.
+	// Statistics are only recorded when they are requested, see 'SetStatisticsInterval()'.
+	// 'maxFileSize' and 'maxRotatedFiles' are passed to CallTelemetryRecorder.
+	virtual void StartTelemetryRecording(const std::string &filePath, size_t maxFileSize, int maxRotatedFiles);
+	virtual void StopTelemetryRecording();
 
 	virtual CallState state() {critSect_->Enter(); CallState state = state_; critSect_->Leave(); return state;};
 	
@@ -200,6 +235,7 @@ public:
 	// ----------- Signalling
 	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId); //s
 	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token); //empty implementation
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId);
 	
 	
 	// ----------- Call control actions
@@ -231,6 +267,19 @@ public:
 											  const std::string &videoTrackId,
 											  const std::string &rendererName);
 	
+	// Marks video of 'userId' as visible at 'targetWidth'x'targetHeight' or as inactive (not on screen).
+	// Inactive remote video track is disabled so it is not decoded and remote user is asked
+	// over data channel to send us smaller video. Visible state restores both.
+	// Video of every user is visible without size limit until this method is called for the user.
+	virtual void SetRemoteVideoSubscription(const std::string &userId, bool isVisible, int targetWidth, int targetHeight);
+	
+	// Enables detection of dominant speaker from audio levels. Detection runs on every statistics snapshot,
+	// so statistics should be requested periodically, see 'SetStatisticsInterval()'.
+	// If 'prioritizeSpeakerVideo' is true and there are at least two remote users, video of every visible user
+	// except dominant speaker is requested in thumbnail size, so dominant speaker gets most of the bandwidth.
+	// Video in 1:1 calls is never limited.
+	virtual void SetActiveSpeakerDetection(bool enabled, bool prioritizeSpeakerVideo);
+	
 	
 	// ----------- Call constraints
 	virtual void SetVideoDeviceId(const std::string &deviceId);
@@ -321,6 +370,7 @@ protected:
 	virtual void EstablishOutgoingCall_w(const std::string &userId, MediaConstraints *mediaConstraints, bool automatic);
 	virtual void AcceptIncomingCall_w(const std::string &userId, const std::string &sdp, MediaConstraints *mediaConstraints);
 	virtual void MessageReceived_w(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId);
+	virtual void MessageReceived_w(const Json::Value &root, ChannelingMessageTransportType transportType, const std::string& wrapperId);
 	virtual void ReceivedByeMessage_w(const std::string &userId, ByeReason reason);
 	virtual void HangUp_w(ByeReason reason);
 	virtual void MuteAudio_w(bool onOff);
@@ -339,7 +389,15 @@ protected:
 												const std::string &streamLabel,
 												const std::string &videoTrackId,
 												const std::string &rendererName);
+	virtual void SetRemoteVideoSubscription_w(const std::string &userId, const VideoSubscription &subscription);
+	virtual void DataChannelOpened_w(const std::string &userId);
+	virtual void SetActiveSpeakerDetection_w(bool enabled, bool prioritizeSpeakerVideo);
 	virtual void RequestStatistics_w();
+	virtual void SetStatisticsInterval_w(int intervalMs);
+	virtual void PeriodicStatisticsRequest_w();
+	virtual void RequestFinalStatistics_w();
+	void StartFinalStatisticsRequest_w();
+	void PublishStatistics_w();
 	
 
 	
@@ -354,6 +412,22 @@ private:
 	
 	void SetupPeerConnectionFactory();
 	
+	// Video subscriptions
+	VideoSubscription EffectiveRemoteVideoSubscription_w(const std::string &userId);
+	bool ShouldSendRemoteVideoSubscription_w(const std::string &userId);
+	// Starts or lifts thumbnail limits when detection settings or number of remote users change.
+	void UpdateNonSpeakerVideoLimits_w();
+	void ApplyRemoteVideoSubscription_w(rtc::scoped_refptr<PeerConnectionWrapper> wrapper);
+	void ApplyAllRemoteVideoSubscriptions_w(bool force);
+	void ReceivedVideoSubscription(const Json::Value &videoSubscriptionMessage, const std::string &from);
+	void ForgetVideoSubscriptions_w(const std::string &userId);
+	void UpdateLocalVideoOutputSize_w();
+	
+	void UpdateActiveSpeaker_w(const CallStatistics &statistics);
+	
+	void RecordSignallingEvent(const std::string &userId, telemetry::SignallingEvent event);
+	void RecordTelemetryStatistics(const CallStatistics &statistics);
+	
 	//variables--------------------------------------------------------------------------------
 	webrtc::CriticalSectionWrapper *critSect_;
 	
@@ -395,12 +469,25 @@ private:
 	
 	CallPrivateDeletionInterface *callDeleter_; // this object deletes itself
 	
-	webrtc::StatsReports collectedStatReports_;
+	UserIdToVideoSubscriptionMap remoteVideoSubscriptions_; // how we show video of other users
+	UserIdToVideoSubscriptionMap localVideoSubscriptions_; // how other users show our video
+	
+	ActiveSpeakerDetector activeSpeakerDetector_;
+	bool activeSpeakerDetectionEnabled_;
+	bool prioritizeSpeakerVideo_;
+	bool isLimitingNonSpeakerVideo_;
+	
+	CallStatisticsCollector statisticsCollector_;
+	int statisticsIntervalMs_;
+	
+	CallTelemetryRecorder *telemetryRecorder_; // we own it. Once created it lives as long as call.
 	
 	// This is a set of wrapper factory ids of wrappers for which we wait for statistics.
 	// We only call statistics callback when this list is empty.
 	// We populate this list when receive 'RequestStatistics()' call
 	std::set<std::string> statisticsWaitSet_;
+	bool hasPendingFinalStatisticsRequest_; // final request waits for the request in progress
+	bool isGatheringFinalStatistics_;
 };
 
 	
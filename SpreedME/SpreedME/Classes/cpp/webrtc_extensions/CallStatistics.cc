@@ -0,0 +1,175 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CallStatistics.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <webrtc/base/timeutils.h>
+
+using namespace spreedme;
+
+
+namespace {
+
+// StatsReport keeps values as strings. Parse them in place instead of going through streams.
+uint64 Uint64Value(const webrtc::StatsReport *report, webrtc::StatsReport::StatsValueName name)
+{
+	const webrtc::StatsReport::Value *value = report->FindValue(name);
+	if (value) {
+		return strtoull(value->value.c_str(), NULL, 10);
+	}
+	return 0;
+}
+
+
+int IntValue(const webrtc::StatsReport *report, webrtc::StatsReport::StatsValueName name)
+{
+	const webrtc::StatsReport::Value *value = report->FindValue(name);
+	if (value) {
+		return (int)strtol(value->value.c_str(), NULL, 10);
+	}
+	return 0;
+}
+
+
+uint64 PositiveDelta(uint64 current, uint64 previous)
+{
+	// Counters can go back when ssrc is renegotiated. Treat it as a restart.
+	return current >= previous ? current - previous : current;
+}
+	
+} // namespace
+
+
+ConnectionStatistics *CallStatisticsCollector::ConnectionForWrapperId(const std::string &wrapperId)
+{
+	std::map<std::string, size_t>::iterator it = indexForWrapperId_.find(wrapperId);
+	if (it != indexForWrapperId_.end()) {
+		return &snapshot_.connections[it->second];
+	}
+	
+	snapshot_.connections.push_back(ConnectionStatistics());
+	indexForWrapperId_.insert(std::pair<std::string, size_t>(wrapperId, snapshot_.connections.size() - 1));
+	
+	ConnectionStatistics *connection = &snapshot_.connections.back();
+	connection->wrapperId = wrapperId;
+	return connection;
+}
+
+
+void CallStatisticsCollector::UpdateConnection(const std::string &wrapperId,
+											   const std::string &userId,
+											   bool isClosed,
+											   const webrtc::StatsReports &reports)
+{
+	ConnectionStatistics *connection = this->ConnectionForWrapperId(wrapperId);
+	if (connection->userId != userId) {
+		connection->userId = userId;
+	}
+	connection->isClosed = isClosed;
+	
+	uint64 bytesSent = 0;
+	uint64 bytesReceived = 0;
+	uint64 packetsSent = 0;
+	uint64 packetsReceived = 0;
+	uint64 packetsLost = 0;
+	int rttMs = 0;
+	int jitterMs = 0;
+	int frameRateSent = 0;
+	int frameRateReceived = 0;
+	int audioInputLevel = 0;
+	int audioOutputLevel = 0;
+	
+	for (webrtc::StatsReports::const_iterator it = reports.begin(); it != reports.end(); ++it) {
+		const webrtc::StatsReport *report = *it;
+		if (report->type() != webrtc::StatsReport::kStatsReportTypeSsrc) {
+			continue;
+		}
+		
+		bytesSent += Uint64Value(report, webrtc::StatsReport::kStatsValueNameBytesSent);
+		bytesReceived += Uint64Value(report, webrtc::StatsReport::kStatsValueNameBytesReceived);
+		packetsSent += Uint64Value(report, webrtc::StatsReport::kStatsValueNamePacketsSent);
+		packetsReceived += Uint64Value(report, webrtc::StatsReport::kStatsValueNamePacketsReceived);
+		packetsLost += Uint64Value(report, webrtc::StatsReport::kStatsValueNamePacketsLost);
+		
+		rttMs = std::max(rttMs, IntValue(report, webrtc::StatsReport::kStatsValueNameRtt));
+		jitterMs = std::max(jitterMs, IntValue(report, webrtc::StatsReport::kStatsValueNameJitterReceived));
+		frameRateSent = std::max(frameRateSent, IntValue(report, webrtc::StatsReport::kStatsValueNameFrameRateSent));
+		frameRateReceived = std::max(frameRateReceived, IntValue(report, webrtc::StatsReport::kStatsValueNameFrameRateReceived));
+		audioInputLevel = std::max(audioInputLevel, IntValue(report, webrtc::StatsReport::kStatsValueNameAudioInputLevel));
+		audioOutputLevel = std::max(audioOutputLevel, IntValue(report, webrtc::StatsReport::kStatsValueNameAudioOutputLevel));
+	}
+	
+	uint32 now = rtc::Time();
+	int elapsedMs = connection->timestamp ? rtc::TimeDiff(now, connection->timestamp) : 0;
+	
+	connection->bytesSentDelta = PositiveDelta(bytesSent, connection->bytesSent);
+	connection->bytesReceivedDelta = PositiveDelta(bytesReceived, connection->bytesReceived);
+	connection->packetsLostDelta = PositiveDelta(packetsLost, connection->packetsLost);
+	
+	if (elapsedMs > 0) {
+		connection->sendBitrate = connection->bytesSentDelta * 8 * 1000 / elapsedMs;
+		connection->receiveBitrate = connection->bytesReceivedDelta * 8 * 1000 / elapsedMs;
+	} else {
+		connection->sendBitrate = 0;
+		connection->receiveBitrate = 0;
+	}
+	
+	connection->timestamp = now;
+	connection->bytesSent = bytesSent;
+	connection->bytesReceived = bytesReceived;
+	connection->packetsSent = packetsSent;
+	connection->packetsReceived = packetsReceived;
+	connection->packetsLost = packetsLost;
+	connection->rttMs = rttMs;
+	connection->jitterMs = jitterMs;
+	connection->frameRateSent = frameRateSent;
+	connection->frameRateReceived = frameRateReceived;
+	connection->audioInputLevel = audioInputLevel;
+	connection->audioOutputLevel = audioOutputLevel;
+}
+
+
+const CallStatistics &CallStatisticsCollector::PublishSnapshot(bool isFinal)
+{
+	snapshot_.timestamp = rtc::Time();
+	snapshot_.isFinal = isFinal;
+	snapshot_.totalBytesSent = 0;
+	snapshot_.totalBytesReceived = 0;
+	
+	for (ConnectionStatisticsVector::iterator it = snapshot_.connections.begin(); it != snapshot_.connections.end(); ++it) {
+		snapshot_.totalBytesSent += it->bytesSent;
+		snapshot_.totalBytesReceived += it->bytesReceived;
+	}
+	
+	return snapshot_;
+}
+
+
+void CallStatisticsCollector::Reset()
+{
+	indexForWrapperId_.clear();
+	snapshot_ = CallStatistics();
+}
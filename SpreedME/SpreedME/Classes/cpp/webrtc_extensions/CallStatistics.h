@@ -0,0 +1,123 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__CallStatistics__
+#define __SpreedME__CallStatistics__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <talk/app/webrtc/statstypes.h>
+#include <webrtc/base/basictypes.h>
+
+
+namespace spreedme {
+
+// Typed statistics of one peer connection.
+// Totals are cumulative since the connection was created,
+// deltas and rates are relative to the previous snapshot of the same connection.
+struct ConnectionStatistics
+{
+	ConnectionStatistics() :
+		isClosed(false), timestamp(0),
+		bytesSent(0), bytesReceived(0),
+		packetsSent(0), packetsReceived(0), packetsLost(0),
+		rttMs(0), jitterMs(0),
+		frameRateSent(0), frameRateReceived(0),
+		audioInputLevel(0), audioOutputLevel(0),
+		bytesSentDelta(0), bytesReceivedDelta(0), packetsLostDelta(0),
+		sendBitrate(0), receiveBitrate(0) {};
+	
+	std::string userId;
+	std::string wrapperId; // PeerConnectionWrapper factoryId
+	bool isClosed;
+	uint32 timestamp; // rtc::Time() in milliseconds of the last update
+	
+	uint64 bytesSent;
+	uint64 bytesReceived;
+	uint64 packetsSent;
+	uint64 packetsReceived;
+	uint64 packetsLost;
+	
+	int rttMs; // worst round trip time among sending ssrcs
+	int jitterMs; // worst jitter among receiving ssrcs
+	int frameRateSent;
+	int frameRateReceived;
+	int audioInputLevel; // level of local audio sent to this connection [0..32767]
+	int audioOutputLevel; // level of remote audio received from this connection [0..32767]
+	
+	uint64 bytesSentDelta;
+	uint64 bytesReceivedDelta;
+	uint64 packetsLostDelta;
+	uint64 sendBitrate; // bits per second
+	uint64 receiveBitrate; // bits per second
+};
+
+typedef std::vector<ConnectionStatistics> ConnectionStatisticsVector;
+
+
+struct CallStatistics
+{
+	CallStatistics() : timestamp(0), totalBytesSent(0), totalBytesReceived(0), isFinal(false) {};
+	
+	uint32 timestamp; // rtc::Time() in milliseconds when snapshot was published
+	uint64 totalBytesSent;
+	uint64 totalBytesReceived;
+	ConnectionStatisticsVector connections;
+	bool isFinal; // true for the snapshot answering Call::RequestFinalStatistics(), no snapshots follow it
+};
+
+
+// Folds webrtc::StatsReports into typed per connection statistics.
+// Entries for connections are allocated once and then reused for every following snapshot,
+// so steady state polling doesn't allocate.
+// CallStatisticsCollector is NOT thread safe.
+class CallStatisticsCollector
+{
+public:
+	CallStatisticsCollector() {};
+	~CallStatisticsCollector() {};
+	
+	void UpdateConnection(const std::string &wrapperId,
+						  const std::string &userId,
+						  bool isClosed,
+						  const webrtc::StatsReports &reports);
+	
+	// Recalculates call totals and returns snapshot with all known connections.
+	const CallStatistics &PublishSnapshot(bool isFinal = false);
+	
+	const CallStatistics &snapshot() const { return snapshot_; };
+	
+	void Reset();
+	
+private:
+	ConnectionStatistics *ConnectionForWrapperId(const std::string &wrapperId);
+	
+	std::map<std::string, size_t> indexForWrapperId_;
+	CallStatistics snapshot_;
+};
+	
+	
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__CallStatistics__) */
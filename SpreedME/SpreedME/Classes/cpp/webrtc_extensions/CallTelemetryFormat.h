@@ -0,0 +1,230 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__CallTelemetryFormat__
+#define __SpreedME__CallTelemetryFormat__
+
+// This header describes binary format written by CallTelemetryRecorder.
+// It should not depend on webrtc or Objective-C since it is also used by offline tools.
+
+#include <stdint.h>
+
+#include <string>
+
+
+namespace spreedme {
+namespace telemetry {
+
+// File layout:
+// file header: magic(4) version(2) reserved(2) startTimeSeconds(8) callIdLength(1) callId(callIdLength)
+// followed by records: type(1) connection(1) payloadLength(2) timestampMs(4) payload(payloadLength)
+// Every rotated file starts with its own header and connection records so it can be read on its own.
+// All integers are little endian. 'timestampMs' is relative to 'startTimeSeconds' of the file.
+
+const char kFileMagic[4] = {'S', 'M', 'T', 'L'};
+const uint16_t kFormatVersion = 1;
+const size_t kFileHeaderFixedSize = 17;
+const size_t kRecordHeaderSize = 8;
+const uint8_t kNoConnection = 0xFF;
+
+typedef enum RecordType {
+	kRecordTypeConnection = 1, // payload: userIdLength(1) userId(userIdLength)
+	kRecordTypeStatistics, // payload: see StatisticsRecord
+	kRecordTypeIceState, // payload: iceConnectionState(1)
+	kRecordTypeFrameSize, // payload: width(2) height(2) rendererNameLength(1) rendererName(rendererNameLength)
+	kRecordTypeSignalling, // payload: SignallingEvent(1)
+} RecordType;
+
+
+typedef enum SignallingEvent {
+	kSignallingEventOfferSent = 0,
+	kSignallingEventOfferReceived,
+	kSignallingEventAnswerSent,
+	kSignallingEventAnswerReceived,
+	kSignallingEventFirstCandidateSent,
+	kSignallingEventFirstCandidateReceived,
+	kSignallingEventConnectionEstablished,
+	kSignallingEventHangUp,
+} SignallingEvent;
+
+
+const size_t kStatisticsRecordSize = 48;
+
+struct StatisticsRecord
+{
+	uint64_t bytesSent;
+	uint64_t bytesReceived;
+	uint64_t packetsLost;
+	uint32_t rttMs;
+	uint32_t jitterMs;
+	uint32_t sendBitrate;
+	uint32_t receiveBitrate;
+	uint16_t frameRateSent;
+	uint16_t frameRateReceived;
+	uint32_t reserved;
+};
+
+
+struct RecordHeader
+{
+	uint8_t type;
+	uint8_t connection;
+	uint16_t payloadLength;
+	uint32_t timestampMs;
+};
+
+
+inline void AppendUInt8(std::string *buffer, uint8_t value)
+{
+	buffer->push_back((char)value);
+}
+
+
+inline void AppendUInt16(std::string *buffer, uint16_t value)
+{
+	for (int i = 0; i < 2; ++i) {
+		buffer->push_back((char)((value >> (8 * i)) & 0xFF));
+	}
+}
+
+
+inline void AppendUInt32(std::string *buffer, uint32_t value)
+{
+	for (int i = 0; i < 4; ++i) {
+		buffer->push_back((char)((value >> (8 * i)) & 0xFF));
+	}
+}
+
+
+inline void AppendUInt64(std::string *buffer, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		buffer->push_back((char)((value >> (8 * i)) & 0xFF));
+	}
+}
+
+
+inline void AppendShortString(std::string *buffer, const std::string &value)
+{
+	size_t length = value.size() > 0xFF ? 0xFF : value.size();
+	AppendUInt8(buffer, (uint8_t)length);
+	buffer->append(value, 0, length);
+}
+
+
+inline uint64_t ReadLittleEndian(const uint8_t *data, size_t size)
+{
+	uint64_t value = 0;
+	for (size_t i = 0; i < size; ++i) {
+		value |= ((uint64_t)data[i]) << (8 * i);
+	}
+	return value;
+}
+
+
+inline void AppendStatisticsRecord(std::string *buffer, const StatisticsRecord &record)
+{
+	AppendUInt64(buffer, record.bytesSent);
+	AppendUInt64(buffer, record.bytesReceived);
+	AppendUInt64(buffer, record.packetsLost);
+	AppendUInt32(buffer, record.rttMs);
+	AppendUInt32(buffer, record.jitterMs);
+	AppendUInt32(buffer, record.sendBitrate);
+	AppendUInt32(buffer, record.receiveBitrate);
+	AppendUInt16(buffer, record.frameRateSent);
+	AppendUInt16(buffer, record.frameRateReceived);
+	AppendUInt32(buffer, record.reserved);
+}
+
+
+inline bool ParseStatisticsRecord(const uint8_t *data, size_t size, StatisticsRecord *record)
+{
+	if (size < kStatisticsRecordSize) {
+		return false;
+	}
+	
+	record->bytesSent = ReadLittleEndian(data, 8);
+	record->bytesReceived = ReadLittleEndian(data + 8, 8);
+	record->packetsLost = ReadLittleEndian(data + 16, 8);
+	record->rttMs = (uint32_t)ReadLittleEndian(data + 24, 4);
+	record->jitterMs = (uint32_t)ReadLittleEndian(data + 28, 4);
+	record->sendBitrate = (uint32_t)ReadLittleEndian(data + 32, 4);
+	record->receiveBitrate = (uint32_t)ReadLittleEndian(data + 36, 4);
+	record->frameRateSent = (uint16_t)ReadLittleEndian(data + 40, 2);
+	record->frameRateReceived = (uint16_t)ReadLittleEndian(data + 42, 2);
+	record->reserved = (uint32_t)ReadLittleEndian(data + 44, 4);
+	
+	return true;
+}
+
+
+inline bool ParseRecordHeader(const uint8_t *data, size_t size, RecordHeader *header)
+{
+	if (size < kRecordHeaderSize) {
+		return false;
+	}
+	
+	header->type = data[0];
+	header->connection = data[1];
+	header->payloadLength = (uint16_t)ReadLittleEndian(data + 2, 2);
+	header->timestampMs = (uint32_t)ReadLittleEndian(data + 4, 4);
+	
+	return true;
+}
+
+
+inline const char *SignallingEventName(uint8_t event)
+{
+	switch (event) {
+		case kSignallingEventOfferSent: return "offer_sent";
+		case kSignallingEventOfferReceived: return "offer_received";
+		case kSignallingEventAnswerSent: return "answer_sent";
+		case kSignallingEventAnswerReceived: return "answer_received";
+		case kSignallingEventFirstCandidateSent: return "first_candidate_sent";
+		case kSignallingEventFirstCandidateReceived: return "first_candidate_received";
+		case kSignallingEventConnectionEstablished: return "connection_established";
+		case kSignallingEventHangUp: return "hang_up";
+		default: return "unknown";
+	}
+}
+
+
+// Values are the same as in webrtc::PeerConnectionInterface::IceConnectionState
+inline const char *IceStateName(uint8_t state)
+{
+	switch (state) {
+		case 0: return "new";
+		case 1: return "checking";
+		case 2: return "connected";
+		case 3: return "completed";
+		case 4: return "failed";
+		case 5: return "disconnected";
+		case 6: return "closed";
+		default: return "unknown";
+	}
+}
+	
+	
+} // namespace telemetry
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__CallTelemetryFormat__) */
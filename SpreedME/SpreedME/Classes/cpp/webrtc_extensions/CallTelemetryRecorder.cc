@@ -0,0 +1,316 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CallTelemetryRecorder.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <webrtc/base/timeutils.h>
+
+#include "utils.h"
+
+using namespace spreedme;
+using namespace spreedme::telemetry;
+
+
+CallTelemetryRecorder::CallTelemetryRecorder(const std::string &filePath,
+											 const std::string &callId,
+											 size_t maxFileSize,
+											 int maxRotatedFiles) :
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	filePath_(filePath),
+	callId_(callId),
+	maxFileSize_(maxFileSize),
+	currentFileSize_(0),
+	maxRotatedFiles_(maxRotatedFiles),
+	startTime_(0),
+	startTimeSeconds_(0)
+{
+}
+
+
+CallTelemetryRecorder::~CallTelemetryRecorder()
+{
+	this->Stop();
+	delete critSect_;
+}
+
+
+bool CallTelemetryRecorder::Start()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (file_.is_open()) {
+		return true;
+	}
+	
+	startTime_ = rtc::Time();
+	startTimeSeconds_ = (uint64_t)time(NULL);
+	
+	// Keep telemetry of previous calls
+	std::ifstream previousFile(filePath_.c_str());
+	if (previousFile.good()) {
+		previousFile.close();
+		this->ShiftRotatedFiles();
+	}
+	
+	file_.open(filePath_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file_.is_open()) {
+		spreed_me_log("Couldn't open telemetry file %s", filePath_.c_str());
+		return false;
+	}
+	
+	currentFileSize_ = 0;
+	this->WriteFileHeader();
+	
+	return true;
+}
+
+
+void CallTelemetryRecorder::Stop()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (file_.is_open()) {
+		file_.flush();
+		file_.close();
+	}
+}
+
+
+bool CallTelemetryRecorder::isRecording()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	return file_.is_open();
+}
+
+
+#pragma mark - Records
+
+void CallTelemetryRecorder::RecordStatistics(const CallStatistics &statistics)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	for (ConnectionStatisticsVector::const_iterator it = statistics.connections.begin(); it != statistics.connections.end(); ++it) {
+		if (it->isClosed && it->bytesSentDelta == 0 && it->bytesReceivedDelta == 0) {
+			continue; // Nothing new happens in closed connections
+		}
+		
+		StatisticsRecord record;
+		record.bytesSent = it->bytesSent;
+		record.bytesReceived = it->bytesReceived;
+		record.packetsLost = it->packetsLost;
+		record.rttMs = (uint32_t)it->rttMs;
+		record.jitterMs = (uint32_t)it->jitterMs;
+		record.sendBitrate = (uint32_t)it->sendBitrate;
+		record.receiveBitrate = (uint32_t)it->receiveBitrate;
+		record.frameRateSent = (uint16_t)it->frameRateSent;
+		record.frameRateReceived = (uint16_t)it->frameRateReceived;
+		record.reserved = 0;
+		
+		payload_.clear();
+		AppendStatisticsRecord(&payload_, record);
+		this->WriteRecord(kRecordTypeStatistics, this->ConnectionIndexForUserId(it->userId), payload_);
+	}
+}
+
+
+void CallTelemetryRecorder::RecordIceConnectionState(const std::string &userId, webrtc::PeerConnectionInterface::IceConnectionState state)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	payload_.clear();
+	AppendUInt8(&payload_, (uint8_t)state);
+	this->WriteRecord(kRecordTypeIceState, this->ConnectionIndexForUserId(userId), payload_);
+}
+
+
+void CallTelemetryRecorder::RecordFrameSize(const std::string &userId, const std::string &rendererName, int width, int height)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	payload_.clear();
+	AppendUInt16(&payload_, (uint16_t)width);
+	AppendUInt16(&payload_, (uint16_t)height);
+	AppendShortString(&payload_, rendererName);
+	this->WriteRecord(kRecordTypeFrameSize, this->ConnectionIndexForUserId(userId), payload_);
+}
+
+
+void CallTelemetryRecorder::RecordSignallingEvent(const std::string &userId, SignallingEvent event)
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	uint8_t connectionIndex = this->ConnectionIndexForUserId(userId);
+	
+	if (event == kSignallingEventFirstCandidateSent || event == kSignallingEventFirstCandidateReceived) {
+		uint32_t eventMask = 1 << event;
+		if (connectionIndex < recordedOnceEvents_.size()) {
+			if (recordedOnceEvents_[connectionIndex] & eventMask) {
+				return;
+			}
+			recordedOnceEvents_[connectionIndex] |= eventMask;
+		}
+	}
+	
+	payload_.clear();
+	AppendUInt8(&payload_, (uint8_t)event);
+	this->WriteRecord(kRecordTypeSignalling, connectionIndex, payload_);
+}
+
+
+#pragma mark - Writing
+
+uint8_t CallTelemetryRecorder::ConnectionIndexForUserId(const std::string &userId)
+{
+	for (size_t i = 0; i < connections_.size(); ++i) {
+		if (connections_[i] == userId) {
+			return (uint8_t)i;
+		}
+	}
+	
+	if (connections_.size() >= kNoConnection) {
+		spreed_me_log("Too many connections in telemetry recorder");
+		return kNoConnection;
+	}
+	
+	connections_.push_back(userId);
+	recordedOnceEvents_.push_back(0);
+	
+	uint8_t connectionIndex = (uint8_t)(connections_.size() - 1);
+	this->WriteConnectionRecord(connectionIndex);
+	
+	return connectionIndex;
+}
+
+
+void CallTelemetryRecorder::WriteFileHeader()
+{
+	record_.clear();
+	record_.append(kFileMagic, sizeof(kFileMagic));
+	AppendUInt16(&record_, kFormatVersion);
+	AppendUInt16(&record_, 0);
+	AppendUInt64(&record_, startTimeSeconds_);
+	AppendShortString(&record_, callId_);
+	
+	file_.write(record_.data(), record_.size());
+	currentFileSize_ += record_.size();
+}
+
+
+void CallTelemetryRecorder::WriteConnectionRecord(uint8_t connectionIndex)
+{
+	std::string payload;
+	AppendShortString(&payload, connections_[connectionIndex]);
+	this->WriteRecord(kRecordTypeConnection, connectionIndex, payload);
+}
+
+
+void CallTelemetryRecorder::WriteRecord(RecordType type, uint8_t connectionIndex, const std::string &payload)
+{
+	this->RotateFilesIfNeeded(kRecordHeaderSize + payload.size());
+	if (!file_.is_open()) {
+		return;
+	}
+	
+	this->AppendRecordToFile(type, connectionIndex, payload);
+}
+
+
+void CallTelemetryRecorder::AppendRecordToFile(RecordType type, uint8_t connectionIndex, const std::string &payload)
+{
+	record_.clear();
+	AppendUInt8(&record_, (uint8_t)type);
+	AppendUInt8(&record_, connectionIndex);
+	AppendUInt16(&record_, (uint16_t)payload.size());
+	AppendUInt32(&record_, (uint32_t)rtc::TimeDiff(rtc::Time(), startTime_));
+	record_.append(payload);
+	
+	file_.write(record_.data(), record_.size());
+	currentFileSize_ += record_.size();
+}
+
+
+void CallTelemetryRecorder::RotateFilesIfNeeded(size_t bytesToWrite)
+{
+	if (maxFileSize_ == 0 || currentFileSize_ + bytesToWrite <= maxFileSize_) {
+		return;
+	}
+	
+	file_.close();
+	this->ShiftRotatedFiles();
+	
+	file_.open(filePath_.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file_.is_open()) {
+		spreed_me_log("Couldn't reopen telemetry file %s", filePath_.c_str());
+		return;
+	}
+	
+	currentFileSize_ = 0;
+	this->WriteFileHeader();
+	
+	// Every file should be readable on its own so repeat connection records
+	for (size_t i = 0; i < connections_.size(); ++i) {
+		std::string payload;
+		AppendShortString(&payload, connections_[i]);
+		this->AppendRecordToFile(kRecordTypeConnection, (uint8_t)i, payload);
+	}
+}
+
+
+void CallTelemetryRecorder::ShiftRotatedFiles()
+{
+	if (maxRotatedFiles_ > 0) {
+		remove(this->RotatedFilePath(maxRotatedFiles_).c_str());
+		for (int i = maxRotatedFiles_ - 1; i > 0; --i) {
+			rename(this->RotatedFilePath(i).c_str(), this->RotatedFilePath(i + 1).c_str());
+		}
+		rename(filePath_.c_str(), this->RotatedFilePath(1).c_str());
+	} else {
+		remove(filePath_.c_str());
+	}
+}
+
+
+std::string CallTelemetryRecorder::RotatedFilePath(int index)
+{
+	char suffix[16];
+	snprintf(suffix, sizeof(suffix), ".%d", index);
+	return filePath_ + suffix;
+}
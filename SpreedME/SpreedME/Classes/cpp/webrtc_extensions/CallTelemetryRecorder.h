@@ -0,0 +1,99 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__CallTelemetryRecorder__
+#define __SpreedME__CallTelemetryRecorder__
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <system_wrappers/interface/critical_section_wrapper.h>
+#include <talk/app/webrtc/peerconnectioninterface.h>
+
+#include "CallStatistics.h"
+#include "CallTelemetryFormat.h"
+
+
+namespace spreedme {
+
+// Records compact binary time series of call quality to a rotating set of files.
+// Current file is written to 'filePath', older files are renamed to 'filePath.1', 'filePath.2', ...
+// with 'filePath.1' being the newest. Starting recording rotates file left from previous recording.
+// Format is described in CallTelemetryFormat.h.
+// CallTelemetryRecorder is thread safe.
+class CallTelemetryRecorder
+{
+public:
+	CallTelemetryRecorder(const std::string &filePath,
+						  const std::string &callId,
+						  size_t maxFileSize,
+						  int maxRotatedFiles);
+	~CallTelemetryRecorder();
+	
+	bool Start();
+	void Stop();
+	bool isRecording();
+	
+	void RecordStatistics(const CallStatistics &statistics);
+	void RecordIceConnectionState(const std::string &userId, webrtc::PeerConnectionInterface::IceConnectionState state);
+	void RecordFrameSize(const std::string &userId, const std::string &rendererName, int width, int height);
+	// 'kSignallingEventFirstCandidateSent' and 'kSignallingEventFirstCandidateReceived'
+	// are recorded only once per connection, all other events are recorded every time.
+	void RecordSignallingEvent(const std::string &userId, telemetry::SignallingEvent event);
+	
+private:
+	CallTelemetryRecorder();
+	
+	// These methods expect critSect_ to be entered
+	uint8_t ConnectionIndexForUserId(const std::string &userId);
+	void WriteFileHeader();
+	void WriteConnectionRecord(uint8_t connectionIndex);
+	void WriteRecord(telemetry::RecordType type, uint8_t connectionIndex, const std::string &payload);
+	void AppendRecordToFile(telemetry::RecordType type, uint8_t connectionIndex, const std::string &payload);
+	void RotateFilesIfNeeded(size_t bytesToWrite);
+	void ShiftRotatedFiles();
+	std::string RotatedFilePath(int index);
+	
+	webrtc::CriticalSectionWrapper *critSect_;
+	
+	std::ofstream file_;
+	std::string filePath_;
+	std::string callId_;
+	size_t maxFileSize_;
+	size_t currentFileSize_;
+	int maxRotatedFiles_;
+	
+	uint32 startTime_; // rtc::Time() when recording started
+	uint64_t startTimeSeconds_; // wall clock time when recording started
+	
+	std::vector<std::string> connections_; // index in vector is the connection index in records
+	std::vector<uint32_t> recordedOnceEvents_; // bit mask of signalling events per connection
+	
+	std::string payload_; // reused for every record to avoid allocations
+	std::string record_;
+};
+	
+	
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__CallTelemetryRecorder__) */
@@ -121,9 +121,11 @@ PeerConnectionWrapper::PeerConnectionWrapper(const std::string &factoryId,
 	customIdentifier_(std::string()),
 	factoryId_(factoryId),
 	videoMuted_(false),
+	networkDataService_(kNetworkDataServiceDataChannel),
 	delegate_(delegate)
 {
 	workerThread_ = rtc::Thread::Current();
+	this->ResetNetworkDataCounters();
 }
 
 
@@ -281,6 +283,9 @@ void PeerConnectionWrapper::SendData(const std::string &msg, const std::string &
 		webrtc::DataBuffer buffer(msg);
 		bool succes = data_channel->Send(buffer);
 		spreed_me_log("DataChannel send message succes=%s", succes ? "YES" : "NO");
+		if (succes) {
+			this->networkDataCounters()->AddSentBytes(msg.size());
+		}
 	} else {
 		spreed_me_log("No data channel or data channel is not ready while trying to send data %s", __FUNCTION__);
 	}
@@ -293,7 +298,9 @@ void PeerConnectionWrapper::SendData(const void *data, size_t size, const std::s
 	if (data_channel && data_channel->state() == webrtc::DataChannelInterface::kOpen) {
 		
 		webrtc::DataBuffer buffer(rtc::Buffer(data, size), true);
-		data_channel->Send(buffer);
+		if (data_channel->Send(buffer)) {
+			this->networkDataCounters()->AddSentBytes(size);
+		}
 		
 	} else {
 		spreed_me_log("No data channel or data channel is not ready while trying to send data %s", __FUNCTION__);
@@ -336,6 +343,18 @@ rtc::scoped_refptr<webrtc::DataChannelInterface> PeerConnectionWrapper::DataChan
 }
 
 
+void PeerConnectionWrapper::ResetNetworkDataCounters()
+{
+	std::atomic_store(&networkDataCounters_, NetworkDataAccounting::Instance()->CreatePeerCounters(userId_, networkDataService_));
+}
+
+
+std::shared_ptr<NetworkDataPeerCounters> PeerConnectionWrapper::networkDataCounters()
+{
+	return std::atomic_load(&networkDataCounters_);
+}
+
+
 std::set<std::string> PeerConnectionWrapper::DataChannelNames()
 {
 	std::set<std::string> keys;
@@ -390,6 +409,8 @@ void PeerConnectionWrapper::OnDataChannelMessage(webrtc::DataChannelInterface *d
 
 void PeerConnectionWrapper::OnDataChannelMessage_w(webrtc::DataChannelInterface *data_channel, webrtc::DataBuffer *buffer)
 {
+	this->networkDataCounters()->AddReceivedBytes(buffer->data.length());
+	
 	rtc::Buffer data = buffer->data;
 	std::string message;
 	if (!buffer->binary) {
@@ -536,6 +557,21 @@ void PeerConnectionWrapper::EnableAllVideo()
 }
 
 
+void PeerConnectionWrapper::SetRemoteVideoEnabled(bool enabled)
+{
+	for (size_t i = 0; i < peer_connection_->remote_streams()->count(); ++i) {
+		rtc::scoped_refptr<webrtc::MediaStreamInterface> stream = peer_connection_->remote_streams()->at(i);
+		webrtc::VideoTrackVector videotrackvector = stream->GetVideoTracks();
+		
+		webrtc::VideoTrackVector::iterator it_videoTracks;
+		for(it_videoTracks = videotrackvector.begin(); it_videoTracks != videotrackvector.end(); it_videoTracks++)
+		{
+			it_videoTracks->get()->set_enabled(enabled);
+		}
+	}
+}
+
+
 bool PeerConnectionWrapper::IsVideoPermittedByConstraints()
 {
 	// This uses webrtc::FindConstraint and we check for mandatory constraints only.  
@@ -559,7 +595,8 @@ bool PeerConnectionWrapper::IsVideoPermittedByConstraints()
 
 void PeerConnectionWrapper::SetupVideoRenderer(const std::string &streamLabel,
 											   const std::string &videoTrackId,
-											   const std::string &rendererName)
+											   const std::string &rendererName,
+											   VideoRendererKind kind)
 {
 	webrtc::VideoTrackInterface *videoTrack = NULL;
 	
@@ -596,7 +633,7 @@ void PeerConnectionWrapper::SetupVideoRenderer(const std::string &streamLabel,
 	rendererInfo.rendererName = rendererName;
 	
 	if (videoTrack) {
-		VideoRenderer *renderer = VideoRendererFactory::CreateVideoRenderer(this, rendererName, videoTrackId, streamLabel);
+		VideoRenderer *renderer = VideoRendererFactory::CreateVideoRenderer(this, rendererName, videoTrackId, streamLabel, kind);
 		
 		
 		
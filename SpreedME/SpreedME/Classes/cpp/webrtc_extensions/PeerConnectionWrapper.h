@@ -25,6 +25,7 @@
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <regex>
 
 #include <modules/audio_device/include/audio_device.h>
@@ -38,6 +39,7 @@
 #include "Error.h"
 #include "MediaConstraints.h"
 #include "MessageQueueInterface.h"
+#include "NetworkDataAccounting.h"
 #include "utils.h"
 #include "VideoRenderer.h"
 #include "VideoRendererInfo.h"
@@ -187,13 +189,16 @@ public:
 	
 	virtual void DisableAllVideo();
 	virtual void EnableAllVideo();
+	// Enables or disables only received video tracks. Disabled tracks are not decoded and not rendered.
+	virtual void SetRemoteVideoEnabled(bool enabled);
 	
 	virtual bool IsVideoPermittedByConstraints();
 	
 	// RendererNames are expected to be unique for the peer connection wrapper.
 	// If you try to setup renderers with the same name for different streams/videoTracks
 	// you will receive FailedToSetupVideoRenderer callback with error 'kVRMERendererAlreadyExists'.
-	virtual void SetupVideoRenderer(const std::string &streamLabel, const std::string &videoTrackId, const std::string &rendererName);
+	virtual void SetupVideoRenderer(const std::string &streamLabel, const std::string &videoTrackId, const std::string &rendererName,
+									VideoRendererKind kind = kVideoRendererKindCamera);
 	virtual void DeleteVideoRenderer(const std::string &streamLabel, const std::string &videoTrackId, const std::string &rendererName);
 	
 //	virtual void SetSpeakerPhone(bool yes);
@@ -220,11 +225,16 @@ public:
 	virtual void SetCustomIdentifier(const std::string &customIdentifier) {customIdentifier_ = customIdentifier;};
 	virtual std::string customIdentifier() {return customIdentifier_;};
 	
-	virtual void SetUserId(const std::string &userId) {userId_ = std::string(userId);};
+	virtual void SetUserId(const std::string &userId) {userId_ = std::string(userId); this->ResetNetworkDataCounters();};
 	virtual std::string userId() {return userId_;};
 	
 	virtual std::string factoryId() {return factoryId_;};
 	
+	// Data channel traffic is accounted for this service, by default kNetworkDataServiceDataChannel.
+	// Should be set before any data is sent or received, traffic counted for this peer before is not carried over.
+	virtual void SetNetworkDataService(NetworkDataService service) {networkDataService_ = service; this->ResetNetworkDataCounters();};
+	virtual NetworkDataService networkDataService() {return networkDataService_;};
+	
 protected:
     
     //
@@ -282,6 +292,8 @@ protected:
 private:
 	//Utilities
 	bool InsertNewDataChannelWithName(rtc::scoped_refptr<webrtc::DataChannelInterface> dataChannel, const std::string &name);
+	void ResetNetworkDataCounters();
+	std::shared_ptr<NetworkDataPeerCounters> networkDataCounters();
     void replaceStringFromSdp(std::string& str, const std::string& from, const std::string& to);
     void replaceRegexFromSdp(std::string& str, std::regex& regex, const std::string& replace_with);
 	
@@ -312,6 +324,11 @@ private:
 	std::string factoryId_;
 	
 	bool videoMuted_;
+	
+	NetworkDataService networkDataService_;
+	// Never NULL. Replaced when user id or service changes, counters are used from several threads (SendData, worker thread)
+	// so it is accessed only with std::atomic_load/std::atomic_store.
+	std::shared_ptr<NetworkDataPeerCounters> networkDataCounters_;
 
 	PeerConnectionWrapperDelegateInterface *delegate_;
 
@@ -24,12 +24,14 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <algorithm>
 #include <stdexcept>
 
 #include <modules/audio_device/audio_device_impl.h>
 #include <modules/video_render/include/video_render.h>
 #include <modules/video_render/video_render_impl.h>
 #include <talk/app/webrtc/videosourceinterface.h>
+#include <talk/media/base/videoadapter.h>
 #include <webrtc/base/refcount.h>
 #include <webrtc/base/ssladapter.h>
 #include <webrtc/base/thread.h>
@@ -316,6 +318,32 @@ void PeerConnectionWrapperFactory::StartVideoCapturing()
 }
 
 
+void PeerConnectionWrapperFactory::SetMaxVideoOutputSize(int width, int height)
+{
+	if (!videoSource_) {
+		return;
+	}
+	
+	cricket::VideoCapturer *videoCapturer = videoSource_->GetVideoCapturer();
+	const cricket::VideoFormat *captureFormat = videoCapturer->GetCaptureFormat();
+	if (!captureFormat || !videoCapturer->video_adapter()) {
+		spreed_me_log("Can't limit video output size. Capturer is not started.");
+		return;
+	}
+	
+	cricket::VideoFormat outputFormat = *captureFormat;
+	if (width > 0 && height > 0 && (width < captureFormat->width || height < captureFormat->height)) {
+		// Keep capture aspect ratio, video adapter expects it
+		double scale = std::min((double)width / captureFormat->width, (double)height / captureFormat->height);
+		outputFormat.width = (int)(captureFormat->width * scale) & ~1;
+		outputFormat.height = (int)(captureFormat->height * scale) & ~1;
+	}
+	
+	spreed_me_log("Limit video output size to %dx%d", outputFormat.width, outputFormat.height);
+	videoCapturer->video_adapter()->OnOutputFormatRequest(outputFormat);
+}
+
+
 STDStringVector PeerConnectionWrapperFactory::videoDeviceUniqueIDs()
 {
 	STDStringVector videoDeviceUniqueIDs;
@@ -74,6 +74,10 @@ public:
 	void StopVideoCapturing();
 	void StartVideoCapturing();
 	
+	// Limits resolution of video which is sent to all peers. Capturing format is not changed,
+	// frames are scaled down by capturer's video adapter. Pass 0, 0 to send in capture resolution again.
+	void SetMaxVideoOutputSize(int width, int height);
+	
 	/* 
 	 This method creates local stream(audio/video) for spreedPeerConnection with exactly one audio and one or zero video tracks.
 	 This method uses constraints which were set by 'SetAudioVideoConstrains()' method.
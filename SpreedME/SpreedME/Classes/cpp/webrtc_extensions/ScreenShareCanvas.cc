@@ -0,0 +1,463 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ScreenShareCanvas.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <libyuv/scale.h>
+
+#include "utils.h"
+
+
+using namespace spreedme;
+
+
+namespace {
+
+const uint64 kHashMultiplier = 0x9E3779B97F4A7C15ULL;
+
+
+inline uint64 MixWord(uint64 hash, uint64 word)
+{
+	hash ^= word;
+	hash *= kHashMultiplier;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+
+uint64 HashBytes(const uint8 *bytes, int length, uint64 hash)
+{
+	int i = 0;
+	for (; i + 8 <= length; i += 8) {
+		uint64 word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = MixWord(hash, word);
+	}
+	if (i < length) {
+		uint64 word = 0;
+		memcpy(&word, bytes + i, length - i);
+		hash = MixWord(hash, word ^ ((uint64)(length - i) << 56));
+	}
+	return hash;
+}
+
+
+int CanvasSizeForStep(int sourceSize, int scaleStep)
+{
+	if (scaleStep >= ScreenShareCanvas::kScaleSteps) {
+		return sourceSize;
+	}
+	return (sourceSize * scaleStep + ScreenShareCanvas::kScaleSteps - 1) / ScreenShareCanvas::kScaleSteps;
+}
+
+} // namespace
+
+
+ScreenShareCanvas::ScreenShareCanvas() :
+	sourceWidth_(0),
+	sourceHeight_(0),
+	lastTimestampNs_(0),
+	needsFullUpdate_(true),
+	tileColumns_(0),
+	tileRows_(0),
+	critSect_(webrtc::CriticalSectionWrapper::CreateCriticalSection()),
+	scaleStep_(0),
+	canvasSourceWidth_(0),
+	canvasSourceHeight_(0),
+	canvasTileColumns_(0),
+	canvasTileRows_(0),
+	canvasWidth_(0),
+	canvasHeight_(0),
+	hasPendingTiles_(false),
+	reportedCanvasWidth_(0),
+	reportedCanvasHeight_(0),
+	displayWidth_(0),
+	displayHeight_(0),
+	maxCanvasSize_(0),
+	visible_(true),
+	framesReceived_(0),
+	framesUnchanged_(0),
+	tilesUpdated_(0)
+{
+}
+
+
+ScreenShareCanvas::~ScreenShareCanvas()
+{
+	delete critSect_;
+}
+
+
+void ScreenShareCanvas::SetDisplaySize(int width, int height)
+{
+	displayWidth_.store(std::max(width, 0));
+	displayHeight_.store(std::max(height, 0));
+}
+
+
+int ScreenShareCanvas::ScaleStepForSourceSize(int width, int height)
+{
+	int displayWidth = displayWidth_.load();
+	int displayHeight = displayHeight_.load();
+	int maxCanvasSize = maxCanvasSize_.load();
+	
+	int scaleStep = kScaleSteps;
+	if (displayWidth > 0 && displayHeight > 0) {
+		// The smallest step which still has at least one canvas pixel per display pixel.
+		scaleStep = 1;
+		while (scaleStep < kScaleSteps &&
+			   (width * scaleStep < displayWidth * kScaleSteps || height * scaleStep < displayHeight * kScaleSteps)) {
+			++scaleStep;
+		}
+	}
+	
+	if (maxCanvasSize > 0) {
+		while (scaleStep > 1 &&
+			   (CanvasSizeForStep(width, scaleStep) > maxCanvasSize || CanvasSizeForStep(height, scaleStep) > maxCanvasSize)) {
+			--scaleStep;
+		}
+	}
+	
+	return scaleStep;
+}
+
+
+void ScreenShareCanvas::ResetTiles(int width, int height)
+{
+	sourceWidth_ = width;
+	sourceHeight_ = height;
+	tileColumns_ = (width + kTileSize - 1) / kTileSize;
+	tileRows_ = (height + kTileSize - 1) / kTileSize;
+	tileHashes_.assign(tileColumns_ * tileRows_, 0);
+	rowHashes_.assign(tileColumns_, 0);
+	changedTiles_.assign(tileColumns_ * tileRows_, 0);
+	needsFullUpdate_ = true;
+}
+
+
+int ScreenShareCanvas::HashTiles(const cricket::VideoFrame *frame)
+{
+	const int chromaTileSize = kTileSize / 2;
+	const int chromaWidth = (sourceWidth_ + 1) / 2;
+	const int chromaHeight = (sourceHeight_ + 1) / 2;
+	
+	const uint8 *yPlane = frame->GetYPlane();
+	const uint8 *uPlane = frame->GetUPlane();
+	const uint8 *vPlane = frame->GetVPlane();
+	int32 yPitch = frame->GetYPitch();
+	int32 uPitch = frame->GetUPitch();
+	int32 vPitch = frame->GetVPitch();
+	
+	int numberOfChangedTiles = 0;
+	
+	for (int tileRow = 0; tileRow < tileRows_; ++tileRow) {
+		std::fill(rowHashes_.begin(), rowHashes_.end(), 0);
+		
+		// Walk whole rows so every plane is read sequentially.
+		int yEnd = std::min((tileRow + 1) * kTileSize, sourceHeight_);
+		for (int y = tileRow * kTileSize; y < yEnd; ++y) {
+			const uint8 *row = yPlane + y * yPitch;
+			for (int column = 0; column < tileColumns_; ++column) {
+				int x = column * kTileSize;
+				rowHashes_[column] = HashBytes(row + x, std::min(kTileSize, sourceWidth_ - x), rowHashes_[column]);
+			}
+		}
+		
+		int chromaYEnd = std::min((tileRow + 1) * chromaTileSize, chromaHeight);
+		for (int y = tileRow * chromaTileSize; y < chromaYEnd; ++y) {
+			const uint8 *uRow = uPlane + y * uPitch;
+			const uint8 *vRow = vPlane + y * vPitch;
+			for (int column = 0; column < tileColumns_; ++column) {
+				int x = column * chromaTileSize;
+				int length = std::min(chromaTileSize, chromaWidth - x);
+				rowHashes_[column] = HashBytes(vRow + x, length, HashBytes(uRow + x, length, rowHashes_[column]));
+			}
+		}
+		
+		for (int column = 0; column < tileColumns_; ++column) {
+			int index = tileRow * tileColumns_ + column;
+			if (tileHashes_[index] != rowHashes_[column]) {
+				tileHashes_[index] = rowHashes_[column];
+				changedTiles_[index] = 1;
+				++numberOfChangedTiles;
+			} else {
+				changedTiles_[index] = 0;
+			}
+		}
+	}
+	
+	return numberOfChangedTiles;
+}
+
+
+bool ScreenShareCanvas::UpdateWithFrame(const cricket::VideoFrame *frame)
+{
+	if (!frame) {
+		return false;
+	}
+	
+	++framesReceived_;
+	
+	int width = (int)frame->GetWidth();
+	int height = (int)frame->GetHeight();
+	if (width <= 0 || height <= 0) {
+		return false;
+	}
+	
+	if (!visible_.load()) {
+		// Canvas is not updated while invisible so everything has to be redrawn when we are back.
+		needsFullUpdate_ = true;
+		return false;
+	}
+	
+	bool sizeChanged = (width != sourceWidth_ || height != sourceHeight_);
+	int64 timestampNs = frame->GetTimeStamp();
+	
+	// Cheap metadata check first, decoder may hand over the same frame again.
+	if (!sizeChanged && !needsFullUpdate_ && timestampNs != 0 && timestampNs == lastTimestampNs_) {
+		++framesUnchanged_;
+		return false;
+	}
+	lastTimestampNs_ = timestampNs;
+	
+	if (sizeChanged) {
+		this->ResetTiles(width, height);
+	}
+	
+	int scaleStep = this->ScaleStepForSourceSize(width, height);
+	int numberOfChangedTiles = this->HashTiles(frame);
+	
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (needsFullUpdate_ || scaleStep != scaleStep_ ||
+		canvasSourceWidth_ != sourceWidth_ || canvasSourceHeight_ != sourceHeight_) {
+		this->ResizeCanvas(scaleStep);
+		std::fill(changedTiles_.begin(), changedTiles_.end(), 1);
+		numberOfChangedTiles = (int)changedTiles_.size();
+		needsFullUpdate_ = false;
+	}
+	
+	if (numberOfChangedTiles == 0) {
+		++framesUnchanged_;
+		return false;
+	}
+	
+	for (int tileRow = 0; tileRow < tileRows_; ++tileRow) {
+		for (int column = 0; column < tileColumns_; ++column) {
+			if (changedTiles_[tileRow * tileColumns_ + column]) {
+				this->ScaleTile(frame, tileRow, column);
+			}
+		}
+	}
+	
+	for (size_t i = 0; i < changedTiles_.size(); ++i) {
+		pendingTiles_[i] |= changedTiles_[i];
+	}
+	hasPendingTiles_ = true;
+	tilesUpdated_ += numberOfChangedTiles;
+	
+	return true;
+}
+
+
+void ScreenShareCanvas::ResizeCanvas(int scaleStep)
+{
+	scaleStep_ = scaleStep;
+	canvasSourceWidth_ = sourceWidth_;
+	canvasSourceHeight_ = sourceHeight_;
+	canvasTileColumns_ = tileColumns_;
+	canvasTileRows_ = tileRows_;
+	
+	int canvasWidth = CanvasSizeForStep(sourceWidth_, scaleStep);
+	int canvasHeight = CanvasSizeForStep(sourceHeight_, scaleStep);
+	if (canvasWidth != canvasWidth_ || canvasHeight != canvasHeight_) {
+		spreed_me_log("Screen share canvas %dx%d for source %dx%d", canvasWidth, canvasHeight, sourceWidth_, sourceHeight_);
+	}
+	canvasWidth_ = canvasWidth;
+	canvasHeight_ = canvasHeight;
+	
+	size_t chromaSize = (size_t)((canvasWidth_ + 1) / 2) * ((canvasHeight_ + 1) / 2);
+	canvasY_.resize((size_t)canvasWidth_ * canvasHeight_);
+	canvasU_.resize(chromaSize);
+	canvasV_.resize(chromaSize);
+	
+	pendingTiles_.assign(canvasTileColumns_ * canvasTileRows_, 0);
+	hasPendingTiles_ = false;
+	// Consumer has to replace everything it has got so far.
+	reportedCanvasWidth_ = 0;
+	reportedCanvasHeight_ = 0;
+}
+
+
+// Tile borders are multiples of kTileSize, so they map to whole even canvas pixels.
+int ScreenShareCanvas::CanvasX(int sourceX)
+{
+	return sourceX >= canvasSourceWidth_ ? canvasWidth_ : sourceX * scaleStep_ / kScaleSteps;
+}
+
+
+int ScreenShareCanvas::CanvasY(int sourceY)
+{
+	return sourceY >= canvasSourceHeight_ ? canvasHeight_ : sourceY * scaleStep_ / kScaleSteps;
+}
+
+
+void ScreenShareCanvas::ScaleTile(const cricket::VideoFrame *frame, int tileRow, int tileColumn)
+{
+	int sourceX = tileColumn * kTileSize;
+	int sourceY = tileRow * kTileSize;
+	int sourceWidth = std::min(sourceX + kTileSize, sourceWidth_) - sourceX;
+	int sourceHeight = std::min((tileRow + 1) * kTileSize, sourceHeight_) - sourceY;
+	
+	int canvasX = this->CanvasX(sourceX);
+	int canvasY = this->CanvasY(sourceY);
+	int canvasWidth = this->CanvasX(sourceX + sourceWidth) - canvasX;
+	int canvasHeight = this->CanvasY(sourceY + sourceHeight) - canvasY;
+	if (canvasWidth <= 0 || canvasHeight <= 0) {
+		return;
+	}
+	
+	int32 yPitch = frame->GetYPitch();
+	int32 uPitch = frame->GetUPitch();
+	int32 vPitch = frame->GetVPitch();
+	int canvasChromaPitch = (canvasWidth_ + 1) / 2;
+	
+	// Tiles are always scaled one by one, so a tile looks the same whether it is updated alone or with the whole frame.
+	libyuv::I420Scale(frame->GetYPlane() + sourceY * yPitch + sourceX, yPitch,
+					  frame->GetUPlane() + (sourceY / 2) * uPitch + sourceX / 2, uPitch,
+					  frame->GetVPlane() + (sourceY / 2) * vPitch + sourceX / 2, vPitch,
+					  sourceWidth, sourceHeight,
+					  &canvasY_[canvasY * canvasWidth_ + canvasX], canvasWidth_,
+					  &canvasU_[(canvasY / 2) * canvasChromaPitch + canvasX / 2], canvasChromaPitch,
+					  &canvasV_[(canvasY / 2) * canvasChromaPitch + canvasX / 2], canvasChromaPitch,
+					  canvasWidth, canvasHeight,
+					  libyuv::kFilterBox);
+}
+
+
+bool ScreenShareCanvas::TakeUpdate(ScreenShareCanvasUpdate *update)
+{
+	if (!update) {
+		return false;
+	}
+	
+	webrtc::CriticalSectionScoped sc(critSect_);
+	
+	if (canvasWidth_ == 0 || canvasHeight_ == 0) {
+		return false;
+	}
+	
+	bool canvasChanged = (reportedCanvasWidth_ != canvasWidth_ || reportedCanvasHeight_ != canvasHeight_);
+	if (!canvasChanged && !hasPendingTiles_) {
+		return false;
+	}
+	
+	update->canvasWidth = canvasWidth_;
+	update->canvasHeight = canvasHeight_;
+	update->regions.clear();
+	update->data.clear();
+	
+	if (canvasChanged) {
+		this->AppendRegion(0, 0, canvasWidth_, canvasHeight_, update);
+	} else {
+		for (int tileRow = 0; tileRow < canvasTileRows_; ++tileRow) {
+			const uint8 *pending = &pendingTiles_[tileRow * canvasTileColumns_];
+			for (int column = 0; column < canvasTileColumns_; ++column) {
+				if (!pending[column]) {
+					continue;
+				}
+				int lastColumn = column;
+				while (lastColumn + 1 < canvasTileColumns_ && pending[lastColumn + 1]) {
+					++lastColumn;
+				}
+				this->AppendTileRun(tileRow, column, lastColumn, update);
+				column = lastColumn;
+			}
+		}
+	}
+	
+	std::fill(pendingTiles_.begin(), pendingTiles_.end(), 0);
+	hasPendingTiles_ = false;
+	reportedCanvasWidth_ = canvasWidth_;
+	reportedCanvasHeight_ = canvasHeight_;
+	
+	return !update->regions.empty();
+}
+
+
+void ScreenShareCanvas::RequestFullUpdate()
+{
+	webrtc::CriticalSectionScoped sc(critSect_);
+	reportedCanvasWidth_ = 0;
+	reportedCanvasHeight_ = 0;
+}
+
+
+void ScreenShareCanvas::AppendTileRun(int tileRow, int firstTile, int lastTile, ScreenShareCanvasUpdate *update)
+{
+	int x = this->CanvasX(firstTile * kTileSize);
+	int y = this->CanvasY(tileRow * kTileSize);
+	int width = this->CanvasX((lastTile + 1) * kTileSize) - x;
+	int height = this->CanvasY((tileRow + 1) * kTileSize) - y;
+	if (width > 0 && height > 0) {
+		this->AppendRegion(x, y, width, height, update);
+	}
+}
+
+
+void ScreenShareCanvas::AppendRegion(int x, int y, int width, int height, ScreenShareCanvasUpdate *update)
+{
+	int chromaX = x / 2;
+	int chromaY = y / 2;
+	int chromaWidth = (width + 1) / 2;
+	int chromaHeight = (height + 1) / 2;
+	int canvasChromaPitch = (canvasWidth_ + 1) / 2;
+	
+	ScreenShareCanvasRegion region;
+	region.x = x;
+	region.y = y;
+	region.width = width;
+	region.height = height;
+	region.yOffset = update->data.size();
+	region.uOffset = region.yOffset + (size_t)width * height;
+	region.vOffset = region.uOffset + (size_t)chromaWidth * chromaHeight;
+	update->data.resize(region.vOffset + (size_t)chromaWidth * chromaHeight);
+	
+	uint8 *destination = &update->data[region.yOffset];
+	for (int row = 0; row < height; ++row) {
+		memcpy(destination + row * width, &canvasY_[(y + row) * canvasWidth_ + x], width);
+	}
+	
+	uint8 *uDestination = &update->data[region.uOffset];
+	uint8 *vDestination = &update->data[region.vOffset];
+	for (int row = 0; row < chromaHeight; ++row) {
+		size_t canvasOffset = (size_t)(chromaY + row) * canvasChromaPitch + chromaX;
+		memcpy(uDestination + row * chromaWidth, &canvasU_[canvasOffset], chromaWidth);
+		memcpy(vDestination + row * chromaWidth, &canvasV_[canvasOffset], chromaWidth);
+	}
+	
+	update->regions.push_back(region);
+}
@@ -0,0 +1,155 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__ScreenShareCanvas__
+#define __SpreedME__ScreenShareCanvas__
+
+#include <atomic>
+#include <vector>
+
+#include <talk/media/base/videoframe.h>
+#include <webrtc/base/basictypes.h>
+#include <system_wrappers/interface/critical_section_wrapper.h>
+
+
+namespace spreedme {
+
+// Changed rectangle of ScreenShareCanvas. Coordinates are in canvas pixels, x and y are always even.
+// Planes are tightly packed in ScreenShareCanvasUpdate::data: Y is width x height,
+// U and V are ((width + 1) / 2) x ((height + 1) / 2).
+struct ScreenShareCanvasRegion
+{
+	int x;
+	int y;
+	int width;
+	int height;
+	size_t yOffset;
+	size_t uOffset;
+	size_t vOffset;
+};
+
+
+struct ScreenShareCanvasUpdate
+{
+	ScreenShareCanvasUpdate() : canvasWidth(0), canvasHeight(0) {};
+	
+	int canvasWidth;
+	int canvasHeight;
+	std::vector<ScreenShareCanvasRegion> regions;
+	std::vector<uint8> data; // reused between updates
+};
+
+
+// ScreenShareCanvas keeps the picture of remote screen at the resolution it is actually shown at.
+// Shared screens are mostly static, so incoming frames are split into tiles and only tiles whose
+// content hash has changed are scaled into the canvas. Frames which repeat the previous one are dropped
+// before hashing. Canvas resolution follows display size (which includes zoom of the view) in steps
+// of 1/8 of source resolution so canvas tiles stay aligned with source tiles.
+// Consumer picks up only regions which have changed since its previous update.
+class ScreenShareCanvas
+{
+public:
+	// Source tile side in pixels, canvas tile side is kTileSize * scale.
+	static const int kTileSize = 64;
+	static const int kScaleSteps = 8;
+	
+	ScreenShareCanvas();
+	~ScreenShareCanvas();
+	
+	// Producer side. Should be called only from one thread (webrtc render thread).
+	// Returns false if frame hasn't changed anything on canvas.
+	bool UpdateWithFrame(const cricket::VideoFrame *frame);
+	
+	// Consumer side. Copies regions which have changed since previous call into |update|.
+	// Returns false if there is nothing new. When canvas size changes whole canvas is reported as changed.
+	bool TakeUpdate(ScreenShareCanvasUpdate *update);
+	// Consumer side. Next TakeUpdate() reports whole canvas, consumer calls it when it has lost its copy.
+	void RequestFullUpdate();
+	
+	// Size in pixels the screen is shown at, 0 means source resolution. Is safe to call from any thread.
+	void SetDisplaySize(int width, int height);
+	// Canvas never gets bigger than this in any dimension, 0 means no limit. Is safe to call from any thread.
+	void SetMaxCanvasSize(int maxSize) {maxCanvasSize_.store(maxSize);};
+	// When canvas is not visible incoming frames are dropped without hashing. Is safe to call from any thread.
+	void SetVisible(bool visible) {visible_.store(visible);};
+	bool isVisible() {return visible_.load();};
+	
+	uint32 framesReceived() {return framesReceived_.load();};
+	// Frames which were dropped because they didn't change anything.
+	uint32 framesUnchanged() {return framesUnchanged_.load();};
+	uint32 tilesUpdated() {return tilesUpdated_.load();};
+	
+private:
+	int ScaleStepForSourceSize(int width, int height);
+	void ResetTiles(int width, int height);
+	// Fills changedTiles_, returns number of changed tiles.
+	int HashTiles(const cricket::VideoFrame *frame);
+	// These methods expect critSect_ to be entered
+	void ResizeCanvas(int scaleStep);
+	void ScaleTile(const cricket::VideoFrame *frame, int tileRow, int tileColumn);
+	void AppendTileRun(int tileRow, int firstTile, int lastTile, ScreenShareCanvasUpdate *update);
+	void AppendRegion(int x, int y, int width, int height, ScreenShareCanvasUpdate *update);
+	int CanvasX(int sourceX);
+	int CanvasY(int sourceY);
+	
+	// Producer state
+	int sourceWidth_;
+	int sourceHeight_;
+	int64 lastTimestampNs_;
+	bool needsFullUpdate_;
+	int tileColumns_;
+	int tileRows_;
+	std::vector<uint64> tileHashes_;
+	std::vector<uint64> rowHashes_;
+	std::vector<uint8> changedTiles_;
+	
+	// Canvas is shared between producer and consumer and guarded by critSect_.
+	webrtc::CriticalSectionWrapper *critSect_;
+	int scaleStep_;
+	int canvasSourceWidth_;
+	int canvasSourceHeight_;
+	int canvasTileColumns_;
+	int canvasTileRows_;
+	int canvasWidth_;
+	int canvasHeight_;
+	std::vector<uint8> canvasY_;
+	std::vector<uint8> canvasU_;
+	std::vector<uint8> canvasV_;
+	std::vector<uint8> pendingTiles_; // changed since last TakeUpdate()
+	bool hasPendingTiles_;
+	int reportedCanvasWidth_;
+	int reportedCanvasHeight_;
+	
+	std::atomic<int> displayWidth_;
+	std::atomic<int> displayHeight_;
+	std::atomic<int> maxCanvasSize_;
+	std::atomic<bool> visible_;
+	
+	std::atomic<uint32> framesReceived_;
+	std::atomic<uint32> framesUnchanged_;
+	std::atomic<uint32> tilesUpdated_;
+};
+	
+	
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__ScreenShareCanvas__) */
@@ -0,0 +1,191 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "VideoFrameSlot.h"
+
+#include <algorithm>
+
+#include "utils.h"
+
+
+using namespace spreedme;
+
+
+// Source frame intervals longer than this are treated as pauses in stream and are not used for estimation.
+const int64 kMaxSourceFrameIntervalUs = 1000000;
+// Frame which arrived early is never held longer than this.
+const int64 kMaxFrameHoldUs = 50000;
+// Jumps of (display time - frame timestamp) bigger than this are treated as timestamp discontinuity.
+const int64 kMaxPresentationOffsetJumpUs = 500000;
+const int64 kPresentationOffsetSmoothing = 16;
+const int kMaxRefreshInterval = 4;
+
+
+VideoFrameSlot::VideoFrameSlot() :
+	readyState_(2),
+	writeIndex_(1),
+	readIndex_(0),
+	presentedIndex_(3),
+	visible_(true),
+	lastPushedTimestampNs_(0),
+	sourceFrameIntervalUs_(0),
+	hasFrameToPresent_(false),
+	hasPresentationOffset_(false),
+	presentationOffsetUs_(0),
+	frameDueTimeUs_(0),
+	framesPushed_(0),
+	framesPresented_(0),
+	framesSuperseded_(0)
+{
+	for (int i = 0; i < kNumberOfBuffers; ++i) {
+		buffers_[i] = NULL;
+	}
+}
+
+
+VideoFrameSlot::~VideoFrameSlot()
+{
+	for (int i = 0; i < kNumberOfBuffers; ++i) {
+		delete buffers_[i];
+		buffers_[i] = NULL;
+	}
+}
+
+
+bool VideoFrameSlot::PushFrame(const cricket::VideoFrame *frame)
+{
+	if (!frame) {
+		return false;
+	}
+	
+	++framesPushed_;
+	
+	int64 timestampNs = frame->GetTimeStamp();
+	if (lastPushedTimestampNs_ > 0 && timestampNs > lastPushedTimestampNs_) {
+		int64 intervalUs = (timestampNs - lastPushedTimestampNs_) / 1000;
+		if (intervalUs < kMaxSourceFrameIntervalUs) {
+			int64 estimationUs = sourceFrameIntervalUs_.load();
+			estimationUs = estimationUs > 0 ? (estimationUs * 7 + intervalUs) / 8 : intervalUs;
+			sourceFrameIntervalUs_.store(estimationUs);
+		}
+	}
+	lastPushedTimestampNs_ = timestampNs;
+	
+	if (!visible_.load()) {
+		return false;
+	}
+	
+	cricket::VideoFrame *buffer = buffers_[writeIndex_];
+	if (!buffer || buffer->GetWidth() != frame->GetWidth() || buffer->GetHeight() != frame->GetHeight()) {
+		delete buffer;
+		buffer = frame->CreateEmptyFrame((int)frame->GetWidth(), (int)frame->GetHeight(),
+										 frame->GetPixelWidth(), frame->GetPixelHeight(),
+										 frame->GetElapsedTime(), timestampNs);
+		buffers_[writeIndex_] = buffer;
+		if (!buffer) {
+			spreed_me_log("Couldn't allocate video frame buffer %dx%d", (int)frame->GetWidth(), (int)frame->GetHeight());
+			return false;
+		}
+	} else {
+		buffer->SetElapsedTime(frame->GetElapsedTime());
+		buffer->SetTimeStamp(timestampNs);
+	}
+	
+	if (!frame->CopyToFrame(buffer)) {
+		return false;
+	}
+	
+	int previousState = readyState_.exchange(writeIndex_ | kFreshFrameFlag);
+	writeIndex_ = previousState & kBufferIndexMask;
+	if (previousState & kFreshFrameFlag) {
+		++framesSuperseded_;
+	}
+	
+	return true;
+}
+
+
+bool VideoFrameSlot::AcquireLatestFrame()
+{
+	if (!(readyState_.load() & kFreshFrameFlag)) {
+		return false;
+	}
+	
+	// Producer can publish another frame in between, exchange will return the newest one in this case.
+	// Only the acquired buffer goes back, presented one stays with us.
+	int previousState = readyState_.exchange(readIndex_);
+	readIndex_ = previousState & kBufferIndexMask;
+	
+	return true;
+}
+
+
+const cricket::VideoFrame *VideoFrameSlot::FrameToPresent(int64 displayTimeUs, int64 refreshPeriodUs)
+{
+	if (this->AcquireLatestFrame()) {
+		if (hasFrameToPresent_) {
+			++framesSuperseded_;
+		}
+		hasFrameToPresent_ = true;
+		
+		int64 frameTimeUs = buffers_[readIndex_]->GetTimeStamp() / 1000;
+		int64 arrivalOffsetUs = displayTimeUs - frameTimeUs;
+		if (!hasPresentationOffset_ ||
+			arrivalOffsetUs - presentationOffsetUs_ > kMaxPresentationOffsetJumpUs ||
+			presentationOffsetUs_ - arrivalOffsetUs > kMaxPresentationOffsetJumpUs) {
+			presentationOffsetUs_ = arrivalOffsetUs;
+			hasPresentationOffset_ = true;
+		}
+		
+		frameDueTimeUs_ = std::min(frameTimeUs + presentationOffsetUs_, displayTimeUs + kMaxFrameHoldUs);
+		presentationOffsetUs_ += (arrivalOffsetUs - presentationOffsetUs_) / kPresentationOffsetSmoothing;
+	}
+	
+	if (!hasFrameToPresent_ || frameDueTimeUs_ > displayTimeUs + refreshPeriodUs / 2) {
+		return NULL;
+	}
+	
+	hasFrameToPresent_ = false;
+	++framesPresented_;
+	
+	// Previously presented buffer is not drawn anymore once caller switches to the new frame.
+	std::swap(readIndex_, presentedIndex_);
+	
+	return buffers_[presentedIndex_];
+}
+
+
+int VideoFrameSlot::PreferredRefreshInterval(int64 displayRefreshPeriodUs)
+{
+	int64 sourceIntervalUs = sourceFrameIntervalUs_.load();
+	if (sourceIntervalUs <= 0 || displayRefreshPeriodUs <= 0) {
+		return 1;
+	}
+	
+	int64 refreshInterval = (sourceIntervalUs + displayRefreshPeriodUs / 2) / displayRefreshPeriodUs;
+	// Never poll noticeably slower than source produces frames.
+	if (refreshInterval * displayRefreshPeriodUs > sourceIntervalUs + sourceIntervalUs / 10) {
+		--refreshInterval;
+	}
+	
+	return (int)std::max<int64>(1, std::min<int64>(refreshInterval, kMaxRefreshInterval));
+}
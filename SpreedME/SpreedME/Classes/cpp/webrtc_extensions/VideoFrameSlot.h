@@ -0,0 +1,104 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__VideoFrameSlot__
+#define __SpreedME__VideoFrameSlot__
+
+#include <atomic>
+
+#include <talk/media/base/videoframe.h>
+#include <webrtc/base/basictypes.h>
+
+
+namespace spreedme {
+
+// VideoFrameSlot hands decoded frames from webrtc render thread over to display thread.
+// Producer always has a buffer to copy new frame into and the latest complete frame is exchanged with consumer
+// atomically, so neither side blocks. Consumer keeps two buffers: the acquired frame which waits until it is due
+// and the presented frame which display may still be drawing from. Producer never writes into either of them.
+// Frame buffers are reused as long as incoming frame size doesn't change.
+// Presentation is paced by frame timestamps, frames which arrived too early are held until they are due.
+class VideoFrameSlot
+{
+public:
+	VideoFrameSlot();
+	~VideoFrameSlot();
+	
+	// Producer side. Should be called only from one thread (webrtc render thread).
+	// Returns false if frame has been dropped without copying, this happens when slot is not visible.
+	bool PushFrame(const cricket::VideoFrame *frame);
+	
+	// Consumer side. Should be called only from one thread (display thread) on every display refresh
+	// which consumer is going to use, 'refreshPeriodUs' is time between such refreshes.
+	// Returns frame which should be presented now or NULL if there is nothing new to present.
+	// Returned frame stays valid and unchanged until FrameToPresent() returns another frame.
+	const cricket::VideoFrame *FrameToPresent(int64 displayTimeUs, int64 refreshPeriodUs);
+	
+	// Returns how many display refreshes should pass between consecutive FrameToPresent() calls
+	// to follow source frame rate. Is safe to call from any thread.
+	int PreferredRefreshInterval(int64 displayRefreshPeriodUs);
+	
+	// When slot is not visible incoming frames are dropped without copying. Is safe to call from any thread.
+	void SetVisible(bool visible) {visible_.store(visible);};
+	bool isVisible() {return visible_.load();};
+	
+	uint32 framesPushed() {return framesPushed_.load();};
+	uint32 framesPresented() {return framesPresented_.load();};
+	// Frames which were replaced by newer frames before they had a chance to be presented.
+	uint32 framesSuperseded() {return framesSuperseded_.load();};
+	
+private:
+	static const int kNumberOfBuffers = 4;
+	static const int kBufferIndexMask = 0x3;
+	static const int kFreshFrameFlag = 0x4;
+	
+	bool AcquireLatestFrame();
+	
+	// Consumer owns readIndex_ and presentedIndex_, producer owns writeIndex_,
+	// the remaining buffer is described by readyState_.
+	cricket::VideoFrame *buffers_[kNumberOfBuffers];
+	std::atomic<int> readyState_; // index of ready buffer | kFreshFrameFlag if it hasn't been acquired yet
+	int writeIndex_;
+	int readIndex_; // acquired frame waiting for its due time
+	int presentedIndex_; // last returned frame, display can still draw it
+	
+	std::atomic<bool> visible_;
+	
+	// Producer side estimation of source frame interval.
+	int64 lastPushedTimestampNs_;
+	std::atomic<int64> sourceFrameIntervalUs_;
+	
+	// Consumer side pacing state.
+	bool hasFrameToPresent_;
+	bool hasPresentationOffset_;
+	int64 presentationOffsetUs_; // smoothed (display time - frame timestamp)
+	int64 frameDueTimeUs_;
+	
+	std::atomic<uint32> framesPushed_;
+	std::atomic<uint32> framesPresented_;
+	std::atomic<uint32> framesSuperseded_;
+};
+	
+	
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__VideoFrameSlot__) */
@@ -26,6 +26,8 @@
 
 #include <talk/app/webrtc/mediastreaminterface.h>
 
+#include "VideoFrameSlot.h"
+
 
 namespace spreedme {
 	
@@ -65,9 +67,12 @@ public:
 	virtual std::string videoTrackId() {return videoTrackId_;};
 	virtual std::string streamLabel() {return streamLabel_;};
 	virtual void *videoView() {return videoView_;};
+	// Subclasses which draw on their own display thread should pass frames through this slot.
+	virtual VideoFrameSlot *frameSlot() {return &frameSlot_;};
 	
 protected:
 	void *videoView_; // subclasses should release/free this object properly!
+	VideoFrameSlot frameSlot_;
 	VideoRendererDelegateInterface *delegate_; // We don't own it
 	
 	std::string name_;
@@ -31,6 +31,7 @@
 #include "VideoRendererIOS.h"
 #elif TARGET_OS_IPHONE
 #include "VideoRendererIOS.h"
+#include "ScreenShareRendererIOS.h"
 #elif TARGET_OS_MAC
 // Other kinds of Mac OS
 #else
@@ -51,7 +52,8 @@ VideoRenderer *
 VideoRendererFactory::CreateVideoRenderer(VideoRendererDelegateInterface *delegate,
 										  const std::string &name,
 										  const std::string &videoTrackId,
-										  const std::string &streamLabel)
+										  const std::string &streamLabel,
+										  VideoRendererKind kind)
 {
 	
 	VideoRenderer *renderer = NULL;
@@ -64,7 +66,11 @@ VideoRendererFactory::CreateVideoRenderer(VideoRendererDelegateInterface *delega
 	// iOS Simulator
 #elif TARGET_OS_IPHONE
 	
-	renderer = new VideoRendererIOS(delegate, name, videoTrackId, streamLabel);
+	if (kind == kVideoRendererKindScreen) {
+		renderer = new ScreenShareRendererIOS(delegate, name, videoTrackId, streamLabel);
+	} else {
+		renderer = new VideoRendererIOS(delegate, name, videoTrackId, streamLabel);
+	}
 
 #elif TARGET_OS_MAC
 	// Other kinds of Mac OS
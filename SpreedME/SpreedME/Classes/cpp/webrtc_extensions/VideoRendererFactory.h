@@ -24,6 +24,7 @@
 #define __SpreedME__VideoRendererFactory__
 
 #include "VideoRenderer.h"
+#include "WebrtcCommonDefinitions.h"
 
 namespace spreedme {
 
@@ -35,7 +36,8 @@ public:
 	static VideoRenderer *CreateVideoRenderer(VideoRendererDelegateInterface *delegate,
 											  const std::string &name,
 											  const std::string &videoTrackId,
-											  const std::string &streamLabel);
+											  const std::string &streamLabel,
+											  VideoRendererKind kind = kVideoRendererKindCamera);
 	
 	
 private:
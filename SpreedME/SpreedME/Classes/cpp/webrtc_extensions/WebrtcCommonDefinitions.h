@@ -37,6 +37,14 @@ typedef enum VideoRendererManagementError {
 VideoRendererManagementError;
 	
 	
+// Screen renderers are optimized for mostly static content which is shown downscaled.
+typedef enum VideoRendererKind {
+	kVideoRendererKindCamera = 0,
+	kVideoRendererKindScreen,
+}
+VideoRendererKind;
+	
+	
 	
 struct IceCandidateStringRepresentation
 {
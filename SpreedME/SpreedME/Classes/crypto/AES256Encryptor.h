@@ -55,6 +55,8 @@ extern NSString * const kSMCryptoCipherAES;
 // These methods will return nil if key is not 32 byte long
 - (NSData *)encryptString:(NSString *)plaintext withKeyData:(NSData *)key iv:(NSData **)iv;
 - (NSString *)decryptData:(NSData *)ciphertext withKeyData:(NSData *)key andIV:(NSData *)iv;
+- (NSData *)encryptData:(NSData *)plainData withKeyData:(NSData *)key iv:(NSData **)iv;
+- (NSData *)decryptedDataFromData:(NSData *)ciphertext withKeyData:(NSData *)key iv:(NSData *)iv;
 
 + (NSData *)randomDataOfLength:(size_t)length;
 
@@ -62,6 +64,14 @@ extern NSString * const kSMCryptoCipherAES;
 - (BOOL)saveDataEncrypted:(NSData *)dataToEncrypt withKeyData:(NSData *)keyData toPath:(NSString *)path;
 - (NSData *)loadDataFromEncryptedFileAtPath:(NSString *)path withKeyData:(NSData *)keyData;
 
+// Streaming segmented files (see SegmentedFileCrypto.h). These never hold more than one segment in memory
+// and should be used for big files. Key has to be 32 bytes long. segmentSize 0 means default segment size.
+- (BOOL)encryptFileAtPath:(NSString *)srcPath toSegmentedFileAtPath:(NSString *)dstPath withKeyData:(NSData *)keyData segmentSize:(uint32_t)segmentSize;
+- (BOOL)decryptSegmentedFileAtPath:(NSString *)srcPath toPath:(NSString *)dstPath withKeyData:(NSData *)keyData;
+// Decrypts only segments needed for the range. Returns nil on authentication failure.
+- (NSData *)dataInRange:(NSRange)range ofSegmentedFileAtPath:(NSString *)path withKeyData:(NSData *)keyData;
+- (unsigned long long)plaintextSizeOfSegmentedFileAtPath:(NSString *)path;
+
 // This method will create 2 files in given directory: data.bin meta.json
 - (BOOL)saveDataEncrypted:(NSData *)dataToEncrypt withPassword:(NSString *)password toDir:(NSString *)dir;
 - (NSData *)loadDataFromEncryptedFileInDir:(NSString *)dir withPassword:(NSString *)password;
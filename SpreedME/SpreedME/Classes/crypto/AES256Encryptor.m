@@ -23,9 +23,10 @@
 #import "AES256Encryptor.h"
 
 #import "JSONKit.h"
+#import "SegmentedFileCrypto.h"
+#import "SMKeyring.h"
 
 #import <CommonCrypto/CommonCryptor.h>
-#import <CommonCrypto/CommonKeyDerivation.h>
 
 
 NSString * const kSMCryptoInitVectorKey					= @"iv";
@@ -183,65 +184,36 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 }
 
 
+- (NSData *)encryptData:(NSData *)plainData withKeyData:(NSData *)key iv:(NSData **)iv
+{
+	return [plainData AES256EncryptWithKeyData:key iv:iv];
+}
+
+
+- (NSData *)decryptedDataFromData:(NSData *)ciphertext withKeyData:(NSData *)key iv:(NSData *)iv
+{
+	return [ciphertext AES256DecryptWithKeyData:key iv:iv];
+}
+
+
 - (NSDictionary *)encryptData:(NSData *)dataToEncrypt
 				 withPassword:(NSString *)password
 					  outData:(NSData * __autoreleasing *)outData
 {
 	if (dataToEncrypt.length > 0 && password.length > 0) {
 		
-		NSData *salt = [AES256Encryptor randomDataOfLength:16];
-		
-		if (!salt) {
+		NSData *salt = nil;
+		NSUInteger numberOfIterations = 0;
+		NSData *keyData = [[SMKeyring sharedInstance] encryptionKeyForPassword:password salt:&salt iterations:&numberOfIterations];
+		if (!keyData) {
 			return nil;
 		}
 		
-		// since we don't expect to transfer these files to other devices
-		// we can safely calculate number of iterations for current device.
-		// Even if we transfer this to other device it just might take more time to
-		// derive the key there.
-		uint numberOfIterations = CCCalibratePBKDF(kCCPBKDF2,
-												   password.length,
-												   salt.length,
-												   kCCPRFHmacAlgSHA256,
-												   32, // expected key length for SHA256
-												   100); // expected time in msec
-		
-		
-		char *passwordPtr = malloc(password.length + 1); // room for terminator (unused)
-		bzero(passwordPtr, sizeof(passwordPtr)); // fill with zeroes (for padding)
-		
-		// fetch key data
-		[password getCString:passwordPtr maxLength:(password.length + 1) encoding:NSUTF8StringEncoding];
-		
-		uint8_t key[32]; // expected key length for SHA256
-		
-		int result = CCKeyDerivationPBKDF(kCCPBKDF2,
-										  passwordPtr,
-										  password.length,
-										  (uint8_t *)salt.bytes,
-										  salt.length,
-										  kCCPRFHmacAlgSHA256,
-										  numberOfIterations,
-										  key,
-										  32); // expected key length for SHA256
-		if (result != kCCSuccess) {
-			spreed_me_log("Failed to derive key with error %d", result);
-			bzero(passwordPtr, sizeof(passwordPtr));
-			free(passwordPtr);
-			return nil;
-		}
-		
-		
-		NSData *keyData = [[NSData alloc] initWithBytes:key length:sizeof(key)];
-		
-		
 		NSData *iv = nil; // iv length in our case is kCCBlockSizeAES128
 		NSData *encryptedData = [dataToEncrypt AES256EncryptWithKeyData:keyData iv:&iv];
 		
 		if (!iv || !encryptedData) {
 			spreed_me_log("Couldn't create init vector while encrypting or couldn't encrypt data");
-			bzero(passwordPtr, sizeof(passwordPtr));
-			free(passwordPtr);
 			return nil;
 		}
 		
@@ -253,9 +225,6 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 									   kSMCryptoCipherKey : kSMCryptoCipherAES,
 									   kSMCryptoModeKey	: kSMCryptoCCMMode};
 		
-		bzero(passwordPtr, sizeof(passwordPtr));
-		free(passwordPtr);
-		
 		*outData = encryptedData;
 		return metadataDict;
 	}
@@ -285,34 +254,13 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 			[mode isEqualToString:kSMCryptoCCMMode]) {
 			
 			
-			char *passwordPtr = malloc(password.length + 1); // room for terminator (unused)
-			bzero(passwordPtr, sizeof(passwordPtr)); // fill with zeroes (for padding)
-			
-			// fetch key data
-			[password getCString:passwordPtr maxLength:(password.length + 1) encoding:NSUTF8StringEncoding];
-			
-			uint8_t key[32]; // expected key length for SHA256
-			
-			int result = CCKeyDerivationPBKDF(kCCPBKDF2,
-											  passwordPtr,
-											  password.length,
-											  (uint8_t *)salt.bytes,
-											  salt.length,
-											  kCCPRFHmacAlgSHA256,
-											  iter,
-											  key,
-											  32); // expected key length for SHA256
-			if (result != kCCSuccess) {
-				spreed_me_log("Failed to derive key with error %d", result);
+			NSData *keyData = [[SMKeyring sharedInstance] keyForPassword:password salt:salt iterations:iter];
+			if (!keyData) {
 				return nil;
 			}
-			NSData *keyData = [[NSData alloc] initWithBytes:key length:sizeof(key)];
 			
 			NSData *decrData = [encData AES256DecryptWithKeyData:keyData iv:iv];
 			
-			bzero(passwordPtr, sizeof(passwordPtr));
-			free(passwordPtr);
-			
 			return decrData;
 		} else {
 			spreed_me_log("Unsupported encrypted metadata!");
@@ -402,7 +350,75 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 }
 
 
-// This method will create 2 files in given directory: data.bin meta.json
+#pragma mark - Segmented files
+
+- (BOOL)encryptFileAtPath:(NSString *)srcPath toSegmentedFileAtPath:(NSString *)dstPath withKeyData:(NSData *)keyData segmentSize:(uint32_t)segmentSize
+{
+	if (srcPath.length == 0 || dstPath.length == 0 || keyData.length != kCCKeySizeAES256) {
+		return NO;
+	}
+	
+	bool success = SegmentedFileEncryptFile([srcPath fileSystemRepresentation], [dstPath fileSystemRepresentation],
+											keyData.bytes, keyData.length, segmentSize);
+	if (!success) {
+		spreed_me_log("Couldn't encrypt file %s", [srcPath cDescription]);
+		[[NSFileManager defaultManager] removeItemAtPath:dstPath error:NULL];
+	}
+	
+	return success;
+}
+
+
+- (BOOL)decryptSegmentedFileAtPath:(NSString *)srcPath toPath:(NSString *)dstPath withKeyData:(NSData *)keyData
+{
+	if (srcPath.length == 0 || dstPath.length == 0 || keyData.length != kCCKeySizeAES256) {
+		return NO;
+	}
+	
+	bool success = SegmentedFileDecryptFile([srcPath fileSystemRepresentation], [dstPath fileSystemRepresentation],
+											keyData.bytes, keyData.length);
+	if (!success) {
+		// Don't leave partially decrypted (possibly unauthenticated) data around
+		spreed_me_log("Couldn't decrypt file %s", [srcPath cDescription]);
+		[[NSFileManager defaultManager] removeItemAtPath:dstPath error:NULL];
+	}
+	
+	return success;
+}
+
+
+- (NSData *)dataInRange:(NSRange)range ofSegmentedFileAtPath:(NSString *)path withKeyData:(NSData *)keyData
+{
+	if (path.length == 0 || keyData.length != kCCKeySizeAES256) {
+		return nil;
+	}
+	
+	NSMutableData *data = [NSMutableData dataWithLength:range.length];
+	size_t bytesRead = 0;
+	bool success = SegmentedFileReadRange([path fileSystemRepresentation], keyData.bytes, keyData.length,
+										  range.location, data.mutableBytes, range.length, &bytesRead);
+	if (!success) {
+		return nil;
+	}
+	
+	data.length = bytesRead;
+	return data;
+}
+
+
+- (unsigned long long)plaintextSizeOfSegmentedFileAtPath:(NSString *)path
+{
+	uint64_t size = 0;
+	if (path.length > 0 && SegmentedFilePlaintextSize([path fileSystemRepresentation], &size)) {
+		return size;
+	}
+	return 0;
+}
+
+
+// This method will create 2 files in given directory: data-<unique suffix>.bin meta.json
+// Cipher text is written under a new name and meta.json which points to it is replaced afterwards,
+// so readers see either the old or the new pair but never a mix of them.
 - (BOOL)saveDataEncrypted:(NSData *)dataToEncrypt withPassword:(NSString *)password toDir:(NSString *)dir
 {
 	BOOL success = NO;
@@ -412,30 +428,40 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 		NSData *encryptedData = nil;
 		NSDictionary *metadataDict = [self encryptData:dataToEncrypt withPassword:password outData:&encryptedData];
 		
-		if (metadataDict) {
+		if (metadataDict && encryptedData) {
 			NSMutableDictionary *metadataMutableDict = [NSMutableDictionary dictionaryWithDictionary:metadataDict];
 			
-			NSString *binFileName = kSMCryptoCipherTextFileName;
 			NSString *metaFilePath = [dir stringByAppendingPathComponent:kSMCryptoMetadataFileName];
+			NSString *previousBinFileName = [self cipherTextFileNameFromMetadataFileAtPath:metaFilePath];
+			
+			NSString *binFileName = [NSString stringWithFormat:@"%@-%@.%@",
+									 [kSMCryptoCipherTextFileName stringByDeletingPathExtension],
+									 [[NSUUID UUID] UUIDString],
+									 [kSMCryptoCipherTextFileName pathExtension]];
+			NSString *binFilePath = [dir stringByAppendingPathComponent:binFileName];
 			
 			[metadataMutableDict setObject:binFileName forKey:kSMCryptoCipherTextFileNameKey];
 			
-			NSString *binFilePath = [dir stringByAppendingPathComponent:binFileName];
+			NSError *error = nil;
+			success = [encryptedData writeToFile:binFilePath options:NSDataWritingAtomic error:&error];
+			if (!success) {
+				spreed_me_log("Couldn't save encrypted data to %s with error %s", [binFilePath cDescription], [error cDescription]);
+				return NO;
+			}
+			
+			NSString *json = [metadataMutableDict JSONString];
+			success = [json writeToFile:metaFilePath
+							 atomically:YES
+							   encoding:NSUTF8StringEncoding
+								  error:&error];
+			if (!success) {
+				spreed_me_log("Couldn't save metadata to %s with error %s", [metaFilePath cDescription], [error cDescription]);
+				[[NSFileManager defaultManager] removeItemAtPath:binFilePath error:NULL];
+				return NO;
+			}
 			
-			if (encryptedData) {
-				
-				NSString *json = [metadataMutableDict JSONString];
-				NSError *error = nil;
-				success = [json writeToFile:metaFilePath
-								 atomically:YES
-								   encoding:NSUTF8StringEncoding
-									  error:&error];
-				if (!success) {
-					spreed_me_log("Couldn't save metadata to %s with error %s", [metaFilePath cDescription], [error cDescription]);
-					return NO;
-				}
-				
-				success = [encryptedData writeToFile:binFilePath atomically:YES];
+			if (previousBinFileName.length > 0 && ![previousBinFileName isEqualToString:binFileName]) {
+				[[NSFileManager defaultManager] removeItemAtPath:[dir stringByAppendingPathComponent:previousBinFileName] error:NULL];
 			}
 			
 		} else {
@@ -447,6 +473,20 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 }
 
 
+- (NSString *)cipherTextFileNameFromMetadataFileAtPath:(NSString *)metaFilePath
+{
+	NSString *jsonString = [[NSString alloc] initWithContentsOfFile:metaFilePath
+														   encoding:NSUTF8StringEncoding
+															  error:NULL];
+	NSDictionary *json = [jsonString objectFromJSONString];
+	NSString *binFileName = nil;
+	if ([json isKindOfClass:[NSDictionary class]]) {
+		binFileName = [[json objectForKey:kSMCryptoCipherTextFileNameKey] lastPathComponent];
+	}
+	return binFileName;
+}
+
+
 - (NSData *)loadDataFromEncryptedFileInDir:(NSString *)dir withPassword:(NSString *)password
 {
 	NSData *decrData = nil;
@@ -475,7 +515,7 @@ NSString * const kSMCryptoCipherTextFileName = @"data.bin";
 		
 		if (binDataName.length > 0) {
 			
-			NSString *binDataPath = [dir stringByAppendingPathComponent:binDataName];
+			NSString *binDataPath = [dir stringByAppendingPathComponent:[binDataName lastPathComponent]];
 			
 			NSError *error = nil;
 			NSData *loadedData = [NSData dataWithContentsOfFile:binDataPath options:0 error:&error];
@@ -0,0 +1,46 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+/*
+ Keeps keys derived from passwords with PBKDF2 in memory for the lifetime of the app.
+ Encryption key for a password is derived once per app launch with fresh salt and
+ number of iterations calibrated for this device. All later saves reuse it,
+ its salt and number of iterations are stored in metadata of every encrypted file.
+ Keys derived for decryption are cached too, so files written during current launch
+ and files with the same salt are decrypted without running PBKDF2 again.
+ Methods can be called from any thread. Derivation itself takes about 100ms.
+ */
+@interface SMKeyring : NSObject
+
++ (instancetype)sharedInstance;
+
+- (NSData *)encryptionKeyForPassword:(NSString *)password
+								salt:(NSData * __autoreleasing *)salt
+						  iterations:(NSUInteger *)iterations;
+
+- (NSData *)keyForPassword:(NSString *)password salt:(NSData *)salt iterations:(NSUInteger)iterations;
+
+- (void)removeAllKeys;
+
+@end
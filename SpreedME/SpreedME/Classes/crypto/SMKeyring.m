@@ -0,0 +1,226 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "SMKeyring.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <CommonCrypto/CommonKeyDerivation.h>
+
+#import "AES256Encryptor.h"
+
+
+const size_t kSMKeyringKeyLength = 32; // expected key length for SHA256
+const size_t kSMKeyringSaltLength = 16;
+const uint32_t kSMKeyringDerivationTimeMs = 100;
+
+
+@interface SMKeyringEncryptionKey : NSObject
+@property (nonatomic, strong) NSData *key;
+@property (nonatomic, strong) NSData *salt;
+@property (nonatomic, assign) NSUInteger iterations;
+@end
+
+@implementation SMKeyringEncryptionKey
+@end
+
+
+@interface SMKeyring ()
+{
+	dispatch_queue_t _queue;
+	
+	NSMutableDictionary *_encryptionKeys; // password hash -> SMKeyringEncryptionKey
+	NSMutableDictionary *_derivedKeys; // password hash + salt + iterations -> key data
+}
+
+@end
+
+
+@implementation SMKeyring
+
++ (instancetype)sharedInstance
+{
+	static dispatch_once_t once;
+	static SMKeyring *sharedInstance;
+	dispatch_once(&once, ^{
+		sharedInstance = [[self alloc] init];
+	});
+	return sharedInstance;
+}
+
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		_queue = dispatch_queue_create("SMKeyring", DISPATCH_QUEUE_SERIAL);
+		_encryptionKeys = [[NSMutableDictionary alloc] init];
+		_derivedKeys = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+
+#pragma mark - Public
+
+- (NSData *)encryptionKeyForPassword:(NSString *)password
+								salt:(NSData * __autoreleasing *)salt
+						  iterations:(NSUInteger *)iterations
+{
+	if (password.length == 0) {
+		return nil;
+	}
+	
+	__block SMKeyringEncryptionKey *encryptionKey = nil;
+	
+	// Derivation is done on the queue so concurrent callers wait for the first one instead of deriving again.
+	dispatch_sync(_queue, ^{
+		NSString *passwordHash = [self hashOfPassword:password];
+		encryptionKey = [_encryptionKeys objectForKey:passwordHash];
+		if (!encryptionKey) {
+			NSData *newSalt = [AES256Encryptor randomDataOfLength:kSMKeyringSaltLength];
+			if (!newSalt) {
+				return;
+			}
+			
+			// Since we don't expect to transfer these files to other devices
+			// we can safely calculate number of iterations for current device.
+			// Even if we transfer this to other device it just might take more time to
+			// derive the key there.
+			uint numberOfIterations = CCCalibratePBKDF(kCCPBKDF2,
+													   password.length,
+													   newSalt.length,
+													   kCCPRFHmacAlgSHA256,
+													   kSMKeyringKeyLength,
+													   kSMKeyringDerivationTimeMs);
+			
+			NSData *key = [self deriveKeyForPassword:password salt:newSalt iterations:numberOfIterations];
+			if (key) {
+				encryptionKey = [[SMKeyringEncryptionKey alloc] init];
+				encryptionKey.key = key;
+				encryptionKey.salt = newSalt;
+				encryptionKey.iterations = numberOfIterations;
+				[_encryptionKeys setObject:encryptionKey forKey:passwordHash];
+				[_derivedKeys setObject:key forKey:[self derivedKeyIdForPasswordHash:passwordHash salt:newSalt iterations:numberOfIterations]];
+			}
+		}
+	});
+	
+	if (salt) {
+		*salt = encryptionKey.salt;
+	}
+	if (iterations) {
+		*iterations = encryptionKey.iterations;
+	}
+	
+	return encryptionKey.key;
+}
+
+
+- (NSData *)keyForPassword:(NSString *)password salt:(NSData *)salt iterations:(NSUInteger)iterations
+{
+	if (password.length == 0 || salt.length == 0 || iterations == 0) {
+		return nil;
+	}
+	
+	__block NSData *key = nil;
+	
+	dispatch_sync(_queue, ^{
+		NSString *keyId = [self derivedKeyIdForPasswordHash:[self hashOfPassword:password] salt:salt iterations:iterations];
+		key = [_derivedKeys objectForKey:keyId];
+		if (!key) {
+			key = [self deriveKeyForPassword:password salt:salt iterations:iterations];
+			if (key) {
+				[_derivedKeys setObject:key forKey:keyId];
+			}
+		}
+	});
+	
+	return key;
+}
+
+
+- (void)removeAllKeys
+{
+	dispatch_sync(_queue, ^{
+		[_encryptionKeys removeAllObjects];
+		[_derivedKeys removeAllObjects];
+	});
+}
+
+
+#pragma mark - Private
+
+- (NSData *)deriveKeyForPassword:(NSString *)password salt:(NSData *)salt iterations:(NSUInteger)iterations
+{
+	// Files written before keyring existed used password.length as password byte length,
+	// we keep it the same so they can still be decrypted. Our passwords are hex strings.
+	size_t passwordBufferLength = password.length + 1; // room for terminator (unused)
+	char *passwordPtr = malloc(passwordBufferLength);
+	bzero(passwordPtr, passwordBufferLength);
+	[password getCString:passwordPtr maxLength:passwordBufferLength encoding:NSUTF8StringEncoding];
+	
+	uint8_t key[kSMKeyringKeyLength];
+	
+	int result = CCKeyDerivationPBKDF(kCCPBKDF2,
+									  passwordPtr,
+									  password.length,
+									  (uint8_t *)salt.bytes,
+									  salt.length,
+									  kCCPRFHmacAlgSHA256,
+									  (uint)iterations,
+									  key,
+									  kSMKeyringKeyLength);
+	
+	bzero(passwordPtr, passwordBufferLength);
+	free(passwordPtr);
+	
+	if (result != kCCSuccess) {
+		spreed_me_log("Failed to derive key with error %d", result);
+		return nil;
+	}
+	
+	NSData *keyData = [[NSData alloc] initWithBytes:key length:sizeof(key)];
+	bzero(key, sizeof(key));
+	
+	return keyData;
+}
+
+
+- (NSString *)hashOfPassword:(NSString *)password
+{
+	// We don't want to keep passwords themselves as dictionary keys
+	NSData *passwordData = [password dataUsingEncoding:NSUTF8StringEncoding];
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(passwordData.bytes, (CC_LONG)passwordData.length, digest);
+	
+	NSData *digestData = [NSData dataWithBytes:digest length:sizeof(digest)];
+	return [digestData base64Encoding];
+}
+
+
+- (NSString *)derivedKeyIdForPasswordHash:(NSString *)passwordHash salt:(NSData *)salt iterations:(NSUInteger)iterations
+{
+	return [NSString stringWithFormat:@"%@:%@:%lu", passwordHash, [salt base64Encoding], (unsigned long)iterations];
+}
+
+
+@end
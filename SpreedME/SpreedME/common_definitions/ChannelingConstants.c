@@ -79,6 +79,7 @@ const char kUsersKey[]			= "Users";
 const char kChatKey[]			= "Chat";
 const char kTalkingKey[]		= "Talking";
 const char kScreenShareKey[]	= "Screenshare";
+const char kVideoSubscriptionKey[]	= "VideoSubscription";
 const char kHelloKey[]			= "Hello";
 const char kSelfKey[]			= "Self";
 const char kAliveKey[]			= "Alive";
@@ -131,6 +132,11 @@ const char kByeReasonNoAnswerString[]	= "pickuptimeout";
 const char kByeReasonRejectString[]		= "reject";
 const char kByeReasonAbortString[]		= "abort";
 
+// Keys used in VideoSubscription message
+const char kVideoSubscriptionActiveKey[]		= "Active";
+const char kVideoSubscriptionWidthKey[]			= "Width";
+const char kVideoSubscriptionHeightKey[]		= "Height";
+
 // Keys used for a IceCandidate JSON object.
 const char kCandidateSdpMidKey[]				= "sdpMid";
 const char kCandidateSdpMlineIndexKey[]			= "sdpMLineIndex";
@@ -147,6 +153,11 @@ const char kDataChannelChunkRequestModeKey[]				= "m";
 const char kDataChannelChunkRequestModeRequestKey[]			= "r";
 const char kDataChannelChunkRequestModeByeKey[]				= "bye";
 const char kDataChannelChunkSequenceNumberKey[]				= "i";
+const char kDataChannelChunkRequestModeProofKey[]			= "p"; // Merkle proof of a chunk, sent before the chunk itself
+const char kDataChannelChunkWantsProofKey[]					= "p"; // flag in chunk request
+const char kDataChannelChunkProofHashesKey[]				= "h";
+const char kDataChannelChunkRequestModeContentHashKey[]		= "c"; // Content hash sent by uploader which announced file before it was hashed
+const char kDataChannelChunkContentHashKey[]				= "ch";
 
 // Error codes
 const char kErrorRoomCodeDefaultRoomDisabled[]				= "default_room_disabled";
@@ -157,3 +168,4 @@ const char kErrorRoomCodeRoomJoinRequiresAccount[]			= "room_join_requires_accou
 
 // Keys used in file transfer
 const char kLCChunksKey[]				= "chunks";
+const char kLCContentHashKey[]			= "contenthash"; // optional, see FileContentHasher
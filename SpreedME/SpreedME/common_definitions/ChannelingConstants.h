@@ -90,6 +90,7 @@ extern const char kUsersKey[];
 extern const char kChatKey[];
 extern const char kTalkingKey[];
 extern const char kScreenShareKey[];
+extern const char kVideoSubscriptionKey[];
 extern const char kHelloKey[];
 extern const char kSelfKey[];
 extern const char kAliveKey[];
@@ -133,6 +134,11 @@ extern const char kByeReasonNoAnswerString[];
 extern const char kByeReasonRejectString[];
 extern const char kByeReasonAbortString[];
 
+// Keys used in VideoSubscription message
+extern const char kVideoSubscriptionActiveKey[];
+extern const char kVideoSubscriptionWidthKey[];
+extern const char kVideoSubscriptionHeightKey[];
+
 // Keys used for a IceCandidate JSON object.
 extern const char kCandidateSdpMidKey[];
 extern const char kCandidateSdpMlineIndexKey[];
@@ -149,6 +155,11 @@ extern const char kDataChannelChunkRequestModeKey[];
 extern const char kDataChannelChunkRequestModeRequestKey[];
 extern const char kDataChannelChunkRequestModeByeKey[];
 extern const char kDataChannelChunkSequenceNumberKey[];
+extern const char kDataChannelChunkRequestModeProofKey[];
+extern const char kDataChannelChunkWantsProofKey[];
+extern const char kDataChannelChunkProofHashesKey[];
+extern const char kDataChannelChunkRequestModeContentHashKey[];
+extern const char kDataChannelChunkContentHashKey[];
 
 // Error codes
 extern const char kErrorRoomCodeDefaultRoomDisabled[];
@@ -159,6 +170,7 @@ extern const char kErrorRoomCodeRoomJoinRequiresAccount[];
 
 // Keys used in file transfer
 extern const char kLCChunksKey[];
+extern const char kLCContentHashKey[];
 
 typedef enum ByeReason
 {
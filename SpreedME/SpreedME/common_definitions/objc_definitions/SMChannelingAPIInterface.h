@@ -129,6 +129,8 @@ extern NSString * const kChannelingConnectionBecomeInactiveLoginFailedReasonKey;
 - (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager hasReceivedUserSessionJoinedEvent:(NSDictionary *)info;
 - (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager hasReceivedUserSessionStatusEvent:(NSDictionary *)info;
 - (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager hasReceivedMessageWithAttestationToken:(NSDictionary *)info;
+// @events is an array of already parsed SMUserSessionEvent which should be applied in order. Called on the main thread.
+- (void)channelingManager:(id<SMChannelingAPIInterface>)channelingManager hasReceivedUserSessionEvents:(NSArray *)events;
 
 
 @end
@@ -85,6 +85,28 @@ STByteCount STAddByteCounts(const STByteCount byteCount1, const STByteCount byte
 };
 	
 	
+STByteCount STSubtractByteCounts(const STByteCount minuend, const STByteCount subtrahend)
+{
+	STByteCount difference = {0,0};
+	
+	if (minuend.numberOf64BitOverflows > subtrahend.numberOf64BitOverflows) {
+		difference.numberOf64BitOverflows = minuend.numberOf64BitOverflows - subtrahend.numberOf64BitOverflows;
+		if (minuend.bytes >= subtrahend.bytes) {
+			difference.bytes = minuend.bytes - subtrahend.bytes;
+		} else {
+			// borrow one ULLONG_MAX
+			difference.numberOf64BitOverflows -= 1;
+			difference.bytes = minuend.bytes + (ULLONG_MAX - subtrahend.bytes);
+		}
+	} else if (minuend.numberOf64BitOverflows == subtrahend.numberOf64BitOverflows &&
+			   minuend.bytes > subtrahend.bytes) {
+		difference.bytes = minuend.bytes - subtrahend.bytes;
+	}
+	
+	return difference;
+};
+	
+	
 int STIsByteCountValid(STByteCount byteCount)
 {
 	int equal = 0;
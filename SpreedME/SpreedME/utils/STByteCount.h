@@ -53,6 +53,8 @@ int STByteCountsEqual(const STByteCount byteCount1, const STByteCount byteCount2
 void STAddBytesToByteCount(uint64_t bytes, STByteCount *byteCount);
 void STAddByteCountToByteCount(const STByteCount byteCount, STByteCount *byteCountOut);
 STByteCount STAddByteCounts(const STByteCount byteCount1, const STByteCount byteCount2);
+// Returns zero if 'subtrahend' is bigger than 'minuend'
+STByteCount STSubtractByteCounts(const STByteCount minuend, const STByteCount subtrahend);
 
 // STByteCount is valid if it is not equal to what is returned from STByteCountMakeInvalid()
 int STIsByteCountValid(STByteCount byteCount);
@@ -0,0 +1,47 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import <Foundation/Foundation.h>
+
+/*
+ Dictionary of objects kept sorted by their string keys (case insensitive compare).
+ Index access is O(1), lookup by key is O(log n), insertion and removal are O(log n) search plus array shift.
+ Keys which compare as equal are treated as the same key.
+ */
+@interface STSortedIndex : NSObject
+
+- (NSUInteger)count;
+
+- (id)objectAtIndex:(NSUInteger)index;
+- (id)objectForKey:(NSString *)key;
+- (NSUInteger)indexOfKey:(NSString *)key; // returns NSNotFound if there is no such key
+
+// Returns index at which object has been inserted. Replaces object if key already exists.
+- (NSUInteger)setObject:(id)object forKey:(NSString *)key;
+// Returns index of removed object or NSNotFound if there was no such key.
+- (NSUInteger)removeObjectForKey:(NSString *)key;
+- (void)removeAllObjects;
+
+- (NSArray *)allObjects; // sorted by keys
+- (NSArray *)allKeys; // sorted
+
+@end
@@ -0,0 +1,158 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#import "STSortedIndex.h"
+
+@interface STSortedIndex ()
+{
+	NSMutableArray *_keys;
+	NSMutableArray *_objects;
+}
+
+@end
+
+
+@implementation STSortedIndex
+
+
+#pragma mark - Object lifecycle
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		_keys = [[NSMutableArray alloc] init];
+		_objects = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+
+#pragma mark - Public methods
+
+- (NSUInteger)count
+{
+	return [_keys count];
+}
+
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+	if (index >= [_objects count]) {
+		return nil;
+	}
+	
+	return [_objects objectAtIndex:index];
+}
+
+
+- (id)objectForKey:(NSString *)key
+{
+	NSUInteger index = [self indexOfKey:key];
+	if (index == NSNotFound) {
+		return nil;
+	}
+	
+	return [_objects objectAtIndex:index];
+}
+
+
+- (NSUInteger)indexOfKey:(NSString *)key
+{
+	if (!key) {
+		return NSNotFound;
+	}
+	
+	return [_keys indexOfObject:key
+				  inSortedRange:NSMakeRange(0, [_keys count])
+						options:NSBinarySearchingFirstEqual
+				usingComparator:[self keyComparator]];
+}
+
+
+- (NSUInteger)setObject:(id)object forKey:(NSString *)key
+{
+	if (!object || !key) {
+		return NSNotFound;
+	}
+	
+	NSUInteger index = [self indexOfKey:key];
+	if (index != NSNotFound) {
+		[_objects replaceObjectAtIndex:index withObject:object];
+		return index;
+	}
+	
+	index = [_keys indexOfObject:key
+				   inSortedRange:NSMakeRange(0, [_keys count])
+						 options:NSBinarySearchingInsertionIndex
+				 usingComparator:[self keyComparator]];
+	
+	[_keys insertObject:[key copy] atIndex:index];
+	[_objects insertObject:object atIndex:index];
+	
+	return index;
+}
+
+
+- (NSUInteger)removeObjectForKey:(NSString *)key
+{
+	NSUInteger index = [self indexOfKey:key];
+	if (index != NSNotFound) {
+		[_keys removeObjectAtIndex:index];
+		[_objects removeObjectAtIndex:index];
+	}
+	
+	return index;
+}
+
+
+- (void)removeAllObjects
+{
+	[_keys removeAllObjects];
+	[_objects removeAllObjects];
+}
+
+
+- (NSArray *)allObjects
+{
+	return [NSArray arrayWithArray:_objects];
+}
+
+
+- (NSArray *)allKeys
+{
+	return [NSArray arrayWithArray:_keys];
+}
+
+
+#pragma mark - Private methods
+
+- (NSComparator)keyComparator
+{
+	// Block doesn't capture anything so it is a global block and is not allocated on every call.
+	return ^NSComparisonResult(NSString *key1, NSString *key2) {
+		return [key1 caseInsensitiveCompare:key2];
+	};
+}
+
+
+@end
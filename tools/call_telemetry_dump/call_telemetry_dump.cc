@@ -0,0 +1,328 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Prints call telemetry files written by spreedme::CallTelemetryRecorder as CSV or JSON.
+//
+// Build on Linux:
+//   c++ -std=c++11 -O2 -I../../SpreedME/SpreedME/Classes/cpp/webrtc_extensions call_telemetry_dump.cc -o call_telemetry_dump
+//
+// Usage:
+//   call_telemetry_dump [--csv | --json] file [file ...]
+// Pass rotated files oldest first (e.g. telemetry.smtl.2 telemetry.smtl.1 telemetry.smtl).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "CallTelemetryFormat.h"
+
+using namespace spreedme::telemetry;
+
+
+namespace {
+
+typedef enum OutputFormat {
+	kOutputFormatCSV = 0,
+	kOutputFormatJSON,
+} OutputFormat;
+
+
+struct Row
+{
+	Row() : timestampMs(0), hasStatistics(false), iceState(-1), width(-1), height(-1), signallingEvent(-1) {};
+	
+	uint64_t timestampMs; // unix time in milliseconds
+	std::string callId;
+	std::string userId;
+	std::string recordType;
+	bool hasStatistics;
+	StatisticsRecord statistics;
+	int iceState;
+	int width;
+	int height;
+	std::string rendererName;
+	int signallingEvent;
+};
+
+
+std::string JSONEscaped(const std::string &value)
+{
+	std::string escaped;
+	for (size_t i = 0; i < value.size(); ++i) {
+		char c = value[i];
+		if (c == '"' || c == '\\') {
+			escaped.push_back('\\');
+			escaped.push_back(c);
+		} else if ((unsigned char)c < 0x20) {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			escaped.append(buffer);
+		} else {
+			escaped.push_back(c);
+		}
+	}
+	return escaped;
+}
+
+
+std::string CSVEscaped(const std::string &value)
+{
+	if (value.find_first_of(",\"\n") == std::string::npos) {
+		return value;
+	}
+	std::string escaped = "\"";
+	for (size_t i = 0; i < value.size(); ++i) {
+		if (value[i] == '"') {
+			escaped.push_back('"');
+		}
+		escaped.push_back(value[i]);
+	}
+	escaped.push_back('"');
+	return escaped;
+}
+
+
+void PrintCSVHeader()
+{
+	printf("time_ms,call_id,user_id,record,bytes_sent,bytes_received,packets_lost,rtt_ms,jitter_ms,"
+		   "send_bps,receive_bps,fps_sent,fps_received,ice_state,width,height,renderer,signalling_event\n");
+}
+
+
+void PrintCSVRow(const Row &row)
+{
+	printf("%llu,%s,%s,%s,", (unsigned long long)row.timestampMs,
+		   CSVEscaped(row.callId).c_str(), CSVEscaped(row.userId).c_str(), row.recordType.c_str());
+	
+	if (row.hasStatistics) {
+		const StatisticsRecord &s = row.statistics;
+		printf("%llu,%llu,%llu,%u,%u,%u,%u,%u,%u,",
+			   (unsigned long long)s.bytesSent, (unsigned long long)s.bytesReceived, (unsigned long long)s.packetsLost,
+			   s.rttMs, s.jitterMs, s.sendBitrate, s.receiveBitrate, s.frameRateSent, s.frameRateReceived);
+	} else {
+		printf(",,,,,,,,,");
+	}
+	
+	printf("%s,", row.iceState >= 0 ? IceStateName((uint8_t)row.iceState) : "");
+	if (row.width >= 0) {
+		printf("%d,%d,%s,", row.width, row.height, CSVEscaped(row.rendererName).c_str());
+	} else {
+		printf(",,,");
+	}
+	printf("%s\n", row.signallingEvent >= 0 ? SignallingEventName((uint8_t)row.signallingEvent) : "");
+}
+
+
+void PrintJSONRow(const Row &row, bool first)
+{
+	printf("%s\n  {\"time_ms\": %llu, \"call_id\": \"%s\", \"user_id\": \"%s\", \"record\": \"%s\"",
+		   first ? "" : ",", (unsigned long long)row.timestampMs,
+		   JSONEscaped(row.callId).c_str(), JSONEscaped(row.userId).c_str(), row.recordType.c_str());
+	
+	if (row.hasStatistics) {
+		const StatisticsRecord &s = row.statistics;
+		printf(", \"bytes_sent\": %llu, \"bytes_received\": %llu, \"packets_lost\": %llu"
+			   ", \"rtt_ms\": %u, \"jitter_ms\": %u, \"send_bps\": %u, \"receive_bps\": %u"
+			   ", \"fps_sent\": %u, \"fps_received\": %u",
+			   (unsigned long long)s.bytesSent, (unsigned long long)s.bytesReceived, (unsigned long long)s.packetsLost,
+			   s.rttMs, s.jitterMs, s.sendBitrate, s.receiveBitrate, s.frameRateSent, s.frameRateReceived);
+	}
+	if (row.iceState >= 0) {
+		printf(", \"ice_state\": \"%s\"", IceStateName((uint8_t)row.iceState));
+	}
+	if (row.width >= 0) {
+		printf(", \"width\": %d, \"height\": %d, \"renderer\": \"%s\"", row.width, row.height, JSONEscaped(row.rendererName).c_str());
+	}
+	if (row.signallingEvent >= 0) {
+		printf(", \"signalling_event\": \"%s\"", SignallingEventName((uint8_t)row.signallingEvent));
+	}
+	printf("}");
+}
+
+
+bool ReadShortString(const uint8_t *data, size_t size, std::string *value)
+{
+	if (size < 1 || size < (size_t)data[0] + 1) {
+		return false;
+	}
+	value->assign((const char *)data + 1, data[0]);
+	return true;
+}
+
+
+// Returns false if file is not a telemetry file. Truncated files are read up to the last complete record.
+bool DumpFile(const char *path, OutputFormat format, bool *firstRow)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	
+	std::vector<uint8_t> content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	const uint8_t *data = content.empty() ? NULL : &content[0];
+	size_t size = content.size();
+	
+	if (size < kFileHeaderFixedSize || memcmp(data, kFileMagic, sizeof(kFileMagic)) != 0) {
+		fprintf(stderr, "%s is not a call telemetry file\n", path);
+		return false;
+	}
+	
+	uint16_t version = (uint16_t)ReadLittleEndian(data + 4, 2);
+	if (version != kFormatVersion) {
+		fprintf(stderr, "%s has unsupported version %u\n", path, version);
+		return false;
+	}
+	
+	uint64_t startTimeMs = ReadLittleEndian(data + 8, 8) * 1000;
+	std::string callId;
+	if (!ReadShortString(data + 16, size - 16, &callId)) {
+		fprintf(stderr, "%s has broken header\n", path);
+		return false;
+	}
+	
+	size_t offset = kFileHeaderFixedSize + callId.size();
+	std::vector<std::string> connections(kNoConnection);
+	
+	RecordHeader header;
+	while (ParseRecordHeader(data + offset, size - offset, &header)) {
+		offset += kRecordHeaderSize;
+		if (size - offset < header.payloadLength) {
+			fprintf(stderr, "%s is truncated\n", path);
+			break;
+		}
+		
+		const uint8_t *payload = data + offset;
+		offset += header.payloadLength;
+		
+		Row row;
+		row.timestampMs = startTimeMs + header.timestampMs;
+		row.callId = callId;
+		if (header.connection < connections.size()) {
+			row.userId = connections[header.connection];
+		}
+		
+		switch (header.type) {
+			case kRecordTypeConnection:
+				if (header.connection < connections.size()) {
+					ReadShortString(payload, header.payloadLength, &connections[header.connection]);
+				}
+				continue; // connection records only declare user ids
+				
+			case kRecordTypeStatistics:
+				row.recordType = "statistics";
+				row.hasStatistics = ParseStatisticsRecord(payload, header.payloadLength, &row.statistics);
+				break;
+				
+			case kRecordTypeIceState:
+				row.recordType = "ice_state";
+				if (header.payloadLength >= 1) {
+					row.iceState = payload[0];
+				}
+				break;
+				
+			case kRecordTypeFrameSize:
+				row.recordType = "frame_size";
+				if (header.payloadLength >= 4) {
+					row.width = (int)ReadLittleEndian(payload, 2);
+					row.height = (int)ReadLittleEndian(payload + 2, 2);
+					ReadShortString(payload + 4, header.payloadLength - 4, &row.rendererName);
+				}
+				break;
+				
+			case kRecordTypeSignalling:
+				row.recordType = "signalling";
+				if (header.payloadLength >= 1) {
+					row.signallingEvent = payload[0];
+				}
+				break;
+				
+			default:
+				continue; // unknown records are skipped to stay compatible with newer recorders
+		}
+		
+		if (format == kOutputFormatCSV) {
+			PrintCSVRow(row);
+		} else {
+			PrintJSONRow(row, *firstRow);
+		}
+		*firstRow = false;
+	}
+	
+	return true;
+}
+
+
+void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [--csv | --json] file [file ...]\n", name);
+}
+	
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+	OutputFormat format = kOutputFormatCSV;
+	std::vector<const char *> paths;
+	
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--csv") == 0) {
+			format = kOutputFormatCSV;
+		} else if (strcmp(argv[i], "--json") == 0) {
+			format = kOutputFormatJSON;
+		} else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+			PrintUsage(argv[0]);
+			return 0;
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	
+	if (paths.empty()) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	
+	if (format == kOutputFormatCSV) {
+		PrintCSVHeader();
+	} else {
+		printf("[");
+	}
+	
+	bool firstRow = true;
+	bool success = true;
+	for (size_t i = 0; i < paths.size(); ++i) {
+		success = DumpFile(paths[i], format, &firstRow) && success;
+	}
+	
+	if (format == kOutputFormatJSON) {
+		printf("\n]\n");
+	}
+	
+	return success ? 0 : 2;
+}
@@ -0,0 +1,111 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Linux stand-in for the part of CommonCrypto used by SegmentedFileCrypto (AES-256 in CTR mode), backed by OpenSSL.
+
+#ifndef __SpreedME__bench_compat_CommonCryptor__
+#define __SpreedME__bench_compat_CommonCryptor__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define OPENSSL_SUPPRESS_DEPRECATED // CommonHMAC.h needs it before the first OpenSSL header
+#include <openssl/evp.h>
+
+#define kCCBlockSizeAES128 16
+#define kCCKeySizeAES256 32
+
+typedef int32_t CCCryptorStatus;
+enum {
+	kCCSuccess = 0,
+	kCCParamError = -4300,
+	kCCUnimplemented = -4305,
+};
+
+typedef uint32_t CCOperation;
+enum {
+	kCCEncrypt = 0,
+	kCCDecrypt,
+};
+
+typedef uint32_t CCMode;
+enum {
+	kCCModeCTR = 4,
+};
+
+typedef uint32_t CCAlgorithm;
+enum {
+	kCCAlgorithmAES = 0,
+};
+
+typedef uint32_t CCPadding;
+enum {
+	ccNoPadding = 0,
+};
+
+typedef uint32_t CCModeOptions;
+enum {
+	kCCModeOptionCTR_BE = 2,
+};
+
+typedef EVP_CIPHER_CTX *CCCryptorRef;
+
+// CTR mode of OpenSSL counts the whole block big endian, like kCCModeOptionCTR_BE.
+static inline CCCryptorStatus CCCryptorCreateWithMode(CCOperation op, CCMode mode, CCAlgorithm alg, CCPadding padding,
+													  const void *iv, const void *key, size_t keyLength,
+													  const void *tweak, size_t tweakLength, int numRounds,
+													  CCModeOptions options, CCCryptorRef *cryptorRef)
+{
+	if (mode != kCCModeCTR || alg != kCCAlgorithmAES || keyLength != kCCKeySizeAES256 || tweak || options != kCCModeOptionCTR_BE) {
+		return kCCUnimplemented;
+	}
+	
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	if (!ctx || EVP_CipherInit_ex(ctx, EVP_aes_256_ctr(), NULL, (const unsigned char *)key, (const unsigned char *)iv, op == kCCEncrypt) != 1) {
+		EVP_CIPHER_CTX_free(ctx);
+		return kCCParamError;
+	}
+	
+	*cryptorRef = ctx;
+	return kCCSuccess;
+}
+
+static inline CCCryptorStatus CCCryptorUpdate(CCCryptorRef cryptorRef, const void *dataIn, size_t dataInLength,
+											  void *dataOut, size_t dataOutAvailable, size_t *dataOutMoved)
+{
+	int moved = 0;
+	if (dataOutAvailable < dataInLength ||
+		EVP_CipherUpdate(cryptorRef, (unsigned char *)dataOut, &moved, (const unsigned char *)dataIn, (int)dataInLength) != 1) {
+		return kCCParamError;
+	}
+	
+	*dataOutMoved = (size_t)moved;
+	return kCCSuccess;
+}
+
+static inline CCCryptorStatus CCCryptorRelease(CCCryptorRef cryptorRef)
+{
+	EVP_CIPHER_CTX_free(cryptorRef);
+	return kCCSuccess;
+}
+
+#endif /* defined(__SpreedME__bench_compat_CommonCryptor__) */
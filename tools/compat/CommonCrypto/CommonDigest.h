@@ -0,0 +1,41 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Linux stand-in for the part of CommonCrypto used by MerkleTree and FileContentHasher, backed by OpenSSL.
+
+#ifndef __SpreedME__bench_compat_CommonDigest__
+#define __SpreedME__bench_compat_CommonDigest__
+
+#define OPENSSL_SUPPRESS_DEPRECATED // low level SHA256 functions match CommonCrypto ones
+#include <openssl/sha.h>
+
+#define CC_SHA256_DIGEST_LENGTH SHA256_DIGEST_LENGTH
+
+typedef SHA256_CTX CC_SHA256_CTX;
+typedef unsigned int CC_LONG;
+
+static inline int CC_SHA256_Init(CC_SHA256_CTX *c) {return SHA256_Init(c);}
+static inline int CC_SHA256_Update(CC_SHA256_CTX *c, const void *data, CC_LONG len) {return SHA256_Update(c, data, len);}
+static inline int CC_SHA256_Final(unsigned char *md, CC_SHA256_CTX *c) {return SHA256_Final(md, c);}
+static inline unsigned char *CC_SHA256(const void *data, CC_LONG len, unsigned char *md) {return SHA256((const unsigned char *)data, len, md);}
+
+#endif /* defined(__SpreedME__bench_compat_CommonDigest__) */
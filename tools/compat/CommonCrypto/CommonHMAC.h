@@ -0,0 +1,74 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Linux stand-in for the part of CommonCrypto used by SegmentedFileCrypto (HMAC-SHA256), backed by OpenSSL.
+
+#ifndef __SpreedME__bench_compat_CommonHMAC__
+#define __SpreedME__bench_compat_CommonHMAC__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <CommonCrypto/CommonDigest.h>
+
+#define OPENSSL_SUPPRESS_DEPRECATED // HMAC_CTX functions match CommonCrypto ones
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+typedef uint32_t CCHmacAlgorithm;
+enum {
+	kCCHmacAlgSHA256 = 2,
+};
+
+// Context is freed by CCHmacFinal, every CCHmacInit has to be finished.
+typedef struct CCHmacContext
+{
+	HMAC_CTX *ctx;
+}
+CCHmacContext;
+
+static inline void CCHmacInit(CCHmacContext *ctx, CCHmacAlgorithm algorithm, const void *key, size_t keyLength)
+{
+	ctx->ctx = HMAC_CTX_new();
+	HMAC_Init_ex(ctx->ctx, key, (int)keyLength, EVP_sha256(), NULL);
+}
+
+static inline void CCHmacUpdate(CCHmacContext *ctx, const void *data, size_t dataLength)
+{
+	HMAC_Update(ctx->ctx, (const unsigned char *)data, dataLength);
+}
+
+static inline void CCHmacFinal(CCHmacContext *ctx, void *macOut)
+{
+	unsigned int length = 0;
+	HMAC_Final(ctx->ctx, (unsigned char *)macOut, &length);
+	HMAC_CTX_free(ctx->ctx);
+	ctx->ctx = NULL;
+}
+
+static inline void CCHmac(CCHmacAlgorithm algorithm, const void *key, size_t keyLength, const void *data, size_t dataLength, void *macOut)
+{
+	unsigned int length = 0;
+	HMAC(EVP_sha256(), key, (int)keyLength, (const unsigned char *)data, dataLength, (unsigned char *)macOut, &length);
+}
+
+#endif /* defined(__SpreedME__bench_compat_CommonHMAC__) */
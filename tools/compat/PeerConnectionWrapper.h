@@ -0,0 +1,198 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Fake spreedme::PeerConnectionWrapper with the part of the interface SignallingHandler and token based
+// connections handlers (FileUploader, FileDownloader) use. It has no peer connection.
+// Data channels are given to it by whoever creates it, so benchmarks decide where sent data goes, and they report
+// state changes and received data thru OnDataChannelStateChange/OnDataChannelMessage like webrtc observers do.
+// Negotiation methods only move signalling state, subclasses which connect wrappers to each other override them.
+// Wrapper created with hasDataChannel has an opened default channel which only counts sent data.
+// Put compat directory before Classes/cpp/webrtc_extensions in include paths so this one is found instead of the real one.
+
+#ifndef __SpreedME__bench_compat_PeerConnectionWrapper__
+#define __SpreedME__bench_compat_PeerConnectionWrapper__
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+
+#include <talk/app/webrtc/datachannelinterface.h>
+#include <talk/app/webrtc/mediastreaminterface.h>
+#include <talk/app/webrtc/peerconnectioninterface.h>
+#include <webrtc/base/scoped_ref_ptr.h>
+
+#include "NetworkDataAccounting.h"
+#include "utils.h"
+#include "WebrtcCommonDefinitions.h"
+
+namespace spreedme {
+
+const char kDefaultDataChannelLabel[] = "default"; // same as in PeerConnectionWrapper.cc
+
+
+class PeerConnectionWrapper;
+
+// Same as the real one without optional media and statistics callbacks.
+class PeerConnectionWrapperDelegateInterface {
+	
+public:
+	virtual void IceConnectionStateChanged(webrtc::PeerConnectionInterface::IceConnectionState new_state, PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	virtual void SignallingStateChanged(webrtc::PeerConnectionInterface::SignalingState new_state, PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	virtual void PeerConnectionObjectHasBeenCreated(PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	
+	virtual void AnswerIsReadyToBeSent(const std::string &sdType, const std::string &sdp, PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	virtual void OfferIsReadyToBeSent(const std::string &sdType, const std::string &sdp, PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	virtual void CandidateIsReadyToBeSent(IceCandidateStringRepresentation *candidateStringRep, PeerConnectionWrapper *peerConnectionWrapper) = 0;
+	
+	virtual void DataChannelStateChanged(webrtc::DataChannelInterface::DataState state, webrtc::DataChannelInterface *data_channel, PeerConnectionWrapper *wrapper) = 0;
+	
+	virtual void ReceivedDataChannelData(webrtc::DataBuffer *buffer,
+										 webrtc::DataChannelInterface *data_channel,
+										 PeerConnectionWrapper *wrapper) = 0;
+	
+	virtual ~PeerConnectionWrapperDelegateInterface() {};
+};
+
+
+class PeerConnectionWrapper
+{
+public:
+	PeerConnectionWrapper(const std::string &factoryId, PeerConnectionWrapperDelegateInterface *delegate) :
+		countingDataChannel_(kDefaultDataChannelLabel), factoryId_(factoryId), delegate_(delegate),
+		signalingState_(webrtc::PeerConnectionInterface::kStable), messagesSent_(0), bytesSent_(0) {};
+	PeerConnectionWrapper(const std::string &userId, const std::string &factoryId, bool hasDataChannel) :
+		countingDataChannel_(kDefaultDataChannelLabel), userId_(userId), factoryId_(factoryId), delegate_(NULL),
+		signalingState_(webrtc::PeerConnectionInterface::kStable), messagesSent_(0), bytesSent_(0)
+	{
+		if (hasDataChannel) {
+			this->AddDataChannel(&countingDataChannel_);
+		}
+	};
+	virtual ~PeerConnectionWrapper() {};
+	
+	virtual void Close() {signalingState_ = webrtc::PeerConnectionInterface::kClosed; dataChannels_.clear();};
+	virtual void Shutdown() {delegate_ = NULL; this->Close();};
+	
+	// Communication
+	virtual void CreateOffer(const std::string recepientId) {userId_ = recepientId; signalingState_ = webrtc::PeerConnectionInterface::kHaveLocalOffer;};
+	virtual void SetupRemoteAnswer(const std::string &sdp) {signalingState_ = webrtc::PeerConnectionInterface::kStable;};
+	virtual void SetupRemoteOffer(const std::string &sdp) {signalingState_ = webrtc::PeerConnectionInterface::kStable;};
+	virtual void SetupRemoteCandidate(const std::string &sdp_mid, int sdp_mline_index, const std::string &sdp) {};
+	
+	// Data channels. Wrapper doesn't own them.
+	virtual void AddDataChannel(webrtc::DataChannelInterface *dataChannel) {dataChannels_[dataChannel->label()] = dataChannel;};
+	virtual void SendData(const std::string &msg) {this->SendBuffer(webrtc::DataBuffer(msg), kDefaultDataChannelLabel);};
+	virtual void SendData(const void *data, size_t size) {this->SendData(data, size, kDefaultDataChannelLabel);};
+	virtual void SendData(const std::string &msg, const std::string &dataChannelName) {this->SendBuffer(webrtc::DataBuffer(msg), dataChannelName);};
+	virtual void SendData(const void *data, size_t size, const std::string &dataChannelName)
+	{
+		this->SendBuffer(webrtc::DataBuffer(rtc::Buffer(data, size), true), dataChannelName);
+	};
+	
+	virtual bool HasOpenedDataChannel() {return !this->FirstOpenedDataChannelName().empty();};
+	virtual std::string FirstOpenedDataChannelName()
+	{
+		for (DataChannels::iterator it = dataChannels_.begin(); it != dataChannels_.end(); ++it) {
+			if (it->second->state() == webrtc::DataChannelInterface::kOpen) {
+				return it->first;
+			}
+		}
+		return std::string();
+	};
+	virtual rtc::scoped_refptr<webrtc::DataChannelInterface> DataChannelForName(const std::string &name)
+	{
+		DataChannels::iterator it = dataChannels_.find(name);
+		return it != dataChannels_.end() ? it->second : NULL;
+	};
+	
+	// proxy DataChannelObserver implementation, wrapper takes ownership of buffer
+	virtual void OnDataChannelStateChange(webrtc::DataChannelInterface *data_channel, webrtc::DataChannelInterface::DataState state)
+	{
+		if (delegate_) {
+			delegate_->DataChannelStateChanged(state, data_channel, this);
+		}
+	};
+	virtual void OnDataChannelMessage(webrtc::DataChannelInterface *data_channel, webrtc::DataBuffer *buffer)
+	{
+		if (delegate_) {
+			delegate_->ReceivedDataChannelData(buffer, data_channel, this);
+		} else {
+			delete buffer;
+		}
+	};
+	
+	virtual webrtc::PeerConnectionInterface::SignalingState signalingState() {return signalingState_;};
+	
+	virtual void AddLocalStream(rtc::scoped_refptr<webrtc::MediaStreamInterface> stream, const webrtc::MediaConstraintsInterface* constraints) {};
+	
+	virtual void SetCustomIdentifier(const std::string &customIdentifier) {customIdentifier_ = customIdentifier;};
+	virtual std::string customIdentifier() {return customIdentifier_;};
+	
+	virtual void SetUserId(const std::string &userId) {userId_ = userId;};
+	virtual std::string userId() {return userId_;};
+	
+	virtual std::string factoryId() {return factoryId_;};
+	
+	virtual void SetNetworkDataService(NetworkDataService service) {};
+	
+	size_t messagesSent() const {return messagesSent_;};
+	size_t bytesSent() const {return bytesSent_;};
+	
+protected:
+	typedef std::map<std::string, webrtc::DataChannelInterface *> DataChannels;
+	
+	void SendBuffer(const webrtc::DataBuffer &buffer, const std::string &dataChannelName)
+	{
+		DataChannels::iterator it = dataChannels_.find(dataChannelName);
+		if (it != dataChannels_.end() && it->second->state() == webrtc::DataChannelInterface::kOpen && it->second->Send(buffer)) {
+			++messagesSent_;
+			bytesSent_ += buffer.data.length();
+		}
+	};
+	
+	class CountingDataChannel : public webrtc::DataChannelInterface
+	{
+	public:
+		explicit CountingDataChannel(const std::string &label) : label_(label) {};
+		virtual std::string label() const {return label_;};
+		virtual DataState state() const {return kOpen;};
+		virtual bool Send(const webrtc::DataBuffer &buffer) {return true;};
+		
+	private:
+		std::string label_;
+	};
+	
+	CountingDataChannel countingDataChannel_;
+	DataChannels dataChannels_;
+	std::string userId_;
+	std::string factoryId_;
+	std::string customIdentifier_;
+	PeerConnectionWrapperDelegateInterface *delegate_; // We do not own it!
+	webrtc::PeerConnectionInterface::SignalingState signalingState_;
+	size_t messagesSent_;
+	size_t bytesSent_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__bench_compat_PeerConnectionWrapper__) */
@@ -0,0 +1,52 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Fake spreedme::PeerConnectionWrapperFactory with the part of the interface token based connections handlers use.
+// Benchmarks subclass it and hand out wrappers which are connected the way they simulate.
+// Put compat directory before Classes/cpp/webrtc_extensions in include paths so this one is found instead of the real one.
+
+#ifndef __SpreedME__bench_compat_PeerConnectionWrapperFactory__
+#define __SpreedME__bench_compat_PeerConnectionWrapperFactory__
+
+#include <string>
+
+#include <talk/app/webrtc/mediastreaminterface.h>
+#include <webrtc/base/scoped_ref_ptr.h>
+
+#include "PeerConnectionWrapper.h"
+
+namespace spreedme {
+
+class PeerConnectionWrapperFactory {
+public:
+	virtual ~PeerConnectionWrapperFactory() {};
+	
+	virtual rtc::scoped_refptr<PeerConnectionWrapper> CreateSpreedPeerConnection(const std::string &userId,
+																				 PeerConnectionWrapperDelegateInterface *pcDelegate = NULL) = 0;
+	
+	// Token based connections carry no media
+	virtual rtc::scoped_refptr<webrtc::MediaStreamInterface> CreateLocalStream(bool withAudio = false, bool withVideo = false) {return NULL;};
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__bench_compat_PeerConnectionWrapperFactory__) */
@@ -0,0 +1,50 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// mach_absolute_time is declared here and defined by the benchmark, like rtc::Time in webrtc/base/timeutils.h.
+// Benchmark's time base is nanoseconds.
+
+#ifndef __SpreedME__bench_compat_mach_time__
+#define __SpreedME__bench_compat_mach_time__
+
+#include <stdint.h>
+
+typedef int kern_return_t;
+#define KERN_SUCCESS 0
+
+typedef struct mach_timebase_info
+{
+	uint32_t numer;
+	uint32_t denom;
+}
+mach_timebase_info_data_t;
+
+uint64_t mach_absolute_time(void);
+
+static inline kern_return_t mach_timebase_info(mach_timebase_info_data_t *info)
+{
+	info->numer = 1;
+	info->denom = 1;
+	return KERN_SUCCESS;
+}
+
+#endif /* defined(__SpreedME__bench_compat_mach_time__) */
@@ -0,0 +1,32 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// clonefile is weak and never defined on Linux, so ClonedFileChunkSource reads original file directly.
+
+#ifndef __SpreedME__bench_compat_clonefile__
+#define __SpreedME__bench_compat_clonefile__
+
+#include <stdint.h>
+
+extern "C" int clonefile(const char *src, const char *dst, uint32_t flags) __attribute__((weak));
+
+#endif /* defined(__SpreedME__bench_compat_clonefile__) */
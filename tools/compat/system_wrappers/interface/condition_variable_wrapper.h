@@ -0,0 +1,59 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal webrtc::ConditionVariableWrapper on top of compat CriticalSectionWrapper.
+
+#ifndef __SpreedME__bench_compat_condition_variable_wrapper__
+#define __SpreedME__bench_compat_condition_variable_wrapper__
+
+#include <condition_variable>
+
+#include "critical_section_wrapper.h"
+
+namespace webrtc {
+
+class ConditionVariableWrapper
+{
+public:
+	static ConditionVariableWrapper *CreateConditionVariable() {return new ConditionVariableWrapper();};
+	
+	void SleepCS(CriticalSectionWrapper &critSect) {
+		CriticalSectionLockable lockable(critSect);
+		condition_.wait(lockable);
+	};
+	void Wake() {condition_.notify_one();};
+	void WakeAll() {condition_.notify_all();};
+	
+private:
+	struct CriticalSectionLockable {
+		explicit CriticalSectionLockable(CriticalSectionWrapper &critSect) : critSect_(critSect) {};
+		void lock() {critSect_.Enter();};
+		void unlock() {critSect_.Leave();};
+		CriticalSectionWrapper &critSect_;
+	};
+	
+	std::condition_variable_any condition_;
+};
+
+} // namespace webrtc
+
+#endif /* defined(__SpreedME__bench_compat_condition_variable_wrapper__) */
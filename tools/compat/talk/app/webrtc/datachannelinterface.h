@@ -0,0 +1,81 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal webrtc::DataBuffer and webrtc::DataChannelInterface, enough to build SignallingHandler and file transfers.
+
+#ifndef __SpreedME__bench_compat_datachannelinterface__
+#define __SpreedME__bench_compat_datachannelinterface__
+
+#include <sstream> // SignallingHandler gets it thru webrtc headers
+#include <string>
+
+namespace rtc {
+
+class Buffer
+{
+public:
+	explicit Buffer(const std::string &data) : data_(data) {};
+	Buffer(const void *data, size_t size) : data_((const char *)data, size) {};
+	
+	const char *data() const {return data_.data();};
+	size_t length() const {return data_.size();};
+	
+private:
+	std::string data_;
+};
+
+} // namespace rtc
+
+
+namespace webrtc {
+
+struct DataBuffer
+{
+	DataBuffer(const std::string &text) : data(text), binary(false) {};
+	DataBuffer(const std::string &data, bool binary) : data(data), binary(binary) {};
+	DataBuffer(const rtc::Buffer &data, bool binary) : data(data), binary(binary) {};
+	
+	rtc::Buffer data;
+	bool binary;
+};
+
+
+class DataChannelInterface
+{
+public:
+	enum DataState {
+		kConnecting,
+		kOpen,
+		kClosing,
+		kClosed
+	};
+	
+	virtual ~DataChannelInterface() {};
+	
+	virtual std::string label() const = 0;
+	virtual DataState state() const = 0;
+	virtual bool Send(const DataBuffer &buffer) = 0;
+};
+
+} // namespace webrtc
+
+#endif /* defined(__SpreedME__bench_compat_datachannelinterface__) */
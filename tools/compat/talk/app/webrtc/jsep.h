@@ -0,0 +1,43 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal webrtc::SessionDescriptionInterface, enough to build SignallingHandler.
+
+#ifndef __SpreedME__bench_compat_jsep__
+#define __SpreedME__bench_compat_jsep__
+
+#include <string>
+
+namespace webrtc {
+
+class SessionDescriptionInterface
+{
+public:
+	virtual ~SessionDescriptionInterface() {};
+	
+	virtual std::string type() const = 0;
+	virtual bool ToString(std::string *out) const = 0;
+};
+
+} // namespace webrtc
+
+#endif /* defined(__SpreedME__bench_compat_jsep__) */
@@ -0,0 +1,58 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal webrtc::VideoRendererInterface, enough to build spreedme::VideoRenderer,
+// and webrtc::MediaStreamInterface which token based connections add to their wrappers.
+
+#ifndef __SpreedME__bench_compat_mediastreaminterface__
+#define __SpreedME__bench_compat_mediastreaminterface__
+
+#include <string>
+
+#include <talk/media/base/videoframe.h>
+#include <webrtc/base/refcount.h>
+
+namespace webrtc {
+
+class VideoRendererInterface
+{
+public:
+	virtual void SetSize(int width, int height) = 0;
+	virtual void RenderFrame(const cricket::VideoFrame *frame) = 0;
+	
+protected:
+	virtual ~VideoRendererInterface() {};
+};
+
+
+class MediaStreamInterface : public rtc::RefCountInterface
+{
+public:
+	virtual std::string label() const = 0;
+};
+
+
+class MediaConstraintsInterface;
+
+} // namespace webrtc
+
+#endif /* defined(__SpreedME__bench_compat_mediastreaminterface__) */
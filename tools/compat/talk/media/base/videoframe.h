@@ -0,0 +1,93 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Minimal cricket::VideoFrame with I420 planes in memory, enough to run VideoFrameSlot and VideoRenderer headless.
+
+#ifndef __SpreedME__bench_compat_videoframe__
+#define __SpreedME__bench_compat_videoframe__
+
+#include <string.h>
+
+#include <vector>
+
+#include <webrtc/base/basictypes.h>
+
+namespace cricket {
+
+class VideoFrame
+{
+public:
+	VideoFrame(int width, int height, int64 elapsedTime, int64 timeStamp) :
+		width_(width), height_(height), elapsedTime_(elapsedTime), timeStamp_(timeStamp),
+		y_((size_t)width * height), u_((size_t)((width + 1) / 2) * ((height + 1) / 2)), v_(u_.size()) {};
+	virtual ~VideoFrame() {};
+	
+	virtual VideoFrame *CreateEmptyFrame(int width, int height, size_t pixelWidth, size_t pixelHeight,
+										 int64 elapsedTime, int64 timeStamp) const
+	{
+		return new VideoFrame(width, height, elapsedTime, timeStamp);
+	};
+	
+	bool CopyToFrame(VideoFrame *destination) const
+	{
+		if (!destination || destination->width_ != width_ || destination->height_ != height_) {
+			return false;
+		}
+		memcpy(&destination->y_[0], &y_[0], y_.size());
+		memcpy(&destination->u_[0], &u_[0], u_.size());
+		memcpy(&destination->v_[0], &v_[0], v_.size());
+		return true;
+	};
+	
+	size_t GetWidth() const {return width_;};
+	size_t GetHeight() const {return height_;};
+	size_t GetPixelWidth() const {return 1;};
+	size_t GetPixelHeight() const {return 1;};
+	
+	const uint8 *GetYPlane() const {return &y_[0];};
+	const uint8 *GetUPlane() const {return &u_[0];};
+	const uint8 *GetVPlane() const {return &v_[0];};
+	uint8 *GetYPlane() {return &y_[0];};
+	uint8 *GetUPlane() {return &u_[0];};
+	uint8 *GetVPlane() {return &v_[0];};
+	int32 GetYPitch() const {return width_;};
+	int32 GetUPitch() const {return (width_ + 1) / 2;};
+	int32 GetVPitch() const {return (width_ + 1) / 2;};
+	
+	int64 GetElapsedTime() const {return elapsedTime_;};
+	void SetElapsedTime(int64 elapsedTime) {elapsedTime_ = elapsedTime;};
+	int64 GetTimeStamp() const {return timeStamp_;};
+	void SetTimeStamp(int64 timeStamp) {timeStamp_ = timeStamp;};
+	
+private:
+	int width_;
+	int height_;
+	int64 elapsedTime_;
+	int64 timeStamp_;
+	std::vector<uint8> y_;
+	std::vector<uint8> u_;
+	std::vector<uint8> v_;
+};
+
+} // namespace cricket
+
+#endif /* defined(__SpreedME__bench_compat_videoframe__) */
@@ -0,0 +1,52 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::CreateRandomString for tokens and wrapper ids. Deterministic, so benchmark runs are repeatable.
+
+#ifndef __SpreedME__bench_compat_helpers__
+#define __SpreedME__bench_compat_helpers__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace rtc {
+
+inline bool CreateRandomString(size_t length, std::string *str)
+{
+	static const char kCharacters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	static uint32_t state = 2463534242U;
+	
+	str->clear();
+	for (size_t i = 0; i < length; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		str->push_back(kCharacters[state % 64]);
+	}
+	return true;
+}
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_helpers__) */
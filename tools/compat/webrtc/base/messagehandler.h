@@ -0,0 +1,66 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::MessageHandler and message data types, enough for handlers posted thru spreedme::MessageQueueInterface.
+
+#ifndef __SpreedME__bench_compat_messagehandler__
+#define __SpreedME__bench_compat_messagehandler__
+
+#include <webrtc/base/basictypes.h>
+
+namespace rtc {
+
+class MessageData
+{
+public:
+	MessageData() {};
+	virtual ~MessageData() {};
+};
+
+
+template <class T>
+class TypedMessageData : public MessageData
+{
+public:
+	explicit TypedMessageData(const T &data) : data_(data) {};
+	
+	const T &data() const {return data_;};
+	T &data() {return data_;};
+	
+private:
+	T data_;
+};
+
+
+struct Message;
+
+class MessageHandler
+{
+public:
+	virtual ~MessageHandler() {};
+	
+	virtual void OnMessage(Message *msg) = 0;
+};
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_messagehandler__) */
@@ -0,0 +1,56 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::Message, enough to implement spreedme::MessageQueueInterface without rtc::Thread.
+
+#ifndef __SpreedME__bench_compat_messagequeue__
+#define __SpreedME__bench_compat_messagequeue__
+
+#include <list>
+
+#include <webrtc/base/basictypes.h>
+#include <webrtc/base/messagehandler.h>
+
+namespace rtc {
+
+const uint32 MQID_ANY = static_cast<uint32>(-1);
+
+
+struct Message
+{
+	Message() : phandler(NULL), message_id(0), pdata(NULL) {};
+	
+	bool Match(MessageHandler *handler, uint32 id) const
+	{
+		return (handler == NULL || handler == phandler) && (id == MQID_ANY || id == message_id);
+	};
+	
+	MessageHandler *phandler;
+	uint32 message_id;
+	MessageData *pdata;
+};
+
+typedef std::list<Message> MessageList;
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_messagequeue__) */
@@ -0,0 +1,71 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::RefCountInterface and rtc::RefCountedObject, used to create FileUploader and FileDownloader like FileSharingManager does.
+// Our scoped_refptr doesn't count references, so owners call AddRef() and Release() themselves.
+
+#ifndef __SpreedME__bench_compat_refcount__
+#define __SpreedME__bench_compat_refcount__
+
+#include <utility>
+
+#include <webrtc/base/scoped_ref_ptr.h>
+
+namespace rtc {
+
+class RefCountInterface
+{
+public:
+	virtual int AddRef() = 0;
+	virtual int Release() = 0;
+	
+protected:
+	virtual ~RefCountInterface() {};
+};
+
+
+template <class T>
+class RefCountedObject : public T
+{
+public:
+	template <class... Args>
+	explicit RefCountedObject(Args&&... args) : T(std::forward<Args>(args)...), ref_count_(0) {};
+	
+	virtual int AddRef() {return ++ref_count_;};
+	virtual int Release()
+	{
+		int count = --ref_count_;
+		if (count == 0) {
+			delete this;
+		}
+		return count;
+	};
+	
+protected:
+	virtual ~RefCountedObject() {};
+	
+	int ref_count_;
+};
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_refcount__) */
@@ -0,0 +1,47 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::scoped_refptr without reference counting, benchmarks keep their objects alive themselves.
+
+#ifndef __SpreedME__bench_compat_scoped_ref_ptr__
+#define __SpreedME__bench_compat_scoped_ref_ptr__
+
+namespace rtc {
+
+template <class T>
+class scoped_refptr
+{
+public:
+	scoped_refptr() : ptr_(0) {};
+	scoped_refptr(T *p) : ptr_(p) {};
+	
+	T *get() const {return ptr_;};
+	operator T*() const {return ptr_;};
+	T *operator->() const {return ptr_;};
+	
+private:
+	T *ptr_;
+};
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_scoped_ref_ptr__) */
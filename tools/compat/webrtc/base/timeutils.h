@@ -0,0 +1,39 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// rtc::Time is declared here and defined by the benchmark, so code which takes its time from it runs on the benchmark's clock.
+
+#ifndef __SpreedME__bench_compat_timeutils__
+#define __SpreedME__bench_compat_timeutils__
+
+#include <webrtc/base/basictypes.h>
+
+namespace rtc {
+
+// Milliseconds, wraps around like the real one.
+uint32 Time();
+
+inline int32 TimeDiff(uint32 later, uint32 earlier) {return (int32)(later - earlier);}
+
+} // namespace rtc
+
+#endif /* defined(__SpreedME__bench_compat_timeutils__) */
@@ -0,0 +1,1198 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Loopback benchmark of file transfers between the real FileUploader and FileDownloader.
+//
+// Both run in one process on one thread. Every side (uploader's device and downloader's device) has its own
+// SignallingHandler, worker and callbacks queues and PeerConnectionWrapperFactory, like FileSharingManager sets them up.
+// Queues are MessageQueueInterface implementations over one event loop with simulated clock, rtc::Time and
+// mach_absolute_time are defined below to return that clock, so throttling, token buckets and timeouts run on it.
+// Messages the signalling handlers send to the server are delivered to the other side's handler half RTT later.
+// Peer connection wrappers are the compat fakes (tools/compat/PeerConnectionWrapper.h): offer and answer carry
+// only id of the wrapper, data channels open --setup-rtts - 1 round trips after the answer arrives (offer and answer
+// take one) and their messages go thru a simulated link with given bandwidth, RTT, packet loss (every lost packet
+// costs one extra RTT, like fast retransmit) and reordering. Channels of all connections share the link and each
+// of them is ordered, a late message holds back later ones on the same channel.
+//
+// Transfer times are deterministic for given --seed. CPU time and allocations are real and are counted in everything
+// the event loop runs: uploader and downloader, signalling, fake channels (they copy every message once, like
+// webrtc does) and file reads and writes (they mostly hit page cache). Creating the shared file, hashing it for the
+// content index before sharing and checking the downloaded file are not counted, hashing has its own column.
+//
+// Build on Linux (OpenSSL and jsoncpp are needed), from this directory:
+//   cc -O2 -include stdint.h -c ../../SpreedME/SpreedME/libs/crc32/crc32.c ../../SpreedME/SpreedME/common_definitions/ChannelingConstants.c
+//   C=../../SpreedME/SpreedME/Classes/cpp
+//   c++ -std=c++11 -O2 -I../compat -include ../compat/bench_prefix.h -D_UINT64_T -I$C -I$C/webrtc_extensions
+//       -I../../SpreedME/SpreedME/common_definitions -I../../SpreedME/SpreedME/utils -I../../SpreedME/SpreedME/libs/crc32
+//       -I/usr/include/jsoncpp file_transfer_bench.cc $C/FileUploader.cc $C/FileDownloader.cc $C/FileTransfererBase.cc
+//       $C/TokenBasedConnectionsHandler.cc $C/SignallingHandler.cc $C/FileChunkSource.cc $C/FileDownloadInfo.cc
+//       $C/SegmentedFileCrypto.cc $C/TransferScheduler.cc $C/TransferRateEstimator.cc $C/FileContentIndex.cc
+//       $C/MerkleTree.cc $C/cpp_utils.cc crc32.o ChannelingConstants.o -ljsoncpp -lcrypto -o file_transfer_bench
+// -D_UINT64_T keeps STByteCount.h from declaring uint64_t again.
+//
+// Usage:
+//   file_transfer_bench [--sizes 1K,64K,1M,16M,256M] [--bandwidth 2M] [--rtt 60] [--loss 0] [--reorder 0]
+//                       [--setup-rtts 4] [--unhashed] [--limit RATE] [--in-call] [--seed 1]
+// Sizes, bandwidth and rate (bytes per second) take K, M and G suffixes (powers of 1024).
+// Files are written to $TMPDIR (or /tmp), make sure there is room for two copies of the biggest one.
+// --unhashed shares files which are not in content index, uploader announces them before it hashes them and
+//            sends content hash over data channels when it is ready, chunks requested before come without proofs.
+// --limit sets transfer bandwidth limits of both devices (TransferScheduler::SetBandwidthLimits).
+// --in-call makes both devices apply their in-call limits (TransferScheduler::SetCallIsActive).
+// FileDownloader decides number of connections from number of chunks, column "ch" shows how many it opened.
+// Column "updates" is number of DownloadProgressHasChanged calls.
+// Exit code is 1 if any transfer didn't complete or downloaded content hash doesn't match.
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <webrtc/base/json.h>
+#include <webrtc/base/refcount.h>
+
+#include "FileContentIndex.h"
+#include "FileDownloader.h"
+#include "FileUploader.h"
+#include "MessageQueueInterface.h"
+#include "PeerConnectionWrapper.h"
+#include "PeerConnectionWrapperFactory.h"
+#include "SignallingHandler.h"
+#include "TransferScheduler.h"
+#include "utils.h"
+
+using namespace spreedme;
+
+
+/*------------------------------------ Allocation counting ---------------------------------------*/
+
+static bool gCountAllocations = false;
+static uint64_t gAllocations = 0;
+
+#if defined(__GLIBC__)
+// operator new of libstdc++ goes through malloc, so this counts both.
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size)
+{
+	if (gCountAllocations) {
+		++gAllocations;
+	}
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+	if (gCountAllocations) {
+		++gAllocations;
+	}
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+	if (gCountAllocations) {
+		++gAllocations;
+	}
+	return __libc_realloc(ptr, size);
+}
+#else
+// Elsewhere we only see C++ allocations.
+void *operator new(size_t size)
+{
+	if (gCountAllocations) {
+		++gAllocations;
+	}
+	void *ptr = malloc(size);
+	if (!ptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+#endif
+
+
+/*------------------------------------ Simulated clock --------------------------------------------*/
+
+static uint64 gNowUs = 0;
+
+namespace rtc {
+
+uint32 Time()
+{
+	return (uint32)(gNowUs / 1000);
+}
+
+} // namespace rtc
+
+
+uint64_t mach_absolute_time(void)
+{
+	return gNowUs * 1000;
+}
+
+
+/*------------------------------------ utils.mm counterparts --------------------------------------*/
+
+bool moveFile(const char *src, const char *dst)
+{
+	return rename(src, dst) == 0;
+}
+
+
+bool checkIfFileExists(const char *fileLocation)
+{
+	struct stat st;
+	return stat(fileLocation, &st) == 0;
+}
+
+
+void makeFileNameSuggestion(const char *srcFileLocation, char **suggestedFileNameLocation)
+{
+	*suggestedFileNameLocation = NULL;
+	if (srcFileLocation) {
+		std::string location(srcFileLocation);
+		size_t slash = location.rfind('/');
+		std::string folder = slash == std::string::npos ? std::string() : location.substr(0, slash + 1);
+		std::string fname = slash == std::string::npos ? location : location.substr(slash + 1);
+		size_t dot = fname.rfind('.');
+		std::string fnameNoExt = dot == std::string::npos ? fname : fname.substr(0, dot);
+		std::string extension = dot == std::string::npos ? std::string() : fname.substr(dot + 1);
+
+		int fileIndex = 1;
+		while (checkIfFileExists((folder + fname).c_str())) {
+			char suffix[32];
+			snprintf(suffix, sizeof(suffix), "_(%d).", fileIndex);
+			fname = fnameNoExt + suffix + extension;
+			fileIndex++;
+		}
+
+		*suggestedFileNameLocation = strdup((folder + fname).c_str());
+	}
+}
+
+
+namespace {
+
+const uint32 kChunkSize = 60000; // FileUploader::DecideOnFileChunksForFileSize
+const uint32 kPacketPayloadSize = 1200; // SCTP payload per packet webrtc uses
+const uint32 kPacketOverhead = 28 + 13 + 12 + 16; // IP/UDP, DTLS, SCTP common header and data chunk header
+const char kUploaderId[] = "uploader";
+const char kDownloaderId[] = "downloader";
+
+
+uint64 ThreadCpuNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+// Measures CPU time and allocations. Meters can't be nested.
+class Meter
+{
+public:
+	Meter() : cpuNs_(0), allocations_(0), startCpuNs_(0), startAllocations_(0) {};
+
+	void Start() {startAllocations_ = gAllocations; gCountAllocations = true; startCpuNs_ = ThreadCpuNs();};
+	void Stop() {cpuNs_ += ThreadCpuNs() - startCpuNs_; gCountAllocations = false; allocations_ += gAllocations - startAllocations_;};
+
+	uint64 cpuNs() const {return cpuNs_;};
+	uint64 allocations() const {return allocations_;};
+
+private:
+	uint64 cpuNs_;
+	uint64 allocations_;
+	uint64 startCpuNs_;
+	uint64 startAllocations_;
+};
+
+
+class ScopedMeter
+{
+public:
+	explicit ScopedMeter(Meter *meter) : meter_(meter) {meter_->Start();};
+	~ScopedMeter() {meter_->Stop();};
+
+private:
+	Meter *meter_;
+};
+
+
+// Deterministic content, so transfers of the same size are comparable.
+void FillChunk(uint32 chunkNumber, char *buffer, uint32 size)
+{
+	uint64 x = 0x9E3779B97F4A7C15ULL ^ ((uint64)chunkNumber + 1) * 0xBF58476D1CE4E5B9ULL;
+	uint32 i = 0;
+	for (; i + 8 <= size; i += 8) {
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		memcpy(buffer + i, &x, 8);
+	}
+	for (; i < size; ++i) {
+		buffer[i] = (char)(x >> (8 * (i % 8)));
+	}
+}
+
+
+uint32 ChunksForFileSize(uint64 fileSize)
+{
+	return (uint32)((fileSize + kChunkSize - 1) / kChunkSize);
+}
+
+
+/*------------------------------------ Event loop and queues --------------------------------------*/
+
+// Runs events in order of their simulated time, events with the same time in order they were posted.
+// Everything it runs is metered.
+class EventLoop
+{
+public:
+	explicit EventLoop(Meter *meter) : sequence_(0), meter_(meter) {};
+
+	void PostTask(uint64 timeUs, const std::function<void()> &task)
+	{
+		events_[EventKey(timeUs < gNowUs ? gNowUs : timeUs, sequence_++)] = task;
+	};
+	void PostTaskDelayed(uint64 delayUs, const std::function<void()> &task) {this->PostTask(gNowUs + delayUs, task);};
+
+	// Runs until there is nothing to do, stopCondition becomes true or next event is after deadline.
+	void Run(const std::function<bool()> &stopCondition, uint64 deadlineUs)
+	{
+		while (!events_.empty() && !stopCondition() && events_.begin()->first.first <= deadlineUs) {
+			Events::iterator it = events_.begin();
+			gNowUs = it->first.first;
+			std::function<void()> task;
+			task.swap(it->second);
+			events_.erase(it);
+
+			ScopedMeter scopedMeter(meter_);
+			task();
+		}
+	};
+
+private:
+	typedef std::pair<uint64, uint64> EventKey; // time, sequence
+	typedef std::map<EventKey, std::function<void()> > Events;
+
+	Events events_;
+	uint64 sequence_;
+	Meter *meter_;
+};
+
+
+// One of the threads FileSharingManager gives to transferers (worker or callbacks thread of one device).
+// Clear() only removes messages posted to this queue.
+class BenchMessageQueue : public MessageQueueInterface
+{
+public:
+	explicit BenchMessageQueue(EventLoop *loop) : loop_(loop), nextMessageId_(0) {};
+	virtual ~BenchMessageQueue()
+	{
+		for (Messages::iterator it = messages_.begin(); it != messages_.end(); ++it) {
+			delete it->second.pdata;
+		}
+	};
+
+	virtual void Post(rtc::MessageHandler *phandler, uint32 id, rtc::MessageData *pdata = NULL)
+	{
+		this->PostDelayed(0, phandler, id, pdata);
+	};
+	virtual void Send(rtc::MessageHandler *phandler, uint32 id, rtc::MessageData *pdata = NULL)
+	{
+		// There is only one thread, so we are always on the queue's thread and handle message right away like rtc::Thread does.
+		rtc::Message msg;
+		msg.phandler = phandler;
+		msg.message_id = id;
+		msg.pdata = pdata;
+		phandler->OnMessage(&msg);
+	};
+	virtual void PostDelayed(int cmsDelay, rtc::MessageHandler *phandler, uint32 id, rtc::MessageData *pdata = NULL)
+	{
+		rtc::Message msg;
+		msg.phandler = phandler;
+		msg.message_id = id;
+		msg.pdata = pdata;
+
+		uint64 messageId = nextMessageId_++;
+		messages_[messageId] = msg;
+		loop_->PostTaskDelayed(cmsDelay > 0 ? (uint64)cmsDelay * 1000 : 0, std::bind(&BenchMessageQueue::Dispatch, this, messageId));
+	};
+	virtual void Clear(rtc::MessageHandler *phandler, uint32 id = rtc::MQID_ANY, rtc::MessageList* removed = NULL)
+	{
+		for (Messages::iterator it = messages_.begin(); it != messages_.end();) {
+			if (it->second.Match(phandler, id)) {
+				if (removed) {
+					removed->push_back(it->second);
+				} else {
+					delete it->second.pdata;
+				}
+				messages_.erase(it++);
+			} else {
+				++it;
+			}
+		}
+	};
+
+private:
+	// Event loop task of cleared message finds nothing
+	void Dispatch(uint64 messageId)
+	{
+		Messages::iterator it = messages_.find(messageId);
+		if (it != messages_.end()) {
+			rtc::Message msg = it->second;
+			messages_.erase(it);
+			msg.phandler->OnMessage(&msg);
+		}
+	};
+
+	typedef std::map<uint64, rtc::Message> Messages;
+
+	EventLoop *loop_;
+	Messages messages_;
+	uint64 nextMessageId_;
+};
+
+
+/*------------------------------------ Network ----------------------------------------------------*/
+
+struct LinkParameters
+{
+	uint64 bytesPerSecond;
+	uint64 rttUs;
+	double loss;
+	double reorder;
+};
+
+
+// One direction of the path between peers. All data channels share its bandwidth,
+// each channel is ordered so a late message holds back later ones on the same channel.
+class SimulatedLink
+{
+public:
+	SimulatedLink(const LinkParameters &parameters, uint32 seed) : parameters_(parameters), busyUntilUs_(0), random_(seed ? seed : 1) {};
+
+	uint64 DeliveryTime(uint64 nowUs, int channel, size_t messageSize)
+	{
+		uint64 packets = (messageSize + kPacketPayloadSize - 1) / kPacketPayloadSize;
+		if (packets == 0) {
+			packets = 1;
+		}
+
+		uint64 start = busyUntilUs_ > nowUs ? busyUntilUs_ : nowUs;
+		busyUntilUs_ = start + this->SerializationUs(messageSize + packets * kPacketOverhead);
+
+		uint64 deliveryUs = busyUntilUs_ + parameters_.rttUs / 2;
+
+		for (uint64 i = 0; i < packets; ++i) {
+			if (this->Random() < parameters_.loss) {
+				busyUntilUs_ += this->SerializationUs(kPacketPayloadSize + kPacketOverhead);
+				deliveryUs += parameters_.rttUs;
+			}
+		}
+
+		if (this->Random() < parameters_.reorder) {
+			deliveryUs += (uint64)(this->Random() * parameters_.rttUs / 2);
+		}
+
+		uint64 &lastDeliveryUs = lastDeliveryUs_[channel];
+		if (deliveryUs < lastDeliveryUs) {
+			deliveryUs = lastDeliveryUs;
+		}
+		lastDeliveryUs = deliveryUs;
+
+		return deliveryUs;
+	};
+
+	uint64 rttUs() const {return parameters_.rttUs;};
+
+private:
+	uint64 SerializationUs(uint64 bytes) {return parameters_.bytesPerSecond ? bytes * 1000000ULL / parameters_.bytesPerSecond : 0;};
+	double Random()
+	{
+		random_ ^= random_ << 13;
+		random_ ^= random_ >> 17;
+		random_ ^= random_ << 5;
+		return (double)random_ / 4294967296.0;
+	};
+
+	LinkParameters parameters_;
+	uint64 busyUntilUs_;
+	std::map<int, uint64> lastDeliveryUs_;
+	uint32 random_;
+};
+
+
+class BenchPeerConnection;
+
+
+// Data channel of a simulated connection. Sent messages arrive at the paired channel of the other side.
+class BenchDataChannel : public webrtc::DataChannelInterface
+{
+public:
+	BenchDataChannel(BenchPeerConnection *wrapper, EventLoop *loop) :
+		wrapper_(wrapper), loop_(loop), peer_(NULL), link_(NULL), linkChannel_(0), state_(kConnecting) {};
+
+	virtual std::string label() const {return kDefaultDataChannelLabel;};
+	virtual DataState state() const {return state_;};
+	virtual bool Send(const webrtc::DataBuffer &buffer);
+
+	void Connect(BenchDataChannel *peer, SimulatedLink *link, int linkChannel) {peer_ = peer; link_ = link; linkChannel_ = linkChannel;};
+	void Open() {if (state_ == kConnecting) {this->SetState(kOpen);}};
+	// Closes without telling own wrapper, like PeerConnectionWrapper::Close, the other side sees it half RTT later.
+	void Close();
+
+	void SetState(DataState state);
+
+private:
+	void Deliver(const std::string &data, bool binary);
+
+	BenchPeerConnection *wrapper_;
+	EventLoop *loop_;
+	BenchDataChannel *peer_;
+	SimulatedLink *link_; // towards peer_
+	int linkChannel_;
+	DataState state_;
+};
+
+
+class BenchNetwork;
+
+
+// Wrapper with one data channel which is paired with the channel of the wrapper on the other side
+// when the offer reaches it. Offer and answer only carry factory id of the wrapper which created them.
+class BenchPeerConnection : public PeerConnectionWrapper
+{
+public:
+	BenchPeerConnection(const std::string &factoryId, PeerConnectionWrapperDelegateInterface *delegate,
+						BenchNetwork *network, EventLoop *loop) :
+		PeerConnectionWrapper(factoryId, delegate), dataChannel_(this, loop), network_(network), loop_(loop)
+	{
+		this->AddDataChannel(&dataChannel_);
+	};
+
+	virtual void Close()
+	{
+		dataChannel_.Close();
+		PeerConnectionWrapper::Close();
+	};
+
+	virtual void CreateOffer(const std::string recepientId);
+	virtual void SetupRemoteOffer(const std::string &sdp);
+	virtual void SetupRemoteAnswer(const std::string &sdp);
+
+	BenchDataChannel *dataChannel() {return &dataChannel_;};
+	BenchNetwork *network() {return network_;};
+
+private:
+	void SessionDescriptionIsReady(const std::string &sdType);
+
+	BenchDataChannel dataChannel_;
+	BenchNetwork *network_;
+	EventLoop *loop_;
+};
+
+
+// Connects the two devices: relays signalling thru the "server" and data channels thru simulated links.
+class BenchNetwork
+{
+public:
+	BenchNetwork(const LinkParameters &link, uint32 setupRtts, uint32 seed, EventLoop *loop) :
+		uploadLink_(link, seed), downloadLink_(link, seed * 7919), setupRtts_(setupRtts), loop_(loop),
+		nextLinkChannel_(0), firstChunkTimeUs_(0), signallingMessages_(0)
+	{
+		handlers_[kUploaderId] = NULL;
+		handlers_[kDownloaderId] = NULL;
+	};
+
+	void SetSignallingHandler(const std::string &userId, SignallingHandler *handler) {handlers_[userId] = handler;};
+
+	void Register(BenchPeerConnection *wrapper) {wrappers_[wrapper->factoryId()] = wrapper;};
+	BenchPeerConnection *WrapperForSdp(const std::string &sdp)
+	{
+		std::map<std::string, BenchPeerConnection *>::iterator it = wrappers_.find(sdp);
+		return it != wrappers_.end() ? it->second : NULL;
+	};
+
+	// Wrappers are named after the side which created them
+	void Pair(BenchPeerConnection *offerer, BenchPeerConnection *answerer)
+	{
+		bool offererUploads = offerer->factoryId().compare(0, strlen(kUploaderId), kUploaderId) == 0;
+		SimulatedLink *fromOfferer = offererUploads ? &downloadLink_ : &uploadLink_;
+		SimulatedLink *fromAnswerer = offererUploads ? &uploadLink_ : &downloadLink_;
+		int linkChannel = nextLinkChannel_++;
+		offerer->dataChannel()->Connect(answerer->dataChannel(), fromOfferer, linkChannel);
+		answerer->dataChannel()->Connect(offerer->dataChannel(), fromAnswerer, linkChannel);
+		answerers_[offerer] = answerer;
+	};
+
+	// ICE, DTLS and SCTP handshakes after answer has arrived
+	void OpenDataChannelsLater(BenchPeerConnection *offerer)
+	{
+		std::map<BenchPeerConnection *, BenchPeerConnection *>::iterator it = answerers_.find(offerer);
+		if (it == answerers_.end()) {
+			return;
+		}
+		BenchDataChannel *offererChannel = offerer->dataChannel();
+		BenchDataChannel *answererChannel = it->second->dataChannel();
+		uint64 delayUs = setupRtts_ > 1 ? (setupRtts_ - 1) * uploadLink_.rttUs() : 0;
+		loop_->PostTaskDelayed(delayUs, [offererChannel, answererChannel]() {
+			answererChannel->Open();
+			offererChannel->Open();
+		});
+	};
+
+	// ServerBasedMessageSenderInterface of one side. Server passes inner message on with sender's id like the real one.
+	class ServerSender : public ServerBasedMessageSenderInterface
+	{
+	public:
+		ServerSender(BenchNetwork *network, const std::string &selfId) : network_(network), selfId_(selfId) {};
+		virtual void SendMessage(const std::string &msg) {network_->RelayMessage(selfId_, msg);};
+
+	private:
+		BenchNetwork *network_;
+		std::string selfId_;
+	};
+
+	void ChunkHasArrived() {if (firstChunkTimeUs_ == 0) {firstChunkTimeUs_ = gNowUs;}};
+	uint64 firstChunkTimeUs() const {return firstChunkTimeUs_;};
+	uint64 signallingMessages() const {return signallingMessages_;};
+
+private:
+	void RelayMessage(const std::string &from, const std::string &msg)
+	{
+		Json::Reader reader;
+		Json::Value root;
+		if (!reader.parse(msg, root)) {
+			return;
+		}
+		std::string type = root.get(kTypeKey, Json::Value()).asString();
+		Json::Value inner = root[type];
+		std::string to = inner.get(kToKey, Json::Value()).asString();
+		std::map<std::string, SignallingHandler *>::iterator it = handlers_.find(to);
+		if (it == handlers_.end()) {
+			return;
+		}
+
+		Json::Value relayed;
+		relayed[kDataKey] = inner;
+		relayed[kFromKey] = from;
+		relayed[kToKey] = to;
+		std::string relayedMsg = Json::FastWriter().write(relayed);
+		++signallingMessages_;
+
+		std::map<std::string, SignallingHandler *> *handlers = &handlers_;
+		loop_->PostTaskDelayed(uploadLink_.rttUs() / 2, [handlers, to, relayedMsg]() {
+			SignallingHandler *handler = (*handlers)[to];
+			if (handler) {
+				handler->ReceiveMessage(relayedMsg, kWebsocketChannelingServer, std::string());
+			}
+		});
+	};
+
+	SimulatedLink uploadLink_; // downloader -> uploader, carries chunk requests
+	SimulatedLink downloadLink_; // uploader -> downloader, carries chunks
+	uint32 setupRtts_;
+	EventLoop *loop_;
+	int nextLinkChannel_;
+	std::map<std::string, SignallingHandler *> handlers_;
+	std::map<std::string, BenchPeerConnection *> wrappers_;
+	std::map<BenchPeerConnection *, BenchPeerConnection *> answerers_;
+	uint64 firstChunkTimeUs_;
+	uint64 signallingMessages_;
+};
+
+
+bool BenchDataChannel::Send(const webrtc::DataBuffer &buffer)
+{
+	if (state_ != kOpen || !peer_) {
+		return false;
+	}
+
+	uint64 deliveryUs = link_->DeliveryTime(gNowUs, linkChannel_, buffer.data.length());
+	loop_->PostTask(deliveryUs, std::bind(&BenchDataChannel::Deliver, peer_,
+										  std::string(buffer.data.data(), buffer.data.length()), buffer.binary));
+	return true;
+}
+
+
+void BenchDataChannel::Close()
+{
+	if (state_ == kClosed) {
+		return;
+	}
+	state_ = kClosed;
+
+	if (peer_) {
+		BenchDataChannel *peer = peer_;
+		loop_->PostTaskDelayed(link_->rttUs() / 2, [peer]() {
+			if (peer->state() != kClosed) {
+				peer->SetState(kClosed);
+			}
+		});
+	}
+}
+
+
+void BenchDataChannel::SetState(DataState state)
+{
+	state_ = state;
+	wrapper_->OnDataChannelStateChange(this, state);
+}
+
+
+void BenchDataChannel::Deliver(const std::string &data, bool binary)
+{
+	if (state_ != kOpen) {
+		return;
+	}
+	if (binary) {
+		wrapper_->network()->ChunkHasArrived();
+	}
+	wrapper_->OnDataChannelMessage(this, new webrtc::DataBuffer(data, binary));
+}
+
+
+void BenchPeerConnection::CreateOffer(const std::string recepientId)
+{
+	PeerConnectionWrapper::CreateOffer(recepientId);
+	loop_->PostTask(gNowUs, std::bind(&BenchPeerConnection::SessionDescriptionIsReady, this, std::string("offer")));
+}
+
+
+void BenchPeerConnection::SetupRemoteOffer(const std::string &sdp)
+{
+	PeerConnectionWrapper::SetupRemoteOffer(sdp);
+	BenchPeerConnection *offerer = network_->WrapperForSdp(sdp);
+	if (offerer) {
+		network_->Pair(offerer, this);
+		loop_->PostTask(gNowUs, std::bind(&BenchPeerConnection::SessionDescriptionIsReady, this, std::string("answer")));
+	}
+}
+
+
+void BenchPeerConnection::SetupRemoteAnswer(const std::string &sdp)
+{
+	PeerConnectionWrapper::SetupRemoteAnswer(sdp);
+	network_->OpenDataChannelsLater(this);
+}
+
+
+// Session description is created asynchronously, then one host candidate is gathered
+void BenchPeerConnection::SessionDescriptionIsReady(const std::string &sdType)
+{
+	if (!delegate_ || signalingState_ == webrtc::PeerConnectionInterface::kClosed) {
+		return;
+	}
+	if (sdType == "offer") {
+		delegate_->OfferIsReadyToBeSent(sdType, factoryId_, this);
+	} else {
+		delegate_->AnswerIsReadyToBeSent(sdType, factoryId_, this);
+	}
+	delegate_->CandidateIsReadyToBeSent(new IceCandidateStringRepresentation("data", 0,
+		"candidate:1 1 udp 2122260223 192.0.2.1 50000 typ host generation 0"), this);
+}
+
+
+// Factory of one device. Owns its wrappers, they are deleted when the benchmark is done with the transfer.
+class BenchPeerConnectionFactory : public PeerConnectionWrapperFactory
+{
+public:
+	BenchPeerConnectionFactory(const std::string &selfId, BenchNetwork *network, EventLoop *loop) :
+		selfId_(selfId), network_(network), loop_(loop) {};
+	virtual ~BenchPeerConnectionFactory()
+	{
+		for (std::vector<BenchPeerConnection *>::iterator it = wrappers_.begin(); it != wrappers_.end(); ++it) {
+			delete *it;
+		}
+	};
+
+	virtual rtc::scoped_refptr<PeerConnectionWrapper> CreateSpreedPeerConnection(const std::string &userId,
+																				 PeerConnectionWrapperDelegateInterface *pcDelegate = NULL)
+	{
+		char factoryId[64];
+		snprintf(factoryId, sizeof(factoryId), "%s-%u", selfId_.c_str(), (unsigned)wrappers_.size() + 1);
+		BenchPeerConnection *wrapper = new BenchPeerConnection(factoryId, pcDelegate, network_, loop_);
+		wrapper->SetUserId(userId);
+		network_->Register(wrapper);
+		wrappers_.push_back(wrapper);
+		return wrapper;
+	};
+
+	size_t wrappersCreated() const {return wrappers_.size();};
+	uint64 bytesSent() const
+	{
+		uint64 bytes = 0;
+		for (std::vector<BenchPeerConnection *>::const_iterator it = wrappers_.begin(); it != wrappers_.end(); ++it) {
+			bytes += (*it)->bytesSent();
+		}
+		return bytes;
+	};
+
+private:
+	std::string selfId_;
+	BenchNetwork *network_;
+	EventLoop *loop_;
+	std::vector<BenchPeerConnection *> wrappers_;
+};
+
+
+/*------------------------------------ Devices ----------------------------------------------------*/
+
+struct Options
+{
+	Options() : setupRtts(4), unhashed(false), limitBytesPerSecond(0), inCall(false), seed(1)
+	{
+		link.bytesPerSecond = 2 * 1024 * 1024;
+		link.rttUs = 60 * 1000;
+		link.loss = 0.0;
+		link.reorder = 0.0;
+	};
+
+	std::vector<uint64> sizes;
+	LinkParameters link;
+	uint32 setupRtts;
+	bool unhashed;
+	uint64 limitBytesPerSecond;
+	bool inCall;
+	uint32 seed;
+};
+
+
+// What FileSharingManager has for one device
+struct Device
+{
+	Device(const std::string &selfId, BenchNetwork *network, EventLoop *loop, const Options &options) :
+		serverSender(network, selfId), signallingHandler(selfId, &serverSender),
+		workerQueue(loop), callbacksQueue(loop), factory(selfId, network, loop)
+	{
+		network->SetSignallingHandler(selfId, &signallingHandler);
+		if (options.limitBytesPerSecond) {
+			scheduler.SetBandwidthLimits((uint32)options.limitBytesPerSecond, (uint32)options.limitBytesPerSecond);
+		}
+		scheduler.SetCallIsActive(options.inCall);
+	};
+
+	BenchNetwork::ServerSender serverSender;
+	SignallingHandler signallingHandler;
+	BenchMessageQueue workerQueue;
+	BenchMessageQueue callbacksQueue;
+	BenchPeerConnectionFactory factory;
+	TransferScheduler scheduler;
+};
+
+
+class TransferObserver : public FileUploaderDelegateInterface, public FileDownloaderDelegateInterface
+{
+public:
+	TransferObserver(FileDownloader *downloader, const std::string &downloadDirectory, EventLoop *loop, uint64 announceDelayUs) :
+		downloader_(downloader), downloadDirectory_(downloadDirectory), loop_(loop), announceDelayUs_(announceDelayUs),
+		finishTimeUs_(0), failed_(false), progressUpdates_(0), uploaderCleanedUp_(false) {};
+
+	// File info goes to the other device in a chat message thru the server
+	virtual void FileSharingHasStarted(const FileInfo &fileInfo, FileUploader *fileUploader)
+	{
+		fileInfo_ = fileInfo;
+		FileDownloader *downloader = downloader_;
+		std::string directory = downloadDirectory_;
+		loop_->PostTaskDelayed(announceDelayUs_, [downloader, fileInfo, directory]() {
+			std::set<std::string> userIds;
+			userIds.insert(kUploaderId);
+			downloader->DownloadFileForToken(fileInfo, directory, userIds, directory + "download.tmp");
+		});
+	};
+	virtual void FileUploaderHasStoppedAndCleanedUp(FileUploader *fileUploader) {uploaderCleanedUp_ = true;};
+
+	virtual void DownloadHasBeenFinished(FileDownloader *fileDownloader, const std::string &filePath) {finishTimeUs_ = gNowUs; filePath_ = filePath;};
+	virtual void DownloadProgressHasChanged(FileDownloader *fileDownloader, uint64 bytesDownloaded, double bytesPerSecond, double estimatedFinishTimeInterval)
+	{
+		++progressUpdates_;
+	};
+	virtual void DownloadHasBeenCanceled(FileDownloader *fileDownloader) {failed_ = true;};
+	virtual void DownloadHasFailed(FileDownloader *fileDownloader) {failed_ = true;};
+	virtual void DownloadHasBeenPaused(FileDownloader *fileDownloader) {};
+	virtual void DownloadHasBeenResumed(FileDownloader *fileDownloader) {};
+	virtual void FileDownloaderHasStoppedAndCleanedUp(FileDownloader *fileDownloader) {};
+
+	bool isDone() const {return finishTimeUs_ != 0 || failed_;};
+	bool uploaderCleanedUp() const {return uploaderCleanedUp_;};
+	const FileInfo &fileInfo() const {return fileInfo_;};
+	uint64 finishTimeUs() const {return finishTimeUs_;};
+	const std::string &filePath() const {return filePath_;};
+	uint32 progressUpdates() const {return progressUpdates_;};
+
+private:
+	FileDownloader *downloader_;
+	std::string downloadDirectory_;
+	EventLoop *loop_;
+	uint64 announceDelayUs_;
+	FileInfo fileInfo_;
+	uint64 finishTimeUs_;
+	std::string filePath_;
+	bool failed_;
+	uint32 progressUpdates_;
+	bool uploaderCleanedUp_;
+};
+
+
+/*------------------------------------ Files ------------------------------------------------------*/
+
+int RemoveEntry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	remove(path);
+	return 0;
+}
+
+
+void RemoveDirectory(const std::string &path)
+{
+	nftw(path.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+
+// Writes the shared file and returns its content hash. Hashing is metered separately.
+std::string WriteFile(const std::string &path, uint64 fileSize, Meter *hashingMeter, std::vector<std::string> *chunkHashes)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return std::string();
+	}
+
+	uint32 chunks = ChunksForFileSize(fileSize);
+	FileContentHasher hasher(kChunkSize, chunks);
+	std::vector<char> buffer(kChunkSize);
+	bool written = true;
+	for (uint32 i = 0; i < chunks && written; ++i) {
+		uint64 offset = (uint64)i * kChunkSize;
+		uint32 size = fileSize - offset > kChunkSize ? kChunkSize : (uint32)(fileSize - offset);
+		FillChunk(i, &buffer[0], size);
+		written = fwrite(&buffer[0], 1, size, file) == size;
+		ScopedMeter scopedMeter(hashingMeter);
+		hasher.AddChunk(i, &buffer[0], size);
+	}
+	written = fclose(file) == 0 && written;
+
+	ScopedMeter scopedMeter(hashingMeter);
+	*chunkHashes = hasher.chunkHashes();
+	return written ? hasher.ContentHash() : std::string();
+}
+
+
+bool FileHasContent(const std::string &path, uint64 fileSize, const std::string &contentHash)
+{
+	struct stat st;
+	if (path.empty() || stat(path.c_str(), &st) != 0 || (uint64)st.st_size != fileSize) {
+		return false;
+	}
+	FILE *file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+
+	uint32 chunks = ChunksForFileSize(fileSize);
+	FileContentHasher hasher(kChunkSize, chunks);
+	std::vector<char> buffer(kChunkSize);
+	bool read = true;
+	for (uint32 i = 0; i < chunks && read; ++i) {
+		uint64 offset = (uint64)i * kChunkSize;
+		uint32 size = fileSize - offset > kChunkSize ? kChunkSize : (uint32)(fileSize - offset);
+		read = fread(&buffer[0], 1, size, file) == size;
+		hasher.AddChunk(i, &buffer[0], size);
+	}
+	fclose(file);
+
+	return read && hasher.ContentHash() == contentHash;
+}
+
+
+/*------------------------------------ Benchmark --------------------------------------------------*/
+
+struct Result
+{
+	uint64 fileSize;
+	uint32 chunks;
+	int channels;
+	bool succeeded;
+	double firstByteMs;
+	double transferSeconds;
+	double megabytesPerSecond;
+	double cpuMsPerMegabyte;
+	double allocationsPerChunk;
+	double hashingMegabytesPerSecond;
+	double overheadPercent;
+	uint32 progressUpdates;
+};
+
+
+Result RunTransfer(uint64 fileSize, const Options &options, const std::string &workDirectory)
+{
+	Result result;
+	memset(&result, 0, sizeof(result));
+	result.fileSize = fileSize;
+	result.chunks = ChunksForFileSize(fileSize);
+
+	std::string shareDirectory = workDirectory + "/share/";
+	std::string downloadDirectory = workDirectory + "/download/";
+	mkdir(shareDirectory.c_str(), 0700);
+	mkdir(downloadDirectory.c_str(), 0700);
+
+	Meter hashingMeter;
+	std::vector<std::string> chunkHashes;
+	std::string sharedFilePath = shareDirectory + "bench.bin";
+	std::string contentHash = WriteFile(sharedFilePath, fileSize, &hashingMeter, &chunkHashes);
+	if (contentHash.empty()) {
+		fprintf(stderr, "Couldn't write %s: %s\n", sharedFilePath.c_str(), strerror(errno));
+		RemoveDirectory(workDirectory + "/share");
+		RemoveDirectory(workDirectory + "/download");
+		return result;
+	}
+	double megabytes = fileSize / (1024.0 * 1024.0);
+	result.hashingMegabytesPerSecond = hashingMeter.cpuNs() ? megabytes / (hashingMeter.cpuNs() / 1000000000.0) : 0;
+
+	// Content index FileSharingManager keeps for shared files, so uploader announces content hash right away
+	FileContentIndex contentIndex(shareDirectory + "index.json");
+	if (!options.unhashed) {
+		contentIndex.AddFile(sharedFilePath, contentHash);
+		contentIndex.SaveChunkHashes(contentHash, chunkHashes);
+	}
+
+	gNowUs = 0;
+	Meter meter;
+	EventLoop loop(&meter);
+	BenchNetwork network(options.link, options.setupRtts, options.seed, &loop);
+
+	{
+		Device uploaderDevice(kUploaderId, &network, &loop, options);
+		Device downloaderDevice(kDownloaderId, &network, &loop, options);
+
+		FileUploader *uploader = new rtc::RefCountedObject<FileUploader>(&uploaderDevice.factory, &uploaderDevice.signallingHandler,
+																		 &uploaderDevice.workerQueue, &uploaderDevice.callbacksQueue);
+		uploader->AddRef();
+		FileDownloader *downloader = new rtc::RefCountedObject<FileDownloader>(&downloaderDevice.factory, &downloaderDevice.signallingHandler,
+																			   &downloaderDevice.workerQueue, &downloaderDevice.callbacksQueue);
+		downloader->AddRef();
+
+		TransferObserver observer(downloader, downloadDirectory, &loop, options.link.rttUs);
+		uploader->SetDelegate(&observer);
+		uploader->SetContentIndex(&contentIndex);
+		uploader->SetBandwidthBucket(uploaderDevice.scheduler.uploadBucket());
+		downloader->SetDelegate(&observer);
+		downloader->SetBandwidthBucket(downloaderDevice.scheduler.downloadBucket());
+
+		loop.PostTask(0, [uploader, sharedFilePath]() {
+			uploader->StartSharingFile(sharedFilePath, "application/octet-stream", "bench.bin",
+									   FileUploader::CreateFileUploadTokenForFileName("bench.bin"));
+		});
+
+		// Generous cap for transfers which stall, e.g. on a rate limit far below the link
+		uint64 expectedUs = options.link.bytesPerSecond ? fileSize * 1000000ULL / options.link.bytesPerSecond : 0;
+		if (options.limitBytesPerSecond) {
+			expectedUs += fileSize * 1000000ULL / options.limitBytesPerSecond;
+		}
+		uint64 deadlineUs = expectedUs * 10 + (options.setupRtts + 10) * options.link.rttUs * 10 + 600 * 1000000ULL;
+
+		loop.Run(std::bind(&TransferObserver::isDone, &observer), deadlineUs);
+
+		result.succeeded = observer.finishTimeUs() != 0 && observer.fileInfo().contentHash == (options.unhashed ? std::string() : contentHash);
+		result.firstByteMs = network.firstChunkTimeUs() / 1000.0;
+		result.transferSeconds = observer.finishTimeUs() / 1000000.0;
+		result.progressUpdates = observer.progressUpdates();
+
+		uploader->StopFileTransfer();
+		loop.Run(std::bind(&TransferObserver::uploaderCleanedUp, &observer), deadlineUs + 60 * 1000000ULL);
+		// Let close notifications and leftover polls run out
+		loop.Run([]() {return false;}, gNowUs + 10 * 1000000ULL);
+
+		result.channels = (int)downloaderDevice.factory.wrappersCreated();
+		uint64 protocolBytes = uploaderDevice.factory.bytesSent() + downloaderDevice.factory.bytesSent();
+		result.overheadPercent = fileSize ? 100.0 * (protocolBytes - (double)fileSize) / fileSize : 0;
+
+		uploader->Release();
+		downloader->Release();
+
+		result.succeeded = result.succeeded && FileHasContent(observer.filePath(), fileSize, contentHash);
+	}
+
+	result.megabytesPerSecond = result.transferSeconds > 0 ? megabytes / result.transferSeconds : 0;
+	result.cpuMsPerMegabyte = megabytes > 0 ? meter.cpuNs() / 1000000.0 / megabytes : 0;
+	result.allocationsPerChunk = result.chunks ? (double)meter.allocations() / result.chunks : 0;
+
+	RemoveDirectory(workDirectory + "/share");
+	RemoveDirectory(workDirectory + "/download");
+
+	return result;
+}
+
+
+bool ParseSize(const std::string &string, uint64 *size)
+{
+	char *end = NULL;
+	double value = strtod(string.c_str(), &end);
+	if (end == string.c_str() || value < 0) {
+		return false;
+	}
+
+	uint64 multiplier = 1;
+	switch (*end) {
+		case 'K': case 'k': multiplier = 1024ULL; ++end; break;
+		case 'M': case 'm': multiplier = 1024ULL * 1024; ++end; break;
+		case 'G': case 'g': multiplier = 1024ULL * 1024 * 1024; ++end; break;
+		default: break;
+	}
+	if (*end != '\0') {
+		return false;
+	}
+
+	*size = (uint64)(value * multiplier);
+	return true;
+}
+
+
+void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [--sizes 1K,64K,1M,16M,256M] [--bandwidth 2M] [--rtt 60] [--loss 0] [--reorder 0]\n"
+					"       [--setup-rtts 4] [--unhashed] [--limit RATE] [--in-call] [--seed 1]\n", name);
+}
+
+
+bool ParseOptions(int argc, char *argv[], Options *options)
+{
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--unhashed") {
+			options->unhashed = true;
+		} else if (arg == "--in-call") {
+			options->inCall = true;
+		} else if (!hasValue) {
+			return false;
+		} else if (arg == "--sizes") {
+			std::string list = argv[++i];
+			size_t start = 0;
+			while (start <= list.size()) {
+				size_t comma = list.find(',', start);
+				std::string item = list.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+				uint64 size = 0;
+				if (!ParseSize(item, &size) || size == 0) {
+					return false;
+				}
+				options->sizes.push_back(size);
+				if (comma == std::string::npos) {
+					break;
+				}
+				start = comma + 1;
+			}
+		} else if (arg == "--bandwidth") {
+			if (!ParseSize(argv[++i], &options->link.bytesPerSecond)) {
+				return false;
+			}
+		} else if (arg == "--limit") {
+			if (!ParseSize(argv[++i], &options->limitBytesPerSecond) || options->limitBytesPerSecond > UINT32_MAX) {
+				return false;
+			}
+		} else if (arg == "--rtt") {
+			options->link.rttUs = (uint64)(atof(argv[++i]) * 1000);
+		} else if (arg == "--loss") {
+			options->link.loss = atof(argv[++i]);
+		} else if (arg == "--reorder") {
+			options->link.reorder = atof(argv[++i]);
+		} else if (arg == "--setup-rtts") {
+			options->setupRtts = (uint32)atoi(argv[++i]);
+		} else if (arg == "--seed") {
+			options->seed = (uint32)strtoul(argv[++i], NULL, 10);
+		} else {
+			return false;
+		}
+	}
+
+	if (options->sizes.empty()) {
+		const uint64 kDefaultSizes[] = {1024ULL, 64 * 1024ULL, 1024 * 1024ULL, 16 * 1024 * 1024ULL, 256 * 1024 * 1024ULL};
+		options->sizes.assign(kDefaultSizes, kDefaultSizes + sizeof(kDefaultSizes) / sizeof(kDefaultSizes[0]));
+	}
+
+	return true;
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+	Options options;
+	if (!ParseOptions(argc, argv, &options)) {
+		PrintUsage(argv[0]);
+		return 2;
+	}
+
+	const char *tmpDir = getenv("TMPDIR");
+	std::string workDirectory = std::string(tmpDir && *tmpDir ? tmpDir : "/tmp") + "/file_transfer_bench.XXXXXX";
+	if (!mkdtemp(&workDirectory[0])) {
+		fprintf(stderr, "Couldn't create directory %s: %s\n", workDirectory.c_str(), strerror(errno));
+		return 1;
+	}
+
+	printf("link: %.2f MB/s, rtt %.0f ms, loss %.3f, reorder %.3f, setup %u rtts, %s, limit %s%s\n",
+		   options.link.bytesPerSecond / (1024.0 * 1024.0), options.link.rttUs / 1000.0,
+		   options.link.loss, options.link.reorder, options.setupRtts, options.unhashed ? "unhashed" : "hashed",
+		   options.limitBytesPerSecond ? (std::to_string(options.limitBytesPerSecond) + " B/s").c_str() : "none",
+		   options.inCall ? ", in call" : "");
+	printf("%12s %8s %3s %10s %10s %8s %10s %12s %10s %9s %8s %s\n",
+		   "size", "chunks", "ch", "ttfb ms", "time s", "MB/s", "cpu ms/MB", "allocs/chunk", "hash MB/s", "overhead", "updates", "");
+
+	bool allSucceeded = true;
+	for (std::vector<uint64>::iterator it = options.sizes.begin(); it != options.sizes.end(); ++it) {
+		Result result = RunTransfer(*it, options, workDirectory);
+		allSucceeded = allSucceeded && result.succeeded;
+
+		printf("%12llu %8u %3d %10.1f %10.3f %8.3f %10.2f %12.1f %10.1f %8.2f%% %8u %s\n",
+			   (unsigned long long)result.fileSize, result.chunks, result.channels, result.firstByteMs,
+			   result.transferSeconds, result.megabytesPerSecond, result.cpuMsPerMegabyte,
+			   result.allocationsPerChunk, result.hashingMegabytesPerSecond, result.overheadPercent,
+			   result.progressUpdates, result.succeeded ? "" : "FAILED");
+		fflush(stdout);
+	}
+
+	rmdir(workDirectory.c_str());
+
+	return allSucceeded ? 0 : 1;
+}
@@ -0,0 +1,895 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Replays channeling traffic through spreedme::SignallingHandler and measures what it costs to parse,
+// route and wrap signalling messages, per message type.
+//
+// SignallingHandler is the real one. PeerConnectionWrapper is a fake from tools/compat which only counts sent data
+// and wrappers are handed out by a fake PeerConnectionWrapperProviderInterface. Call and TokenBasedConnectionsHandler
+// need webrtc, so the receivers registered here replicate what their MessageReceived methods do before webrtc
+// is involved: Call copies parsed message to its worker thread and picks fields out in MessageReceived_w and
+// ReceivedOffer/Answer/Candidate; token connections handler parses message string again.
+// Keep the replicas in sync with Call.cc and TokenBasedConnectionsHandler.cc.
+//
+// Phases, every message is run thru each phase --iterations times:
+//   parse  Json::Reader on the message as it came from websocket (ChannelingManager, SignallingHandler::ReceiveMessage)
+//   route  SignallingHandler::ReceiveMessage with parsed message, including receivers
+//   p2p    SignallingHandler::ReceivedDataChannelData with message Data as peer sends it thru data channel
+//   wrap   SignallingHandler::SendOffer/SendAnswer/SendCandidate/SendBye/SendMessage with payload of the message
+// Then the whole input is replayed in order as the app would do it: received messages are parsed and routed,
+// sent messages are wrapped.
+//
+// Build on Linux (jsoncpp is needed), from this directory:
+//   cc -O2 -c ../../SpreedME/SpreedME/common_definitions/ChannelingConstants.c
+//   c++ -std=c++11 -O2 -I../compat -include ../compat/bench_prefix.h -D_UINT64_T -I../../SpreedME/SpreedME/Classes/cpp
+//       -I../../SpreedME/SpreedME/Classes/cpp/webrtc_extensions -I../../SpreedME/SpreedME/common_definitions
+//       -I../../SpreedME/SpreedME/utils -I/usr/include/jsoncpp signalling_replay_bench.cc ../../SpreedME/SpreedME/Classes/cpp/SignallingHandler.cc
+//       ../../SpreedME/SpreedME/Classes/cpp/SignallingMessageAnonymizer.cc ChannelingConstants.o
+//       -ljsoncpp -o signalling_replay_bench
+// ../compat has to come before webrtc_extensions, so the fake PeerConnectionWrapper.h is used.
+// -D_UINT64_T keeps STByteCount.h from declaring uint64_t again.
+//
+// Usage:
+//   signalling_replay_bench [--iterations 20] [--synthetic peers] [--anonymize out.smsr] [file ...]
+// Files are recordings written by SignallingTrafficRecorder (hidden SMSignallingRecordingEnabled setting puts them
+// to Caches/SignallingRecordings) or plain captures with one websocket message per line, which count as received.
+// --synthetic adds call setup storm of given number of peers: offers with full audio/video/data SDP, answers,
+// candidates, token offers for file transfers, presence, chat and byes.
+// --anonymize writes all input messages as anonymized recording, for sharing captures made without recorder.
+// Exit code is 1 if there was nothing to replay or if any message failed to parse.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <webrtc/base/json.h>
+
+#include "ChannelingConstants.h"
+#include "PeerConnectionWrapper.h"
+#include "SignallingHandler.h"
+#include "SignallingMessageAnonymizer.h"
+#include "SignallingTrafficRecorder.h"
+
+using namespace spreedme;
+
+
+namespace {
+
+const char kSelfId[] = "self";
+const char kWebsocketWrapperId[] = "";
+
+
+struct RecordedMessage
+{
+	RecordedMessage() : timeMs(0), direction(kSignallingRecordReceived) {};
+	
+	uint64_t timeMs;
+	SignallingRecordDirection direction;
+	std::string msg;
+	
+	// Filled in by PrepareMessage
+	std::string type;
+	Json::Value root;
+	std::string from;
+	std::string p2pData; // Data as peer would send it thru data channel, empty if it can't go p2p
+	Json::Value payload; // Offer/Answer/Candidate/Bye object or Data for other types
+};
+
+
+/*------------------------------------ Fakes and receiver replicas ---------------------------------*/
+
+class CountingServerSender : public ServerBasedMessageSenderInterface
+{
+public:
+	CountingServerSender() : messages_(0), bytes_(0) {};
+	
+	virtual void SendMessage(const std::string &msg) {++messages_; bytes_ += msg.size();};
+	
+	uint64_t messages() const {return messages_;};
+	uint64_t bytes() const {return bytes_;};
+	
+private:
+	uint64_t messages_;
+	uint64_t bytes_;
+};
+
+
+class FakeWrapperProvider : public PeerConnectionWrapperProviderInterface
+{
+public:
+	~FakeWrapperProvider()
+	{
+		for (std::map<std::string, PeerConnectionWrapper *>::iterator it = wrappers_.begin(); it != wrappers_.end(); ++it) {
+			delete it->second;
+		}
+	};
+	
+	// Every peer gets wrapper with opened data channel, like in a running call.
+	PeerConnectionWrapper *WrapperForUserId(const std::string &userId)
+	{
+		std::map<std::string, PeerConnectionWrapper *>::iterator it = wrappers_.find(userId);
+		if (it != wrappers_.end()) {
+			return it->second;
+		}
+		PeerConnectionWrapper *wrapper = new PeerConnectionWrapper(userId, "wrapper-" + userId, true);
+		wrappers_[userId] = wrapper;
+		wrappersById_[wrapper->factoryId()] = wrapper;
+		return wrapper;
+	};
+	
+	virtual PeerConnectionWrapper *GetP2PWrapperForUserId(const std::string &userId)
+	{
+		std::map<std::string, PeerConnectionWrapper *>::iterator it = wrappers_.find(userId);
+		return it != wrappers_.end() ? it->second : NULL;
+	};
+	virtual PeerConnectionWrapper *GetP2PWrapperForWrapperId(const std::string &wrapperId)
+	{
+		std::map<std::string, PeerConnectionWrapper *>::iterator it = wrappersById_.find(wrapperId);
+		return it != wrappersById_.end() ? it->second : NULL;
+	};
+	
+private:
+	std::map<std::string, PeerConnectionWrapper *> wrappers_;
+	std::map<std::string, PeerConnectionWrapper *> wrappersById_;
+};
+
+
+struct RoutedCounts
+{
+	RoutedCounts() : offers(0), answers(0), candidates(0), conferences(0), videoSubscriptions(0), other(0), tokenMessages(0), sdpBytes(0) {};
+	
+	uint64_t offers;
+	uint64_t answers;
+	uint64_t candidates;
+	uint64_t conferences;
+	uint64_t videoSubscriptions;
+	uint64_t other;
+	uint64_t tokenMessages;
+	uint64_t sdpBytes; // keeps extracted fields alive, so compiler can't drop the work
+};
+
+
+// Call::MessageReceived (JsonSignallingMessageData copy) and Call::MessageReceived_w without webrtc parts.
+class CallRoutingReplica : public SignallingMessageReceiverInterface
+{
+public:
+	explicit CallRoutingReplica(RoutedCounts *counts) : counts_(counts) {};
+	
+	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+	{
+		Json::Reader jsonReader;
+		Json::Value root;
+		if (jsonReader.parse(msg, root)) {
+			this->MessageReceived_w(root, transportType, wrapperId);
+		}
+	};
+	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token) {};
+	virtual void MessageReceived(const Json::Value &root, const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+	{
+		Json::Value copy(root); // posted to worker thread
+		this->MessageReceived_w(copy, transportType, wrapperId);
+	};
+	
+private:
+	void MessageReceived_w(const Json::Value &root, ChannelingMessageTransportType transportType, const std::string& wrapperId)
+	{
+		const Json::Value &innerJson = root[kDataKey];
+		if (innerJson.isNull()) {
+			return;
+		}
+		std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
+		std::string from = root.get(kFromKey, Json::Value()).asString();
+		if (messageType == kOfferKey) {
+			Json::Value wrappedOffer = innerJson.get(kOfferKey, Json::Value());
+			std::string sdp = wrappedOffer.get(kSessionDescriptionSdpKey, Json::Value()).asString();
+			std::string id = wrappedOffer.get(kDataChannelIdKey, Json::Value()).asString();
+			std::string token = wrappedOffer.get(kDataChannelTokenKey, Json::Value()).asString();
+			std::string conferenceId = wrappedOffer.get(kOfferConferenceKey, Json::Value()).asString();
+			counts_->sdpBytes += sdp.size() + id.size() + token.size() + conferenceId.size() + from.size();
+			++counts_->offers;
+		} else if (messageType == kAnswerKey) {
+			Json::Value wrappedAnswer = innerJson.get(kAnswerKey, Json::Value());
+			std::string sdp = wrappedAnswer.get(kSessionDescriptionSdpKey, Json::Value()).asString();
+			counts_->sdpBytes += sdp.size() + from.size();
+			++counts_->answers;
+		} else if (messageType == kCandidateKey) {
+			Json::Value wrappedCandidate = innerJson.get(kCandidateKey, Json::Value());
+			std::string sdpMid = wrappedCandidate.get(kCandidateSdpMidKey, Json::Value()).asString();
+			int sdpMLineIndex = wrappedCandidate.get(kCandidateSdpMlineIndexKey, Json::Value(-1)).asInt();
+			std::string candidateString = wrappedCandidate.get(kCandidateSdpKey, Json::Value()).asString();
+			counts_->sdpBytes += sdpMid.size() + candidateString.size() + from.size() + (sdpMLineIndex > -1 ? 1 : 0);
+			++counts_->candidates;
+		} else if (messageType == kConferenceKey) {
+			const Json::Value &ids = innerJson[kConferenceKey];
+			for (Json::ArrayIndex i = 0; ids.isArray() && i < ids.size(); ++i) {
+				counts_->sdpBytes += ids[i].asString().size();
+			}
+			++counts_->conferences;
+		} else if (messageType == kVideoSubscriptionKey) {
+			counts_->sdpBytes += innerJson.get(kVideoSubscriptionWidthKey, Json::Value(0)).asInt();
+			++counts_->videoSubscriptions;
+		} else {
+			++counts_->other;
+		}
+	};
+	
+	RoutedCounts *counts_;
+};
+
+
+// TokenBasedConnectionsHandler::MessageReceived_s without webrtc parts. It gets message string and parses it again.
+class TokenRoutingReplica : public SignallingMessageReceiverInterface
+{
+public:
+	explicit TokenRoutingReplica(RoutedCounts *counts) : counts_(counts) {};
+	
+	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId) {};
+	virtual void MessageReceived(const std::string &msg, ChannelingMessageTransportType transportType, const std::string& wrapperId, const std::string &token)
+	{
+		Json::Reader jsonReader;
+		Json::Value root;
+		if (!jsonReader.parse(msg, root)) {
+			return;
+		}
+		Json::Value innerJson = root[kDataKey];
+		std::string messageType = innerJson.get(kTypeKey, Json::Value()).asString();
+		std::string from = root.get(kFromKey, Json::Value()).asString();
+		const Json::Value &offerAnswerCandidate = innerJson[messageType];
+		counts_->sdpBytes += offerAnswerCandidate.get(kSessionDescriptionSdpKey, Json::Value()).asString().size() + from.size() + token.size();
+		++counts_->tokenMessages;
+	};
+	
+private:
+	RoutedCounts *counts_;
+};
+
+
+/*------------------------------------ Input -------------------------------------------------------*/
+
+bool ParseRecordingLine(const std::string &line, RecordedMessage *message)
+{
+	if (line.empty() || line[0] == '#') {
+		return false;
+	}
+	
+	if (line[0] == '{') {
+		// Plain capture, like websocket_deflate_bench reads
+		message->direction = kSignallingRecordReceived;
+		message->msg = line;
+		return true;
+	}
+	
+	char *end = NULL;
+	message->timeMs = strtoull(line.c_str(), &end, 10);
+	size_t position = end - line.c_str();
+	if (position + 3 > line.size() || line[position] != ' ' || line[position + 2] != ' ') {
+		return false;
+	}
+	char direction = line[position + 1];
+	if (direction != kSignallingRecordReceived && direction != kSignallingRecordReceivedP2P && direction != kSignallingRecordSent) {
+		return false;
+	}
+	message->direction = (SignallingRecordDirection)direction;
+	message->msg = line.substr(position + 3);
+	return true;
+}
+
+
+bool ReadMessages(const char *path, std::vector<RecordedMessage> *messages)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	
+	std::string line;
+	size_t lineNumber = 0;
+	while (std::getline(file, line)) {
+		++lineNumber;
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		RecordedMessage message;
+		if (ParseRecordingLine(line, &message)) {
+			messages->push_back(message);
+		} else if (!line.empty() && line[0] != '#') {
+			fprintf(stderr, "%s:%zu: not a recorded message\n", path, lineNumber);
+		}
+	}
+	return true;
+}
+
+
+/*------------------------------------ Synthetic traffic ------------------------------------------*/
+
+std::string SyntheticSdp(const std::string &type, int peer)
+{
+	char buffer[64];
+	std::string sdp;
+	snprintf(buffer, sizeof(buffer), "v=0\r\no=- %d%08d 2 IN IP4 127.0.0.1\r\n", 4611 + peer, 73912 * (peer + 1));
+	sdp += buffer;
+	sdp += "s=-\r\nt=0 0\r\na=group:BUNDLE audio video data\r\na=msid-semantic: WMS stream\r\n";
+	
+	const char *media[] = {"audio", "video", "data"};
+	for (int m = 0; m < 3; ++m) {
+		if (m == 0) {
+			sdp += "m=audio 9 UDP/TLS/RTP/SAVPF 111 103 104 9 102 0 8 106 105 13 110 112 113 126\r\n";
+		} else if (m == 1) {
+			sdp += "m=video 9 UDP/TLS/RTP/SAVPF 96 97 98 99 100 101 127 124 125\r\n";
+		} else {
+			sdp += "m=application 9 DTLS/SCTP 5000\r\n";
+		}
+		sdp += "c=IN IP4 0.0.0.0\r\na=rtcp:9 IN IP4 0.0.0.0\r\n";
+		snprintf(buffer, sizeof(buffer), "a=ice-ufrag:uF%02dq\r\n", peer % 100);
+		sdp += buffer;
+		sdp += "a=ice-pwd:Q2vS3dN4mPb8a1xZ0yK7cT5h\r\na=ice-options:trickle renomination\r\n";
+		sdp += "a=fingerprint:sha-256 4A:AD:B9:B1:3F:82:18:3B:54:02:12:DF:3E:5D:49:6B:19:E5:7C:AB:4A:AD:B9:B1:3F:82:18:3B:54:02:12:DF\r\n";
+		sdp += type == "answer" ? "a=setup:active\r\n" : "a=setup:actpass\r\n";
+		sdp += std::string("a=mid:") + media[m] + "\r\n";
+		if (m == 2) {
+			sdp += "a=sctpmap:5000 webrtc-datachannel 1024\r\n";
+			continue;
+		}
+		sdp += "a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\na=extmap:3 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n";
+		sdp += "a=sendrecv\r\na=rtcp-mux\r\n";
+		if (m == 0) {
+			sdp += "a=rtpmap:111 opus/48000/2\r\na=rtcp-fb:111 transport-cc\r\na=fmtp:111 minptime=10;useinbandfec=1\r\n"
+				   "a=rtpmap:103 ISAC/16000\r\na=rtpmap:104 ISAC/32000\r\na=rtpmap:9 G722/8000\r\na=rtpmap:102 ILBC/8000\r\n"
+				   "a=rtpmap:0 PCMU/8000\r\na=rtpmap:8 PCMA/8000\r\na=rtpmap:106 CN/32000\r\na=rtpmap:105 CN/16000\r\n"
+				   "a=rtpmap:13 CN/8000\r\na=rtpmap:110 telephone-event/48000\r\na=rtpmap:112 telephone-event/32000\r\n"
+				   "a=rtpmap:113 telephone-event/16000\r\na=rtpmap:126 telephone-event/8000\r\n";
+		} else {
+			sdp += "a=rtpmap:96 VP8/90000\r\na=rtcp-fb:96 goog-remb\r\na=rtcp-fb:96 transport-cc\r\na=rtcp-fb:96 ccm fir\r\n"
+				   "a=rtcp-fb:96 nack\r\na=rtcp-fb:96 nack pli\r\na=rtpmap:97 rtx/90000\r\na=fmtp:97 apt=96\r\n"
+				   "a=rtpmap:98 VP9/90000\r\na=rtcp-fb:98 goog-remb\r\na=rtcp-fb:98 transport-cc\r\na=rtcp-fb:98 ccm fir\r\n"
+				   "a=rtcp-fb:98 nack\r\na=rtcp-fb:98 nack pli\r\na=rtpmap:99 rtx/90000\r\na=fmtp:99 apt=98\r\n"
+				   "a=rtpmap:100 H264/90000\r\na=rtcp-fb:100 goog-remb\r\na=rtcp-fb:100 transport-cc\r\na=rtcp-fb:100 ccm fir\r\n"
+				   "a=rtcp-fb:100 nack\r\na=rtcp-fb:100 nack pli\r\n"
+				   "a=fmtp:100 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"
+				   "a=rtpmap:101 rtx/90000\r\na=fmtp:101 apt=100\r\na=rtpmap:127 red/90000\r\na=rtpmap:124 rtx/90000\r\n"
+				   "a=fmtp:124 apt=127\r\na=rtpmap:125 ulpfec/90000\r\n";
+		}
+		for (int ssrc = 0; ssrc < (m == 0 ? 1 : 2); ++ssrc) {
+			unsigned long ssrcNumber = 1000000000UL + peer * 1000 + m * 10 + ssrc;
+			const char *attributes[] = {"cname:Xq3sZ9Ob4Vn1dLk2", "msid:stream track", "mslabel:stream", "label:track"};
+			for (int a = 0; a < 4; ++a) {
+				snprintf(buffer, sizeof(buffer), "a=ssrc:%lu %s\r\n", ssrcNumber, attributes[a]);
+				sdp += buffer;
+			}
+		}
+	}
+	
+	return sdp;
+}
+
+
+std::string SyntheticCandidate(int peer, int index)
+{
+	char buffer[256];
+	if (index % 3 == 2) {
+		snprintf(buffer, sizeof(buffer), "candidate:%d 1 udp 1686052607 198.51.%d.%d %d typ srflx raddr 192.168.%d.%d rport %d generation 0 ufrag uF%02dq network-id 1 network-cost 10",
+				 842163049 + index, peer % 250, index % 250, 50000 + index, peer % 250, index % 250, 50000 + index, peer % 100);
+	} else {
+		snprintf(buffer, sizeof(buffer), "candidate:%d 1 %s 2122260223 192.168.%d.%d %d typ host %sgeneration 0 ufrag uF%02dq network-id 1 network-cost 10",
+				 1467250027 + index, index % 3 ? "tcp" : "udp", peer % 250, index % 250, index % 3 ? 9 : 50000 + index, index % 3 ? "tcptype active " : "", peer % 100);
+	}
+	return buffer;
+}
+
+
+// Message as server delivers it
+std::string ReceivedMessage(const std::string &from, const Json::Value &data)
+{
+	Json::Value root;
+	root[kDataKey] = data;
+	root[kFromKey] = from;
+	root[kToKey] = kSelfId;
+	root[kTypeKey] = data.get(kTypeKey, Json::Value()).asString();
+	Json::FastWriter writer;
+	return writer.write(root);
+}
+
+
+void AddReceived(const std::string &from, const Json::Value &data, uint64_t timeMs, std::vector<RecordedMessage> *messages)
+{
+	RecordedMessage message;
+	message.timeMs = timeMs;
+	message.direction = kSignallingRecordReceived;
+	message.msg = ReceivedMessage(from, data);
+	message.msg.resize(message.msg.size() - 1); // FastWriter adds new line
+	messages->push_back(message);
+}
+
+
+void AddSent(const std::string &type, const Json::Value &payload, uint64_t timeMs, std::vector<RecordedMessage> *messages)
+{
+	Json::Value root;
+	root[kTypeKey] = type;
+	root[type] = payload;
+	Json::FastWriter writer;
+	RecordedMessage message;
+	message.timeMs = timeMs;
+	message.direction = kSignallingRecordSent;
+	message.msg = writer.write(root);
+	message.msg.resize(message.msg.size() - 1);
+	messages->push_back(message);
+}
+
+
+// Sent messages look like SignallingHandler::SendOffer etc. make them
+Json::Value WrappedForSending(const std::string &type, const std::string &to, const Json::Value &payload)
+{
+	Json::Value wrapped;
+	SignallingHandler::WrapJsonBeforeSending(payload, kSelfId, to, type, wrapped);
+	return wrapped;
+}
+
+
+void GenerateSyntheticTraffic(int peers, std::vector<RecordedMessage> *messages)
+{
+	std::string picture = "data:image/jpeg;base64," + std::string(6000, 'A');
+	Json::Value conference(Json::arrayValue);
+	conference.append(kSelfId);
+	
+	for (int p = 0; p < peers; ++p) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "peer%04dxq7GzVb2kLmN9sRtYw4", p);
+		std::string peer(buffer);
+		uint64_t t = p * 250;
+		
+		Json::Value status;
+		status[kLCDisplayNameKey] = "Peer " + peer.substr(0, 8);
+		status[kLCBuddyPictureKey] = picture;
+		Json::Value joined;
+		joined[kTypeKey] = kJoinedKey;
+		joined[kIdKey] = peer;
+		joined[kUserIdKey] = "";
+		joined[kUserAgentKey] = "Mozilla/5.0 (iPhone; CPU iPhone OS 10_3 like Mac OS X) AppleWebKit/603.1.30";
+		joined[kStatusKey] = status;
+		AddReceived(peer, joined, t, messages);
+		
+		Json::Value offer;
+		offer[kLCTypeKey] = "offer";
+		offer[kSessionDescriptionSdpKey] = SyntheticSdp("offer", p);
+		if (p > 0) {
+			offer[kOfferConferenceKey] = "conference-1";
+		}
+		Json::Value offerData;
+		offerData[kTypeKey] = kOfferKey;
+		offerData[kToKey] = kSelfId;
+		offerData[kOfferKey] = offer;
+		AddReceived(peer, offerData, t + 20, messages);
+		
+		Json::Value answer;
+		answer[kLCTypeKey] = "answer";
+		answer[kSessionDescriptionSdpKey] = SyntheticSdp("answer", p);
+		AddSent(kAnswerKey, WrappedForSending(kAnswerKey, peer, answer), t + 40, messages);
+		
+		for (int c = 0; c < 8; ++c) {
+			Json::Value candidate;
+			candidate[kLCTypeKey] = kCandidateSdpKey;
+			candidate[kCandidateSdpMidKey] = c % 2 ? "video" : "audio";
+			candidate[kCandidateSdpMlineIndexKey] = c % 2;
+			candidate[kCandidateSdpKey] = SyntheticCandidate(p, c);
+			AddSent(kCandidateKey, WrappedForSending(kCandidateKey, peer, candidate), t + 42 + c, messages);
+			
+			Json::Value candidateData;
+			candidateData[kTypeKey] = kCandidateKey;
+			candidateData[kToKey] = kSelfId;
+			candidateData[kCandidateKey] = candidate;
+			candidateData[kCandidateKey][kCandidateSdpKey] = SyntheticCandidate(p + 1000, c);
+			AddReceived(peer, candidateData, t + 45 + c, messages);
+		}
+		
+		conference.append(peer);
+		Json::Value conferenceData;
+		conferenceData[kTypeKey] = kConferenceKey;
+		conferenceData[kIdKey] = "conference-1";
+		conferenceData[kConferenceKey] = conference;
+		AddReceived(peer, conferenceData, t + 60, messages);
+		
+		// File transfer connection, goes to token message receivers
+		Json::Value tokenOffer;
+		tokenOffer[kLCTypeKey] = "offer";
+		tokenOffer[kSessionDescriptionSdpKey] = SyntheticSdp("offer", p + 500);
+		tokenOffer[kDataChannelTokenKey] = "filetoken-" + peer;
+		tokenOffer[kDataChannelIdKey] = "fileconnection-" + peer;
+		Json::Value tokenOfferData;
+		tokenOfferData[kTypeKey] = kOfferKey;
+		tokenOfferData[kToKey] = kSelfId;
+		tokenOfferData[kOfferKey] = tokenOffer;
+		AddReceived(peer, tokenOfferData, t + 100, messages);
+		
+		Json::Value chat;
+		chat[kMessageKey] = "Hello from " + peer + ", can you see my video now?";
+		chat[kMidKey] = "mid-" + peer;
+		Json::Value chatData;
+		chatData[kTypeKey] = kChatKey;
+		chatData[kToKey] = kSelfId;
+		chatData[kChatKey] = chat;
+		AddReceived(peer, chatData, t + 150, messages);
+		
+		// Talking and video subscriptions go thru data channel once call is up
+		Json::Value talking;
+		talking[kTypeKey] = kTalkingKey;
+		talking[kTalkingKey] = true;
+		Json::Value p2pTalking;
+		SignallingHandler::WrapP2PJson(talking, kSelfId, peer, p2pTalking);
+		RecordedMessage talkingMessage;
+		talkingMessage.timeMs = t + 160;
+		talkingMessage.direction = kSignallingRecordReceivedP2P;
+		talkingMessage.msg = p2pTalking.toStyledString();
+		messages->push_back(talkingMessage);
+		
+		Json::Value subscription;
+		subscription[kVideoSubscriptionActiveKey] = true;
+		subscription[kVideoSubscriptionWidthKey] = 320;
+		subscription[kVideoSubscriptionHeightKey] = 240;
+		Json::Value subscriptionData;
+		subscriptionData[kTypeKey] = kVideoSubscriptionKey;
+		subscriptionData[kVideoSubscriptionKey] = subscription;
+		Json::Value p2pSubscription;
+		SignallingHandler::WrapP2PJson(subscriptionData, kSelfId, peer, p2pSubscription);
+		RecordedMessage subscriptionMessage;
+		subscriptionMessage.timeMs = t + 170;
+		subscriptionMessage.direction = kSignallingRecordReceivedP2P;
+		subscriptionMessage.msg = p2pSubscription.toStyledString();
+		messages->push_back(subscriptionMessage);
+	}
+	
+	for (int p = 0; p < peers; ++p) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "peer%04dxq7GzVb2kLmN9sRtYw4", p);
+		Json::Value bye;
+		bye[kByeReasonKey] = kByeReasonAbortString;
+		Json::Value byeData;
+		byeData[kTypeKey] = kByeKey;
+		byeData[kToKey] = kSelfId;
+		byeData[kByeKey] = bye;
+		AddReceived(buffer, byeData, peers * 250 + p, messages);
+	}
+}
+
+
+/*------------------------------------ Benchmark --------------------------------------------------*/
+
+// Fills in parsed parts of @message. Returns false if message is not json object.
+bool PrepareMessage(RecordedMessage *message)
+{
+	Json::Reader reader;
+	if (!reader.parse(message->msg, message->root) || !message->root.isObject()) {
+		return false;
+	}
+	
+	// Received messages carry Data, sent ones are {Type: type, type: data}
+	Json::Value data;
+	if (message->direction == kSignallingRecordSent) {
+		message->type = message->root.get(kTypeKey, Json::Value()).asString();
+		data = message->root[message->type];
+		message->from = data.isObject() ? data.get(kToKey, Json::Value()).asString() : std::string();
+	} else {
+		data = message->root[kDataKey];
+		message->type = data.isObject() ? data.get(kTypeKey, Json::Value()).asString() : std::string();
+		message->from = message->root.get(kFromKey, Json::Value()).asString();
+	}
+	if (message->type.empty()) {
+		message->type = "unknown";
+	}
+	
+	if (data.isObject() && SignallingHandler::IsChannelingMessage(data)) {
+		Json::StyledWriter writer;
+		message->p2pData = writer.write(data);
+	}
+	
+	if (data.isObject() && data[message->type].isObject() &&
+		(message->type == kOfferKey || message->type == kAnswerKey || message->type == kCandidateKey || message->type == kByeKey)) {
+		message->payload = data[message->type];
+	} else {
+		message->payload = data;
+	}
+	
+	return true;
+}
+
+
+class ReplayBench
+{
+public:
+	ReplayBench() : handler_(kSelfId, &serverSender_), callReplica_(&counts_), tokenReplica_(&counts_)
+	{
+		handler_.SetWrapperProvider(&wrapperProvider_);
+		handler_.RegisterMessageReceiver(&callReplica_);
+		handler_.RegisterTokenMessageReceiver(&tokenReplica_);
+	};
+	~ReplayBench()
+	{
+		handler_.UnRegisterMessageReceiver(&callReplica_);
+		handler_.UnRegisterTokenMessageReceiver(&tokenReplica_);
+	};
+	
+	void Parse(const RecordedMessage &message)
+	{
+		Json::Reader reader;
+		Json::Value root;
+		reader.parse(message.msg, root);
+	};
+	
+	bool CanRoute(const RecordedMessage &message) {return message.direction != kSignallingRecordSent;};
+	void Route(const RecordedMessage &message)
+	{
+		if (message.direction == kSignallingRecordReceivedP2P) {
+			handler_.ReceiveMessage(message.root, message.msg, kPeerToPeer, this->Wrapper(message)->factoryId());
+		} else {
+			handler_.ReceiveMessage(message.root, message.msg, kWebsocketChannelingServer, kWebsocketWrapperId);
+		}
+	};
+	
+	bool CanReceiveP2P(const RecordedMessage &message) {return !message.p2pData.empty() && !message.from.empty();};
+	void ReceiveP2P(const RecordedMessage &message)
+	{
+		PeerConnectionWrapper *wrapper = this->Wrapper(message);
+		webrtc::DataChannelInterface *dataChannel = wrapper->DataChannelForName(kDefaultDataChannelLabel);
+		handler_.ReceivedDataChannelData(new webrtc::DataBuffer(message.p2pData), dataChannel, wrapper);
+	};
+	
+	void Wrap(const RecordedMessage &message)
+	{
+		const Json::Value &payload = message.payload;
+		std::string token = payload.get(kDataChannelTokenKey, Json::Value()).asString();
+		std::string id = payload.get(kDataChannelIdKey, Json::Value()).asString();
+		
+		if (message.type == kOfferKey) {
+			handler_.SendOffer(payload.get(kLCTypeKey, Json::Value()).asString(),
+							   payload.get(kSessionDescriptionSdpKey, Json::Value()).asString(),
+							   token, id, payload.get(kOfferConferenceKey, Json::Value()).asString(), this->Wrapper(message));
+		} else if (message.type == kAnswerKey) {
+			handler_.SendAnswer(payload.get(kLCTypeKey, Json::Value()).asString(),
+								payload.get(kSessionDescriptionSdpKey, Json::Value()).asString(),
+								token, id, this->Wrapper(message));
+		} else if (message.type == kCandidateKey) {
+			IceCandidateStringRepresentation *candidate =
+				new IceCandidateStringRepresentation(payload.get(kCandidateSdpMidKey, Json::Value()).asString(),
+													 payload.get(kCandidateSdpMlineIndexKey, Json::Value(0)).asInt(),
+													 payload.get(kCandidateSdpKey, Json::Value()).asString());
+			handler_.SendCandidate(candidate, token, id, this->Wrapper(message));
+		} else if (message.type == kByeKey) {
+			handler_.SendBye(message.from, kByeReasonNotSpecified, NULL);
+		} else {
+			// Like ChannelingManager sendMessage:type:to:, without known peer it goes thru server
+			handler_.SendMessage(message.type, message.p2pData.empty() ? message.msg : message.p2pData, std::string());
+		}
+	};
+	
+	const RoutedCounts &counts() const {return counts_;};
+	const CountingServerSender &serverSender() const {return serverSender_;};
+	
+private:
+	PeerConnectionWrapper *Wrapper(const RecordedMessage &message) {return wrapperProvider_.WrapperForUserId(message.from);};
+	
+	CountingServerSender serverSender_;
+	FakeWrapperProvider wrapperProvider_;
+	RoutedCounts counts_;
+	SignallingHandler handler_;
+	CallRoutingReplica callReplica_;
+	TokenRoutingReplica tokenReplica_;
+};
+
+
+struct TypeTotals
+{
+	TypeTotals() : messages(0), bytes(0) {};
+	
+	std::vector<size_t> indexes;
+	uint64_t messages;
+	uint64_t bytes;
+};
+
+
+typedef enum Phase {
+	kPhaseParse = 0,
+	kPhaseRoute,
+	kPhaseP2P,
+	kPhaseWrap,
+	kPhasesCount,
+}
+Phase;
+
+
+// Returns mean microseconds per message or negative value if phase doesn't apply to any message of the type.
+double MeasurePhase(ReplayBench *bench, Phase phase, const std::vector<RecordedMessage> &messages, const std::vector<size_t> &indexes, int iterations)
+{
+	std::vector<const RecordedMessage *> applicable;
+	for (size_t i = 0; i < indexes.size(); ++i) {
+		const RecordedMessage &message = messages[indexes[i]];
+		if ((phase == kPhaseRoute && !bench->CanRoute(message)) ||
+			(phase == kPhaseP2P && !bench->CanReceiveP2P(message))) {
+			continue;
+		}
+		applicable.push_back(&message);
+	}
+	if (applicable.empty()) {
+		return -1.0;
+	}
+	
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		for (size_t i = 0; i < applicable.size(); ++i) {
+			switch (phase) {
+				case kPhaseParse: bench->Parse(*applicable[i]); break;
+				case kPhaseRoute: bench->Route(*applicable[i]); break;
+				case kPhaseP2P: bench->ReceiveP2P(*applicable[i]); break;
+				case kPhaseWrap: bench->Wrap(*applicable[i]); break;
+				default: break;
+			}
+		}
+	}
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+	
+	return std::chrono::duration<double, std::micro>(elapsed).count() / ((double)iterations * applicable.size());
+}
+
+
+void PrintPhase(double us)
+{
+	if (us < 0) {
+		printf(" %9s", "-");
+	} else {
+		printf(" %9.2f", us);
+	}
+}
+
+
+bool WriteAnonymizedRecording(const char *path, const std::vector<RecordedMessage> &messages)
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open()) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	
+	SignallingMessageAnonymizer anonymizer;
+	file << kSignallingRecordingHeader << '\n';
+	for (size_t i = 0; i < messages.size(); ++i) {
+		std::string anonymized = anonymizer.AnonymizeMessage(messages[i].msg);
+		if (!anonymized.empty()) {
+			file << messages[i].timeMs << ' ' << (char)messages[i].direction << ' ' << anonymized << '\n';
+		}
+	}
+	
+	return file.good();
+}
+
+
+void PrintUsage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [--iterations 20] [--synthetic peers] [--anonymize out.smsr] [file ...]\n", name);
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+	int iterations = 20;
+	int syntheticPeers = 0;
+	const char *anonymizedPath = NULL;
+	std::vector<RecordedMessage> messages;
+	
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--iterations" && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+		} else if (arg == "--synthetic" && i + 1 < argc) {
+			syntheticPeers = atoi(argv[++i]);
+		} else if (arg == "--anonymize" && i + 1 < argc) {
+			anonymizedPath = argv[++i];
+		} else if (arg.compare(0, 2, "--") == 0) {
+			PrintUsage(argv[0]);
+			return 1;
+		} else if (!ReadMessages(argv[i], &messages)) {
+			return 1;
+		}
+	}
+	if (iterations < 1) {
+		iterations = 1;
+	}
+	if (syntheticPeers > 0) {
+		GenerateSyntheticTraffic(syntheticPeers, &messages);
+	}
+	if (messages.empty()) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	
+	if (anonymizedPath && !WriteAnonymizedRecording(anonymizedPath, messages)) {
+		return 1;
+	}
+	
+	bool success = true;
+	uint64_t totalBytes = 0;
+	std::map<std::string, TypeTotals> types;
+	for (size_t i = 0; i < messages.size(); ++i) {
+		if (!PrepareMessage(&messages[i])) {
+			fprintf(stderr, "Message %zu is not a json object\n", i + 1);
+			success = false;
+			continue;
+		}
+		TypeTotals &totals = types[messages[i].type];
+		totals.indexes.push_back(i);
+		totals.messages += 1;
+		totals.bytes += messages[i].msg.size();
+		totalBytes += messages[i].msg.size();
+	}
+	
+	printf("%zu messages, %llu bytes, %d iterations\n", messages.size(), (unsigned long long)totalBytes, iterations);
+	printf("%-18s %8s %9s %9s %9s %9s %9s   (us per message)\n", "type", "messages", "bytes", "parse", "route", "p2p", "wrap");
+	
+	ReplayBench bench;
+	for (std::map<std::string, TypeTotals>::iterator it = types.begin(); it != types.end(); ++it) {
+		printf("%-18s %8llu %9.0f", it->first.c_str(), (unsigned long long)it->second.messages, (double)it->second.bytes / it->second.messages);
+		for (int phase = 0; phase < kPhasesCount; ++phase) {
+			PrintPhase(MeasurePhase(&bench, (Phase)phase, messages, it->second.indexes, iterations));
+		}
+		printf("\n");
+	}
+	
+	// Whole input in order: received messages are parsed and routed, sent ones wrapped
+	ReplayBench replay;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int iteration = 0; iteration < iterations; ++iteration) {
+		for (size_t i = 0; i < messages.size(); ++i) {
+			const RecordedMessage &message = messages[i];
+			if (message.root.isNull()) {
+				continue;
+			}
+			if (replay.CanRoute(message)) {
+				replay.Parse(message);
+				replay.Route(message);
+			} else {
+				replay.Wrap(message);
+			}
+		}
+	}
+	double replayMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+	printf("replay: %.3f ms per pass, %.0f messages/s, %.1f MB/s\n",
+		   replayMs, replayMs > 0 ? messages.size() / (replayMs / 1000.0) : 0.0,
+		   replayMs > 0 ? totalBytes / (1024.0 * 1024.0) / (replayMs / 1000.0) : 0.0);
+	
+	const RoutedCounts &counts = replay.counts();
+	printf("routed per pass: %llu offers, %llu answers, %llu candidates, %llu conferences, %llu video subscriptions, %llu other, %llu token messages; "
+		   "%llu messages wrapped for server\n",
+		   (unsigned long long)counts.offers / iterations, (unsigned long long)counts.answers / iterations,
+		   (unsigned long long)counts.candidates / iterations, (unsigned long long)counts.conferences / iterations,
+		   (unsigned long long)counts.videoSubscriptions / iterations, (unsigned long long)counts.other / iterations,
+		   (unsigned long long)counts.tokenMessages / iterations,
+		   (unsigned long long)replay.serverSender().messages() / iterations);
+	
+	return success ? 0 : 1;
+}
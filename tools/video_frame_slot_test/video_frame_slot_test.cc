@@ -0,0 +1,296 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Headless test of the video render pipeline: a VideoRenderer without view pushes frames into its VideoFrameSlot
+// and a simulated display polls the slot like SMRTCVideoRenderView does from its CADisplayLink.
+//
+// Checks:
+//   hold       frame which is being drawn isn't overwritten while a newer frame waits for its due time
+//   tearing    producer and display threads run concurrently, drawn frame never changes under the display
+//   pacing     30 and 24 fps sources on 60 Hz display: refresh interval follows source, no frame is superseded
+//   visibility invisible slot drops frames without copying and presents nothing
+//   reuse      buffers are allocated only when frame size changes
+//
+// Build on Linux, from this directory:
+//   c++ -std=c++11 -O2 -pthread -I../compat -I../../SpreedME/SpreedME/Classes/cpp/webrtc_extensions
+//       -I../../SpreedME/SpreedME/utils video_frame_slot_test.cc
+//       ../../SpreedME/SpreedME/Classes/cpp/webrtc_extensions/VideoFrameSlot.cc -o video_frame_slot_test
+//
+// Usage:
+//   video_frame_slot_test
+// Exit code is 1 if any check has failed.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "VideoRenderer.h"
+
+using namespace spreedme;
+
+
+namespace {
+
+const int64 kDisplayRefreshUs = 16667;
+
+
+// Counts buffers VideoFrameSlot allocates thru incoming frame.
+class CountingVideoFrame : public cricket::VideoFrame
+{
+public:
+	CountingVideoFrame(int width, int height, int64 timeStampNs) :
+		cricket::VideoFrame(width, height, 0, timeStampNs) {};
+	
+	virtual cricket::VideoFrame *CreateEmptyFrame(int width, int height, size_t pixelWidth, size_t pixelHeight,
+												  int64 elapsedTime, int64 timeStamp) const
+	{
+		++allocations;
+		return cricket::VideoFrame::CreateEmptyFrame(width, height, pixelWidth, pixelHeight, elapsedTime, timeStamp);
+	};
+	
+	// Whole frame is filled with one value, so a torn frame is easy to spot.
+	void Fill(uint8 value)
+	{
+		memset(this->GetYPlane(), value, this->GetWidth() * this->GetHeight());
+		size_t chromaSize = (size_t)this->GetUPitch() * ((this->GetHeight() + 1) / 2);
+		memset(this->GetUPlane(), value, chromaSize);
+		memset(this->GetVPlane(), value, chromaSize);
+	};
+	
+	static std::atomic<int> allocations;
+};
+
+std::atomic<int> CountingVideoFrame::allocations(0);
+
+
+bool IsFilledWith(const cricket::VideoFrame *frame, uint8 value)
+{
+	const uint8 *yPlane = frame->GetYPlane();
+	size_t ySize = frame->GetWidth() * frame->GetHeight();
+	for (size_t i = 0; i < ySize; ++i) {
+		if (yPlane[i] != value) {
+			return false;
+		}
+	}
+	return frame->GetUPlane()[0] == value && frame->GetVPlane()[0] == value;
+}
+
+
+// VideoRenderer as platform renderers use it, but nothing is drawn.
+class HeadlessVideoRenderer : public VideoRenderer
+{
+public:
+	HeadlessVideoRenderer() : VideoRenderer(NULL, "headless", "track", "stream") {videoView_ = NULL;};
+	
+	virtual void RenderFrame(const cricket::VideoFrame *frame) {frameSlot_.PushFrame(frame);};
+	virtual void Shutdown() {};
+};
+
+
+bool Check(bool condition, const char *name, const char *details)
+{
+	printf("%-10s %s  %s\n", name, condition ? "PASS" : "FAIL", details);
+	return condition;
+}
+
+
+bool TestHold()
+{
+	HeadlessVideoRenderer renderer;
+	VideoFrameSlot *slot = renderer.frameSlot();
+	CountingVideoFrame frame(64, 48, 0);
+	
+	const int64 startUs = 1000000;
+	frame.Fill(1);
+	frame.SetTimeStamp(startUs * 1000);
+	renderer.RenderFrame(&frame);
+	const cricket::VideoFrame *drawn = slot->FrameToPresent(startUs, kDisplayRefreshUs);
+	if (!drawn || !IsFilledWith(drawn, 1)) {
+		return Check(false, "hold", "first frame hasn't been presented");
+	}
+	
+	// Next frame is far in the future, it is acquired but held.
+	frame.Fill(2);
+	frame.SetTimeStamp((startUs + 100000) * 1000);
+	renderer.RenderFrame(&frame);
+	const cricket::VideoFrame *held = slot->FrameToPresent(startUs + kDisplayRefreshUs, kDisplayRefreshUs);
+	
+	// Producer keeps going while display still draws the first frame.
+	for (int i = 0; i < 3; ++i) {
+		frame.Fill(3 + i);
+		frame.SetTimeStamp((startUs + 133000 + i * 33000) * 1000);
+		renderer.RenderFrame(&frame);
+	}
+	
+	return Check(!held && IsFilledWith(drawn, 1), "hold", "presented frame survives while next one is held");
+}
+
+
+bool TestTearing()
+{
+	HeadlessVideoRenderer renderer;
+	VideoFrameSlot *slot = renderer.frameSlot();
+	const int kFrames = 3000;
+	std::atomic<bool> producerDone(false);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	
+	std::thread producer([&]() {
+		CountingVideoFrame frame(320, 240, 0);
+		for (int i = 1; i <= kFrames; ++i) {
+			int64 nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			frame.Fill((uint8)(i & 0xFF));
+			// Bursts of early frames, so some of them are held by pacing.
+			frame.SetTimeStamp((nowUs + (i % 4) * 20000) * 1000);
+			renderer.RenderFrame(&frame);
+			if (i % 4 == 0) {
+				std::this_thread::sleep_for(std::chrono::microseconds(500));
+			}
+		}
+		producerDone.store(true);
+	});
+	
+	int presented = 0;
+	int draws = 0;
+	int tornDraws = 0;
+	const cricket::VideoFrame *drawn = NULL;
+	uint8 drawnValue = 0;
+	while (!producerDone.load()) {
+		int64 nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		const cricket::VideoFrame *frame = slot->FrameToPresent(nowUs, kDisplayRefreshUs);
+		if (frame) {
+			drawn = frame;
+			drawnValue = frame->GetYPlane()[0];
+			++presented;
+		}
+		// View redraws its current frame whenever GLKView asks, not only when a new one arrives.
+		for (int i = 0; drawn && i < 8; ++i) {
+			++draws;
+			if (!IsFilledWith(drawn, drawnValue)) {
+				++tornDraws;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	producer.join();
+	
+	char details[128];
+	snprintf(details, sizeof(details), "%d frames pushed, %d presented, %d of %d draws torn",
+			 kFrames, presented, tornDraws, draws);
+	return Check(presented > 0 && tornDraws == 0, "tearing", details);
+}
+
+
+bool TestPacing(int sourceFps, int expectedInterval)
+{
+	HeadlessVideoRenderer renderer;
+	VideoFrameSlot *slot = renderer.frameSlot();
+	CountingVideoFrame frame(64, 48, 0);
+	
+	const int64 sourceIntervalUs = 1000000 / sourceFps;
+	const int kFrames = 300;
+	int64 nextFrameUs = 0;
+	int pushed = 0;
+	int interval = 1;
+	int64 lastPollUs = -1;
+	
+	for (int64 refresh = 0; pushed < kFrames; ++refresh) {
+		int64 displayUs = refresh * kDisplayRefreshUs;
+		// Frames arrive with a little network jitter
+		while (pushed < kFrames && nextFrameUs + (pushed % 3) * 2000 <= displayUs) {
+			frame.SetTimeStamp(nextFrameUs * 1000);
+			renderer.RenderFrame(&frame);
+			++pushed;
+			nextFrameUs += sourceIntervalUs;
+		}
+		if (lastPollUs >= 0 && displayUs - lastPollUs < interval * kDisplayRefreshUs) {
+			continue;
+		}
+		slot->FrameToPresent(displayUs, interval * kDisplayRefreshUs);
+		interval = slot->PreferredRefreshInterval(kDisplayRefreshUs);
+		lastPollUs = displayUs;
+	}
+	
+	char name[16];
+	char details[128];
+	snprintf(name, sizeof(name), "pacing%d", sourceFps);
+	snprintf(details, sizeof(details), "%u pushed, %u presented, %u superseded, refresh interval %d",
+			 slot->framesPushed(), slot->framesPresented(), slot->framesSuperseded(), interval);
+	return Check(interval == expectedInterval && slot->framesSuperseded() == 0 &&
+				 slot->framesPresented() + 2 >= slot->framesPushed(), name, details);
+}
+
+
+bool TestVisibility()
+{
+	HeadlessVideoRenderer renderer;
+	VideoFrameSlot *slot = renderer.frameSlot();
+	CountingVideoFrame frame(64, 48, 1000);
+	
+	slot->SetVisible(false);
+	bool pushed = slot->PushFrame(&frame);
+	bool presented = slot->FrameToPresent(0, kDisplayRefreshUs) != NULL;
+	slot->SetVisible(true);
+	frame.SetTimeStamp(2000);
+	bool pushedVisible = slot->PushFrame(&frame);
+	
+	return Check(!pushed && !presented && pushedVisible, "visibility", "frames are dropped while slot is invisible");
+}
+
+
+bool TestReuse()
+{
+	HeadlessVideoRenderer renderer;
+	VideoFrameSlot *slot = renderer.frameSlot();
+	CountingVideoFrame small(320, 240, 0);
+	CountingVideoFrame large(640, 480, 0);
+	
+	CountingVideoFrame::allocations.store(0);
+	for (int i = 0; i < 1000; ++i) {
+		CountingVideoFrame &frame = i < 500 ? small : large;
+		frame.SetTimeStamp((int64)i * 33333 * 1000);
+		renderer.RenderFrame(&frame);
+		slot->FrameToPresent(i * 33333, kDisplayRefreshUs);
+	}
+	
+	char details[128];
+	snprintf(details, sizeof(details), "%d buffers allocated for 1000 frames of 2 sizes", CountingVideoFrame::allocations.load());
+	return Check(CountingVideoFrame::allocations.load() <= 8, "reuse", details);
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+	bool success = true;
+	success = TestHold() && success;
+	success = TestTearing() && success;
+	success = TestPacing(30, 2) && success;
+	success = TestPacing(24, 2) && success;
+	success = TestVisibility() && success;
+	success = TestReuse() && success;
+	
+	return success ? 0 : 1;
+}
@@ -0,0 +1,326 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WebSocketDeflate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <set>
+#include <sstream>
+
+using namespace spreedme;
+
+namespace spreedme {
+
+const char kPerMessageDeflateExtensionName[] = "permessage-deflate";
+
+} // namespace spreedme
+
+
+namespace {
+
+const unsigned char kDeflateMessageTail[4] = {0x00, 0x00, 0xFF, 0xFF};
+const size_t kCompressionBufferSize = 16 * 1024;
+
+
+std::string TrimmedString(const std::string &string)
+{
+	size_t begin = string.find_first_not_of(" \t");
+	if (begin == std::string::npos) {
+		return std::string();
+	}
+	size_t end = string.find_last_not_of(" \t");
+	return string.substr(begin, end - begin + 1);
+}
+
+
+std::string UnquotedString(const std::string &string)
+{
+	if (string.size() >= 2 && string[0] == '"' && string[string.size() - 1] == '"') {
+		return string.substr(1, string.size() - 2);
+	}
+	return string;
+}
+
+
+bool ParseWindowBits(const std::string &value, int *windowBits)
+{
+	if (value.empty() || value.size() > 2 || value.find_first_not_of("0123456789") != std::string::npos) {
+		return false;
+	}
+	int bits = atoi(value.c_str());
+	if (bits < 8 || bits > kPerMessageDeflateMaxWindowBits) {
+		return false;
+	}
+	*windowBits = bits;
+	return true;
+}
+
+
+std::string::size_type FindExtensionSeparator(const std::string &header, std::string::size_type start)
+{
+	bool inQuotes = false;
+	for (std::string::size_type i = start; i < header.size(); ++i) {
+		if (header[i] == '"') {
+			inQuotes = !inQuotes;
+		} else if (header[i] == ',' && !inQuotes) {
+			return i;
+		}
+	}
+	return std::string::npos;
+}
+
+} // namespace
+
+
+#pragma mark - PerMessageDeflateParameters
+
+std::string PerMessageDeflateParameters::ClientOffer(int serverMaxWindowBits, bool requestServerNoContextTakeover)
+{
+	std::ostringstream offer;
+	offer << kPerMessageDeflateExtensionName << "; client_max_window_bits";
+	if (serverMaxWindowBits >= kPerMessageDeflateMinWindowBits && serverMaxWindowBits < kPerMessageDeflateMaxWindowBits) {
+		offer << "; server_max_window_bits=" << serverMaxWindowBits;
+	}
+	if (requestServerNoContextTakeover) {
+		offer << "; server_no_context_takeover";
+	}
+	return offer.str();
+}
+
+
+bool PerMessageDeflateParameters::ParseServerResponse(const std::string &header, PerMessageDeflateParameters *params, bool *isValid)
+{
+	*isValid = true;
+	
+	std::string::size_type start = 0;
+	while (start < header.size()) {
+		std::string::size_type end = FindExtensionSeparator(header, start);
+		std::string extension = header.substr(start, end == std::string::npos ? std::string::npos : end - start);
+		start = (end == std::string::npos) ? header.size() : end + 1;
+		
+		std::istringstream extensionStream(extension);
+		std::string token;
+		std::getline(extensionStream, token, ';');
+		if (TrimmedString(token) != kPerMessageDeflateExtensionName) {
+			continue;
+		}
+		
+		PerMessageDeflateParameters parsed;
+		std::set<std::string> seenParameters;
+		
+		while (std::getline(extensionStream, token, ';')) {
+			token = TrimmedString(token);
+			std::string name = token;
+			std::string value;
+			std::string::size_type equalsSign = token.find('=');
+			if (equalsSign != std::string::npos) {
+				name = TrimmedString(token.substr(0, equalsSign));
+				value = UnquotedString(TrimmedString(token.substr(equalsSign + 1)));
+			}
+			
+			// Every parameter can be given only once
+			if (!seenParameters.insert(name).second) {
+				*isValid = false;
+				return false;
+			}
+			
+			bool parameterIsValid = false;
+			if (name == "client_no_context_takeover") {
+				parsed.clientNoContextTakeover = true;
+				parameterIsValid = value.empty();
+			} else if (name == "server_no_context_takeover") {
+				parsed.serverNoContextTakeover = true;
+				parameterIsValid = value.empty();
+			} else if (name == "client_max_window_bits") {
+				// Server may only lower our window, we can't go below what zlib supports
+				parameterIsValid = ParseWindowBits(value, &parsed.clientMaxWindowBits) &&
+					parsed.clientMaxWindowBits >= kPerMessageDeflateMinWindowBits;
+			} else if (name == "server_max_window_bits") {
+				parameterIsValid = ParseWindowBits(value, &parsed.serverMaxWindowBits);
+			}
+			
+			if (!parameterIsValid) {
+				*isValid = false;
+				return false;
+			}
+		}
+		
+		*params = parsed;
+		return true;
+	}
+	
+	return false;
+}
+
+
+#pragma mark - PerMessageDeflater
+
+PerMessageDeflater::PerMessageDeflater(int windowBits, bool noContextTakeover, int compressionLevel) :
+	initialized_(false),
+	noContextTakeover_(noContextTakeover)
+{
+	if (windowBits < kPerMessageDeflateMinWindowBits) {
+		windowBits = kPerMessageDeflateMinWindowBits;
+	} else if (windowBits > kPerMessageDeflateMaxWindowBits) {
+		windowBits = kPerMessageDeflateMaxWindowBits;
+	}
+	
+	memset(&stream_, 0, sizeof(stream_));
+	// Negative window bits produce raw deflate stream without zlib header and checksum.
+	// Memory level 8 is zlib default, window size is what really matters for our json.
+	initialized_ = (deflateInit2(&stream_, compressionLevel, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+
+PerMessageDeflater::~PerMessageDeflater()
+{
+	if (initialized_) {
+		deflateEnd(&stream_);
+	}
+}
+
+
+bool PerMessageDeflater::Compress(const char *data, size_t size, std::string *out)
+{
+	out->clear();
+	if (!initialized_) {
+		return false;
+	}
+	
+	unsigned char buffer[kCompressionBufferSize];
+	
+	stream_.next_in = (Bytef *)data;
+	stream_.avail_in = (uInt)size;
+	
+	int result = Z_OK;
+	do {
+		stream_.next_out = buffer;
+		stream_.avail_out = sizeof(buffer);
+		result = deflate(&stream_, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR) {
+			deflateReset(&stream_);
+			out->clear();
+			return false;
+		}
+		out->append((const char *)buffer, sizeof(buffer) - stream_.avail_out);
+	} while (stream_.avail_out == 0);
+	
+	// Sync flush always ends with empty stored block which RFC 7692 requires us to remove.
+	if (out->size() >= sizeof(kDeflateMessageTail) &&
+		memcmp(out->data() + out->size() - sizeof(kDeflateMessageTail), kDeflateMessageTail, sizeof(kDeflateMessageTail)) == 0) {
+		out->resize(out->size() - sizeof(kDeflateMessageTail));
+	}
+	
+	if (noContextTakeover_) {
+		deflateReset(&stream_);
+	}
+	
+	return true;
+}
+
+
+#pragma mark - PerMessageInflater
+
+PerMessageInflater::PerMessageInflater(int windowBits, bool noContextTakeover, size_t maxMessageSize) :
+	initialized_(false),
+	noContextTakeover_(noContextTakeover),
+	maxMessageSize_(maxMessageSize)
+{
+	if (windowBits < 8) {
+		windowBits = 8;
+	} else if (windowBits > kPerMessageDeflateMaxWindowBits) {
+		windowBits = kPerMessageDeflateMaxWindowBits;
+	}
+	
+	memset(&stream_, 0, sizeof(stream_));
+	initialized_ = (inflateInit2(&stream_, -windowBits) == Z_OK);
+}
+
+
+PerMessageInflater::~PerMessageInflater()
+{
+	if (initialized_) {
+		inflateEnd(&stream_);
+	}
+}
+
+
+bool PerMessageInflater::Decompress(const char *data, size_t size, std::string *out)
+{
+	out->clear();
+	if (!initialized_) {
+		return false;
+	}
+	
+	// Put back the tail which sender has removed, otherwise inflate would wait for more data.
+	bool success = this->Inflate((const unsigned char *)data, size, out) &&
+		this->Inflate(kDeflateMessageTail, sizeof(kDeflateMessageTail), out);
+	
+	if (!success) {
+		// Window state is unknown after error, so the next message can't rely on it.
+		inflateReset(&stream_);
+		out->clear();
+	} else if (noContextTakeover_) {
+		inflateReset(&stream_);
+	}
+	
+	return success;
+}
+
+
+bool PerMessageInflater::Inflate(const unsigned char *data, size_t size, std::string *out)
+{
+	unsigned char buffer[kCompressionBufferSize];
+	
+	stream_.next_in = (Bytef *)data;
+	stream_.avail_in = (uInt)size;
+	
+	// Keep going while there is input or output buffer was too small to take everything
+	do {
+		stream_.next_out = buffer;
+		stream_.avail_out = sizeof(buffer);
+		int result = inflate(&stream_, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END) {
+			return false;
+		}
+		
+		size_t produced = sizeof(buffer) - stream_.avail_out;
+		if (maxMessageSize_ > 0 && out->size() + produced > maxMessageSize_) {
+			return false;
+		}
+		out->append((const char *)buffer, produced);
+		
+		if (result == Z_STREAM_END) {
+			// Sender has finished its deflate stream with final block, next message starts a new one.
+			inflateReset(&stream_);
+			break;
+		}
+		if (result == Z_BUF_ERROR && produced == 0) {
+			// No progress is possible. This is fine only if all input has been consumed.
+			return (stream_.avail_in == 0);
+		}
+	} while (stream_.avail_in > 0 || stream_.avail_out == 0);
+	
+	return true;
+}
@@ -0,0 +1,115 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SpreedME__WebSocketDeflate__
+#define __SpreedME__WebSocketDeflate__
+
+// permessage-deflate websocket extension (RFC 7692): extension negotiation and message codec.
+// Lives here with the benchmark until websocket driver used by the app (PocketSocket) can negotiate
+// extensions and set RSV1, then it should move to Classes/cpp and be called from SMWebSocketController.
+// It should not depend on webrtc or Objective-C.
+
+#include <stddef.h>
+
+#include <string>
+
+#include <zlib.h>
+
+
+namespace spreedme {
+
+extern const char kPerMessageDeflateExtensionName[];
+	
+const int kPerMessageDeflateMinWindowBits = 9; // zlib can't produce raw deflate streams with 8 bit window
+const int kPerMessageDeflateMaxWindowBits = 15;
+
+
+struct PerMessageDeflateParameters
+{
+	PerMessageDeflateParameters() :
+		clientNoContextTakeover(false),
+		serverNoContextTakeover(false),
+		clientMaxWindowBits(kPerMessageDeflateMaxWindowBits),
+		serverMaxWindowBits(kPerMessageDeflateMaxWindowBits) {};
+	
+	bool clientNoContextTakeover;
+	bool serverNoContextTakeover;
+	int clientMaxWindowBits;
+	int serverMaxWindowBits;
+	
+	// Value of Sec-WebSocket-Extensions header which client sends in opening handshake.
+	// Client always announces that it supports client_max_window_bits.
+	static std::string ClientOffer(int serverMaxWindowBits, bool requestServerNoContextTakeover);
+	
+	// Parses Sec-WebSocket-Extensions header from server handshake response.
+	// Returns false if server hasn't accepted permessage-deflate or if response can't be honored,
+	// in the latter case 'isValid' is set to false and connection should be failed as RFC requires.
+	static bool ParseServerResponse(const std::string &header, PerMessageDeflateParameters *params, bool *isValid);
+};
+
+
+// Compresses payloads of outgoing messages. With context takeover LZ77 window is kept between messages
+// so repeated keys and ids of our json envelopes cost only a few bytes after the first message.
+class PerMessageDeflater
+{
+public:
+	PerMessageDeflater(int windowBits, bool noContextTakeover, int compressionLevel = Z_DEFAULT_COMPRESSION);
+	~PerMessageDeflater();
+	
+	// Returns payload to be sent in frames with RSV1 bit set.
+	bool Compress(const char *data, size_t size, std::string *out);
+	
+private:
+	PerMessageDeflater(const PerMessageDeflater &);
+	PerMessageDeflater &operator=(const PerMessageDeflater &);
+	
+	z_stream stream_;
+	bool initialized_;
+	bool noContextTakeover_;
+};
+
+
+// Decompresses payloads of incoming messages which had RSV1 bit set in their first frame.
+class PerMessageInflater
+{
+public:
+	// 'maxMessageSize' protects from decompression bombs, 0 means no limit.
+	PerMessageInflater(int windowBits, bool noContextTakeover, size_t maxMessageSize);
+	~PerMessageInflater();
+	
+	bool Decompress(const char *data, size_t size, std::string *out);
+	
+private:
+	PerMessageInflater(const PerMessageInflater &);
+	PerMessageInflater &operator=(const PerMessageInflater &);
+	
+	bool Inflate(const unsigned char *data, size_t size, std::string *out);
+	
+	z_stream stream_;
+	bool initialized_;
+	bool noContextTakeover_;
+	size_t maxMessageSize_;
+};
+
+} // namespace spreedme
+
+#endif /* defined(__SpreedME__WebSocketDeflate__) */
@@ -0,0 +1,227 @@
+/**
+ * @copyright Copyright (c) 2017 Struktur AG
+ * @author Yuriy Shevchuk
+ * @author Ivan Sein <ivan@nextcloud.com>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Measures how much permessage-deflate (spreedme::PerMessageDeflater) saves on recorded channeling traffic.
+// Every message is compressed as client would send it and inflated back to check the round trip.
+//
+// Build on Linux:
+//   c++ -std=c++11 -O2 websocket_deflate_bench.cc WebSocketDeflate.cc -lz -o websocket_deflate_bench
+//
+// Usage:
+//   websocket_deflate_bench file [file ...]
+// Input files contain one websocket message per line, in the order they were sent or received,
+// or are recordings written by SignallingTrafficRecorder.
+// Envelope newlines written by SignallingHandler::WrapJsonStringBeforeSendingToSignallingServer are insignificant
+// json whitespace and should be removed when traffic is recorded.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "WebSocketDeflate.h"
+
+using namespace spreedme;
+
+
+namespace {
+
+struct Configuration
+{
+	const char *name;
+	bool compress;
+	int windowBits;
+	bool noContextTakeover;
+};
+
+
+const Configuration kConfigurations[] = {
+	{"uncompressed", false, 15, false},
+	{"deflate, context takeover, 15 bit window", true, 15, false},
+	{"deflate, context takeover, 10 bit window", true, 10, false},
+	{"deflate, no context takeover, 15 bit window", true, 15, true},
+};
+
+
+struct TypeTotals
+{
+	TypeTotals() : messages(0), logicalBytes(0), wireBytes(0) {};
+	
+	uint64_t messages;
+	uint64_t logicalBytes;
+	uint64_t wireBytes;
+};
+
+
+// Client to server frames are masked. We count one frame per message as our messages are never fragmented.
+size_t FrameOverhead(size_t payloadSize)
+{
+	size_t lengthSize = 0;
+	if (payloadSize > 0xFFFF) {
+		lengthSize = 8;
+	} else if (payloadSize > 125) {
+		lengthSize = 2;
+	}
+	return 2 + lengthSize + 4;
+}
+
+
+// Good enough to group our envelopes, doesn't try to be a json parser.
+std::string MessageType(const std::string &message)
+{
+	const std::string typeKey = "\"Type\"";
+	std::string::size_type position = message.find(typeKey);
+	if (position == std::string::npos) {
+		return "unknown";
+	}
+	std::string::size_type begin = message.find('"', message.find(':', position + typeKey.size()));
+	std::string::size_type end = (begin == std::string::npos) ? std::string::npos : message.find('"', begin + 1);
+	if (end == std::string::npos) {
+		return "unknown";
+	}
+	return message.substr(begin + 1, end - begin - 1);
+}
+
+
+bool ReadMessages(const char *path, std::vector<std::string> *messages)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file.is_open()) {
+		fprintf(stderr, "Couldn't open %s\n", path);
+		return false;
+	}
+	
+	std::string line;
+	while (std::getline(file, line)) {
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		if (line[0] != '{') {
+			// SignallingTrafficRecorder line: <ms> <direction> <message>. Messages received peer to peer are not websocket traffic.
+			std::string::size_type directionPosition = line.find(' ');
+			if (directionPosition == std::string::npos || directionPosition + 3 > line.size() ||
+				line[directionPosition + 1] == 'p') {
+				continue;
+			}
+			line.erase(0, directionPosition + 3);
+		}
+		messages->push_back(line);
+	}
+	return true;
+}
+
+
+bool RunConfiguration(const Configuration &configuration, const std::vector<std::string> &messages, bool printTypes)
+{
+	PerMessageDeflater deflater(configuration.windowBits, configuration.noContextTakeover);
+	PerMessageInflater inflater(configuration.windowBits, configuration.noContextTakeover, 0);
+	
+	uint64_t logicalBytes = 0;
+	uint64_t wireBytes = 0;
+	std::chrono::steady_clock::duration compressionTime = std::chrono::steady_clock::duration::zero();
+	std::map<std::string, TypeTotals> types;
+	
+	std::string compressed;
+	std::string inflated;
+	for (size_t i = 0; i < messages.size(); ++i) {
+		const std::string &message = messages[i];
+		size_t payloadSize = message.size();
+		
+		if (configuration.compress) {
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool success = deflater.Compress(message.data(), message.size(), &compressed);
+			compressionTime += std::chrono::steady_clock::now() - start;
+			
+			if (!success || !inflater.Decompress(compressed.data(), compressed.size(), &inflated) || inflated != message) {
+				fprintf(stderr, "%s: round trip has failed for message %zu\n", configuration.name, i + 1);
+				return false;
+			}
+			payloadSize = compressed.size();
+		}
+		
+		size_t messageWireBytes = payloadSize + FrameOverhead(payloadSize);
+		logicalBytes += message.size();
+		wireBytes += messageWireBytes;
+		
+		TypeTotals &totals = types[MessageType(message)];
+		totals.messages += 1;
+		totals.logicalBytes += message.size();
+		totals.wireBytes += messageWireBytes;
+	}
+	
+	double compressionUs = std::chrono::duration<double, std::micro>(compressionTime).count();
+	printf("%-46s logical %10llu B  wire %10llu B  ratio %5.1f%%  compression %8.1f us/message\n",
+		   configuration.name,
+		   (unsigned long long)logicalBytes,
+		   (unsigned long long)wireBytes,
+		   logicalBytes ? 100.0 * wireBytes / logicalBytes : 0.0,
+		   messages.empty() ? 0.0 : compressionUs / messages.size());
+	
+	if (printTypes) {
+		for (std::map<std::string, TypeTotals>::iterator it = types.begin(); it != types.end(); ++it) {
+			printf("    %-20s %8llu messages  logical %10llu B  wire %10llu B  ratio %5.1f%%\n",
+				   it->first.c_str(),
+				   (unsigned long long)it->second.messages,
+				   (unsigned long long)it->second.logicalBytes,
+				   (unsigned long long)it->second.wireBytes,
+				   it->second.logicalBytes ? 100.0 * it->second.wireBytes / it->second.logicalBytes : 0.0);
+		}
+	}
+	
+	return true;
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s file [file ...]\n", argv[0]);
+		return 1;
+	}
+	
+	std::vector<std::string> messages;
+	for (int i = 1; i < argc; ++i) {
+		if (!ReadMessages(argv[i], &messages)) {
+			return 1;
+		}
+	}
+	
+	printf("%zu messages\n", messages.size());
+	
+	bool success = true;
+	size_t numberOfConfigurations = sizeof(kConfigurations) / sizeof(kConfigurations[0]);
+	for (size_t i = 0; i < numberOfConfigurations; ++i) {
+		// Breakdown by message type is shown for the configuration we negotiate by default
+		success = RunConfiguration(kConfigurations[i], messages, i == 1) && success;
+	}
+	
+	return success ? 0 : 1;
+}